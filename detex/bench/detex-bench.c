@@ -0,0 +1,527 @@
+/*
+
+Copyright (c) 2015 Harm Hanemaaijer <fgenfb@yahoo.com>
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+*/
+
+/*
+ * Benchmarks for the block decoders, pixel conversions and texture file
+ * loaders. Every benchmark is repeated until it has run for a minimum time,
+ * and reports its throughput in MB/s (of input data), blocks/s and ns/block,
+ * as text or as JSON (--json) to track regressions across builds.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#    define WIN32_LEAN_AND_MEAN
+#    include <windows.h>
+#else
+#    include <time.h>
+#endif
+
+#include "detex.h"
+
+// Size of the generated textures in pixels, 4096 blocks.
+#define BENCH_TEXTURE_SIZE 256
+// Size of the BPTC texture decoded by the thread scaling benchmark, 262144 blocks.
+#define BENCH_SCALING_TEXTURE_SIZE 2048
+// Size of the top level of the textures used for the file benchmarks.
+#define BENCH_FILE_TEXTURE_SIZE 512
+#define BENCH_MAX_LEVELS 16
+
+// Every compressed format with a decoder (see decompress_function[] in texture.c).
+static const uint32_t decoder_formats[] = {
+    DETEX_TEXTURE_FORMAT_BC1,
+    DETEX_TEXTURE_FORMAT_BC1A,
+    DETEX_TEXTURE_FORMAT_BC2,
+    DETEX_TEXTURE_FORMAT_BC3,
+    DETEX_TEXTURE_FORMAT_RGTC1,
+    DETEX_TEXTURE_FORMAT_SIGNED_RGTC1,
+    DETEX_TEXTURE_FORMAT_RGTC2,
+    DETEX_TEXTURE_FORMAT_SIGNED_RGTC2,
+    DETEX_TEXTURE_FORMAT_BPTC_FLOAT,
+    DETEX_TEXTURE_FORMAT_BPTC_SIGNED_FLOAT,
+    DETEX_TEXTURE_FORMAT_BPTC,
+    DETEX_TEXTURE_FORMAT_ETC1,
+    DETEX_TEXTURE_FORMAT_ETC2,
+    DETEX_TEXTURE_FORMAT_ETC2_PUNCHTHROUGH,
+    DETEX_TEXTURE_FORMAT_ETC2_EAC,
+    DETEX_TEXTURE_FORMAT_EAC_R11,
+    DETEX_TEXTURE_FORMAT_EAC_SIGNED_R11,
+    DETEX_TEXTURE_FORMAT_EAC_RG11,
+    DETEX_TEXTURE_FORMAT_EAC_SIGNED_RG11,
+};
+
+// Common conversions, as used when decompressing and saving textures. The
+// library only names texture formats, so the pixel formats are named here.
+typedef struct {
+    const char *name;
+    uint32_t source_format;
+    uint32_t target_format;
+} Conversion;
+
+static const Conversion conversions[] = {
+    {"RGBA8/BGRA8", DETEX_PIXEL_FORMAT_RGBA8, DETEX_PIXEL_FORMAT_BGRA8},
+    {"RGBX8/RGB8", DETEX_PIXEL_FORMAT_RGBX8, DETEX_PIXEL_FORMAT_RGB8},
+    {"RGB8/RGBX8", DETEX_PIXEL_FORMAT_RGB8, DETEX_PIXEL_FORMAT_RGBX8},
+    {"RGB8/BGRX8", DETEX_PIXEL_FORMAT_RGB8, DETEX_PIXEL_FORMAT_BGRX8},
+    {"RGBA8/R8", DETEX_PIXEL_FORMAT_RGBA8, DETEX_PIXEL_FORMAT_R8},
+    {"RGBA8/RG8", DETEX_PIXEL_FORMAT_RGBA8, DETEX_PIXEL_FORMAT_RG8},
+    {"R8/RGBX8", DETEX_PIXEL_FORMAT_R8, DETEX_PIXEL_FORMAT_RGBX8},
+    {"RG8/RGBX8", DETEX_PIXEL_FORMAT_RG8, DETEX_PIXEL_FORMAT_RGBX8},
+    {"SIGNED_RG8/RG8", DETEX_PIXEL_FORMAT_SIGNED_RG8, DETEX_PIXEL_FORMAT_RG8},
+    {"RGBA8/RGBA16", DETEX_PIXEL_FORMAT_RGBA8, DETEX_PIXEL_FORMAT_RGBA16},
+    {"RGBA16/RGBA8", DETEX_PIXEL_FORMAT_RGBA16, DETEX_PIXEL_FORMAT_RGBA8},
+    {"RGBX16/FLOAT_RGBX16", DETEX_PIXEL_FORMAT_RGBX16, DETEX_PIXEL_FORMAT_FLOAT_RGBX16},
+    {"FLOAT_RGBX16/RGBX16", DETEX_PIXEL_FORMAT_FLOAT_RGBX16, DETEX_PIXEL_FORMAT_RGBX16},
+    {"FLOAT_RGBX16/FLOAT_RGBX32", DETEX_PIXEL_FORMAT_FLOAT_RGBX16, DETEX_PIXEL_FORMAT_FLOAT_RGBX32},
+    {"FLOAT_RGBX32/FLOAT_RGBX16", DETEX_PIXEL_FORMAT_FLOAT_RGBX32, DETEX_PIXEL_FORMAT_FLOAT_RGBX16},
+    {"FLOAT_RGBX16/RGBA8", DETEX_PIXEL_FORMAT_FLOAT_RGBX16, DETEX_PIXEL_FORMAT_RGBA8},
+};
+
+// Formats saved and loaded by the file benchmarks.
+static const uint32_t file_formats[] = {DETEX_TEXTURE_FORMAT_BC1, DETEX_TEXTURE_FORMAT_BC3};
+
+typedef enum {
+    FILE_TYPE_DDS,
+    FILE_TYPE_KTX,
+    FILE_TYPE_TEX,
+} FILE_TYPE;
+
+static const char *file_type_names[] = {"DDS", "KTX", "TEX"};
+static const char *file_type_extensions[] = {"dds", "ktx", "tex"};
+
+static double min_time = 0.25;
+static uint32_t seed = 1;
+static const char *filter = NULL;
+static const char *tmp_dir = ".";
+// Largest number of workers of the thread scaling benchmark, zero for the number of processors.
+static int max_threads = 0;
+static bool json = false;
+static int nu_results = 0;
+
+static double GetTime() {
+#ifdef _WIN32
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (double)counter.QuadPart / frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+// Seeded xorshift random number generator, so that every run uses the same data.
+static uint32_t random_state;
+
+static uint32_t Random() {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+static void FillRandom(uint8_t *data, size_t size) {
+    for (size_t i = 0; i < size; i++) data[i] = (uint8_t)(Random() >> 24);
+}
+
+typedef void (*BenchFuncType)(void *context);
+
+// Run func until it has run for at least min_time, then report the average time per call.
+// bytes and nu_blocks are the amount of data processed by one call. When reference_seconds
+// is positive, the speedup relative to it is reported as well. Returns the time per call, or
+// zero when the benchmark is filtered out.
+static double RunBenchmark(
+    const char *name, BenchFuncType func, void *context, double bytes, double nu_blocks, double reference_seconds) {
+    if (filter != NULL && strstr(name, filter) == NULL) return 0;
+    func(context);
+    int64_t iterations = 1;
+    double elapsed_time;
+    for (;;) {
+        double start_time = GetTime();
+        for (int64_t i = 0; i < iterations; i++) func(context);
+        elapsed_time = GetTime() - start_time;
+        if (elapsed_time >= min_time || iterations >= ((int64_t)1 << 40)) break;
+        // Aim for the minimum time, at most growing tenfold at a time.
+        double factor = elapsed_time > 0 ? min_time * 1.1 / elapsed_time : 10;
+        iterations = (int64_t)(iterations * (factor > 10 ? 10 : factor < 2 ? 2 : factor));
+    }
+    double seconds = elapsed_time / iterations;
+    double mb_per_s = bytes / seconds / (1024.0 * 1024.0);
+    double blocks_per_s = nu_blocks / seconds;
+    double ns_per_block = seconds * 1e9 / nu_blocks;
+    double speedup = reference_seconds > 0 ? reference_seconds / seconds : 0;
+    if (json) {
+        printf("%s\n    {\"name\": \"%s\", \"iterations\": %lld, \"seconds\": %.9g, \"bytes\": %.0f, \"blocks\": %.0f, "
+               "\"mb_per_s\": %.3f, \"blocks_per_s\": %.1f, \"ns_per_block\": %.3f",
+               nu_results > 0 ? "," : "",
+               name,
+               (long long)iterations,
+               seconds,
+               bytes,
+               nu_blocks,
+               mb_per_s,
+               blocks_per_s,
+               ns_per_block);
+        if (speedup > 0) printf(", \"speedup\": %.3f", speedup);
+        printf("}");
+    } else {
+        printf("%-48s %10.1f MB/s %14.0f blocks/s %10.2f ns/block", name, mb_per_s, blocks_per_s, ns_per_block);
+        if (speedup > 0) printf(" %6.2fx", speedup);
+        printf("\n");
+    }
+    fflush(stdout);
+    nu_results++;
+    return seconds;
+}
+
+// Generate nu_blocks seeded random blocks. When valid is set, blocks that the
+// decoder rejects are regenerated (up to a limit), so that the benchmark
+// measures the decoding of valid blocks rather than the rejection of invalid ones.
+static uint8_t *GenerateBlocks(uint32_t texture_format, int nu_blocks, bool valid) {
+    uint32_t block_size = detexGetCompressedBlockSize(texture_format);
+    uint8_t *data = (uint8_t *)malloc((size_t)nu_blocks * block_size);
+    uint8_t pixel_buffer[DETEX_MAX_BLOCK_SIZE];
+    for (int i = 0; i < nu_blocks; i++) {
+        uint8_t *block = data + (size_t)i * block_size;
+        for (int tries = 0; tries < 1000; tries++) {
+            FillRandom(block, block_size);
+            if (!valid || detexDecompressBlock(block,
+                                               texture_format,
+                                               DETEX_MODE_MASK_ALL,
+                                               0,
+                                               pixel_buffer,
+                                               detexGetPixelFormat(texture_format)))
+                break;
+        }
+    }
+    return data;
+}
+
+typedef struct {
+    detexTexture texture;
+    uint8_t *pixel_buffer;
+} DecodeContext;
+
+static void DecodeBlocks(void *context) {
+    DecodeContext *c = (DecodeContext *)context;
+    uint32_t block_size = detexGetCompressedBlockSize(c->texture.format);
+    uint32_t pixel_format = detexGetPixelFormat(c->texture.format);
+    uint32_t tile_size = detexGetPixelSize(pixel_format) * 16;
+    int nu_blocks = c->texture.width_in_blocks * c->texture.height_in_blocks;
+    for (int i = 0; i < nu_blocks; i++)
+        detexDecompressBlock(c->texture.data + i * block_size,
+                             c->texture.format,
+                             DETEX_MODE_MASK_ALL,
+                             0,
+                             c->pixel_buffer + i * tile_size,
+                             pixel_format);
+}
+
+static void DecodeTextureTiled(void *context) {
+    DecodeContext *c = (DecodeContext *)context;
+    detexDecompressTextureTiled(&c->texture, c->pixel_buffer, detexGetPixelFormat(c->texture.format));
+}
+
+static void BenchmarkDecoders() {
+    int nu_blocks = (BENCH_TEXTURE_SIZE / 4) * (BENCH_TEXTURE_SIZE / 4);
+    for (int i = 0; i < sizeof(decoder_formats) / sizeof(decoder_formats[0]); i++) {
+        uint32_t format = decoder_formats[i];
+        for (int valid = 0; valid <= 1; valid++) {
+            DecodeContext c;
+            c.texture.format = format;
+            c.texture.width = BENCH_TEXTURE_SIZE;
+            c.texture.height = BENCH_TEXTURE_SIZE;
+            c.texture.width_in_blocks = BENCH_TEXTURE_SIZE / 4;
+            c.texture.height_in_blocks = BENCH_TEXTURE_SIZE / 4;
+            c.texture.flags = 0;
+            c.texture.data = GenerateBlocks(format, nu_blocks, valid);
+            c.pixel_buffer = (uint8_t *)malloc((size_t)nu_blocks * DETEX_MAX_BLOCK_SIZE);
+            double bytes = (double)nu_blocks * detexGetCompressedBlockSize(format);
+            const char *data_name = valid ? "valid" : "random";
+            char name[128];
+            snprintf(name, sizeof(name), "decode/%s/%s/block", detexGetTextureFormatText(format), data_name);
+            RunBenchmark(name, DecodeBlocks, &c, bytes, nu_blocks, 0);
+            snprintf(name, sizeof(name), "decode/%s/%s/tiled", detexGetTextureFormatText(format), data_name);
+            RunBenchmark(name, DecodeTextureTiled, &c, bytes, nu_blocks, 0);
+            free(c.texture.data);
+            free(c.pixel_buffer);
+        }
+    }
+}
+
+typedef struct {
+    DecodeContext decode;
+    int nu_threads;
+} ParallelDecodeContext;
+
+static void DecodeTextureLinearParallel(void *context) {
+    ParallelDecodeContext *c = (ParallelDecodeContext *)context;
+    detexDecompressTextureLinearParallel(
+        &c->decode.texture, c->decode.pixel_buffer, DETEX_PIXEL_FORMAT_RGBA8, c->nu_threads);
+}
+
+// Decode a large BPTC texture with 1, 2, 4, ... workers up to max_threads (by
+// default the number of processors), and report the speedup relative to a
+// single worker.
+static void BenchmarkThreadScaling() {
+    int nu_blocks = (BENCH_SCALING_TEXTURE_SIZE / 4) * (BENCH_SCALING_TEXTURE_SIZE / 4);
+    ParallelDecodeContext c;
+    c.decode.texture.format = DETEX_TEXTURE_FORMAT_BPTC;
+    c.decode.texture.width = BENCH_SCALING_TEXTURE_SIZE;
+    c.decode.texture.height = BENCH_SCALING_TEXTURE_SIZE;
+    c.decode.texture.width_in_blocks = BENCH_SCALING_TEXTURE_SIZE / 4;
+    c.decode.texture.height_in_blocks = BENCH_SCALING_TEXTURE_SIZE / 4;
+    c.decode.texture.flags = 0;
+    c.decode.texture.data = NULL;
+    c.decode.pixel_buffer = NULL;
+    double bytes = (double)nu_blocks * detexGetCompressedBlockSize(DETEX_TEXTURE_FORMAT_BPTC);
+    int nu_max_threads = max_threads > 0 ? max_threads : detexGetNumberOfProcessors();
+    double reference_seconds = 0;
+    for (int nu_threads = 1;; nu_threads = nu_threads * 2 < nu_max_threads ? nu_threads * 2 : nu_max_threads) {
+        char name[128];
+        snprintf(name, sizeof(name), "parallel/BPTC/threads=%d", nu_threads);
+        if (filter == NULL || strstr(name, filter) != NULL) {
+            // Generate the texture on first use only, it is large.
+            if (c.decode.texture.data == NULL) {
+                c.decode.texture.data = GenerateBlocks(DETEX_TEXTURE_FORMAT_BPTC, nu_blocks, true);
+                c.decode.pixel_buffer = (uint8_t *)malloc((size_t)nu_blocks * 64);
+            }
+            c.nu_threads = nu_threads;
+            double seconds = RunBenchmark(name, DecodeTextureLinearParallel, &c, bytes, nu_blocks, reference_seconds);
+            if (nu_threads == 1) reference_seconds = seconds;
+        }
+        if (nu_threads >= nu_max_threads) break;
+    }
+    free(c.decode.texture.data);
+    free(c.decode.pixel_buffer);
+}
+
+typedef struct {
+    uint8_t *source;
+    uint8_t *target;
+    int nu_pixels;
+    uint32_t source_format;
+    uint32_t target_format;
+} ConvertContext;
+
+static void ConvertPixels(void *context) {
+    ConvertContext *c = (ConvertContext *)context;
+    detexConvertPixels(c->source, c->nu_pixels, c->source_format, c->target, c->target_format);
+}
+
+static void BenchmarkConversions() {
+    int nu_pixels = BENCH_TEXTURE_SIZE * BENCH_TEXTURE_SIZE;
+    uint8_t *pixels = (uint8_t *)malloc((size_t)nu_pixels * 4);
+    for (int i = 0; i < sizeof(conversions) / sizeof(conversions[0]); i++) {
+        ConvertContext c;
+        c.nu_pixels = nu_pixels;
+        c.source_format = conversions[i].source_format;
+        c.target_format = conversions[i].target_format;
+        c.source = (uint8_t *)malloc((size_t)nu_pixels * detexGetPixelSize(c.source_format));
+        c.target = (uint8_t *)malloc((size_t)nu_pixels * detexGetPixelSize(c.target_format));
+        // Generate the source pixels from random RGBA8 pixels, so that float
+        // formats get values in the normal range.
+        FillRandom(pixels, (size_t)nu_pixels * 4);
+        char name[128];
+        snprintf(name, sizeof(name), "convert/%s", conversions[i].name);
+        if (!detexConvertPixels(pixels, nu_pixels, DETEX_PIXEL_FORMAT_RGBA8, c.source, c.source_format) ||
+            !detexConvertPixels(c.source, nu_pixels, c.source_format, c.target, c.target_format)) {
+            fprintf(stderr, "%s: %s\n", name, detexGetErrorMessage());
+        } else {
+            double bytes = (double)nu_pixels * detexGetPixelSize(c.source_format);
+            RunBenchmark(name, ConvertPixels, &c, bytes, nu_pixels / 16, 0);
+        }
+        free(c.source);
+        free(c.target);
+    }
+    free(pixels);
+}
+
+typedef struct {
+    FILE_TYPE type;
+    const char *filename;
+    detexTexture *textures[BENCH_MAX_LEVELS];
+    int nu_levels;
+} FileContext;
+
+static bool SaveFile(FILE_TYPE type, const char *filename, detexTexture **textures, int nu_levels) {
+    switch (type) {
+        case FILE_TYPE_DDS:
+            return detexFileSaveDDS(filename, textures, nu_levels);
+        case FILE_TYPE_KTX:
+            return detexFileSaveKTX(filename, textures, nu_levels);
+        case FILE_TYPE_TEX:
+            return detexFileSaveTEX(filename, textures, nu_levels);
+    }
+    return false;
+}
+
+static void SaveFileFunc(void *context) {
+    FileContext *c = (FileContext *)context;
+    SaveFile(c->type, c->filename, c->textures, c->nu_levels);
+}
+
+static void LoadFileFunc(void *context) {
+    FileContext *c = (FileContext *)context;
+    detexTexture **textures;
+    int nu_levels;
+    bool r = false;
+    switch (c->type) {
+        case FILE_TYPE_DDS:
+            r = detexFileLoadDDS(c->filename, BENCH_MAX_LEVELS, &textures, &nu_levels);
+            break;
+        case FILE_TYPE_KTX:
+            r = detexFileLoadKTX(c->filename, BENCH_MAX_LEVELS, &textures, &nu_levels);
+            break;
+        case FILE_TYPE_TEX:
+            r = detexFileLoadTEX(c->filename, BENCH_MAX_LEVELS, &textures, &nu_levels);
+            break;
+    }
+    if (r) detexFreeTextures(textures, nu_levels);
+}
+
+static void MapFileFunc(void *context) {
+    FileContext *c = (FileContext *)context;
+    detexTexture **textures;
+    int nu_levels;
+    detexFileMapping *mapping;
+    bool r = false;
+    switch (c->type) {
+        case FILE_TYPE_DDS:
+            r = detexFileMapDDS(c->filename, BENCH_MAX_LEVELS, &textures, &nu_levels, &mapping);
+            break;
+        case FILE_TYPE_KTX:
+            r = detexFileMapKTX(c->filename, BENCH_MAX_LEVELS, &textures, &nu_levels, &mapping);
+            break;
+        case FILE_TYPE_TEX:
+            r = detexFileMapTEX(c->filename, BENCH_MAX_LEVELS, &textures, &nu_levels, &mapping);
+            break;
+    }
+    if (r) {
+        detexFreeTextures(textures, nu_levels);
+        detexFileUnmap(mapping);
+    }
+}
+
+static void BenchmarkFiles() {
+    for (int i = 0; i < sizeof(file_formats) / sizeof(file_formats[0]); i++) {
+        uint32_t format = file_formats[i];
+        uint32_t block_size = detexGetCompressedBlockSize(format);
+        // A texture with a full mip-map chain.
+        FileContext c;
+        c.nu_levels = 0;
+        double bytes = 0;
+        double nu_blocks = 0;
+        for (int size = BENCH_FILE_TEXTURE_SIZE; size >= 1; size /= 2) {
+            detexTexture *texture = (detexTexture *)malloc(sizeof(detexTexture));
+            texture->format = format;
+            texture->width = size;
+            texture->height = size;
+            texture->width_in_blocks = (size + 3) / 4;
+            texture->height_in_blocks = (size + 3) / 4;
+            texture->flags = 0;
+            texture->data = GenerateBlocks(format, texture->width_in_blocks * texture->height_in_blocks, true);
+            c.textures[c.nu_levels++] = texture;
+            nu_blocks += texture->width_in_blocks * texture->height_in_blocks;
+            bytes += (double)texture->width_in_blocks * texture->height_in_blocks * block_size;
+        }
+        for (int type = FILE_TYPE_DDS; type <= FILE_TYPE_TEX; type++) {
+            char filename[1024];
+            snprintf(filename, sizeof(filename), "%s/detex-bench.%s", tmp_dir, file_type_extensions[type]);
+            c.type = (FILE_TYPE)type;
+            c.filename = filename;
+            char name[128];
+            snprintf(name, sizeof(name), "file/%s/%s/", file_type_names[type], detexGetTextureFormatText(format));
+            if (!SaveFile(c.type, filename, c.textures, c.nu_levels)) {
+                fprintf(stderr, "%s: %s\n", name, detexGetErrorMessage());
+                continue;
+            }
+            size_t length = strlen(name);
+            snprintf(name + length, sizeof(name) - length, "save");
+            RunBenchmark(name, SaveFileFunc, &c, bytes, nu_blocks, 0);
+            snprintf(name + length, sizeof(name) - length, "load");
+            RunBenchmark(name, LoadFileFunc, &c, bytes, nu_blocks, 0);
+            snprintf(name + length, sizeof(name) - length, "map");
+            RunBenchmark(name, MapFileFunc, &c, bytes, nu_blocks, 0);
+            remove(filename);
+        }
+        for (int j = 0; j < c.nu_levels; j++) {
+            free(c.textures[j]->data);
+            free(c.textures[j]);
+        }
+    }
+}
+
+#define USAGE \
+    "detex_bench [--json] [--filter TEXT] [--time SECONDS] [--seed N] [--simd none|sse2|avx2|neon] [--tmp-dir DIR] " \
+    "[--max-threads N]"
+
+int main(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) {
+            json = true;
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (strcmp(argv[i], "--time") == 0 && i + 1 < argc) {
+            min_time = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--simd") == 0 && i + 1 < argc) {
+            static const char *levels[] = {"none", "sse2", "avx2", "neon"};
+            i++;
+            int level = 0;
+            while (level < 4 && strcmp(argv[i], levels[level]) != 0) level++;
+            if (level == 4) {
+                fprintf(stderr, "Bad arguments: " USAGE "\n");
+                return EXIT_FAILURE;
+            }
+            detexSetSIMDLevel(level);
+        } else if (strcmp(argv[i], "--tmp-dir") == 0 && i + 1 < argc) {
+            tmp_dir = argv[++i];
+        } else if (strcmp(argv[i], "--max-threads") == 0 && i + 1 < argc) {
+            max_threads = atoi(argv[++i]);
+            if (max_threads < 1) {
+                fprintf(stderr, "Bad arguments: " USAGE "\n");
+                return EXIT_FAILURE;
+            }
+        } else {
+            fprintf(stderr, "Bad arguments: " USAGE "\n");
+            return EXIT_FAILURE;
+        }
+    }
+    // Zero is a fixed point of xorshift.
+    random_state = seed != 0 ? seed : 1;
+    if (json) {
+        printf("{\n  \"seed\": %u,\n  \"simd_level\": %u,\n  \"min_time\": %g,\n  \"results\": [",
+               seed,
+               detexGetSIMDLevel(),
+               min_time);
+    } else {
+        printf("SIMD level %u, seed %u\n", detexGetSIMDLevel(), seed);
+    }
+    BenchmarkDecoders();
+    BenchmarkThreadScaling();
+    BenchmarkConversions();
+    BenchmarkFiles();
+    if (json) printf("\n  ]\n}\n");
+    return EXIT_SUCCESS;
+}
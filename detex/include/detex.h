@@ -32,13 +32,38 @@ OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 #define DETEX_API extern
 #define DETEX_DATA extern
 #define DETEX_INLINE_ONLY static inline
+#if defined(_MSC_VER)
+#    define DETEX_ALWAYS_INLINE static __forceinline
+#elif defined(__GNUC__) || defined(__clang__)
+#    define DETEX_ALWAYS_INLINE static inline __attribute__((always_inline))
+#else
+#    define DETEX_ALWAYS_INLINE static inline
+#endif
 #define DETEX_RESTRICT
-#define DETEX_THREAD_LOCAL static /* we don't care about multi threading */
+#if defined(_MSC_VER)
+#    define DETEX_THREAD_LOCAL static __declspec(thread)
+#elif defined(__GNUC__) || defined(__clang__)
+#    define DETEX_THREAD_LOCAL static __thread
+#else
+#    define DETEX_THREAD_LOCAL static _Thread_local
+#endif
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#    define DETEX_ARCH_X86
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#    define DETEX_ARCH_ARM64
+#endif
+/* Compile a function for an instruction set that is selected at run-time. */
+#if defined(__GNUC__) || defined(__clang__)
+#    define DETEX_TARGET(name) __attribute__((target(name)))
+#else
+#    define DETEX_TARGET(name)
+#endif
 
 __BEGIN_DECLS
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 
 /* Maximum uncompressed block size in bytes. */
@@ -225,6 +250,35 @@ enum {
     DETEX_DECOMPRESS_FLAG_NON_OPAQUE_ONLY = 0x4,
 };
 
+/* Compression function flags. */
+
+enum {
+    /* Use the slower, higher quality endpoint search (cluster fit) instead */
+    /* of the default fast range fit. */
+    DETEX_COMPRESS_FLAG_QUALITY = 0x1,
+    /* Allow BC1 blocks in the 3-color mode to use palette entry 3 for black */
+    /* pixels. D3D and GPU decoders (and detexDecompressBlockBC1A) decode this */
+    /* entry as transparent black, so it is off by default. */
+    DETEX_COMPRESS_FLAG_BC1_BLACK = 0x2,
+};
+
+/* Bits 8-15 of the compression flags hold the search budget of encoders that */
+/* search over a set of modes (BPTC: the number of partitions evaluated in full */
+/* for every partitioned mode, BPTC_FLOAT: the number of partitions evaluated */
+/* in full for the two-subset modes). Zero selects the default for the encoder. */
+#define DETEX_COMPRESS_BUDGET_SHIFT 8
+#define DETEX_COMPRESS_BUDGET_MASK 0xFF00
+#define DETEX_COMPRESS_FLAG_BUDGET(n) (((uint32_t)(n) << DETEX_COMPRESS_BUDGET_SHIFT) & DETEX_COMPRESS_BUDGET_MASK)
+
+/* Bits 16-23 of the compression flags hold the rate-distortion optimization */
+/* lambda of the BC1 and BC3 texture encoders. When non-zero, every block may */
+/* reuse the endpoints or indices of one of the nearby blocks before it, */
+/* trading at most lambda units of squared error for every bit saved, so that */
+/* the texture compresses better with a general purpose compressor. */
+#define DETEX_COMPRESS_RDO_SHIFT 16
+#define DETEX_COMPRESS_RDO_MASK 0xFF0000
+#define DETEX_COMPRESS_FLAG_RDO(lambda) (((uint32_t)(lambda) << DETEX_COMPRESS_RDO_SHIFT) & DETEX_COMPRESS_RDO_MASK)
+
 /* Set mode function flags. */
 
 enum {
@@ -382,6 +436,172 @@ DETEX_API bool detexDecompressBlockBPTC_SIGNED_FLOAT(const uint8_t *bitstring,
                                                      uint32_t flags,
                                                      uint8_t *pixel_buffer);
 
+/*
+ * Multi-block decompression functions. Decompress nu_blocks consecutive
+ * blocks into consecutive 4x4 pixel tiles, using the same pixel format as the
+ * corresponding single block function. The blocks are decoded with SIMD
+ * instructions when available (see detexGetSIMDLevel); the result is identical
+ * to that of the single block functions. When flags is not zero, blocks that
+ * fail are set to zero and false is returned.
+ */
+DETEX_API bool detexDecompressBlocksBC1(const uint8_t *bitstring, int nu_blocks, uint32_t flags, uint8_t *pixel_buffer);
+
+DETEX_API bool detexDecompressBlocksBC1A(const uint8_t *bitstring,
+                                         int nu_blocks,
+                                         uint32_t flags,
+                                         uint8_t *pixel_buffer);
+
+DETEX_API bool detexDecompressBlocksBC2(const uint8_t *bitstring, int nu_blocks, uint32_t flags, uint8_t *pixel_buffer);
+
+DETEX_API bool detexDecompressBlocksBC3(const uint8_t *bitstring, int nu_blocks, uint32_t flags, uint8_t *pixel_buffer);
+
+/*
+ * Multi-block ETC decompression functions, see above. Invalid blocks (ETC1
+ * blocks with an out of range differential color) are set to zero and false
+ * is returned, also when flags is zero.
+ */
+DETEX_API bool detexDecompressBlocksETC1(const uint8_t *bitstring,
+                                         int nu_blocks,
+                                         uint32_t flags,
+                                         uint8_t *pixel_buffer);
+
+DETEX_API bool detexDecompressBlocksETC2(const uint8_t *bitstring,
+                                         int nu_blocks,
+                                         uint32_t flags,
+                                         uint8_t *pixel_buffer);
+
+DETEX_API bool detexDecompressBlocksETC2_PUNCHTHROUGH(const uint8_t *bitstring,
+                                                      int nu_blocks,
+                                                      uint32_t flags,
+                                                      uint8_t *pixel_buffer);
+
+DETEX_API bool detexDecompressBlocksETC2_EAC(const uint8_t *bitstring,
+                                             int nu_blocks,
+                                             uint32_t flags,
+                                             uint8_t *pixel_buffer);
+
+/*
+ * Multi-block decompression functions for the single channel formats, see
+ * above. Invalid blocks (signed RGTC and EAC blocks with a disallowed base
+ * value) are set to zero and false is returned, also when flags is zero.
+ */
+DETEX_API bool detexDecompressBlocksRGTC1(const uint8_t *bitstring,
+                                          int nu_blocks,
+                                          uint32_t flags,
+                                          uint8_t *pixel_buffer);
+
+DETEX_API bool detexDecompressBlocksRGTC2(const uint8_t *bitstring,
+                                          int nu_blocks,
+                                          uint32_t flags,
+                                          uint8_t *pixel_buffer);
+
+DETEX_API bool detexDecompressBlocksSIGNED_RGTC1(const uint8_t *bitstring,
+                                                 int nu_blocks,
+                                                 uint32_t flags,
+                                                 uint8_t *pixel_buffer);
+
+DETEX_API bool detexDecompressBlocksSIGNED_RGTC2(const uint8_t *bitstring,
+                                                 int nu_blocks,
+                                                 uint32_t flags,
+                                                 uint8_t *pixel_buffer);
+
+DETEX_API bool detexDecompressBlocksEAC_R11(const uint8_t *bitstring,
+                                            int nu_blocks,
+                                            uint32_t flags,
+                                            uint8_t *pixel_buffer);
+
+DETEX_API bool detexDecompressBlocksEAC_RG11(const uint8_t *bitstring,
+                                             int nu_blocks,
+                                             uint32_t flags,
+                                             uint8_t *pixel_buffer);
+
+DETEX_API bool detexDecompressBlocksEAC_SIGNED_R11(const uint8_t *bitstring,
+                                                   int nu_blocks,
+                                                   uint32_t flags,
+                                                   uint8_t *pixel_buffer);
+
+DETEX_API bool detexDecompressBlocksEAC_SIGNED_RG11(const uint8_t *bitstring,
+                                                    int nu_blocks,
+                                                    uint32_t flags,
+                                                    uint8_t *pixel_buffer);
+
+/*
+ * Function that decompresses nu_blocks consecutive blocks into consecutive 4x4
+ * pixel tiles. Returns false when a block could not be decompressed; such
+ * blocks are set to zero.
+ */
+typedef bool (*detexDecompressBlocksFuncType)(const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer);
+
+/*
+ * Return a function that decompresses blocks of the given texture format
+ * straight into tiles of the given pixel format, without a conversion pass,
+ * or NULL when there is none for the combination. Available for BC1-BC3 into
+ * RGBA8, RGBX8, BGRA8, BGRX8, RGB8, RGBA16 and RGBX16, for ETC1, ETC2,
+ * ETC2_PUNCHTHROUGH and ETC2_EAC into RGBA8 and RGBX8, and for RGTC1, RGTC2,
+ * EAC R11 and RG11 and their signed variants into their native pixel format.
+ * The result is identical to decompressing in the native pixel format followed
+ * by detexConvertPixels.
+ */
+DETEX_API detexDecompressBlocksFuncType detexGetDecompressBlocksFunction(uint32_t texture_format,
+                                                                        uint32_t pixel_format);
+
+/*
+ * Compression functions for 8-bit RGBA8 formats. The input pixel format is
+ * DETEX_PIXEL_FORMAT_RGBA8 (16 pixels stored row-by-row). For formats without
+ * alpha, the alpha component is ignored.
+ */
+
+/* Compress a 4x4 pixel block into a 64-bit block using the BC1 format. */
+DETEX_API bool detexCompressBlockBC1(const uint8_t *pixel_buffer, uint32_t flags, uint8_t *bitstring);
+/* Compress a 4x4 pixel block into a 128-bit block using the BC3 format. */
+DETEX_API bool detexCompressBlockBC3(const uint8_t *pixel_buffer, uint32_t flags, uint8_t *bitstring);
+/*
+ * Rate-distortion optimize an encoded BC1 or BC3 block of the 4x4 pixel block
+ * against nu_references previously stored blocks of the same format. The block
+ * is replaced by one that reuses the endpoints or indices of a reference block
+ * when the increase of the squared error is smaller than the lambda of the
+ * flags (DETEX_COMPRESS_FLAG_RDO) times the estimated number of bits saved.
+ */
+DETEX_API void detexOptimizeBlockBC1(const uint8_t *pixel_buffer,
+                                     uint32_t flags,
+                                     const uint8_t *const *references,
+                                     int nu_references,
+                                     uint8_t *bitstring);
+DETEX_API void detexOptimizeBlockBC3(const uint8_t *pixel_buffer,
+                                     uint32_t flags,
+                                     const uint8_t *const *references,
+                                     int nu_references,
+                                     uint8_t *bitstring);
+/* Compress a 4x4 pixel block into a 64-bit block using the ETC1 format. */
+DETEX_API bool detexCompressBlockETC1(const uint8_t *pixel_buffer, uint32_t flags, uint8_t *bitstring);
+/* Compress a 4x4 pixel block into a 64-bit block using the ETC2 format. */
+DETEX_API bool detexCompressBlockETC2(const uint8_t *pixel_buffer, uint32_t flags, uint8_t *bitstring);
+/* Compress a 4x4 pixel block into a 128-bit block using the ETC2_EAC format. */
+DETEX_API bool detexCompressBlockETC2_EAC(const uint8_t *pixel_buffer, uint32_t flags, uint8_t *bitstring);
+/* Compress a 4x4 pixel block into a 128-bit block using the BPTC (BC7) format. */
+DETEX_API bool detexCompressBlockBPTC(const uint8_t *pixel_buffer, uint32_t flags, uint8_t *bitstring);
+/* Compress the red component of a 4x4 pixel block into a 64-bit block using the RGTC1 (BC4) format. */
+DETEX_API bool detexCompressBlockRGTC1(const uint8_t *pixel_buffer, uint32_t flags, uint8_t *bitstring);
+/* Compress the red and green components of a 4x4 pixel block into a 128-bit block using the RGTC2 (BC5) format. */
+DETEX_API bool detexCompressBlockRGTC2(const uint8_t *pixel_buffer, uint32_t flags, uint8_t *bitstring);
+/*
+ * Signed RGTC1 and RGTC2 variants of the above. The components are mapped from
+ * [0, 255] to [-127, 127] by subtracting 128, like the pixel format conversions.
+ */
+DETEX_API bool detexCompressBlockSIGNED_RGTC1(const uint8_t *pixel_buffer, uint32_t flags, uint8_t *bitstring);
+DETEX_API bool detexCompressBlockSIGNED_RGTC2(const uint8_t *pixel_buffer, uint32_t flags, uint8_t *bitstring);
+
+/*
+ * Compression functions for half-float formats. The input pixel format is
+ * DETEX_PIXEL_FORMAT_FLOAT_RGBX16 for BPTC_FLOAT, which encodes negative values
+ * as zero, and DETEX_PIXEL_FORMAT_SIGNED_FLOAT_RGBX16 for BPTC_SIGNED_FLOAT.
+ */
+
+/* Compress a 4x4 pixel block into a 128-bit block using the BPTC_FLOAT (BC6H) format. */
+DETEX_API bool detexCompressBlockBPTC_FLOAT(const uint8_t *pixel_buffer, uint32_t flags, uint8_t *bitstring);
+/* Compress a 4x4 pixel block into a 128-bit block using the BPTC_SIGNED_FLOAT format. */
+DETEX_API bool detexCompressBlockBPTC_SIGNED_FLOAT(const uint8_t *pixel_buffer, uint32_t flags, uint8_t *bitstring);
+
 /*
  * Get mode functions. They return the internal compression format mode used
  * inside the compressed block. For compressed formats that do not use a mode,
@@ -516,6 +736,13 @@ enum {
          DETEX_TEXTURE_FORMAT_128BIT_BLOCK_BIT | DETEX_PIXEL_FORMAT_RGBA8),
 };
 
+/* Texture flags. */
+enum {
+    /* The texture data is not owned by the texture (for example, it points into */
+    /* a memory-mapped file), and must not be freed. */
+    DETEX_TEXTURE_FLAG_BORROWED_DATA = 0x1,
+};
+
 typedef struct {
     uint32_t format;
     int width;
@@ -523,6 +750,7 @@ typedef struct {
     int width_in_blocks;
     int height_in_blocks;
     uint8_t *data;
+    uint32_t flags;
 } detexTexture;
 
 /*
@@ -541,6 +769,20 @@ DETEX_API bool detexDecompressBlock(const uint8_t *bitstring,
                                     uint8_t *pixel_buffer,
                                     uint32_t pixel_format);
 
+/*
+ * Decompress nu_blocks consecutive blocks into consecutive tiles in the given
+ * pixel format. Where possible the blocks are decompressed straight into the
+ * pixel format (see detexGetDecompressBlocksFunction), otherwise they are
+ * converted in batches. Blocks that fail are set to zero; returns true if all
+ * blocks were decompressed succesfully.
+ */
+DETEX_API bool detexDecompressBlocks(const uint8_t *bitstring,
+                                     uint32_t texture_format,
+                                     int nu_blocks,
+                                     uint32_t flags,
+                                     uint8_t *pixel_buffer,
+                                     uint32_t pixel_format);
+
 /*
  * Decode texture function (tiled). Decode an entire compressed texture into an
  * array of image buffer tiles (corresponding to compressed blocks), converting
@@ -555,6 +797,108 @@ DETEX_API bool detexDecompressTextureTiled(const detexTexture *texture, uint8_t
  */
 DETEX_API bool detexDecompressTextureLinear(const detexTexture *texture, uint8_t *pixel_buffer, uint32_t pixel_format);
 
+/*
+ * Decode texture function (linear, multi-threaded). Equivalent to
+ * detexDecompressTextureLinear, but the block rows of a compressed texture are
+ * distributed over nu_threads threads, each writing to disjoint rows of
+ * pixel_buffer. When nu_threads is zero, the number of processors is used.
+ */
+DETEX_API bool detexDecompressTextureLinearParallel(const detexTexture *texture,
+                                                    uint8_t *pixel_buffer,
+                                                    uint32_t pixel_format,
+                                                    int nu_threads);
+
+/*
+ * Encode texture function. Compress an entire texture (compressed or
+ * uncompressed) into the given compressed texture format, storing the blocks
+ * row-by-row in bitstring, which must be large enough to hold all blocks.
+ * Edge blocks of textures with a size that is not a multiple of four are
+ * padded by repeating the last row/column. The blocks of a texture that is
+ * already in the format are kept. Returns false when there is no encoder for
+ * the format.
+ */
+DETEX_API bool detexCompressTexture(const detexTexture *texture,
+                                    uint8_t *bitstring,
+                                    uint32_t texture_format,
+                                    uint32_t flags);
+
+/*
+ * Encode texture function (multi-threaded). Equivalent to
+ * detexCompressTexture, but the block rows are distributed over nu_threads
+ * threads. When nu_threads is zero, the number of processors is used.
+ */
+DETEX_API bool detexCompressTextureParallel(const detexTexture *texture,
+                                            uint8_t *bitstring,
+                                            uint32_t texture_format,
+                                            uint32_t flags,
+                                            int nu_threads);
+
+/*
+ * Return whether every pixel of a BC3 texture has an alpha of 255. Only the
+ * alpha blocks are inspected; returns false for other formats.
+ */
+DETEX_API bool detexTextureIsOpaqueBC3(const detexTexture *texture);
+
+/*
+ * Repack a BC3 texture for which detexTextureIsOpaqueBC3 returns true into
+ * BC1 without decoding it, storing the 64-bit blocks in bitstring. The color
+ * blocks are copied, swapping the endpoints of blocks that would otherwise be
+ * decoded in the 3-color mode of BC1. The result decodes to the same pixels.
+ */
+DETEX_API bool detexConvertOpaqueBC3ToBC1(const detexTexture *texture, uint8_t *bitstring);
+
+/* Mip-map generation filters. */
+enum {
+    /* Average of the covered source pixels. */
+    DETEX_MIPMAP_FILTER_BOX = 0,
+    /* Kaiser windowed sinc, sharper than the box filter. */
+    DETEX_MIPMAP_FILTER_KAISER = 1,
+};
+
+/* Mip-map generation flags. */
+enum {
+    /* The color components are sRGB encoded; filter in linear space. Alpha is */
+    /* always filtered as is. */
+    DETEX_MIPMAP_FLAG_SRGB = 0x1,
+};
+
+/*
+ * Generate a complete mip-map chain (down to 1x1) for a texture of any format.
+ * The levels are returned as DETEX_PIXEL_FORMAT_RGBA8 textures, level 0 being
+ * the texture itself. Each level is resampled from the previous one, in
+ * parallel over tiles using nu_threads threads (zero selects the number of
+ * processors). Free the textures with detexFreeTextures. Returns true if
+ * successful.
+ */
+DETEX_API bool detexGenerateMipmaps(const detexTexture *texture,
+                                    uint32_t filter,
+                                    uint32_t flags,
+                                    int nu_threads,
+                                    detexTexture ***textures_out,
+                                    int *nu_levels_out);
+
+/*
+ * SIMD instruction sets used by the decompression and half-float conversion
+ * functions. DETEX_SIMD_LEVEL_AVX2 also includes the F16C half-float
+ * conversion instructions.
+ */
+enum {
+    DETEX_SIMD_LEVEL_NONE = 0,
+    DETEX_SIMD_LEVEL_SSE2 = 1,
+    DETEX_SIMD_LEVEL_AVX2 = 2,
+    DETEX_SIMD_LEVEL_NEON = 3,
+};
+
+/* Return the SIMD instruction set in use, by default the best one supported by the CPU. */
+DETEX_API uint32_t detexGetSIMDLevel();
+
+/*
+ * Limit the SIMD instruction set used, for example DETEX_SIMD_LEVEL_NONE to
+ * use scalar code only. Levels that the CPU does not support are ignored. Not
+ * thread-safe; call it before decompressing.
+ */
+DETEX_API void detexSetSIMDLevel(uint32_t level);
+
 /*
  * Miscellaneous functions.
  */
@@ -641,9 +985,13 @@ DETEX_API void detexSetErrorMessage(const char *format, ...);
  * HDR-related functions.
  */
 
-/* Set HDR gamma curve parameters. */
+/* Set HDR gamma curve parameters. The parameters are per-thread; the */
+/* multi-threaded texture functions pass them on to their worker threads. */
 DETEX_API void detexSetHDRParameters(float gamma, float range_min, float range_max);
 
+/* Get the HDR gamma curve parameters of the calling thread. */
+DETEX_API void detexGetHDRParameters(float *gamma, float *range_min, float *range_max);
+
 /* Calculate the dynamic range of a pixel buffer. Valid for float and half-float formats. */
 /* Returns true if successful. */
 DETEX_API bool detexCalculateDynamicRange(
@@ -657,6 +1005,17 @@ DETEX_API void detexConvertHDRFloatToFloat(float *buffer, int n);
  * Texture file loading.
  */
 
+/* Texture file container types. */
+enum {
+    DETEX_FILE_TYPE_KTX = 1,
+    DETEX_FILE_TYPE_DDS = 2,
+    DETEX_FILE_TYPE_TEX = 3,
+};
+
+/* Function that writes the size bytes of data of a mip-map level to file, used by the */
+/* detexFileWrite* functions in place of fwrite. Returns true if successful. */
+typedef bool (*detexFileWriteLevelFuncType)(void *context, FILE *file, const detexTexture *texture, size_t size);
+
 /* Load texture from KTX file with mip-maps. Returns true if successful. */
 /* nu_levels is a return parameter that returns the number of mipmap levels found. */
 /* textures_out is a return parameter for an array of detexTexture pointers that is allocated, */
@@ -670,6 +1029,14 @@ DETEX_API bool detexFileLoadKTX(const char *filename,
 /* Save textures to KTX file (multiple mip-maps levels). Return true if succesful. */
 DETEX_API bool detexFileSaveKTX(const char *filename, detexTexture **textures, int nu_levels);
 
+/* Save textures to KTX file, writing the data of every level with write_level, or with fwrite */
+/* when it is NULL. Return true if succesful. */
+DETEX_API bool detexFileWriteKTX(const char *filename,
+                                 detexTexture **textures,
+                                 int nu_levels,
+                                 detexFileWriteLevelFuncType write_level,
+                                 void *context);
+
 /* Load texture from DDS file with mip-maps. Returns true if successful. */
 /* nu_levels is a return parameter that returns the number of mipmap levels found. */
 /* textures_out is a return parameter for an array of detexTexture pointers that is allocated, */
@@ -683,6 +1050,14 @@ DETEX_API bool detexFileLoadDDS(const char *filename,
 /* Save textures to DDS file (multiple mip-maps levels). Return true if succesful. */
 DETEX_API bool detexFileSaveDDS(const char *filename, detexTexture **textures, int nu_levels);
 
+/* Save textures to DDS file, writing the data of every level with write_level, or with fwrite */
+/* when it is NULL. Return true if succesful. */
+DETEX_API bool detexFileWriteDDS(const char *filename,
+                                 detexTexture **textures,
+                                 int nu_levels,
+                                 detexFileWriteLevelFuncType write_level,
+                                 void *context);
+
 /* Load TEX file (multiple mip-maps levels). Returs true if succesful. */
 DETEX_API bool detexFileLoadTEX(const char *filename,
                                 int max_mipmaps,
@@ -692,6 +1067,107 @@ DETEX_API bool detexFileLoadTEX(const char *filename,
 /* Save textures to TEX file (multiple mip-maps levels). Return true if succesful. */
 DETEX_API bool detexFileSaveTEX(const char *filename, detexTexture **textures, int nu_levels);
 
+/* Save textures to TEX file, writing the data of every level with write_level, or with fwrite */
+/* when it is NULL. The levels are written smallest first. Return true if succesful. */
+DETEX_API bool detexFileWriteTEX(const char *filename,
+                                 detexTexture **textures,
+                                 int nu_levels,
+                                 detexFileWriteLevelFuncType write_level,
+                                 void *context);
+
+/* Maximum number of mip-map levels described by a detexFileLayout. */
+#define DETEX_FILE_MAX_LEVELS 32
+
+/* Layout of the mip-map levels in a texture file, calculated from its header. */
+typedef struct {
+    uint32_t file_type; /* DETEX_FILE_TYPE_* */
+    uint64_t file_size;
+    int nu_levels;
+    /* The mip-map levels, largest first. Their data pointers are NULL. */
+    detexTexture levels[DETEX_FILE_MAX_LEVELS];
+    /* Offset in the file and size in bytes of the data of every level. */
+    size_t offsets[DETEX_FILE_MAX_LEVELS];
+    size_t sizes[DETEX_FILE_MAX_LEVELS];
+} detexFileLayout;
+
+/* Read only the header of a KTX, DDS or TEX file and calculate the layout of its mip-map */
+/* levels, without reading their data. Fails if the file is too small to hold all levels. */
+/* Returns true if successful. */
+DETEX_API bool detexFileProbeKTX(const char *filename, detexFileLayout *layout);
+
+DETEX_API bool detexFileProbeDDS(const char *filename, detexFileLayout *layout);
+
+DETEX_API bool detexFileProbeTEX(const char *filename, detexFileLayout *layout);
+
+/* Probe a texture file of which the type is determined from its signature. Returns true */
+/* if successful. */
+DETEX_API bool detexFileProbe(const char *filename, detexFileLayout *layout);
+
+/* Load nu_levels mip-map levels starting at first_level from a KTX, DDS or TEX file, seeking to */
+/* and reading only the data of those levels. A negative first_level counts from the smallest */
+/* level, so -1 loads just the smallest one. Fewer levels are returned when the file ends */
+/* before first_level + nu_levels. Free the textures with detexFreeTextures. Returns true if */
+/* successful. */
+DETEX_API bool detexFileLoadLevels(const char *filename,
+                                   int first_level,
+                                   int nu_levels,
+                                   detexTexture ***textures_out,
+                                   int *nu_levels_out);
+
+/* A file mapped into memory. Pages are copy-on-write, so the data may be */
+/* modified without changing the file. */
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    void *file_handle;
+    void *mapping_handle;
+} detexFileMapping;
+
+/* Map a file into memory. Returns NULL if unsuccessful. */
+DETEX_API detexFileMapping *detexFileMap(const char *filename);
+
+/* Unmap a file mapped with detexFileMap or one of the detexFileMap* loaders. */
+DETEX_API void detexFileUnmap(detexFileMapping *mapping);
+
+/* Map a KTX, DDS or TEX file into memory and return textures for its mip-map */
+/* levels without copying the data. The textures have the */
+/* DETEX_TEXTURE_FLAG_BORROWED_DATA flag set, their data points into the mapping */
+/* returned in mapping_out, which must outlive them and be released with */
+/* detexFileUnmap. Free the textures with detexFreeTextures. Returns true if */
+/* successful. */
+DETEX_API bool detexFileMapKTX(const char *filename,
+                               int max_mipmaps,
+                               detexTexture ***textures_out,
+                               int *nu_levels_out,
+                               detexFileMapping **mapping_out);
+
+DETEX_API bool detexFileMapDDS(const char *filename,
+                               int max_mipmaps,
+                               detexTexture ***textures_out,
+                               int *nu_levels_out,
+                               detexFileMapping **mapping_out);
+
+DETEX_API bool detexFileMapTEX(const char *filename,
+                               int max_mipmaps,
+                               detexTexture ***textures_out,
+                               int *nu_levels_out,
+                               detexFileMapping **mapping_out);
+
+/* Save textures that point into a file mapping, as returned by the detexFileMap* loaders, to a */
+/* file of type file_type (DETEX_FILE_TYPE_*) without reading their data. The header is built */
+/* from the textures and the data of every level is copied from the mapped file to the new */
+/* file by the kernel (copy_file_range or sendfile) where available, in the level order of the */
+/* new container. Returns true if successful. */
+DETEX_API bool detexFileRewrap(const char *filename,
+                               uint32_t file_type,
+                               detexTexture **textures,
+                               int nu_levels,
+                               const detexFileMapping *mapping);
+
+/* Free an array of textures returned by one of the file loaders, including */
+/* the texture data unless it has the DETEX_TEXTURE_FLAG_BORROWED_DATA flag. */
+DETEX_API void detexFreeTextures(detexTexture **textures, int nu_levels);
+
 /* Return pixel size in bytes for pixel format or texture format (decompressed). */
 DETEX_INLINE_ONLY int detexGetPixelSize(uint32_t pixel_format) { return 1 + ((pixel_format & 0xF00) >> 8); }
 
@@ -759,6 +1235,15 @@ DETEX_INLINE_ONLY float detexClamp0To1(float f) {
         return f;
 }
 
+/* Convert a float point value to a 16-bit integer, mapping 0.0 to 1.0 to 0 to */
+/* 65535 and rounding to nearest. Out of range values and NaN are clamped. */
+DETEX_INLINE_ONLY uint16_t detexGetUInt16FromNormalizedFloat(float f) {
+    if (!(f > 0.0f)) return 0;
+    if (f >= 1.0f) return 65535;
+    // The product is exact in double precision, so the result does not depend on the rounding mode.
+    return (uint16_t)((double)f * 65535.0 + 0.5);
+}
+
 /* Integer division using look-up tables, used by BC1/2/3 and RGTC (BC4/5) */
 /* decompression. */
 
@@ -928,6 +1413,24 @@ typedef struct {
 
 DETEX_API uint32_t detexBlock128ExtractBits(detexBlock128 *block, int nu_bits);
 
+/* Return the nu_bits (at most 32) bits starting at bit index bit0 (less than 128) of a 128-bit */
+/* bitstring. The field is extracted with shifts and masks; a field that straddles the */
+/* boundary between the two 64-bit words takes two word reads. */
+DETEX_INLINE_ONLY uint32_t detexBlock128GetBits(const detexBlock128 *block, int bit0, int nu_bits) {
+    uint64_t mask = ((uint64_t)1 << nu_bits) - 1;
+    if (bit0 >= 64) return (uint32_t)((block->data1 >> (bit0 - 64)) & mask);
+    uint64_t value = block->data0 >> bit0;
+    if (bit0 + nu_bits > 64) value |= block->data1 << (64 - bit0);
+    return (uint32_t)(value & mask);
+}
+
+/* Extract the next nu_bits (at most 32) bits of a 128-bit bitstring and advance the index. */
+DETEX_INLINE_ONLY uint32_t detexBlock128ReadBits(detexBlock128 *block, int nu_bits) {
+    uint32_t value = detexBlock128GetBits(block, block->index, nu_bits);
+    block->index += nu_bits;
+    return value;
+}
+
 /* Return bitfield from bit0 to bit1 from 64-bit bitstring. */
 DETEX_API uint32_t detexGetBits64(uint64_t data, int bit0, int bit1);
 
@@ -947,10 +1450,51 @@ DETEX_DATA const uint8_t detex_bptc_table_anchor_index_second_subset[64];
 DETEX_DATA const uint8_t detex_bptc_table_anchor_index_second_subset_of_three[64];
 DETEX_DATA const uint8_t detex_bptc_table_anchor_index_third_subset[64];
 
+/* Per-pixel anchor flags of the two and three subset partitions. */
+DETEX_DATA const uint8_t detex_bptc_table_anchor_P2[64 * 16];
+DETEX_DATA const uint8_t detex_bptc_table_anchor_P3[64 * 16];
+
 DETEX_DATA const uint16_t detex_bptc_table_aWeight2[4];
 DETEX_DATA const uint16_t detex_bptc_table_aWeight3[8];
 DETEX_DATA const uint16_t detex_bptc_table_aWeight4[16];
 
+/* Function called for every index of a parallel loop. Returns false on error. */
+typedef bool (*detexParallelFuncType)(void *context, int index);
+
+/* Call func(context, i) for i from 0 to count - 1, distributed over nu_threads */
+/* threads (zero selects the number of processors). Returns false when any of */
+/* the calls returned false. */
+DETEX_API bool detexParallelFor(int count, int nu_threads, detexParallelFuncType func, void *context);
+
+/* Function called for every index of a parallel loop, together with the index */
+/* of the worker (0 to nu_threads - 1) that runs it. Returns false on error. */
+typedef bool (*detexParallelWorkerFuncType)(void *context, int worker, int index);
+
+/* Same as detexParallelFor, but also passes the worker index, so that callers */
+/* can keep per-worker scratch state. nu_threads must be positive. */
+DETEX_API bool detexParallelForWorkers(int count, int nu_threads, detexParallelWorkerFuncType func, void *context);
+
+/* Return the number of logical processors. */
+DETEX_API int detexGetNumberOfProcessors();
+
+/* Flag for detexCallOnce, initialize with DETEX_ONCE_INIT. */
+typedef volatile long detexOnceFlag;
+
+#define DETEX_ONCE_INIT 0
+
+/* Call func exactly once for the given flag, even when called concurrently */
+/* from multiple threads. Returns after func has completed. */
+DETEX_API void detexCallOnce(detexOnceFlag *flag, void (*func)(void));
+
+/*
+ * Half-float conversion functions. They use the F16C (DETEX_SIMD_LEVEL_AVX2) or
+ * NEON instructions when available and otherwise the table below; the results
+ * are identical. All NaNs are converted to a single NaN value. Float to half-float
+ * conversion rounds halfway cases away from zero. The normalized conversions
+ * clamp to 0.0 to 1.0 and round to the nearest integer, independent of the
+ * floating point rounding mode.
+ */
+
 DETEX_API void detexConvertHalfFloatToFloat(uint16_t *source_buffer, int n, float *target_buffer);
 
 DETEX_API void detexConvertFloatToHalfFloat(float *source_buffer, int n, uint16_t *target_buffer);
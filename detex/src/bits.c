@@ -18,31 +18,11 @@ OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 
 #include "detex.h"
 
-uint32_t detexBlock128ExtractBits(detexBlock128 *block, int nu_bits) {
-    uint32_t value = 0;
-    for (int i = 0; i < nu_bits; i++) {
-        if (block->index < 64) {
-            int shift = block->index - i;
-            if (shift < 0)
-                value |= (block->data0 & ((uint64_t)1 << block->index)) << (-shift);
-            else
-                value |= (block->data0 & ((uint64_t)1 << block->index)) >> shift;
-        } else {
-            int shift = ((block->index - 64) - i);
-            if (shift < 0)
-                value |= (block->data1 & ((uint64_t)1 << (block->index - 64))) << (-shift);
-            else
-                value |= (block->data1 & ((uint64_t)1 << (block->index - 64))) >> shift;
-        }
-        block->index++;
-    }
-    //	if (block->index > 128)
-    //		printf("Block overflow (%d)\n", block->index);
-    return value;
-}
+uint32_t detexBlock128ExtractBits(detexBlock128 *block, int nu_bits) { return detexBlock128ReadBits(block, nu_bits); }
 
 uint32_t detexGetBits64(uint64_t data, int bit0, int bit1) {
-    return (data & (((uint64_t)1 << (bit1 + 1)) - 1)) >> bit0;
+    // Shift the mask down rather than building it up, so that bit1 can be 63.
+    return (data >> bit0) & (UINT64_MAX >> (63 - (bit1 - bit0)));
 }
 
 uint32_t detexGetBits64Reversed(uint64_t data, int bit0, int bit1) {
@@ -60,9 +40,9 @@ uint32_t detexGetBits64Reversed(uint64_t data, int bit0, int bit1) {
 }
 
 uint64_t detexClearBits64(uint64_t data, int bit0, int bit1) {
-    uint64_t mask = ~(((uint64_t)1 << (bit1 + 1)) - 1);
-    mask |= ((uint64_t)1 << bit0) - 1;
-    return data & mask;
+    // As in detexGetBits64, so that bit1 can be 63.
+    uint64_t mask = (UINT64_MAX >> (63 - (bit1 - bit0))) << bit0;
+    return data & ~mask;
 }
 
 /* Set bit0 to bit1 of 64-bit bitstring. */
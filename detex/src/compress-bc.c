@@ -0,0 +1,794 @@
+/*
+
+Copyright (c) 2015 Harm Hanemaaijer <fgenfb@yahoo.com>
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+*/
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#include "detex.h"
+
+// The encoders in this file are the counterpart of the decoders in
+// decompress-bc.c. Palettes are always built with exactly the same arithmetic
+// as the decoders so that the error that is minimized is the error of the
+// texture as decoded by detex.
+
+// Decode a 5-6-5 color in the same way as the BC1/BC2/BC3 decoders.
+static void Unpack565(uint32_t color, int *rgb) {
+    rgb[0] = (color & 0xF800) >> (11 - 3);
+    rgb[1] = (color & 0x07E0) >> (5 - 2);
+    rgb[2] = (color & 0x001F) << 3;
+}
+
+// Quantize a floating point color to 5-6-5, rounding to the nearest value
+// that the decoder can represent.
+static uint32_t Pack565(const float *rgb) {
+    int r = (int)floorf(rgb[0] / 8.0f + 0.5f);
+    int g = (int)floorf(rgb[1] / 4.0f + 0.5f);
+    int b = (int)floorf(rgb[2] / 8.0f + 0.5f);
+    r = r < 0 ? 0 : (r > 31 ? 31 : r);
+    g = g < 0 ? 0 : (g > 63 ? 63 : g);
+    b = b < 0 ? 0 : (b > 31 ? 31 : b);
+    return ((uint32_t)r << 11) | ((uint32_t)g << 5) | (uint32_t)b;
+}
+
+// Round a floating point color to the 5-6-5 grid, keeping it as floats.
+static void SnapTo565Grid(const float *rgb, float *out) {
+    int c[3];
+    Unpack565(Pack565(rgb), c);
+    out[0] = (float)c[0];
+    out[1] = (float)c[1];
+    out[2] = (float)c[2];
+}
+
+// Calculate the four palette colors of a BC1-style color block. When
+// four_colors is false, the 3-color mode (with black as fourth entry) is used.
+static void CalculatePaletteBC1(uint32_t color0, uint32_t color1, bool four_colors, int palette[4][3]) {
+    Unpack565(color0, palette[0]);
+    Unpack565(color1, palette[1]);
+    for (int c = 0; c < 3; c++)
+        if (four_colors) {
+            palette[2][c] = detexDivide0To767By3(2 * palette[0][c] + palette[1][c]);
+            palette[3][c] = detexDivide0To767By3(palette[0][c] + 2 * palette[1][c]);
+        } else {
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+            palette[3][c] = 0;
+        }
+}
+
+// Select the best of the first nu_entries palette entries for every pixel.
+// Returns the total squared error and stores the 32-bit index word.
+static uint32_t SelectIndicesBC1(const uint8_t *DETEX_RESTRICT pixel_buffer,
+                                 const int palette[4][3],
+                                 int nu_entries,
+                                 uint32_t *DETEX_RESTRICT indices_out) {
+    uint32_t indices = 0;
+    uint32_t total_error = 0;
+    for (int i = 0; i < 16; i++) {
+        const uint8_t *pixel = &pixel_buffer[i * 4];
+        uint32_t best_error = UINT32_MAX;
+        int best_index = 0;
+        for (int j = 0; j < nu_entries; j++) {
+            int dr = pixel[0] - palette[j][0];
+            int dg = pixel[1] - palette[j][1];
+            int db = pixel[2] - palette[j][2];
+            uint32_t error = dr * dr + dg * dg + db * db;
+            if (error < best_error) {
+                best_error = error;
+                best_index = j;
+            }
+        }
+        indices |= (uint32_t)best_index << (i * 2);
+        total_error += best_error;
+    }
+    *indices_out = indices;
+    return total_error;
+}
+
+static void StoreColorBlock(uint32_t color0, uint32_t color1, uint32_t indices, uint8_t *bitstring) {
+    bitstring[0] = color0 & 0xFF;
+    bitstring[1] = color0 >> 8;
+    bitstring[2] = color1 & 0xFF;
+    bitstring[3] = color1 >> 8;
+    bitstring[4] = indices & 0xFF;
+    bitstring[5] = (indices >> 8) & 0xFF;
+    bitstring[6] = (indices >> 16) & 0xFF;
+    bitstring[7] = indices >> 24;
+}
+
+// Best color block found so far.
+typedef struct {
+    uint32_t error;
+    uint32_t color0;
+    uint32_t color1;
+    uint32_t indices;
+    bool four_colors;
+    // Whether 3-color blocks may use palette entry 3 for black pixels.
+    bool allow_black;
+} BC1Candidate;
+
+// Encode the endpoint pair using either the 4-color (color0 > color1) or the
+// 3-color (color0 <= color1) mode, and keep it when it is better than the
+// current candidate.
+static void TryEndpointsBC1(const uint8_t *DETEX_RESTRICT pixel_buffer,
+                            uint32_t color_a,
+                            uint32_t color_b,
+                            bool four_colors,
+                            BC1Candidate *DETEX_RESTRICT best) {
+    uint32_t color0, color1;
+    if (four_colors) {
+        color0 = color_a > color_b ? color_a : color_b;
+        color1 = color_a > color_b ? color_b : color_a;
+        if (color0 == color1) {
+            // Keep the block in the 4-color mode; the single color remains
+            // exactly available as palette entry 0 (or 1 for black).
+            if (color0 == 0)
+                color0 = 1;
+            else
+                color1 = color0 - 1;
+        }
+    } else {
+        color0 = color_a < color_b ? color_a : color_b;
+        color1 = color_a < color_b ? color_b : color_a;
+    }
+    int palette[4][3];
+    CalculatePaletteBC1(color0, color1, four_colors, palette);
+    uint32_t indices;
+    uint32_t error = SelectIndicesBC1(pixel_buffer, palette, four_colors || best->allow_black ? 4 : 3, &indices);
+    if (error < best->error) {
+        best->error = error;
+        best->color0 = color0;
+        best->color1 = color1;
+        best->indices = indices;
+        best->four_colors = four_colors;
+    }
+}
+
+static void TryEndpointsBC1Float(const uint8_t *DETEX_RESTRICT pixel_buffer,
+                                 const float *a,
+                                 const float *b,
+                                 bool four_colors,
+                                 BC1Candidate *DETEX_RESTRICT best) {
+    TryEndpointsBC1(pixel_buffer, Pack565(a), Pack565(b), four_colors, best);
+}
+
+// Calculate the mean and the principal axis (the eigenvector of the covariance
+// matrix with the largest eigenvalue) of the colors of a block. Returns false
+// when all colors are the same.
+static bool CalculatePrincipalAxis(const uint8_t *DETEX_RESTRICT pixel_buffer, float *mean, float *axis) {
+    mean[0] = mean[1] = mean[2] = 0;
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 3; c++) mean[c] += pixel_buffer[i * 4 + c];
+    for (int c = 0; c < 3; c++) mean[c] /= 16.0f;
+    float cov[6] = {0, 0, 0, 0, 0, 0};
+    for (int i = 0; i < 16; i++) {
+        float r = pixel_buffer[i * 4] - mean[0];
+        float g = pixel_buffer[i * 4 + 1] - mean[1];
+        float b = pixel_buffer[i * 4 + 2] - mean[2];
+        cov[0] += r * r;
+        cov[1] += r * g;
+        cov[2] += r * b;
+        cov[3] += g * g;
+        cov[4] += g * b;
+        cov[5] += b * b;
+    }
+    if (cov[0] + cov[3] + cov[5] < 0.001f) return false;
+    // Power iteration, starting with the row of the largest diagonal element.
+    float v[3];
+    if (cov[0] >= cov[3] && cov[0] >= cov[5]) {
+        v[0] = cov[0], v[1] = cov[1], v[2] = cov[2];
+    } else if (cov[3] >= cov[5]) {
+        v[0] = cov[1], v[1] = cov[3], v[2] = cov[4];
+    } else {
+        v[0] = cov[2], v[1] = cov[4], v[2] = cov[5];
+    }
+    for (int iteration = 0; iteration < 8; iteration++) {
+        float x = v[0] * cov[0] + v[1] * cov[1] + v[2] * cov[2];
+        float y = v[0] * cov[1] + v[1] * cov[3] + v[2] * cov[4];
+        float z = v[0] * cov[2] + v[1] * cov[4] + v[2] * cov[5];
+        float m = fmaxf(fabsf(x), fmaxf(fabsf(y), fabsf(z)));
+        if (m == 0.0f) break;
+        v[0] = x / m, v[1] = y / m, v[2] = z / m;
+    }
+    float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    if (length < 0.0001f) {
+        // Degenerate covariance; fall back to the luminance axis.
+        v[0] = v[1] = v[2] = 1.0f;
+        length = sqrtf(3.0f);
+    }
+    for (int c = 0; c < 3; c++) axis[c] = v[c] / length;
+    return true;
+}
+
+// Refine the endpoints with a least squares fit for the given indices.
+// Returns false when the system is singular (all pixels use the same weight).
+static bool RefineEndpointsBC1(const uint8_t *DETEX_RESTRICT pixel_buffer,
+                               uint32_t indices,
+                               bool four_colors,
+                               float *a,
+                               float *b) {
+    static const float weights4[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+    static const float weights3[4] = {1.0f, 0.0f, 0.5f, -1.0f};
+    const float *weights = four_colors ? weights4 : weights3;
+    float alpha2 = 0, beta2 = 0, alphabeta = 0;
+    float alphax[3] = {0, 0, 0}, betax[3] = {0, 0, 0};
+    for (int i = 0; i < 16; i++) {
+        float alpha = weights[(indices >> (i * 2)) & 3];
+        if (alpha < 0)
+            // Black pixels of the 3-color mode do not depend on the endpoints.
+            continue;
+        float beta = 1.0f - alpha;
+        alpha2 += alpha * alpha;
+        beta2 += beta * beta;
+        alphabeta += alpha * beta;
+        for (int c = 0; c < 3; c++) {
+            alphax[c] += alpha * pixel_buffer[i * 4 + c];
+            betax[c] += beta * pixel_buffer[i * 4 + c];
+        }
+    }
+    float factor = alpha2 * beta2 - alphabeta * alphabeta;
+    if (fabsf(factor) < 0.0001f) return false;
+    for (int c = 0; c < 3; c++) {
+        a[c] = (alphax[c] * beta2 - betax[c] * alphabeta) / factor;
+        b[c] = (betax[c] * alpha2 - alphax[c] * alphabeta) / factor;
+    }
+    return true;
+}
+
+
+// Fast endpoint selection: take the extent of the colors along the principal
+// axis, inset slightly to account for the interpolated colors, followed by a
+// single least squares refinement.
+static void RangeFitBC1(const uint8_t *DETEX_RESTRICT pixel_buffer,
+                        const float *mean,
+                        const float *axis,
+                        bool allow_three_colors,
+                        BC1Candidate *DETEX_RESTRICT best) {
+    float t_min = FLT_MAX, t_max = -FLT_MAX;
+    for (int i = 0; i < 16; i++) {
+        float t = (pixel_buffer[i * 4] - mean[0]) * axis[0] + (pixel_buffer[i * 4 + 1] - mean[1]) * axis[1] +
+                  (pixel_buffer[i * 4 + 2] - mean[2]) * axis[2];
+        t_min = fminf(t_min, t);
+        t_max = fmaxf(t_max, t);
+    }
+    float inset = (t_max - t_min) / 16.0f;
+    float a[3], b[3];
+    for (int c = 0; c < 3; c++) {
+        a[c] = mean[c] + axis[c] * (t_min + inset);
+        b[c] = mean[c] + axis[c] * (t_max - inset);
+    }
+    TryEndpointsBC1Float(pixel_buffer, a, b, true, best);
+    if (allow_three_colors) TryEndpointsBC1Float(pixel_buffer, a, b, false, best);
+    if (RefineEndpointsBC1(pixel_buffer, best->indices, best->four_colors, a, b))
+        TryEndpointsBC1Float(pixel_buffer, a, b, best->four_colors, best);
+}
+
+// Sum of squared errors of the least squares fit of a clustering, relative to
+// a constant (the sum of the squared colors) that does not depend on the
+// clustering.
+static float ClusterError(const float *a,
+                          const float *b,
+                          float alpha2,
+                          float beta2,
+                          float alphabeta,
+                          const float *alphax,
+                          const float *betax) {
+    float error = 0;
+    for (int c = 0; c < 3; c++)
+        error += a[c] * a[c] * alpha2 + b[c] * b[c] * beta2 +
+                 2.0f * (a[c] * b[c] * alphabeta - a[c] * alphax[c] - b[c] * betax[c]);
+    return error;
+}
+
+// Solve the least squares endpoints of a clustering, snapped to the 5-6-5 grid.
+// Returns false when the system is singular.
+static bool SolveCluster(float alpha2,
+                         float beta2,
+                         float alphabeta,
+                         const float *alphax,
+                         const float *betax,
+                         float *a,
+                         float *b) {
+    float factor = alpha2 * beta2 - alphabeta * alphabeta;
+    if (factor < 0.0001f) return false;
+    float fa[3], fb[3];
+    for (int c = 0; c < 3; c++) {
+        fa[c] = (alphax[c] * beta2 - betax[c] * alphabeta) / factor;
+        fb[c] = (betax[c] * alpha2 - alphax[c] * alphabeta) / factor;
+    }
+    SnapTo565Grid(fa, a);
+    SnapTo565Grid(fb, b);
+    return true;
+}
+
+// High quality endpoint selection. The pixels are ordered along the principal
+// axis and every ordered partition into four (or three) clusters is evaluated
+// with a least squares fit of the endpoints.
+static void ClusterFitBC1(const uint8_t *DETEX_RESTRICT pixel_buffer,
+                          const float *axis,
+                          bool allow_three_colors,
+                          BC1Candidate *DETEX_RESTRICT best) {
+    // Sort the pixels along the axis (insertion sort, 16 elements).
+    int order[16];
+    float t[16];
+    for (int i = 0; i < 16; i++) {
+        float d = pixel_buffer[i * 4] * axis[0] + pixel_buffer[i * 4 + 1] * axis[1] + pixel_buffer[i * 4 + 2] * axis[2];
+        int j = i;
+        for (; j > 0 && t[j - 1] > d; j--) {
+            t[j] = t[j - 1];
+            order[j] = order[j - 1];
+        }
+        t[j] = d;
+        order[j] = i;
+    }
+    // Prefix sums of the ordered colors.
+    float sum[17][3];
+    sum[0][0] = sum[0][1] = sum[0][2] = 0;
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 3; c++) sum[i + 1][c] = sum[i][c] + pixel_buffer[order[i] * 4 + c];
+    float best_error = FLT_MAX;
+    float best_a[3], best_b[3];
+    // Four colors: [0, i) -> a, [i, j) -> 2/3 a + 1/3 b, [j, k) -> 1/3 a + 2/3 b,
+    // [k, 16) -> b.
+    for (int i = 0; i <= 16; i++)
+        for (int j = i; j <= 16; j++)
+            for (int k = j; k <= 16; k++) {
+                float n0 = i, n1 = j - i, n2 = k - j, n3 = 16 - k;
+                float alpha2 = n0 + n1 * (4.0f / 9.0f) + n2 * (1.0f / 9.0f);
+                float beta2 = n3 + n1 * (1.0f / 9.0f) + n2 * (4.0f / 9.0f);
+                float alphabeta = (n1 + n2) * (2.0f / 9.0f);
+                float alphax[3], betax[3];
+                for (int c = 0; c < 3; c++) {
+                    float s0 = sum[i][c], s1 = sum[j][c] - sum[i][c], s2 = sum[k][c] - sum[j][c];
+                    float s3 = sum[16][c] - sum[k][c];
+                    alphax[c] = s0 + s1 * (2.0f / 3.0f) + s2 * (1.0f / 3.0f);
+                    betax[c] = s3 + s1 * (1.0f / 3.0f) + s2 * (2.0f / 3.0f);
+                }
+                float a[3], b[3];
+                if (!SolveCluster(alpha2, beta2, alphabeta, alphax, betax, a, b)) continue;
+                float error = ClusterError(a, b, alpha2, beta2, alphabeta, alphax, betax);
+                if (error < best_error) {
+                    best_error = error;
+                    memcpy(best_a, a, sizeof(a));
+                    memcpy(best_b, b, sizeof(b));
+                }
+            }
+    if (best_error < FLT_MAX) TryEndpointsBC1Float(pixel_buffer, best_a, best_b, true, best);
+    if (!allow_three_colors) return;
+    // Three colors: [0, i) -> a, [i, j) -> 1/2 a + 1/2 b, [j, 16) -> b.
+    best_error = FLT_MAX;
+    for (int i = 0; i <= 16; i++)
+        for (int j = i; j <= 16; j++) {
+            float n0 = i, n1 = j - i, n2 = 16 - j;
+            float alpha2 = n0 + n1 * 0.25f;
+            float beta2 = n2 + n1 * 0.25f;
+            float alphabeta = n1 * 0.25f;
+            float alphax[3], betax[3];
+            for (int c = 0; c < 3; c++) {
+                float s0 = sum[i][c], s1 = sum[j][c] - sum[i][c], s2 = sum[16][c] - sum[j][c];
+                alphax[c] = s0 + s1 * 0.5f;
+                betax[c] = s2 + s1 * 0.5f;
+            }
+            float a[3], b[3];
+            if (!SolveCluster(alpha2, beta2, alphabeta, alphax, betax, a, b)) continue;
+            float error = ClusterError(a, b, alpha2, beta2, alphabeta, alphax, betax);
+            if (error < best_error) {
+                best_error = error;
+                memcpy(best_a, a, sizeof(a));
+                memcpy(best_b, b, sizeof(b));
+            }
+        }
+    if (best_error < FLT_MAX) TryEndpointsBC1Float(pixel_buffer, best_a, best_b, false, best);
+}
+
+// Optimal encoding of a block consisting of a single color. For every
+// component, the pair of endpoints is searched for which the 2/3 : 1/3
+// interpolated palette color is closest to the color.
+static void SingleColorBC1(const uint8_t *DETEX_RESTRICT pixel_buffer, BC1Candidate *DETEX_RESTRICT best) {
+    int endpoint_a[3], endpoint_b[3];
+    for (int c = 0; c < 3; c++) {
+        int bits = c == 1 ? 6 : 5;
+        int shift = 8 - bits;
+        int value = pixel_buffer[c];
+        int best_error = INT32_MAX;
+        for (int a = 0; a < (1 << bits) && best_error > 0; a++)
+            for (int b = 0; b < (1 << bits); b++) {
+                int error = abs((int)detexDivide0To767By3(2 * (a << shift) + (b << shift)) - value);
+                if (error < best_error) {
+                    best_error = error;
+                    endpoint_a[c] = a;
+                    endpoint_b[c] = b;
+                    if (error == 0) break;
+                }
+            }
+    }
+    uint32_t color_a = (endpoint_a[0] << 11) | (endpoint_a[1] << 5) | endpoint_a[2];
+    uint32_t color_b = (endpoint_b[0] << 11) | (endpoint_b[1] << 5) | endpoint_b[2];
+    TryEndpointsBC1(pixel_buffer, color_a, color_b, true, best);
+}
+
+static void CompressColorBlock(const uint8_t *DETEX_RESTRICT pixel_buffer,
+                               uint32_t flags,
+                               bool allow_three_colors,
+                               uint8_t *DETEX_RESTRICT bitstring) {
+    // Palette entry 3 of a 3-color block is decoded as transparent black by
+    // D3D and GPU decoders, so it is only used for black on request.
+    BC1Candidate best = {UINT32_MAX, 0, 0, 0, true, allow_three_colors && (flags & DETEX_COMPRESS_FLAG_BC1_BLACK)};
+    float mean[3], axis[3];
+    if (!CalculatePrincipalAxis(pixel_buffer, mean, axis))
+        SingleColorBC1(pixel_buffer, &best);
+    else {
+        RangeFitBC1(pixel_buffer, mean, axis, allow_three_colors, &best);
+        if (flags & DETEX_COMPRESS_FLAG_QUALITY) ClusterFitBC1(pixel_buffer, axis, allow_three_colors, &best);
+    }
+    StoreColorBlock(best.color0, best.color1, best.indices, bitstring);
+}
+
+/* Compress a 4x4 block of RGBA8 pixels into a 64-bit BC1 block. */
+bool detexCompressBlockBC1(const uint8_t *DETEX_RESTRICT pixel_buffer,
+                           uint32_t flags,
+                           uint8_t *DETEX_RESTRICT bitstring) {
+    CompressColorBlock(pixel_buffer, flags, true, bitstring);
+    return true;
+}
+
+// Calculate the eight palette values of a BC3 alpha block in the same way as
+// the BC3 decoder.
+static void CalculatePaletteBC3Alpha(int alpha0, int alpha1, int *palette) {
+    palette[0] = alpha0;
+    palette[1] = alpha1;
+    if (alpha0 > alpha1) {
+        for (int i = 1; i < 7; i++) palette[i + 1] = detexDivide0To1791By7((7 - i) * alpha0 + i * alpha1);
+    } else {
+        for (int i = 1; i < 5; i++) palette[i + 1] = detexDivide0To1279By5((5 - i) * alpha0 + i * alpha1);
+        palette[6] = 0;
+        palette[7] = 0xFF;
+    }
+}
+
+// Best alpha block found so far.
+typedef struct {
+    uint32_t error;
+    int alpha0;
+    int alpha1;
+    uint64_t indices;
+} BC3AlphaCandidate;
+
+static void TryEndpointsBC3Alpha(const uint8_t *DETEX_RESTRICT pixel_buffer,
+                                 int alpha0,
+                                 int alpha1,
+                                 BC3AlphaCandidate *DETEX_RESTRICT best) {
+    int palette[8];
+    CalculatePaletteBC3Alpha(alpha0, alpha1, palette);
+    uint64_t indices = 0;
+    uint32_t total_error = 0;
+    for (int i = 0; i < 16; i++) {
+        int alpha = pixel_buffer[i * 4 + 3];
+        uint32_t best_error = UINT32_MAX;
+        int best_index = 0;
+        for (int j = 0; j < 8; j++) {
+            uint32_t error = (alpha - palette[j]) * (alpha - palette[j]);
+            if (error < best_error) {
+                best_error = error;
+                best_index = j;
+            }
+        }
+        indices |= (uint64_t)best_index << (i * 3);
+        total_error += best_error;
+        if (total_error >= best->error) return;
+    }
+    best->error = total_error;
+    best->alpha0 = alpha0;
+    best->alpha1 = alpha1;
+    best->indices = indices;
+}
+
+static void CompressAlphaBlockBC3(const uint8_t *DETEX_RESTRICT pixel_buffer,
+                                  uint32_t flags,
+                                  uint8_t *DETEX_RESTRICT bitstring) {
+    int min_alpha = 255, max_alpha = 0;
+    // Range of the alpha values excluding 0 and 255, for the 6-value mode.
+    int min_inner_alpha = 255, max_inner_alpha = 0;
+    for (int i = 0; i < 16; i++) {
+        int alpha = pixel_buffer[i * 4 + 3];
+        min_alpha = alpha < min_alpha ? alpha : min_alpha;
+        max_alpha = alpha > max_alpha ? alpha : max_alpha;
+        if (alpha != 0 && alpha != 255) {
+            min_inner_alpha = alpha < min_inner_alpha ? alpha : min_inner_alpha;
+            max_inner_alpha = alpha > max_inner_alpha ? alpha : max_inner_alpha;
+        }
+    }
+    BC3AlphaCandidate best;
+    best.error = UINT32_MAX;
+    // 8-value mode (alpha0 > alpha1), or a single value when min == max.
+    TryEndpointsBC3Alpha(pixel_buffer, max_alpha, min_alpha, &best);
+    if ((flags & DETEX_COMPRESS_FLAG_QUALITY) && best.error > 0) {
+        // Search a small window of endpoints inside the range; pulling the
+        // endpoints in can reduce the error of the interpolated values.
+        for (int alpha0 = max_alpha; alpha0 >= max_alpha - 4 && alpha0 >= 0; alpha0--)
+            for (int alpha1 = min_alpha; alpha1 <= min_alpha + 4 && alpha1 < alpha0; alpha1++)
+                TryEndpointsBC3Alpha(pixel_buffer, alpha0, alpha1, &best);
+        // 6-value mode (alpha0 <= alpha1) with explicit 0 and 255.
+        if (min_inner_alpha > max_inner_alpha) min_inner_alpha = max_inner_alpha = 0;
+        TryEndpointsBC3Alpha(pixel_buffer, min_inner_alpha, max_inner_alpha, &best);
+    }
+    bitstring[0] = best.alpha0;
+    bitstring[1] = best.alpha1;
+    for (int i = 0; i < 6; i++) bitstring[2 + i] = (best.indices >> (i * 8)) & 0xFF;
+}
+
+/* Compress a 4x4 block of RGBA8 pixels into a 128-bit BC3 block. */
+bool detexCompressBlockBC3(const uint8_t *DETEX_RESTRICT pixel_buffer,
+                           uint32_t flags,
+                           uint8_t *DETEX_RESTRICT bitstring) {
+    CompressAlphaBlockBC3(pixel_buffer, flags, bitstring);
+    // The color block of BC2/BC3 is always decoded in 4-color mode.
+    CompressColorBlock(pixel_buffer, flags, false, &bitstring[8]);
+    return true;
+}
+
+// Rate-distortion optimization. The rate of a block is estimated as the number
+// of bits a general purpose compressor such as zstd needs to store it: a field
+// (the endpoints or the indices) that also occurs in one of the previous blocks
+// costs about as much as a match, other fields are stored as literals.
+#define RDO_MATCH_BITS 16
+// Fields shorter than this are too short to be matched.
+#define RDO_MIN_MATCH 3
+
+// Estimate the number of bits of an 8-byte (half) block candidate, of which
+// the first split bytes hold the endpoints. The reference blocks are compared
+// at the given offset.
+static uint32_t EstimateBitsRDO(const uint8_t *candidate,
+                                const uint8_t *const *references,
+                                int nu_references,
+                                int offset,
+                                int split) {
+    bool endpoints_match = false;
+    bool indices_match = false;
+    for (int i = 0; i < nu_references; i++) {
+        const uint8_t *previous = references[i] + offset;
+        if (memcmp(candidate, previous, 8) == 0) return RDO_MATCH_BITS;
+        endpoints_match = endpoints_match || memcmp(candidate, previous, split) == 0;
+        indices_match = indices_match || memcmp(candidate + split, previous + split, 8 - split) == 0;
+    }
+    if (split < RDO_MIN_MATCH) endpoints_match = false;
+    if (8 - split < RDO_MIN_MATCH) indices_match = false;
+    return (endpoints_match ? RDO_MATCH_BITS : split * 8) + (indices_match ? RDO_MATCH_BITS : (8 - split) * 8);
+}
+
+// Squared error of an encoded color block, decoded in the same way as the
+// decoders. Returns UINT32_MAX when a 3-color block uses palette entry 3 and
+// allow_black is false.
+static uint32_t EvaluateColorBlock(const uint8_t *DETEX_RESTRICT pixel_buffer,
+                                   const uint8_t *block,
+                                   bool allow_three_colors,
+                                   bool allow_black) {
+    uint32_t color0 = block[0] | ((uint32_t)block[1] << 8);
+    uint32_t color1 = block[2] | ((uint32_t)block[3] << 8);
+    uint32_t indices = block[4] | ((uint32_t)block[5] << 8) | ((uint32_t)block[6] << 16) | ((uint32_t)block[7] << 24);
+    bool four_colors = !allow_three_colors || color0 > color1;
+    int palette[4][3];
+    CalculatePaletteBC1(color0, color1, four_colors, palette);
+    uint32_t error = 0;
+    for (int i = 0; i < 16; i++) {
+        int index = (indices >> (i * 2)) & 3;
+        if (index == 3 && !four_colors && !allow_black) return UINT32_MAX;
+        const int *color = palette[index];
+        for (int c = 0; c < 3; c++) {
+            int d = pixel_buffer[i * 4 + c] - color[c];
+            error += d * d;
+        }
+    }
+    return error;
+}
+
+// Best rate-distortion candidate found so far.
+typedef struct {
+    uint32_t cost;
+    uint8_t block[8];
+} RDOCandidate;
+
+static void TryCandidateRDO(const uint8_t *candidate,
+                            uint32_t error,
+                            uint32_t lambda,
+                            const uint8_t *const *references,
+                            int nu_references,
+                            int offset,
+                            int split,
+                            RDOCandidate *best) {
+    if (error == UINT32_MAX) return;
+    uint32_t cost = error + lambda * EstimateBitsRDO(candidate, references, nu_references, offset, split);
+    if (cost < best->cost) {
+        best->cost = cost;
+        memcpy(best->block, candidate, 8);
+    }
+}
+
+// Replace the color block at bitstring by a block that reuses the endpoints or
+// the indices of one of the reference blocks when that lowers the cost
+// error + lambda * bits.
+static void OptimizeColorBlock(const uint8_t *DETEX_RESTRICT pixel_buffer,
+                               uint32_t lambda,
+                               const uint8_t *const *references,
+                               int nu_references,
+                               int offset,
+                               bool allow_three_colors,
+                               bool allow_black,
+                               uint8_t *DETEX_RESTRICT bitstring) {
+    RDOCandidate best;
+    // The current block is valid as it is, even when it comes from a BC1
+    // source that uses the black entry.
+    best.cost = EvaluateColorBlock(pixel_buffer, bitstring, allow_three_colors, true) +
+                lambda * EstimateBitsRDO(bitstring, references, nu_references, offset, 4);
+    memcpy(best.block, bitstring, 8);
+    for (int i = 0; i < nu_references; i++) {
+        const uint8_t *previous = references[i] + offset;
+        // Runs of identical blocks are common once blocks are reused.
+        if (i > 0 && memcmp(previous, references[i - 1] + offset, 8) == 0) continue;
+        uint8_t candidate[8];
+        // The whole block.
+        TryCandidateRDO(previous,
+                        EvaluateColorBlock(pixel_buffer, previous, allow_three_colors, allow_black),
+                        lambda,
+                        references,
+                        nu_references,
+                        offset,
+                        4,
+                        &best);
+        // The endpoints, with the best indices for them.
+        uint32_t color0 = previous[0] | ((uint32_t)previous[1] << 8);
+        uint32_t color1 = previous[2] | ((uint32_t)previous[3] << 8);
+        bool four_colors = !allow_three_colors || color0 > color1;
+        int palette[4][3];
+        CalculatePaletteBC1(color0, color1, four_colors, palette);
+        uint32_t indices;
+        uint32_t error = SelectIndicesBC1(pixel_buffer, palette, four_colors || allow_black ? 4 : 3, &indices);
+        StoreColorBlock(color0, color1, indices, candidate);
+        TryCandidateRDO(candidate, error, lambda, references, nu_references, offset, 4, &best);
+        // The indices, with least squares endpoints for them. The order of the
+        // endpoints must be kept because it selects the mode.
+        indices = previous[4] | ((uint32_t)previous[5] << 8) | ((uint32_t)previous[6] << 16) |
+                  ((uint32_t)previous[7] << 24);
+        float a[3], b[3];
+        if (!RefineEndpointsBC1(pixel_buffer, indices, four_colors, a, b)) continue;
+        uint32_t new_color0 = Pack565(a);
+        uint32_t new_color1 = Pack565(b);
+        if ((new_color0 > new_color1) != (color0 > color1)) continue;
+        StoreColorBlock(new_color0, new_color1, indices, candidate);
+        TryCandidateRDO(candidate,
+                        EvaluateColorBlock(pixel_buffer, candidate, allow_three_colors, allow_black),
+                        lambda,
+                        references,
+                        nu_references,
+                        offset,
+                        4,
+                        &best);
+    }
+    memcpy(bitstring, best.block, 8);
+}
+
+/* Rate-distortion optimize a BC1 block against a set of reference blocks. */
+void detexOptimizeBlockBC1(const uint8_t *DETEX_RESTRICT pixel_buffer,
+                           uint32_t flags,
+                           const uint8_t *const *references,
+                           int nu_references,
+                           uint8_t *DETEX_RESTRICT bitstring) {
+    uint32_t lambda = (flags & DETEX_COMPRESS_RDO_MASK) >> DETEX_COMPRESS_RDO_SHIFT;
+    bool allow_black = (flags & DETEX_COMPRESS_FLAG_BC1_BLACK) != 0;
+    OptimizeColorBlock(pixel_buffer, lambda, references, nu_references, 0, true, allow_black, bitstring);
+}
+
+// Load the 48-bit index field of a BC3 alpha block.
+static uint64_t LoadAlphaIndicesBC3(const uint8_t *block) {
+    uint64_t indices = 0;
+    for (int i = 0; i < 6; i++) indices |= (uint64_t)block[2 + i] << (i * 8);
+    return indices;
+}
+
+// Squared error of an encoded BC3 alpha block.
+static uint32_t EvaluateAlphaBlockBC3(const uint8_t *DETEX_RESTRICT pixel_buffer, const uint8_t *block) {
+    int palette[8];
+    CalculatePaletteBC3Alpha(block[0], block[1], palette);
+    uint64_t indices = LoadAlphaIndicesBC3(block);
+    uint32_t error = 0;
+    for (int i = 0; i < 16; i++) {
+        int index = (indices >> (i * 3)) & 7;
+        int d = pixel_buffer[i * 4 + 3] - palette[index];
+        error += d * d;
+    }
+    return error;
+}
+
+// Least squares alpha endpoints for the indices of an alpha block, keeping the
+// mode (alpha0 > alpha1) of the block. Returns false when there are none.
+static bool RefineEndpointsBC3Alpha(const uint8_t *DETEX_RESTRICT pixel_buffer,
+                                    const uint8_t *block,
+                                    uint8_t *alpha0_out,
+                                    uint8_t *alpha1_out) {
+    bool eight_values = block[0] > block[1];
+    uint64_t indices = LoadAlphaIndicesBC3(block);
+    float alpha2 = 0, beta2 = 0, alphabeta = 0, alphax = 0, betax = 0;
+    for (int i = 0; i < 16; i++) {
+        int index = (indices >> (i * 3)) & 7;
+        float alpha;
+        if (index <= 1)
+            alpha = index == 0 ? 1.0f : 0.0f;
+        else if (eight_values)
+            alpha = (8 - index) / 7.0f;
+        else if (index <= 5)
+            alpha = (6 - index) / 5.0f;
+        else
+            // The constant 0 and 255 of the 6-value mode.
+            continue;
+        float beta = 1.0f - alpha;
+        alpha2 += alpha * alpha;
+        beta2 += beta * beta;
+        alphabeta += alpha * beta;
+        alphax += alpha * pixel_buffer[i * 4 + 3];
+        betax += beta * pixel_buffer[i * 4 + 3];
+    }
+    float factor = alpha2 * beta2 - alphabeta * alphabeta;
+    if (fabsf(factor) < 0.0001f) return false;
+    float a = (alphax * beta2 - betax * alphabeta) / factor;
+    float b = (betax * alpha2 - alphax * alphabeta) / factor;
+    int alpha0 = (int)floorf(a + 0.5f);
+    int alpha1 = (int)floorf(b + 0.5f);
+    alpha0 = alpha0 < 0 ? 0 : (alpha0 > 255 ? 255 : alpha0);
+    alpha1 = alpha1 < 0 ? 0 : (alpha1 > 255 ? 255 : alpha1);
+    if ((alpha0 > alpha1) != eight_values) return false;
+    *alpha0_out = alpha0;
+    *alpha1_out = alpha1;
+    return true;
+}
+
+// Replace the alpha block at bitstring by a block that reuses one of the
+// reference blocks or their indices when that lowers the cost. The endpoints
+// are too short to be matched on their own.
+static void OptimizeAlphaBlockBC3(const uint8_t *DETEX_RESTRICT pixel_buffer,
+                                  uint32_t lambda,
+                                  const uint8_t *const *references,
+                                  int nu_references,
+                                  uint8_t *DETEX_RESTRICT bitstring) {
+    RDOCandidate best;
+    best.cost = EvaluateAlphaBlockBC3(pixel_buffer, bitstring) +
+                lambda * EstimateBitsRDO(bitstring, references, nu_references, 0, 2);
+    memcpy(best.block, bitstring, 8);
+    for (int i = 0; i < nu_references; i++) {
+        const uint8_t *previous = references[i];
+        if (i > 0 && memcmp(previous, references[i - 1], 8) == 0) continue;
+        TryCandidateRDO(
+            previous, EvaluateAlphaBlockBC3(pixel_buffer, previous), lambda, references, nu_references, 0, 2, &best);
+        uint8_t candidate[8];
+        memcpy(candidate, previous, 8);
+        if (!RefineEndpointsBC3Alpha(pixel_buffer, previous, &candidate[0], &candidate[1])) continue;
+        TryCandidateRDO(
+            candidate, EvaluateAlphaBlockBC3(pixel_buffer, candidate), lambda, references, nu_references, 0, 2, &best);
+    }
+    memcpy(bitstring, best.block, 8);
+}
+
+/* Rate-distortion optimize a BC3 block against a set of reference blocks. */
+void detexOptimizeBlockBC3(const uint8_t *DETEX_RESTRICT pixel_buffer,
+                           uint32_t flags,
+                           const uint8_t *const *references,
+                           int nu_references,
+                           uint8_t *DETEX_RESTRICT bitstring) {
+    uint32_t lambda = (flags & DETEX_COMPRESS_RDO_MASK) >> DETEX_COMPRESS_RDO_SHIFT;
+    OptimizeAlphaBlockBC3(pixel_buffer, lambda, references, nu_references, bitstring);
+    // The color block of BC3 is always decoded in 4-color mode.
+    OptimizeColorBlock(pixel_buffer, lambda, references, nu_references, 8, false, false, &bitstring[8]);
+}
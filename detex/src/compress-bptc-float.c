@@ -0,0 +1,717 @@
+/*
+
+Copyright (c) 2015 Harm Hanemaaijer <fgenfb@yahoo.com>
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+*/
+
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#include "detex.h"
+
+// BPTC_FLOAT (BC6H) encoder, the counterpart of the decoder in
+// decompress-bptc-float.c. The endpoints of each subset are fitted along the
+// principal axis of its pixels in the domain of the unquantized endpoints (the
+// half-float bit patterns scaled by 64 / 31, or 32 / 31 for the signed format),
+// and every mode quantizes and packs the same fitted endpoints. The error is
+// measured on the decoded half-float bit patterns, which is roughly
+// logarithmic in the pixel values. Only the best few partitions of the
+// two-subset modes (the search budget) are encoded in full. The quality flag
+// raises the budget, adds least squares refinement iterations and tries to
+// improve the quantized endpoints one step at a time.
+
+// A run of bits of an endpoint component in the block header, written in the
+// notation of the decoder comments: component[a:b] stores bit b first,
+// followed by the bits towards bit a.
+typedef struct {
+    int8_t endpoint;
+    int8_t component;
+    int8_t a;
+    int8_t b;
+} BitRun;
+
+#define R(endpoint, a, b) {endpoint, 0, a, b}
+#define G(endpoint, a, b) {endpoint, 1, a, b}
+#define B(endpoint, a, b) {endpoint, 2, a, b}
+#define END {-1, 0, 0, 0}
+
+static const BitRun layout_mode0[] = {
+    G(2, 4, 4), B(2, 4, 4), B(3, 4, 4), R(0, 9, 0), G(0, 9, 0), B(0, 9, 0), R(1, 4, 0), G(3, 4, 4), G(2, 3, 0),
+    G(1, 4, 0), B(3, 0, 0), G(3, 3, 0), B(1, 4, 0), B(3, 1, 1), B(2, 3, 0), R(2, 4, 0), B(3, 2, 2), R(3, 4, 0),
+    B(3, 3, 3), END};
+static const BitRun layout_mode1[] = {
+    G(2, 5, 5), G(3, 4, 4), G(3, 5, 5), R(0, 6, 0), B(3, 0, 0), B(3, 1, 1), B(2, 4, 4), G(0, 6, 0), B(2, 5, 5),
+    B(3, 2, 2), G(2, 4, 4), B(0, 6, 0), B(3, 3, 3), B(3, 5, 5), B(3, 4, 4), R(1, 5, 0), G(2, 3, 0), G(1, 5, 0),
+    G(3, 3, 0), B(1, 5, 0), B(2, 3, 0), R(2, 5, 0), R(3, 5, 0), END};
+static const BitRun layout_mode2[] = {
+    R(0, 9, 0), G(0, 9, 0), B(0, 9, 0), R(1, 4, 0), R(0, 10, 10), G(2, 3, 0), G(1, 3, 0), G(0, 10, 10),
+    B(3, 0, 0), G(3, 3, 0), B(1, 3, 0), B(0, 10, 10), B(3, 1, 1), B(2, 3, 0), R(2, 4, 0), B(3, 2, 2),
+    R(3, 4, 0), B(3, 3, 3), END};
+static const BitRun layout_mode3[] = {
+    R(0, 9, 0), G(0, 9, 0), B(0, 9, 0), R(1, 3, 0), R(0, 10, 10), G(3, 4, 4), G(2, 3, 0), G(1, 4, 0),
+    G(0, 10, 10), G(3, 3, 0), B(1, 3, 0), B(0, 10, 10), B(3, 1, 1), B(2, 3, 0), R(2, 3, 0), B(3, 0, 0),
+    B(3, 2, 2), R(3, 3, 0), G(2, 4, 4), B(3, 3, 3), END};
+static const BitRun layout_mode4[] = {
+    R(0, 9, 0), G(0, 9, 0), B(0, 9, 0), R(1, 3, 0), R(0, 10, 10), B(2, 4, 4), G(2, 3, 0), G(1, 3, 0),
+    G(0, 10, 10), B(3, 0, 0), G(3, 3, 0), B(1, 4, 0), B(0, 10, 10), B(2, 3, 0), R(2, 3, 0), B(3, 1, 1),
+    B(3, 2, 2), R(3, 3, 0), B(3, 4, 4), B(3, 3, 3), END};
+static const BitRun layout_mode5[] = {
+    R(0, 8, 0), B(2, 4, 4), G(0, 8, 0), G(2, 4, 4), B(0, 8, 0), B(3, 4, 4), R(1, 4, 0), G(3, 4, 4), G(2, 3, 0),
+    G(1, 4, 0), B(3, 0, 0), G(3, 3, 0), B(1, 4, 0), B(3, 1, 1), B(2, 3, 0), R(2, 4, 0), B(3, 2, 2), R(3, 4, 0),
+    B(3, 3, 3), END};
+static const BitRun layout_mode6[] = {
+    R(0, 7, 0), G(3, 4, 4), B(2, 4, 4), G(0, 7, 0), B(3, 2, 2), G(2, 4, 4), B(0, 7, 0), B(3, 3, 3), B(3, 4, 4),
+    R(1, 5, 0), G(2, 3, 0), G(1, 4, 0), B(3, 0, 0), G(3, 3, 0), B(1, 4, 0), B(3, 1, 1), B(2, 3, 0), R(2, 5, 0),
+    R(3, 5, 0), END};
+static const BitRun layout_mode7[] = {
+    R(0, 7, 0), B(3, 0, 0), B(2, 4, 4), G(0, 7, 0), G(2, 5, 5), G(2, 4, 4), B(0, 7, 0), G(3, 5, 5), B(3, 4, 4),
+    R(1, 4, 0), G(3, 4, 4), G(2, 3, 0), G(1, 5, 0), G(3, 3, 0), B(1, 4, 0), B(3, 1, 1), B(2, 3, 0), R(2, 4, 0),
+    B(3, 2, 2), R(3, 4, 0), B(3, 3, 3), END};
+static const BitRun layout_mode8[] = {
+    R(0, 7, 0), B(3, 1, 1), B(2, 4, 4), G(0, 7, 0), B(2, 5, 5), G(2, 4, 4), B(0, 7, 0), B(3, 5, 5), B(3, 4, 4),
+    R(1, 4, 0), G(3, 4, 4), G(2, 3, 0), G(1, 4, 0), B(3, 0, 0), G(3, 3, 0), B(1, 5, 0), B(2, 3, 0), R(2, 4, 0),
+    B(3, 2, 2), R(3, 4, 0), B(3, 3, 3), END};
+static const BitRun layout_mode9[] = {
+    R(0, 5, 0), G(3, 4, 4), B(3, 0, 0), B(3, 1, 1), B(2, 4, 4), G(0, 5, 0), G(2, 5, 5), B(2, 5, 5), B(3, 2, 2),
+    G(2, 4, 4), B(0, 5, 0), G(3, 5, 5), B(3, 3, 3), B(3, 5, 5), B(3, 4, 4), R(1, 5, 0), G(2, 3, 0), G(1, 5, 0),
+    G(3, 3, 0), B(1, 5, 0), B(2, 3, 0), R(2, 5, 0), R(3, 5, 0), END};
+static const BitRun layout_mode10[] = {R(0, 9, 0), G(0, 9, 0), B(0, 9, 0), R(1, 9, 0), G(1, 9, 0), B(1, 9, 0), END};
+static const BitRun layout_mode11[] = {R(0, 9, 0), G(0, 9, 0), B(0, 9, 0), R(1, 8, 0), R(0, 10, 10), G(1, 8, 0),
+    G(0, 10, 10), B(1, 8, 0), B(0, 10, 10), END};
+static const BitRun layout_mode12[] = {R(0, 9, 0), G(0, 9, 0), B(0, 9, 0), R(1, 7, 0), R(0, 10, 11), G(1, 7, 0),
+    G(0, 10, 11), B(1, 7, 0), B(0, 10, 11), END};
+static const BitRun layout_mode13[] = {R(0, 9, 0), G(0, 9, 0), B(0, 9, 0), R(1, 3, 0), R(0, 10, 15), G(1, 3, 0),
+    G(0, 10, 15), B(1, 3, 0), B(0, 10, 15), END};
+
+#undef R
+#undef G
+#undef B
+#undef END
+
+typedef struct {
+    int nu_subsets;
+    // Value and size of the mode field.
+    int mode_value;
+    int mode_bits;
+    // Precision of the endpoints (EPB).
+    int endpoint_bits;
+    // Precision of the red, green and blue deltas of the transformed
+    // endpoints, zero when the endpoints are stored as they are.
+    int delta_bits[3];
+    const BitRun *layout;
+} BPTCFloatMode;
+
+static const BPTCFloatMode bptc_float_modes[14] = {
+    {2, 0x00, 2, 10, {5, 5, 5}, layout_mode0},
+    {2, 0x01, 2, 7, {6, 6, 6}, layout_mode1},
+    {2, 0x02, 5, 11, {5, 4, 4}, layout_mode2},
+    {2, 0x06, 5, 11, {4, 5, 4}, layout_mode3},
+    {2, 0x0A, 5, 11, {4, 4, 5}, layout_mode4},
+    {2, 0x0E, 5, 9, {5, 5, 5}, layout_mode5},
+    {2, 0x12, 5, 8, {6, 5, 5}, layout_mode6},
+    {2, 0x16, 5, 8, {5, 6, 5}, layout_mode7},
+    {2, 0x1A, 5, 8, {5, 5, 6}, layout_mode8},
+    {2, 0x1E, 5, 6, {0, 0, 0}, layout_mode9},
+    {1, 0x03, 5, 10, {0, 0, 0}, layout_mode10},
+    {1, 0x07, 5, 11, {9, 9, 9}, layout_mode11},
+    {1, 0x0B, 5, 12, {8, 8, 8}, layout_mode12},
+    {1, 0x0F, 5, 16, {4, 4, 4}, layout_mode13},
+};
+
+// Maximum number of partitions evaluated in full for the two-subset modes.
+#define BPTC_FLOAT_MAX_BUDGET 32
+
+// The pixels of a block.
+typedef struct {
+    // Decoded half-float bit patterns to aim for, negative for negative values
+    // of the signed format.
+    int targets[16][3];
+    // The targets in the domain of the unquantized endpoints.
+    float pixels[16][3];
+    bool is_signed;
+    uint32_t flags;
+    // Improve the quantized endpoints one step at a time (quality mode, only
+    // for the final mode and partition).
+    bool polish;
+} BPTCFloatBlock;
+
+// The pixels of one subset with the fitted (unquantized) endpoints.
+typedef struct {
+    uint8_t members[16];
+    int nu_members;
+    float endpoints[2][3];
+} BPTCFloatSubset;
+
+// Best BPTC_FLOAT block found so far.
+typedef struct {
+    uint64_t error;
+    int mode;
+    int partition;
+    uint8_t bitstring[16];
+} BPTCFloatCandidate;
+
+DETEX_INLINE_ONLY int GetIndexBits(const BPTCFloatMode *m) { return m->nu_subsets == 1 ? 4 : 3; }
+
+DETEX_INLINE_ONLY int GetAnchor(int partition, int subset) {
+    return subset == 0 ? 0 : detex_bptc_table_anchor_index_second_subset[partition];
+}
+
+// Range of the quantized endpoints of the given precision.
+DETEX_INLINE_ONLY int GetMinEndpoint(int bits, bool is_signed) { return is_signed ? -((1 << (bits - 1)) - 1) : 0; }
+
+DETEX_INLINE_ONLY int GetMaxEndpoint(int bits, bool is_signed) {
+    return is_signed ? (1 << (bits - 1)) - 1 : (1 << bits) - 1;
+}
+
+// Reconstruct an endpoint component in the same way as the decoder.
+static int UnquantizeEndpoint(int value, int bits, bool is_signed) {
+    if (bits == 16) return value;
+    int magnitude = is_signed && value < 0 ? -value : value;
+    int unquantized;
+    if (magnitude == 0)
+        unquantized = 0;
+    else if (magnitude == GetMaxEndpoint(bits, is_signed))
+        unquantized = is_signed ? 0x7FFF : 0xFFFF;
+    else
+        unquantized = ((magnitude << 15) + 0x4000) >> (bits - 1);
+    return value < 0 ? -unquantized : unquantized;
+}
+
+// Quantize an endpoint component to the nearest value that the decoder can
+// reconstruct.
+static int QuantizeEndpoint(float value, int bits, bool is_signed) {
+    int min_value = GetMinEndpoint(bits, is_signed);
+    int max_value = GetMaxEndpoint(bits, is_signed);
+    if (bits == 16) {
+        int q = (int)floorf(value + 0.5f);
+        return q < min_value ? min_value : (q > max_value ? max_value : q);
+    }
+    float scaled = floorf(value * (1 << bits) / 65536.0f);
+    int estimate = (int)fminf(fmaxf(scaled, (float)(min_value + 1)), (float)(max_value - 1));
+    int best_value = 0;
+    float best_error = FLT_MAX;
+    for (int q = estimate - 1; q <= estimate + 1; q++) {
+        if (q < min_value || q > max_value) continue;
+        float error = fabsf(UnquantizeEndpoint(q, bits, is_signed) - value);
+        if (error < best_error) {
+            best_error = error;
+            best_value = q;
+        }
+    }
+    return best_value;
+}
+
+// Interpolate between two unquantized endpoint components and apply the final
+// scaling of the decoder, giving a half-float bit pattern (negated for
+// negative values).
+DETEX_INLINE_ONLY int Interpolate(int e0, int e1, int weight, bool is_signed) {
+    int value = ((64 - weight) * e0 + weight * e1 + 32) >> 6;
+    if (!is_signed) return value * 31 / 64;
+    return value < 0 ? -(((-value) * 31) >> 5) : (value * 31) >> 5;
+}
+
+// Select the best index for every member pixel for the given quantized
+// endpoints. Returns the error, or a value of at least bound when the error
+// reaches bound. In fast mode, only the indices next to the projection of a
+// pixel on the line between the endpoints are tried.
+static uint64_t EvaluateEndpoints(const BPTCFloatBlock *block,
+                                  const BPTCFloatSubset *subset,
+                                  const int endpoints[2][3],
+                                  int bits,
+                                  int index_bits,
+                                  uint64_t bound,
+                                  uint8_t *DETEX_RESTRICT indices) {
+    const uint16_t *weights = index_bits == 3 ? detex_bptc_table_aWeight3 : detex_bptc_table_aWeight4;
+    int nu_indices = 1 << index_bits;
+    int e0[3], e1[3];
+    int palette[16][3];
+    for (int c = 0; c < 3; c++) {
+        e0[c] = UnquantizeEndpoint(endpoints[0][c], bits, block->is_signed);
+        e1[c] = UnquantizeEndpoint(endpoints[1][c], bits, block->is_signed);
+        for (int j = 0; j < nu_indices; j++) palette[j][c] = Interpolate(e0[c], e1[c], weights[j], block->is_signed);
+    }
+    bool project = !(block->flags & DETEX_COMPRESS_FLAG_QUALITY);
+    float direction[3];
+    float scale = 0;
+    for (int c = 0; c < 3; c++) {
+        direction[c] = (float)(e1[c] - e0[c]);
+        scale += direction[c] * direction[c];
+    }
+    if (scale > 0) scale = (nu_indices - 1) / scale;
+    uint64_t error = 0;
+    for (int k = 0; k < subset->nu_members; k++) {
+        int i = subset->members[k];
+        const int *target = block->targets[i];
+        int first = 0, last = nu_indices - 1;
+        if (project) {
+            const float *pixel = block->pixels[i];
+            float t = ((pixel[0] - e0[0]) * direction[0] + (pixel[1] - e0[1]) * direction[1] +
+                       (pixel[2] - e0[2]) * direction[2]) *
+                      scale;
+            int estimate = (int)floorf(fminf(fmaxf(t, 0.0f), (float)(nu_indices - 1)) + 0.5f);
+            first = estimate > 0 ? estimate - 1 : 0;
+            last = estimate < nu_indices - 1 ? estimate + 1 : nu_indices - 1;
+        }
+        uint64_t best_pixel_error = UINT64_MAX;
+        int best_index = 0;
+        for (int j = first; j <= last; j++) {
+            uint64_t pixel_error = 0;
+            for (int c = 0; c < 3; c++) {
+                int64_t d = palette[j][c] - target[c];
+                pixel_error += d * d;
+            }
+            if (pixel_error < best_pixel_error) {
+                best_pixel_error = pixel_error;
+                best_index = j;
+            }
+        }
+        indices[i] = best_index;
+        error += best_pixel_error;
+        if (error >= bound) return error;
+    }
+    return error;
+}
+
+// Least squares endpoints for the given indices. Returns false when the system
+// is singular (all members use the same weight).
+static bool RefineEndpoints(const BPTCFloatBlock *block,
+                            const BPTCFloatSubset *subset,
+                            int index_bits,
+                            const uint8_t *indices,
+                            float a[3],
+                            float b[3]) {
+    const uint16_t *weights = index_bits == 3 ? detex_bptc_table_aWeight3 : detex_bptc_table_aWeight4;
+    float alpha2 = 0, beta2 = 0, alphabeta = 0;
+    float alphax[3] = {0, 0, 0}, betax[3] = {0, 0, 0};
+    for (int k = 0; k < subset->nu_members; k++) {
+        int i = subset->members[k];
+        float beta = weights[indices[i]] / 64.0f;
+        float alpha = 1.0f - beta;
+        alpha2 += alpha * alpha;
+        beta2 += beta * beta;
+        alphabeta += alpha * beta;
+        for (int c = 0; c < 3; c++) {
+            alphax[c] += alpha * block->pixels[i][c];
+            betax[c] += beta * block->pixels[i][c];
+        }
+    }
+    float factor = alpha2 * beta2 - alphabeta * alphabeta;
+    if (fabsf(factor) < 0.0001f) return false;
+    for (int c = 0; c < 3; c++) {
+        a[c] = (alphax[c] * beta2 - betax[c] * alphabeta) / factor;
+        b[c] = (betax[c] * alpha2 - alphax[c] * alphabeta) / factor;
+    }
+    return true;
+}
+
+// Fit the endpoints of a subset with a range fit along the principal axis of
+// its pixels.
+static void FitSubset(const BPTCFloatBlock *block, BPTCFloatSubset *subset) {
+    float mean[3] = {0, 0, 0};
+    for (int k = 0; k < subset->nu_members; k++)
+        for (int c = 0; c < 3; c++) mean[c] += block->pixels[subset->members[k]][c];
+    for (int c = 0; c < 3; c++) mean[c] /= subset->nu_members;
+    float cov[3][3] = {{0}};
+    for (int k = 0; k < subset->nu_members; k++) {
+        float d[3];
+        for (int c = 0; c < 3; c++) d[c] = block->pixels[subset->members[k]][c] - mean[c];
+        for (int c = 0; c < 3; c++)
+            for (int c2 = 0; c2 < 3; c2++) cov[c][c2] += d[c] * d[c2];
+    }
+    int largest = 0;
+    for (int c = 1; c < 3; c++)
+        if (cov[c][c] > cov[largest][largest]) largest = c;
+    if (cov[0][0] + cov[1][1] + cov[2][2] < 0.001f) {
+        for (int c = 0; c < 3; c++) subset->endpoints[0][c] = subset->endpoints[1][c] = mean[c];
+        return;
+    }
+    // Power iteration, starting with the row of the largest diagonal element.
+    float v[3];
+    for (int c = 0; c < 3; c++) v[c] = cov[largest][c];
+    for (int iteration = 0; iteration < 8; iteration++) {
+        float w[3];
+        float m = 0;
+        for (int c = 0; c < 3; c++) {
+            w[c] = cov[c][0] * v[0] + cov[c][1] * v[1] + cov[c][2] * v[2];
+            m = fmaxf(m, fabsf(w[c]));
+        }
+        if (m == 0.0f) break;
+        for (int c = 0; c < 3; c++) v[c] = w[c] / m;
+    }
+    float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    if (length < 0.0001f) {
+        v[0] = v[1] = v[2] = 1.0f;
+        length = sqrtf(3.0f);
+    }
+    float t_min = FLT_MAX, t_max = -FLT_MAX;
+    for (int k = 0; k < subset->nu_members; k++) {
+        float t = 0;
+        for (int c = 0; c < 3; c++) t += (block->pixels[subset->members[k]][c] - mean[c]) * v[c] / length;
+        t_min = fminf(t_min, t);
+        t_max = fmaxf(t_max, t);
+    }
+    for (int c = 0; c < 3; c++) {
+        subset->endpoints[0][c] = mean[c] + v[c] / length * t_min;
+        subset->endpoints[1][c] = mean[c] + v[c] / length * t_max;
+    }
+}
+
+// Quantize a pair of unquantized endpoints.
+static void QuantizeEndpoints(const float a[3], const float b[3], int bits, bool is_signed, int endpoints[2][3]) {
+    for (int c = 0; c < 3; c++) {
+        endpoints[0][c] = QuantizeEndpoint(a[c], bits, is_signed);
+        endpoints[1][c] = QuantizeEndpoint(b[c], bits, is_signed);
+    }
+}
+
+// Quantize the fitted endpoints of a subset for a mode and improve them.
+// Returns the error; the endpoints and the indices of the members are stored.
+static uint64_t EncodeSubset(const BPTCFloatBlock *block,
+                             const BPTCFloatSubset *subset,
+                             const BPTCFloatMode *m,
+                             int endpoints[2][3],
+                             uint8_t *DETEX_RESTRICT indices) {
+    int bits = m->endpoint_bits;
+    int index_bits = GetIndexBits(m);
+    QuantizeEndpoints(subset->endpoints[0], subset->endpoints[1], bits, block->is_signed, endpoints);
+    uint64_t error = EvaluateEndpoints(block, subset, endpoints, bits, index_bits, UINT64_MAX, indices);
+    int nu_iterations = (block->flags & DETEX_COMPRESS_FLAG_QUALITY) ? 3 : 1;
+    for (int iteration = 0; iteration < nu_iterations && error > 0; iteration++) {
+        float a[3], b[3];
+        if (!RefineEndpoints(block, subset, index_bits, indices, a, b)) break;
+        int refined[2][3];
+        uint8_t refined_indices[16];
+        QuantizeEndpoints(a, b, bits, block->is_signed, refined);
+        uint64_t refined_error = EvaluateEndpoints(block, subset, refined, bits, index_bits, error, refined_indices);
+        if (refined_error >= error) break;
+        error = refined_error;
+        memcpy(endpoints, refined, sizeof(refined));
+        for (int k = 0; k < subset->nu_members; k++) indices[subset->members[k]] = refined_indices[subset->members[k]];
+    }
+    if (!block->polish) return error;
+    // Move the quantized endpoint components one step at a time while the
+    // error decreases.
+    int min_value = GetMinEndpoint(bits, block->is_signed);
+    int max_value = GetMaxEndpoint(bits, block->is_signed);
+    bool improved = true;
+    for (int pass = 0; pass < 4 && improved && error > 0; pass++) {
+        improved = false;
+        for (int k = 0; k < 2; k++)
+            for (int c = 0; c < 3; c++)
+                for (int step = -1; step <= 1; step += 2) {
+                    int value = endpoints[k][c] + step;
+                    if (value < min_value || value > max_value) continue;
+                    int trial[2][3];
+                    uint8_t trial_indices[16];
+                    memcpy(trial, endpoints, sizeof(trial));
+                    trial[k][c] = value;
+                    uint64_t trial_error =
+                        EvaluateEndpoints(block, subset, trial, bits, index_bits, error, trial_indices);
+                    if (trial_error < error) {
+                        error = trial_error;
+                        memcpy(endpoints, trial, sizeof(trial));
+                        for (int j = 0; j < subset->nu_members; j++)
+                            indices[subset->members[j]] = trial_indices[subset->members[j]];
+                        improved = true;
+                    }
+                }
+    }
+    return error;
+}
+
+// Make sure that the most significant index bit of the anchor pixel of a subset
+// is zero, as it is not stored, by swapping the endpoints and inverting the
+// indices when needed.
+static void FixAnchor(const BPTCFloatSubset *subset, int anchor, int index_bits, int endpoints[2][3], uint8_t *indices) {
+    int max_index = (1 << index_bits) - 1;
+    if (indices[anchor] <= max_index >> 1) return;
+    for (int c = 0; c < 3; c++) {
+        int temp = endpoints[0][c];
+        endpoints[0][c] = endpoints[1][c];
+        endpoints[1][c] = temp;
+    }
+    for (int k = 0; k < subset->nu_members; k++)
+        indices[subset->members[k]] = max_index - indices[subset->members[k]];
+}
+
+// Check whether the differences between the endpoints and the first endpoint
+// fit in the delta bits of a mode with transformed endpoints. When clamp is
+// set, the endpoints are moved into range instead.
+static bool CheckDeltas(const BPTCFloatMode *m, bool is_signed, bool clamp, int endpoints[4][3]) {
+    bool fits = true;
+    int min_value = GetMinEndpoint(m->endpoint_bits, is_signed);
+    int max_value = GetMaxEndpoint(m->endpoint_bits, is_signed);
+    for (int i = 1; i < m->nu_subsets * 2; i++)
+        for (int c = 0; c < 3; c++) {
+            int low = endpoints[0][c] - (1 << (m->delta_bits[c] - 1));
+            int high = endpoints[0][c] + (1 << (m->delta_bits[c] - 1)) - 1;
+            if (endpoints[i][c] >= low && endpoints[i][c] <= high) continue;
+            fits = false;
+            if (clamp) {
+                low = low < min_value ? min_value : low;
+                high = high > max_value ? max_value : high;
+                endpoints[i][c] = endpoints[i][c] < low ? low : high;
+            }
+        }
+    return fits;
+}
+
+static void WriteBits(detexBlock128 *block, uint32_t value, int nu_bits) {
+    if (block->index < 64) {
+        block->data0 |= (uint64_t)value << block->index;
+        if (block->index + nu_bits > 64) block->data1 |= (uint64_t)value >> (64 - block->index);
+    } else
+        block->data1 |= (uint64_t)value << (block->index - 64);
+    block->index += nu_bits;
+}
+
+static void PackBlock(const BPTCFloatMode *m,
+                      int partition,
+                      const int endpoints[4][3],
+                      const uint8_t *indices,
+                      const uint8_t *subset,
+                      uint8_t *bitstring) {
+    // The values stored in the header: the first endpoint, followed by the
+    // other endpoints or their deltas.
+    uint32_t fields[4][3];
+    for (int i = 0; i < m->nu_subsets * 2; i++)
+        for (int c = 0; c < 3; c++) {
+            int value = endpoints[i][c];
+            int bits = m->endpoint_bits;
+            if (i > 0 && m->delta_bits[c] > 0) {
+                value -= endpoints[0][c];
+                bits = m->delta_bits[c];
+            }
+            fields[i][c] = (uint32_t)value & ((1u << bits) - 1);
+        }
+    detexBlock128 block = {0, 0, 0};
+    WriteBits(&block, m->mode_value, m->mode_bits);
+    for (const BitRun *run = m->layout; run->endpoint >= 0; run++) {
+        int step = run->a >= run->b ? 1 : -1;
+        for (int bit = run->b;; bit += step) {
+            WriteBits(&block, (fields[run->endpoint][run->component] >> bit) & 1, 1);
+            if (bit == run->a) break;
+        }
+    }
+    int index_bits = GetIndexBits(m);
+    if (m->nu_subsets == 2) WriteBits(&block, partition, 5);
+    for (int i = 0; i < 16; i++) {
+        bool anchor = GetAnchor(partition, subset[i]) == i;
+        WriteBits(&block, indices[i], index_bits - anchor);
+    }
+    memcpy(&bitstring[0], &block.data0, 8);
+    memcpy(&bitstring[8], &block.data1, 8);
+}
+
+// Encode the block in the given mode and partition, using the fitted endpoints
+// of the subsets. Updates best when the error is lower.
+static void EncodeBlockBPTCFloatMode(const BPTCFloatBlock *block,
+                                     int mode,
+                                     int partition,
+                                     const BPTCFloatSubset *subsets,
+                                     BPTCFloatCandidate *DETEX_RESTRICT best) {
+    const BPTCFloatMode *m = &bptc_float_modes[mode];
+    int index_bits = GetIndexBits(m);
+    uint8_t subset[16];
+    for (int i = 0; i < 16; i++) subset[i] = m->nu_subsets == 1 ? 0 : detex_bptc_table_P2[partition * 16 + i];
+    int endpoints[4][3];
+    uint8_t indices[16];
+    uint64_t error = 0;
+    for (int s = 0; s < m->nu_subsets; s++) {
+        error += EncodeSubset(block, &subsets[s], m, &endpoints[s * 2], indices);
+        if (error >= best->error) return;
+        FixAnchor(&subsets[s], GetAnchor(partition, s), index_bits, &endpoints[s * 2], indices);
+    }
+    if (m->delta_bits[0] > 0 && !CheckDeltas(m, block->is_signed, true, endpoints)) {
+        // Reselect the indices for the clamped endpoints. Swapping the endpoints
+        // of the first subset changes the base of the deltas, so check again.
+        error = 0;
+        for (int s = 0; s < m->nu_subsets; s++) {
+            error += EvaluateEndpoints(
+                block, &subsets[s], &endpoints[s * 2], m->endpoint_bits, index_bits, best->error, indices);
+            if (error >= best->error) return;
+            FixAnchor(&subsets[s], GetAnchor(partition, s), index_bits, &endpoints[s * 2], indices);
+        }
+        if (!CheckDeltas(m, block->is_signed, false, endpoints)) return;
+    }
+    if (error >= best->error) return;
+    best->error = error;
+    best->mode = mode;
+    best->partition = partition;
+    PackBlock(m, partition, (const int(*)[3])endpoints, indices, subset, best->bitstring);
+}
+
+// Estimate the error of every partition of the two-subset modes. A subset is
+// approximated by the line through its principal axis: the variance off the
+// line is lost completely, the variance along it is reduced by the number of
+// index levels.
+static void EstimatePartitionErrors(const BPTCFloatBlock *block, float *errors) {
+    // Center the pixels to keep the sums of products accurate.
+    float mean[3] = {0, 0, 0};
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 3; c++) mean[c] += block->pixels[i][c] / 16.0f;
+    float pixels[16][3];
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 3; c++) pixels[i][c] = block->pixels[i][c] - mean[c];
+    const float levels = 7.0f;
+    for (int partition = 0; partition < 32; partition++) {
+        float sum[2][3] = {{0}};
+        float products[2][6] = {{0}};
+        int count[2] = {0, 0};
+        for (int i = 0; i < 16; i++) {
+            int s = detex_bptc_table_P2[partition * 16 + i];
+            const float *p = pixels[i];
+            count[s]++;
+            for (int c = 0; c < 3; c++) sum[s][c] += p[c];
+            products[s][0] += p[0] * p[0];
+            products[s][1] += p[0] * p[1];
+            products[s][2] += p[0] * p[2];
+            products[s][3] += p[1] * p[1];
+            products[s][4] += p[1] * p[2];
+            products[s][5] += p[2] * p[2];
+        }
+        float error = 0;
+        for (int s = 0; s < 2; s++) {
+            float cov[3][3];
+            int k = 0;
+            for (int c = 0; c < 3; c++)
+                for (int c2 = c; c2 < 3; c2++, k++)
+                    cov[c][c2] = cov[c2][c] = products[s][k] - sum[s][c] * sum[s][c2] / count[s];
+            float trace = cov[0][0] + cov[1][1] + cov[2][2];
+            // Largest eigenvalue with a few power iterations.
+            float v[3] = {1.0f, 1.0f, 1.0f};
+            float lambda = 0;
+            for (int iteration = 0; iteration < 4; iteration++) {
+                float w[3];
+                for (int c = 0; c < 3; c++) w[c] = cov[c][0] * v[0] + cov[c][1] * v[1] + cov[c][2] * v[2];
+                float length2 = w[0] * w[0] + w[1] * w[1] + w[2] * w[2];
+                if (length2 < 1e-6f) break;
+                float length = sqrtf(length2);
+                // Rayleigh quotient.
+                lambda = (w[0] * v[0] + w[1] * v[1] + w[2] * v[2]) / (v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+                for (int c = 0; c < 3; c++) v[c] = w[c] / length;
+            }
+            error += (trace - lambda) + lambda / (levels * levels);
+        }
+        errors[partition] = error;
+    }
+}
+
+// Divide the pixels over the subsets of a partition and fit their endpoints.
+static void FitPartition(const BPTCFloatBlock *block, int partition, BPTCFloatSubset *subsets) {
+    subsets[0].nu_members = subsets[1].nu_members = 0;
+    for (int i = 0; i < 16; i++) {
+        BPTCFloatSubset *subset = &subsets[detex_bptc_table_P2[partition * 16 + i]];
+        subset->members[subset->nu_members++] = i;
+    }
+    FitSubset(block, &subsets[0]);
+    FitSubset(block, &subsets[1]);
+}
+
+static void CompressBlockBPTCFloat(const uint8_t *DETEX_RESTRICT pixel_buffer,
+                                   uint32_t flags,
+                                   bool is_signed,
+                                   uint8_t *DETEX_RESTRICT bitstring) {
+    uint16_t half_floats[16 * 4];
+    memcpy(half_floats, pixel_buffer, sizeof(half_floats));
+    BPTCFloatBlock block;
+    block.is_signed = is_signed;
+    block.flags = flags;
+    block.polish = false;
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 3; c++) {
+            int h = half_floats[i * 4 + c];
+            // Clamp infinity and NaN to the largest finite value, and negative
+            // values to zero for the unsigned format.
+            int magnitude = h & 0x7FFF;
+            if (magnitude > 0x7BFF) magnitude = 0x7BFF;
+            bool negative = (h & 0x8000) != 0;
+            if (negative && !is_signed) magnitude = 0;
+            int target = negative ? -magnitude : magnitude;
+            block.targets[i][c] = target;
+            // Aim for the middle of the range of unquantized values that
+            // decode to the target.
+            float unquantized = 0;
+            if (magnitude > 0)
+                unquantized = is_signed ? fminf((magnitude + 0.5f) * 32.0f / 31.0f, 32767.0f)
+                                        : fminf((magnitude + 0.5f) * 64.0f / 31.0f, 65535.0f);
+            block.pixels[i][c] = negative ? -unquantized : unquantized;
+        }
+    int budget = (flags & DETEX_COMPRESS_BUDGET_MASK) >> DETEX_COMPRESS_BUDGET_SHIFT;
+    if (budget == 0) budget = (flags & DETEX_COMPRESS_FLAG_QUALITY) ? 4 : 1;
+    if (budget > BPTC_FLOAT_MAX_BUDGET) budget = BPTC_FLOAT_MAX_BUDGET;
+    BPTCFloatCandidate best;
+    best.error = UINT64_MAX;
+    // Single subset modes, starting with the ones with the most precise
+    // endpoints that usually win for smooth blocks.
+    BPTCFloatSubset whole;
+    whole.nu_members = 16;
+    for (int i = 0; i < 16; i++) whole.members[i] = i;
+    FitSubset(&block, &whole);
+    static const int single_subset_modes[4] = {11, 12, 10, 13};
+    for (int j = 0; j < 4 && best.error > 0; j++)
+        EncodeBlockBPTCFloatMode(&block, single_subset_modes[j], 0, &whole, &best);
+    // Two-subset modes for the partitions with the lowest estimated error.
+    int selected[BPTC_FLOAT_MAX_BUDGET];
+    int nu_selected = 0;
+    if (best.error > 0) {
+        float errors[32];
+        EstimatePartitionErrors(&block, errors);
+        for (int partition = 0; partition < 32; partition++) {
+            int j = nu_selected < budget ? nu_selected++ : budget;
+            for (; j > 0 && errors[selected[j - 1]] > errors[partition]; j--)
+                if (j < budget) selected[j] = selected[j - 1];
+            if (j < budget) selected[j] = partition;
+        }
+    }
+    for (int j = 0; j < nu_selected && best.error > 0; j++) {
+        BPTCFloatSubset subsets[2];
+        FitPartition(&block, selected[j], subsets);
+        for (int mode = 0; mode < 10 && best.error > 0; mode++)
+            EncodeBlockBPTCFloatMode(&block, mode, selected[j], subsets, &best);
+    }
+    if ((flags & DETEX_COMPRESS_FLAG_QUALITY) && best.error > 0) {
+        // Polish the endpoints of the best mode and partition.
+        block.polish = true;
+        if (best.mode >= 10) {
+            EncodeBlockBPTCFloatMode(&block, best.mode, 0, &whole, &best);
+        } else {
+            BPTCFloatSubset subsets[2];
+            FitPartition(&block, best.partition, subsets);
+            EncodeBlockBPTCFloatMode(&block, best.mode, best.partition, subsets, &best);
+        }
+    }
+    memcpy(bitstring, best.bitstring, 16);
+}
+
+/* Compress a 4x4 block of DETEX_PIXEL_FORMAT_FLOAT_RGBX16 pixels into a */
+/* 128-bit BPTC_FLOAT (BC6H) block. Negative values are encoded as zero. */
+bool detexCompressBlockBPTC_FLOAT(const uint8_t *DETEX_RESTRICT pixel_buffer,
+                                  uint32_t flags,
+                                  uint8_t *DETEX_RESTRICT bitstring) {
+    CompressBlockBPTCFloat(pixel_buffer, flags, false, bitstring);
+    return true;
+}
+
+/* Compress a 4x4 block of DETEX_PIXEL_FORMAT_SIGNED_FLOAT_RGBX16 pixels into */
+/* a 128-bit BPTC_SIGNED_FLOAT (BC6H_SF16) block. */
+bool detexCompressBlockBPTC_SIGNED_FLOAT(const uint8_t *DETEX_RESTRICT pixel_buffer,
+                                         uint32_t flags,
+                                         uint8_t *DETEX_RESTRICT bitstring) {
+    CompressBlockBPTCFloat(pixel_buffer, flags, true, bitstring);
+    return true;
+}
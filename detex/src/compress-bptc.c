@@ -0,0 +1,571 @@
+/*
+
+Copyright (c) 2015 Harm Hanemaaijer <fgenfb@yahoo.com>
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+*/
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#include "detex.h"
+
+// BPTC (BC7) encoder, the counterpart of the decoder in decompress-bptc.c. Every
+// one of the eight modes is tried. For the partitioned modes (0, 1, 2, 3 and 7),
+// the error of every partition is first estimated from the spread of the colors
+// of its subsets; only the best few (the search budget) are encoded in full.
+// Endpoints are found with a range fit along the principal axis of each subset,
+// followed by least squares refinement, and are reconstructed with exactly the
+// same arithmetic as the decoder.
+
+// P-bit usage of a mode.
+enum {
+    P_BITS_NONE,
+    // One p-bit for every endpoint.
+    P_BITS_ENDPOINT,
+    // One p-bit shared by both endpoints of a subset (mode 1).
+    P_BITS_SHARED,
+};
+
+typedef struct {
+    int nu_subsets;
+    int partition_bits;
+    int rotation_bits;
+    int index_selection_bits;
+    // Precision of the color and alpha components, without the p-bit. Modes
+    // without alpha components decode alpha as 0xFF.
+    int color_bits;
+    int alpha_bits;
+    int p_bits;
+    // Bits of the primary and secondary (modes 4 and 5) indices.
+    int index_bits;
+    int index2_bits;
+} BPTCMode;
+
+static const BPTCMode bptc_modes[8] = {
+    {3, 4, 0, 0, 4, 0, P_BITS_ENDPOINT, 3, 0},
+    {2, 6, 0, 0, 6, 0, P_BITS_SHARED, 3, 0},
+    {3, 6, 0, 0, 5, 0, P_BITS_NONE, 2, 0},
+    {2, 6, 0, 0, 7, 0, P_BITS_ENDPOINT, 2, 0},
+    {1, 0, 2, 1, 5, 6, P_BITS_NONE, 2, 3},
+    {1, 0, 2, 0, 7, 8, P_BITS_NONE, 2, 2},
+    {1, 0, 0, 0, 7, 7, P_BITS_ENDPOINT, 4, 0},
+    {2, 6, 0, 0, 5, 5, P_BITS_ENDPOINT, 2, 0},
+};
+
+// Maximum number of partitions evaluated in full for each partitioned mode.
+#define BPTC_MAX_BUDGET 64
+
+static const uint16_t *GetWeights(int index_bits) {
+    if (index_bits == 2) return detex_bptc_table_aWeight2;
+    if (index_bits == 3) return detex_bptc_table_aWeight3;
+    return detex_bptc_table_aWeight4;
+}
+
+DETEX_INLINE_ONLY int GetSubset(int nu_subsets, int partition, int i) {
+    if (nu_subsets == 1) return 0;
+    if (nu_subsets == 2) return detex_bptc_table_P2[partition * 16 + i];
+    return detex_bptc_table_P3[partition * 16 + i];
+}
+
+DETEX_INLINE_ONLY int GetAnchor(int nu_subsets, int partition, int subset) {
+    if (subset == 0) return 0;
+    if (nu_subsets == 2) return detex_bptc_table_anchor_index_second_subset[partition];
+    if (subset == 1) return detex_bptc_table_anchor_index_second_subset_of_three[partition];
+    return detex_bptc_table_anchor_index_third_subset[partition];
+}
+
+// Reconstruct an endpoint component in the same way as the decoder.
+DETEX_INLINE_ONLY int Unquantize(int value, int p_bit, int bits, bool has_p_bit) {
+    int precision = bits + has_p_bit;
+    int v = has_p_bit ? (value << 1) | p_bit : value;
+    v <<= 8 - precision;
+    return v | (v >> precision);
+}
+
+// Quantize an endpoint component with the given p-bit to the nearest value
+// that the decoder can reconstruct.
+static int QuantizeComponent(float value, int p_bit, int bits, bool has_p_bit) {
+    int max_value = (1 << bits) - 1;
+    float scaled = value * ((1 << (bits + has_p_bit)) - 1) / 255.0f;
+    int estimate = (int)floorf((has_p_bit ? (scaled - p_bit) * 0.5f : scaled) + 0.5f);
+    int best_value = 0;
+    float best_error = FLT_MAX;
+    for (int q = estimate - 1; q <= estimate + 1; q++) {
+        if (q < 0 || q > max_value) continue;
+        float error = fabsf(Unquantize(q, p_bit, bits, has_p_bit) - value);
+        if (error < best_error) {
+            best_error = error;
+            best_value = q;
+        }
+    }
+    return best_value;
+}
+
+// The pixels of one subset and the components that are fitted together.
+typedef struct {
+    const int (*pixels)[4];
+    uint8_t members[16];
+    int nu_members;
+    int first_component;
+    int nu_components;
+    int bits;
+    int p_bits;
+    int index_bits;
+    uint32_t flags;
+} SubsetFitter;
+
+// Encoding of the components of one subset.
+typedef struct {
+    uint32_t error;
+    int endpoints[2][4];
+    int p_bit[2];
+    // Index of every pixel of the block (only valid for the members).
+    uint8_t indices[16];
+} SubsetFit;
+
+// Select the best index for every member pixel for the given quantized
+// endpoints. Updates best when the error is lower.
+static void EvaluateEndpoints(const SubsetFitter *fitter,
+                              const int endpoints[2][4],
+                              const int *p_bit,
+                              SubsetFit *DETEX_RESTRICT best) {
+    const uint16_t *weights = GetWeights(fitter->index_bits);
+    int nu_indices = 1 << fitter->index_bits;
+    bool has_p_bit = fitter->p_bits != P_BITS_NONE;
+    int palette[16][4];
+    for (int c = 0; c < fitter->nu_components; c++) {
+        int e0 = Unquantize(endpoints[0][c], p_bit[0], fitter->bits, has_p_bit);
+        int e1 = Unquantize(endpoints[1][c], p_bit[1], fitter->bits, has_p_bit);
+        for (int j = 0; j < nu_indices; j++) palette[j][c] = ((64 - weights[j]) * e0 + weights[j] * e1 + 32) >> 6;
+    }
+    uint8_t indices[16];
+    uint32_t error = 0;
+    for (int k = 0; k < fitter->nu_members; k++) {
+        int i = fitter->members[k];
+        const int *pixel = &fitter->pixels[i][fitter->first_component];
+        uint32_t best_pixel_error = UINT32_MAX;
+        int best_index = 0;
+        for (int j = 0; j < nu_indices; j++) {
+            uint32_t pixel_error = 0;
+            for (int c = 0; c < fitter->nu_components; c++)
+                pixel_error += (pixel[c] - palette[j][c]) * (pixel[c] - palette[j][c]);
+            if (pixel_error < best_pixel_error) {
+                best_pixel_error = pixel_error;
+                best_index = j;
+            }
+        }
+        indices[i] = best_index;
+        error += best_pixel_error;
+        if (error >= best->error) return;
+    }
+    best->error = error;
+    memcpy(best->endpoints, endpoints, sizeof(best->endpoints));
+    best->p_bit[0] = p_bit[0];
+    best->p_bit[1] = p_bit[1];
+    for (int k = 0; k < fitter->nu_members; k++) best->indices[fitter->members[k]] = indices[fitter->members[k]];
+}
+
+// Quantize a pair of floating point endpoints and evaluate them. The p-bits are
+// chosen per endpoint by the quantization error, or in quality mode, every
+// combination is evaluated.
+static void TryEndpoints(const SubsetFitter *fitter, const float *a, const float *b, SubsetFit *DETEX_RESTRICT best) {
+    static const int p_bit_combinations[4][2] = {{0, 0}, {1, 1}, {0, 1}, {1, 0}};
+    int nu_combinations = 1;
+    if (fitter->p_bits == P_BITS_SHARED)
+        nu_combinations = 2;
+    else if (fitter->p_bits == P_BITS_ENDPOINT && (fitter->flags & DETEX_COMPRESS_FLAG_QUALITY))
+        nu_combinations = 4;
+    const float *targets[2] = {a, b};
+    for (int n = 0; n < nu_combinations; n++) {
+        int p_bit[2] = {p_bit_combinations[n][0], p_bit_combinations[n][1]};
+        if (fitter->p_bits == P_BITS_ENDPOINT && nu_combinations == 1)
+            // Select the p-bit of each endpoint with the lowest quantization error.
+            for (int k = 0; k < 2; k++) {
+                float errors[2] = {0, 0};
+                for (int p = 0; p < 2; p++)
+                    for (int c = 0; c < fitter->nu_components; c++) {
+                        int q = QuantizeComponent(targets[k][c], p, fitter->bits, true);
+                        float d = Unquantize(q, p, fitter->bits, true) - targets[k][c];
+                        errors[p] += d * d;
+                    }
+                p_bit[k] = errors[1] < errors[0];
+            }
+        int endpoints[2][4];
+        for (int k = 0; k < 2; k++)
+            for (int c = 0; c < fitter->nu_components; c++)
+                endpoints[k][c] =
+                    QuantizeComponent(targets[k][c], p_bit[k], fitter->bits, fitter->p_bits != P_BITS_NONE);
+        EvaluateEndpoints(fitter, endpoints, p_bit, best);
+    }
+}
+
+// Calculate the mean and the principal axis of the members of a subset.
+// Returns false when all members have the same color.
+static bool CalculatePrincipalAxis(const SubsetFitter *fitter, float *mean, float *axis) {
+    int n = fitter->nu_components;
+    for (int c = 0; c < n; c++) mean[c] = 0;
+    for (int k = 0; k < fitter->nu_members; k++)
+        for (int c = 0; c < n; c++) mean[c] += fitter->pixels[fitter->members[k]][fitter->first_component + c];
+    for (int c = 0; c < n; c++) mean[c] /= fitter->nu_members;
+    float cov[4][4] = {{0}};
+    for (int k = 0; k < fitter->nu_members; k++) {
+        float d[4];
+        for (int c = 0; c < n; c++) d[c] = fitter->pixels[fitter->members[k]][fitter->first_component + c] - mean[c];
+        for (int c = 0; c < n; c++)
+            for (int c2 = c; c2 < n; c2++) cov[c][c2] += d[c] * d[c2];
+    }
+    float trace = 0;
+    int largest = 0;
+    for (int c = 0; c < n; c++) {
+        for (int c2 = 0; c2 < c; c2++) cov[c][c2] = cov[c2][c];
+        trace += cov[c][c];
+        if (cov[c][c] > cov[largest][largest]) largest = c;
+    }
+    if (trace < 0.001f) return false;
+    // Power iteration, starting with the row of the largest diagonal element.
+    float v[4];
+    for (int c = 0; c < n; c++) v[c] = cov[largest][c];
+    for (int iteration = 0; iteration < 8; iteration++) {
+        float w[4];
+        float m = 0;
+        for (int c = 0; c < n; c++) {
+            w[c] = 0;
+            for (int c2 = 0; c2 < n; c2++) w[c] += cov[c][c2] * v[c2];
+            m = fmaxf(m, fabsf(w[c]));
+        }
+        if (m == 0.0f) break;
+        for (int c = 0; c < n; c++) v[c] = w[c] / m;
+    }
+    float length = 0;
+    for (int c = 0; c < n; c++) length += v[c] * v[c];
+    length = sqrtf(length);
+    if (length < 0.0001f) {
+        for (int c = 0; c < n; c++) v[c] = 1.0f;
+        length = sqrtf((float)n);
+    }
+    for (int c = 0; c < n; c++) axis[c] = v[c] / length;
+    return true;
+}
+
+// Least squares endpoints for the current indices of best. Returns false when
+// the system is singular (all members use the same weight).
+static bool RefineEndpoints(const SubsetFitter *fitter, const SubsetFit *fit, float *a, float *b) {
+    const uint16_t *weights = GetWeights(fitter->index_bits);
+    float alpha2 = 0, beta2 = 0, alphabeta = 0;
+    float alphax[4] = {0, 0, 0, 0}, betax[4] = {0, 0, 0, 0};
+    for (int k = 0; k < fitter->nu_members; k++) {
+        int i = fitter->members[k];
+        float beta = weights[fit->indices[i]] / 64.0f;
+        float alpha = 1.0f - beta;
+        alpha2 += alpha * alpha;
+        beta2 += beta * beta;
+        alphabeta += alpha * beta;
+        for (int c = 0; c < fitter->nu_components; c++) {
+            alphax[c] += alpha * fitter->pixels[i][fitter->first_component + c];
+            betax[c] += beta * fitter->pixels[i][fitter->first_component + c];
+        }
+    }
+    float factor = alpha2 * beta2 - alphabeta * alphabeta;
+    if (fabsf(factor) < 0.0001f) return false;
+    for (int c = 0; c < fitter->nu_components; c++) {
+        a[c] = fminf(fmaxf((alphax[c] * beta2 - betax[c] * alphabeta) / factor, 0.0f), 255.0f);
+        b[c] = fminf(fmaxf((betax[c] * alpha2 - alphax[c] * alphabeta) / factor, 0.0f), 255.0f);
+    }
+    return true;
+}
+
+static void FitSubset(const SubsetFitter *fitter, SubsetFit *DETEX_RESTRICT fit) {
+    fit->error = UINT32_MAX;
+    float mean[4], axis[4];
+    if (!CalculatePrincipalAxis(fitter, mean, axis)) {
+        TryEndpoints(fitter, mean, mean, fit);
+        return;
+    }
+    float t_min = FLT_MAX, t_max = -FLT_MAX;
+    for (int k = 0; k < fitter->nu_members; k++) {
+        float t = 0;
+        for (int c = 0; c < fitter->nu_components; c++)
+            t += (fitter->pixels[fitter->members[k]][fitter->first_component + c] - mean[c]) * axis[c];
+        t_min = fminf(t_min, t);
+        t_max = fmaxf(t_max, t);
+    }
+    float a[4], b[4];
+    for (int c = 0; c < fitter->nu_components; c++) {
+        a[c] = fminf(fmaxf(mean[c] + axis[c] * t_min, 0.0f), 255.0f);
+        b[c] = fminf(fmaxf(mean[c] + axis[c] * t_max, 0.0f), 255.0f);
+    }
+    TryEndpoints(fitter, a, b, fit);
+    int nu_iterations = (fitter->flags & DETEX_COMPRESS_FLAG_QUALITY) ? 3 : 1;
+    for (int iteration = 0; iteration < nu_iterations; iteration++) {
+        uint32_t error = fit->error;
+        if (error == 0 || !RefineEndpoints(fitter, fit, a, b)) break;
+        TryEndpoints(fitter, a, b, fit);
+        if (fit->error == error) break;
+    }
+}
+
+// Make sure that the most significant index bit of the anchor pixel of a subset
+// is zero, as it is not stored, by swapping the endpoints and inverting the
+// indices when needed.
+static void FixAnchor(SubsetFit *fit, const uint8_t *members, int nu_members, int anchor, int index_bits) {
+    int max_index = (1 << index_bits) - 1;
+    if (fit->indices[anchor] <= max_index >> 1) return;
+    for (int c = 0; c < 4; c++) {
+        int temp = fit->endpoints[0][c];
+        fit->endpoints[0][c] = fit->endpoints[1][c];
+        fit->endpoints[1][c] = temp;
+    }
+    int temp = fit->p_bit[0];
+    fit->p_bit[0] = fit->p_bit[1];
+    fit->p_bit[1] = temp;
+    for (int k = 0; k < nu_members; k++) fit->indices[members[k]] = max_index - fit->indices[members[k]];
+}
+
+static void WriteBits(detexBlock128 *block, uint32_t value, int nu_bits) {
+    if (block->index < 64) {
+        block->data0 |= (uint64_t)value << block->index;
+        if (block->index + nu_bits > 64) block->data1 |= (uint64_t)value >> (64 - block->index);
+    } else
+        block->data1 |= (uint64_t)value << (block->index - 64);
+    block->index += nu_bits;
+}
+
+static void WriteIndices(detexBlock128 *block,
+                         const uint8_t *indices,
+                         int index_bits,
+                         int nu_subsets,
+                         int partition,
+                         const uint8_t *subset) {
+    for (int i = 0; i < 16; i++) {
+        bool anchor = GetAnchor(nu_subsets, partition, subset[i]) == i;
+        WriteBits(block, indices[i], index_bits - anchor);
+    }
+}
+
+// Best BPTC block found so far.
+typedef struct {
+    uint32_t error;
+    uint8_t bitstring[16];
+} BPTCCandidate;
+
+// Encode the block in the given mode, partition, rotation and index selection.
+// Updates best when the error is lower.
+static void EncodeBlockBPTCMode(const int pixels[16][4],
+                                int mode,
+                                int partition,
+                                int rotation,
+                                int index_selection,
+                                uint32_t flags,
+                                BPTCCandidate *DETEX_RESTRICT best) {
+    const BPTCMode *m = &bptc_modes[mode];
+    // The decoder swaps alpha with the rotated component; swap them in the
+    // input instead.
+    int rotated[16][4];
+    memcpy(rotated, pixels, sizeof(rotated));
+    if (rotation > 0)
+        for (int i = 0; i < 16; i++) {
+            rotated[i][3] = pixels[i][rotation - 1];
+            rotated[i][rotation - 1] = pixels[i][3];
+        }
+    uint8_t subset[16];
+    for (int i = 0; i < 16; i++) subset[i] = GetSubset(m->nu_subsets, partition, i);
+    SubsetFitter fitter;
+    fitter.pixels = (const int(*)[4])rotated;
+    fitter.first_component = 0;
+    fitter.p_bits = m->p_bits;
+    fitter.flags = flags;
+    uint32_t error = 0;
+    if (m->alpha_bits == 0) {
+        // Alpha is always decoded as 0xFF.
+        for (int i = 0; i < 16; i++) error += (255 - rotated[i][3]) * (255 - rotated[i][3]);
+        fitter.nu_components = 3;
+    } else {
+        fitter.nu_components = m->index2_bits > 0 ? 3 : 4;
+    }
+    fitter.bits = m->color_bits;
+    fitter.index_bits = m->index_bits;
+    // Modes 4 and 5 have separate color and alpha indices; with the index
+    // selection bit set, mode 4 uses the 3-bit indices for color.
+    int color_index_bits = index_selection ? m->index2_bits : m->index_bits;
+    int alpha_index_bits = index_selection ? m->index_bits : m->index2_bits;
+    if (m->index2_bits > 0) fitter.index_bits = color_index_bits;
+    SubsetFit fits[3];
+    for (int s = 0; s < m->nu_subsets; s++) {
+        fitter.nu_members = 0;
+        for (int i = 0; i < 16; i++)
+            if (subset[i] == s) fitter.members[fitter.nu_members++] = i;
+        FitSubset(&fitter, &fits[s]);
+        error += fits[s].error;
+        if (error >= best->error) return;
+        int anchor = GetAnchor(m->nu_subsets, partition, s);
+        FixAnchor(&fits[s], fitter.members, fitter.nu_members, anchor, fitter.index_bits);
+    }
+    SubsetFit alpha_fit;
+    if (m->index2_bits > 0) {
+        fitter.first_component = 3;
+        fitter.nu_components = 1;
+        fitter.bits = m->alpha_bits;
+        fitter.index_bits = alpha_index_bits;
+        FitSubset(&fitter, &alpha_fit);
+        error += alpha_fit.error;
+        if (error >= best->error) return;
+        FixAnchor(&alpha_fit, fitter.members, fitter.nu_members, 0, alpha_index_bits);
+        for (int k = 0; k < 2; k++) fits[0].endpoints[k][3] = alpha_fit.endpoints[k][0];
+    }
+    detexBlock128 block = {0, 0, 0};
+    WriteBits(&block, 1 << mode, mode + 1);
+    WriteBits(&block, partition, m->partition_bits);
+    WriteBits(&block, rotation, m->rotation_bits);
+    WriteBits(&block, index_selection, m->index_selection_bits);
+    for (int c = 0; c < (m->alpha_bits > 0 ? 4 : 3); c++) {
+        int bits = c < 3 ? m->color_bits : m->alpha_bits;
+        for (int s = 0; s < m->nu_subsets; s++)
+            for (int k = 0; k < 2; k++) WriteBits(&block, fits[s].endpoints[k][c], bits);
+    }
+    if (m->p_bits == P_BITS_ENDPOINT)
+        for (int s = 0; s < m->nu_subsets; s++)
+            for (int k = 0; k < 2; k++) WriteBits(&block, fits[s].p_bit[k], 1);
+    else if (m->p_bits == P_BITS_SHARED)
+        for (int s = 0; s < m->nu_subsets; s++) WriteBits(&block, fits[s].p_bit[0], 1);
+    if (m->index2_bits == 0) {
+        uint8_t indices[16];
+        for (int i = 0; i < 16; i++) indices[i] = fits[subset[i]].indices[i];
+        WriteIndices(&block, indices, m->index_bits, m->nu_subsets, partition, subset);
+    }
+    else if (index_selection) {
+        WriteIndices(&block, alpha_fit.indices, m->index_bits, 1, 0, subset);
+        WriteIndices(&block, fits[0].indices, m->index2_bits, 1, 0, subset);
+    } else {
+        WriteIndices(&block, fits[0].indices, m->index_bits, 1, 0, subset);
+        WriteIndices(&block, alpha_fit.indices, m->index2_bits, 1, 0, subset);
+    }
+    best->error = error;
+    memcpy(&best->bitstring[0], &block.data0, 8);
+    memcpy(&best->bitstring[8], &block.data1, 8);
+}
+
+// Estimate the error of every partition of a partitioned mode. A subset is
+// approximated by the line through its principal axis: the variance off the
+// line is lost completely, the variance along it is reduced by the number of
+// index levels.
+static void EstimatePartitionErrors(const int pixels[16][4],
+                                    int nu_subsets,
+                                    int nu_partitions,
+                                    int index_bits,
+                                    float *errors) {
+    float levels = (float)((1 << index_bits) - 1);
+    for (int partition = 0; partition < nu_partitions; partition++) {
+        // Sums of the components and of their products, per subset.
+        float sum[3][4] = {{0}};
+        float products[3][10] = {{0}};
+        int count[3] = {0, 0, 0};
+        for (int i = 0; i < 16; i++) {
+            int s = GetSubset(nu_subsets, partition, i);
+            const int *p = pixels[i];
+            count[s]++;
+            for (int c = 0; c < 4; c++) sum[s][c] += p[c];
+            products[s][0] += p[0] * p[0];
+            products[s][1] += p[0] * p[1];
+            products[s][2] += p[0] * p[2];
+            products[s][3] += p[0] * p[3];
+            products[s][4] += p[1] * p[1];
+            products[s][5] += p[1] * p[2];
+            products[s][6] += p[1] * p[3];
+            products[s][7] += p[2] * p[2];
+            products[s][8] += p[2] * p[3];
+            products[s][9] += p[3] * p[3];
+        }
+        float error = 0;
+        for (int s = 0; s < nu_subsets; s++) {
+            if (count[s] == 0) continue;
+            float cov[4][4];
+            int k = 0;
+            for (int c = 0; c < 4; c++)
+                for (int c2 = c; c2 < 4; c2++, k++)
+                    cov[c][c2] = cov[c2][c] = products[s][k] - sum[s][c] * sum[s][c2] / count[s];
+            float trace = cov[0][0] + cov[1][1] + cov[2][2] + cov[3][3];
+            // Largest eigenvalue with a few power iterations.
+            float v[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+            float lambda = 0;
+            for (int iteration = 0; iteration < 4; iteration++) {
+                float w[4];
+                for (int c = 0; c < 4; c++)
+                    w[c] = cov[c][0] * v[0] + cov[c][1] * v[1] + cov[c][2] * v[2] + cov[c][3] * v[3];
+                float length2 = w[0] * w[0] + w[1] * w[1] + w[2] * w[2] + w[3] * w[3];
+                if (length2 < 1e-6f) break;
+                float length = sqrtf(length2);
+                // Rayleigh quotient.
+                lambda = (w[0] * v[0] + w[1] * v[1] + w[2] * v[2] + w[3] * v[3]) /
+                         (v[0] * v[0] + v[1] * v[1] + v[2] * v[2] + v[3] * v[3]);
+                for (int c = 0; c < 4; c++) v[c] = w[c] / length;
+            }
+            error += (trace - lambda) + lambda / (levels * levels);
+        }
+        errors[partition] = error;
+    }
+}
+
+// Encode a partitioned mode, trying the partitions with the lowest estimated
+// error.
+static void EncodeBlockBPTCPartitioned(const int pixels[16][4],
+                                       int mode,
+                                       int budget,
+                                       uint32_t flags,
+                                       BPTCCandidate *DETEX_RESTRICT best) {
+    const BPTCMode *m = &bptc_modes[mode];
+    int nu_partitions = 1 << m->partition_bits;
+    float errors[64];
+    EstimatePartitionErrors(pixels, m->nu_subsets, nu_partitions, m->index_bits, errors);
+    // Select the partitions with the lowest estimates (insertion sort).
+    int selected[BPTC_MAX_BUDGET];
+    int nu_selected = 0;
+    for (int partition = 0; partition < nu_partitions; partition++) {
+        int j = nu_selected < budget ? nu_selected++ : budget;
+        for (; j > 0 && errors[selected[j - 1]] > errors[partition]; j--)
+            if (j < budget) selected[j] = selected[j - 1];
+        if (j < budget) selected[j] = partition;
+    }
+    for (int j = 0; j < nu_selected; j++) EncodeBlockBPTCMode(pixels, mode, selected[j], 0, 0, flags, best);
+}
+
+/* Compress a 4x4 block of RGBA8 pixels into a 128-bit BPTC (BC7) block. */
+bool detexCompressBlockBPTC(const uint8_t *DETEX_RESTRICT pixel_buffer,
+                            uint32_t flags,
+                            uint8_t *DETEX_RESTRICT bitstring) {
+    int pixels[16][4];
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 4; c++) pixels[i][c] = pixel_buffer[i * 4 + c];
+    int budget = (flags & DETEX_COMPRESS_BUDGET_MASK) >> DETEX_COMPRESS_BUDGET_SHIFT;
+    if (budget == 0) budget = (flags & DETEX_COMPRESS_FLAG_QUALITY) ? 4 : 1;
+    if (budget > BPTC_MAX_BUDGET) budget = BPTC_MAX_BUDGET;
+    BPTCCandidate best;
+    best.error = UINT32_MAX;
+    // Single subset modes. Mode 6 is usually the best, so try it first to make
+    // the early termination of the other modes more effective.
+    EncodeBlockBPTCMode(pixels, 6, 0, 0, 0, flags, &best);
+    // Modes 4 and 5 with every rotation and index selection in quality mode.
+    bool quality = (flags & DETEX_COMPRESS_FLAG_QUALITY) != 0;
+    for (int rotation = 0; rotation < (quality ? 4 : 1) && best.error > 0; rotation++) {
+        EncodeBlockBPTCMode(pixels, 5, 0, rotation, 0, flags, &best);
+        EncodeBlockBPTCMode(pixels, 4, 0, rotation, 0, flags, &best);
+        if (quality) EncodeBlockBPTCMode(pixels, 4, 0, rotation, 1, flags, &best);
+    }
+    static const int partitioned_modes[5] = {1, 3, 7, 0, 2};
+    for (int j = 0; j < 5 && best.error > 0; j++)
+        EncodeBlockBPTCPartitioned(pixels, partitioned_modes[j], budget, flags, &best);
+    memcpy(bitstring, best.bitstring, 16);
+    return true;
+}
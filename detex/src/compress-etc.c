@@ -0,0 +1,486 @@
+/*
+
+Copyright (c) 2015 Harm Hanemaaijer <fgenfb@yahoo.com>
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+*/
+
+#include <math.h>
+#include <string.h>
+
+#include "detex.h"
+
+// The encoders in this file are the counterpart of the decoders in
+// decompress-etc.c and decompress-eac.c. Colors are reconstructed with exactly
+// the same arithmetic as the decoders, so the error that is minimized is the
+// error of the texture as decoded by detex.
+//
+// ETC pixel i is located at column i / 4, row i % 4 of the block; the pixel
+// buffers passed to the encoders are RGBA8 stored row-by-row.
+
+static const int etc1_modifier_table[8][4] = {{2, 8, -2, -8},
+                                              {5, 17, -5, -17},
+                                              {9, 29, -9, -29},
+                                              {13, 42, -13, -42},
+                                              {18, 60, -18, -60},
+                                              {24, 80, -24, -80},
+                                              {33, 106, -33, -106},
+                                              {47, 183, -47, -183}};
+
+static const int8_t eac_modifier_table[16][8] = {{-3, -6, -9, -15, 2, 5, 8, 14},
+                                                 {-3, -7, -10, -13, 2, 6, 9, 12},
+                                                 {-2, -5, -8, -13, 1, 4, 7, 12},
+                                                 {-2, -4, -6, -13, 1, 3, 5, 12},
+                                                 {-3, -6, -8, -12, 2, 5, 7, 11},
+                                                 {-3, -7, -9, -11, 2, 6, 8, 10},
+                                                 {-4, -7, -8, -11, 3, 6, 7, 10},
+                                                 {-3, -5, -8, -11, 2, 4, 7, 10},
+                                                 {-2, -6, -8, -10, 1, 5, 7, 9},
+                                                 {-2, -5, -8, -10, 1, 4, 7, 9},
+                                                 {-2, -4, -8, -10, 1, 3, 7, 9},
+                                                 {-2, -5, -7, -10, 1, 4, 6, 9},
+                                                 {-3, -4, -7, -10, 2, 3, 6, 9},
+                                                 {-1, -2, -3, -10, 0, 1, 2, 9},
+                                                 {-4, -6, -8, -9, 3, 5, 7, 8},
+                                                 {-3, -5, -7, -9, 2, 4, 6, 8}};
+
+// Offset of ETC pixel i in an RGBA8 pixel buffer.
+DETEX_INLINE_ONLY int PixelOffset(int i) { return ((i & 3) * 4 + (i >> 2)) * 4; }
+
+// Expand a quantized base color component in the same way as the decoder.
+DETEX_INLINE_ONLY int Expand4(int x) { return (x << 4) | x; }
+
+DETEX_INLINE_ONLY int Expand5(int x) { return (x << 3) | (x >> 2); }
+
+// The ETC pixels (see above) of each of the two subblocks, without flip (two
+// 2x4 columns) and with flip (two 4x2 rows).
+static const uint8_t subblock_pixels[2][2][8] = {
+    {{0, 1, 2, 3, 4, 5, 6, 7}, {8, 9, 10, 11, 12, 13, 14, 15}},
+    {{0, 1, 4, 5, 8, 9, 12, 13}, {2, 3, 6, 7, 10, 11, 14, 15}},
+};
+
+// Encoding of one subblock: a quantized base color (4 or 5 bits per
+// component), the modifier table and the pixel index bits of its pixels.
+typedef struct {
+    uint32_t error;
+    int color[3];
+    int table;
+    uint32_t index_word;
+} SubblockCandidate;
+
+// Select the best modifier table and pixel indices for a subblock with the
+// given (expanded) base color. Updates best when the error is lower.
+static void EvaluateSubblockETC1(const uint8_t *DETEX_RESTRICT pixel_buffer,
+                                 const uint8_t *pixels,
+                                 const int *base,
+                                 const int *color,
+                                 SubblockCandidate *DETEX_RESTRICT best) {
+    for (int table = 0; table < 8; table++) {
+        int palette[4][3];
+        for (int j = 0; j < 4; j++)
+            for (int c = 0; c < 3; c++) palette[j][c] = detexClamp0To255(base[c] + etc1_modifier_table[table][j]);
+        uint32_t error = 0;
+        uint32_t index_word = 0;
+        for (int k = 0; k < 8; k++) {
+            int i = pixels[k];
+            const uint8_t *pixel = &pixel_buffer[PixelOffset(i)];
+            uint32_t best_pixel_error = UINT32_MAX;
+            int best_index = 0;
+            for (int j = 0; j < 4; j++) {
+                int dr = pixel[0] - palette[j][0];
+                int dg = pixel[1] - palette[j][1];
+                int db = pixel[2] - palette[j][2];
+                uint32_t pixel_error = dr * dr + dg * dg + db * db;
+                if (pixel_error < best_pixel_error) {
+                    best_pixel_error = pixel_error;
+                    best_index = j;
+                }
+            }
+            error += best_pixel_error;
+            if (error >= best->error) break;
+            // The least significant index bit is stored in bit i, the most
+            // significant one in bit 16 + i.
+            index_word |= ((uint32_t)(best_index & 1) << i) | ((uint32_t)(best_index >> 1) << (16 + i));
+        }
+        if (error < best->error) {
+            best->error = error;
+            memcpy(best->color, color, sizeof(best->color));
+            best->table = table;
+            best->index_word = index_word;
+        }
+    }
+}
+
+// Find the best base colors of a subblock with bits per component (4 for the
+// individual mode, 5 for the differential mode). The average color, rounded to
+// the grid, is always tried; in quality mode, the grid points surrounding the
+// average are tried as well. Returns the number of candidates, the best first.
+static int EncodeSubblockETC1(const uint8_t *DETEX_RESTRICT pixel_buffer,
+                              const uint8_t *pixels,
+                              int bits,
+                              uint32_t flags,
+                              SubblockCandidate *candidates) {
+    int max_value = (1 << bits) - 1;
+    int low[3], high[3], nearest[3];
+    for (int c = 0; c < 3; c++) {
+        int sum = 0;
+        for (int k = 0; k < 8; k++) sum += pixel_buffer[PixelOffset(pixels[k]) + c];
+        float value = sum * max_value / (8.0f * 255.0f);
+        nearest[c] = (int)floorf(value + 0.5f);
+        low[c] = (int)floorf(value);
+        high[c] = low[c] < max_value ? low[c] + 1 : max_value;
+    }
+    int nu_candidates = 0;
+    for (int n = 0; n < ((flags & DETEX_COMPRESS_FLAG_QUALITY) ? 8 : 1); n++) {
+        int color[3], base[3];
+        for (int c = 0; c < 3; c++) {
+            if (flags & DETEX_COMPRESS_FLAG_QUALITY)
+                color[c] = (n & (1 << c)) ? high[c] : low[c];
+            else
+                color[c] = nearest[c];
+            base[c] = bits == 4 ? Expand4(color[c]) : Expand5(color[c]);
+        }
+        // Skip duplicates (when the average is at the top of the range).
+        bool duplicate = false;
+        for (int j = 0; j < nu_candidates; j++)
+            if (memcmp(candidates[j].color, color, sizeof(color)) == 0) duplicate = true;
+        if (duplicate) continue;
+        SubblockCandidate *candidate = &candidates[nu_candidates++];
+        candidate->error = UINT32_MAX;
+        EvaluateSubblockETC1(pixel_buffer, pixels, base, color, candidate);
+    }
+    // Move the best candidate to the front.
+    for (int j = 1; j < nu_candidates; j++)
+        if (candidates[j].error < candidates[0].error) {
+            SubblockCandidate temp = candidates[0];
+            candidates[0] = candidates[j];
+            candidates[j] = temp;
+        }
+    return nu_candidates;
+}
+
+// Best ETC1 block found so far.
+typedef struct {
+    uint32_t error;
+    bool differential;
+    int flip;
+    SubblockCandidate subblock[2];
+} ETC1Candidate;
+
+// Combine the candidates of the two subblocks into a differential mode block,
+// in which the second base color is stored as a 3-bit signed offset (-4 to 3)
+// from the first.
+static void CombineDifferentialETC1(const uint8_t *DETEX_RESTRICT pixel_buffer,
+                                    int flip,
+                                    const SubblockCandidate *candidates1,
+                                    int nu_candidates1,
+                                    const SubblockCandidate *candidates2,
+                                    int nu_candidates2,
+                                    ETC1Candidate *DETEX_RESTRICT best) {
+    bool found = false;
+    for (int j = 0; j < nu_candidates1; j++)
+        for (int k = 0; k < nu_candidates2; k++) {
+            const SubblockCandidate *a = &candidates1[j];
+            const SubblockCandidate *b = &candidates2[k];
+            bool valid = true;
+            for (int c = 0; c < 3; c++) {
+                int delta = b->color[c] - a->color[c];
+                if (delta < -4 || delta > 3) valid = false;
+            }
+            if (!valid) continue;
+            found = true;
+            if (a->error + b->error < best->error) {
+                best->error = a->error + b->error;
+                best->differential = true;
+                best->flip = flip;
+                best->subblock[0] = *a;
+                best->subblock[1] = *b;
+            }
+        }
+    if (found) return;
+    // The base colors are too far apart; clamp the second one to the range
+    // that can be reached from the first.
+    const SubblockCandidate *a = &candidates1[0];
+    int color[3], base[3];
+    for (int c = 0; c < 3; c++) {
+        int lower = a->color[c] - 4 < 0 ? 0 : a->color[c] - 4;
+        int upper = a->color[c] + 3 > 31 ? 31 : a->color[c] + 3;
+        int value = candidates2[0].color[c];
+        color[c] = value < lower ? lower : (value > upper ? upper : value);
+        base[c] = Expand5(color[c]);
+    }
+    SubblockCandidate b;
+    b.error = UINT32_MAX;
+    EvaluateSubblockETC1(pixel_buffer, subblock_pixels[flip][1], base, color, &b);
+    if (a->error + b.error < best->error) {
+        best->error = a->error + b.error;
+        best->differential = true;
+        best->flip = flip;
+        best->subblock[0] = *a;
+        best->subblock[1] = b;
+    }
+}
+
+static void StoreBlockETC1(const ETC1Candidate *DETEX_RESTRICT block, uint8_t *DETEX_RESTRICT bitstring) {
+    const int *color1 = block->subblock[0].color;
+    const int *color2 = block->subblock[1].color;
+    for (int c = 0; c < 3; c++)
+        if (block->differential)
+            bitstring[c] = (color1[c] << 3) | ((color2[c] - color1[c]) & 7);
+        else
+            bitstring[c] = (color1[c] << 4) | color2[c];
+    bitstring[3] = (block->subblock[0].table << 5) | (block->subblock[1].table << 2) | (block->differential << 1) |
+                   block->flip;
+    uint32_t index_word = block->subblock[0].index_word | block->subblock[1].index_word;
+    bitstring[4] = index_word >> 24;
+    bitstring[5] = (index_word >> 16) & 0xFF;
+    bitstring[6] = (index_word >> 8) & 0xFF;
+    bitstring[7] = index_word & 0xFF;
+}
+
+// Encode a block in either the individual or the differential mode, with or
+// without flip. Returns the error.
+static uint32_t CompressBlockETC1Modes(const uint8_t *DETEX_RESTRICT pixel_buffer,
+                                       uint32_t flags,
+                                       uint8_t *DETEX_RESTRICT bitstring) {
+    ETC1Candidate best;
+    best.error = UINT32_MAX;
+    for (int flip = 0; flip < 2; flip++) {
+        SubblockCandidate candidates[2][8];
+        int nu_candidates[2];
+        // Differential mode, 5-bit base colors.
+        for (int s = 0; s < 2; s++)
+            nu_candidates[s] = EncodeSubblockETC1(pixel_buffer, subblock_pixels[flip][s], 5, flags, candidates[s]);
+        CombineDifferentialETC1(
+            pixel_buffer, flip, candidates[0], nu_candidates[0], candidates[1], nu_candidates[1], &best);
+        // Individual mode, 4-bit base colors.
+        for (int s = 0; s < 2; s++)
+            EncodeSubblockETC1(pixel_buffer, subblock_pixels[flip][s], 4, flags, candidates[s]);
+        if (candidates[0][0].error + candidates[1][0].error < best.error) {
+            best.error = candidates[0][0].error + candidates[1][0].error;
+            best.differential = false;
+            best.flip = flip;
+            best.subblock[0] = candidates[0][0];
+            best.subblock[1] = candidates[1][0];
+        }
+    }
+    StoreBlockETC1(&best, bitstring);
+    return best.error;
+}
+
+/* Compress a 4x4 block of RGBA8 pixels into a 64-bit ETC1 block. */
+bool detexCompressBlockETC1(const uint8_t *DETEX_RESTRICT pixel_buffer,
+                            uint32_t flags,
+                            uint8_t *DETEX_RESTRICT bitstring) {
+    CompressBlockETC1Modes(pixel_buffer, flags, bitstring);
+    return true;
+}
+
+// Reconstruct a planar mode component in the same way as the decoder.
+DETEX_INLINE_ONLY int PlanarValue(int o, int h, int v, int x, int y) {
+    return detexClamp0To255((x * (h - o) + y * (v - o) + 4 * o + 2) >> 2);
+}
+
+// Encode the block using the ETC2 planar mode, in which every component is a
+// plane through the colors O (top-left), H (right) and V (bottom), fitted with
+// least squares. Returns the error, or UINT32_MAX when the block could not be
+// encoded.
+static uint32_t CompressBlockETC2Planar(const uint8_t *DETEX_RESTRICT pixel_buffer, uint8_t *DETEX_RESTRICT bitstring) {
+    // The value of pixel (x, y) is O + x (H - O) / 4 + y (V - O) / 4, so the
+    // weights of O, H and V are (4 - x - y) / 4, x / 4 and y / 4. Solve the
+    // normal equations with Cramer's rule.
+    float m[3][3] = {{0}};
+    float rhs[3][3] = {{0}};
+    for (int y = 0; y < 4; y++)
+        for (int x = 0; x < 4; x++) {
+            float w[3] = {(4 - x - y) * 0.25f, x * 0.25f, y * 0.25f};
+            for (int j = 0; j < 3; j++) {
+                for (int k = 0; k < 3; k++) m[j][k] += w[j] * w[k];
+                for (int c = 0; c < 3; c++) rhs[c][j] += w[j] * pixel_buffer[(y * 4 + x) * 4 + c];
+            }
+        }
+    float det = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+                m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+    // The quantized O, H and V colors, 6-7-6 bits.
+    int q[3][3];
+    for (int c = 0; c < 3; c++) {
+        const float *r = rhs[c];
+        float solution[3];
+        solution[0] = (r[0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) - m[0][1] * (r[1] * m[2][2] - m[1][2] * r[2]) +
+                       m[0][2] * (r[1] * m[2][1] - m[1][1] * r[2])) /
+                      det;
+        solution[1] = (m[0][0] * (r[1] * m[2][2] - m[1][2] * r[2]) - r[0] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+                       m[0][2] * (m[1][0] * r[2] - r[1] * m[2][0])) /
+                      det;
+        solution[2] = (m[0][0] * (m[1][1] * r[2] - r[1] * m[2][1]) - m[0][1] * (m[1][0] * r[2] - r[1] * m[2][0]) +
+                       r[0] * (m[1][0] * m[2][1] - m[1][1] * m[2][0])) /
+                      det;
+        int max_value = c == 1 ? 127 : 63;
+        for (int j = 0; j < 3; j++) {
+            int value = (int)floorf(solution[j] * max_value / 255.0f + 0.5f);
+            q[j][c] = value < 0 ? 0 : (value > max_value ? max_value : value);
+        }
+    }
+    int expanded[3][3];
+    for (int j = 0; j < 3; j++) {
+        expanded[j][0] = (q[j][0] << 2) | (q[j][0] >> 4);
+        expanded[j][1] = (q[j][1] << 1) | (q[j][1] >> 6);
+        expanded[j][2] = (q[j][2] << 2) | (q[j][2] >> 4);
+    }
+    uint32_t error = 0;
+    for (int y = 0; y < 4; y++)
+        for (int x = 0; x < 4; x++)
+            for (int c = 0; c < 3; c++) {
+                int d = PlanarValue(expanded[0][c], expanded[1][c], expanded[2][c], x, y) -
+                        pixel_buffer[(y * 4 + x) * 4 + c];
+                error += d * d;
+            }
+    int RO = q[0][0], GO = q[0][1], BO = q[0][2];
+    int RH = q[1][0], GH = q[1][1], BH = q[1][2];
+    int RV = q[2][0], GV = q[2][1], BV = q[2][2];
+    uint8_t block[8];
+    block[0] = (RO << 1) | (GO >> 6);
+    block[1] = ((GO & 0x3F) << 1) | (BO >> 5);
+    block[2] = (((BO >> 3) & 3) << 3) | ((BO >> 1) & 3);
+    block[3] = ((BO & 1) << 7) | ((RH >> 1) << 2) | 2 | (RH & 1);
+    block[4] = (GH << 1) | (BH >> 5);
+    block[5] = ((BH & 0x1F) << 3) | (RV >> 3);
+    block[6] = ((RV & 7) << 5) | (GV >> 2);
+    block[7] = ((GV & 3) << 6) | BV;
+    // The planar mode is signalled by the red and green differential base
+    // colors staying in range while the blue one overflows. Bit 7 of the first
+    // two bytes and bits 7, 6, 5 and 2 of the third byte are not used by the
+    // planar mode; find a setting for which the decoder selects it.
+    for (int unused_bits = 0; unused_bits < 64; unused_bits++) {
+        uint8_t candidate[8];
+        memcpy(candidate, block, sizeof(block));
+        candidate[0] |= (unused_bits & 1) << 7;
+        candidate[1] |= ((unused_bits >> 1) & 1) << 7;
+        candidate[2] |= (((unused_bits >> 2) & 7) << 5) | (((unused_bits >> 5) & 1) << 2);
+        if (detexGetModeETC2(candidate) == 4) {
+            memcpy(bitstring, candidate, sizeof(candidate));
+            return error;
+        }
+    }
+    return UINT32_MAX;
+}
+
+// Encode the color part of an ETC2 block. The individual and differential
+// modes are shared with ETC1; in quality mode, the planar mode is tried as
+// well, which suits smooth gradients.
+static void CompressColorBlockETC2(const uint8_t *DETEX_RESTRICT pixel_buffer,
+                                   uint32_t flags,
+                                   uint8_t *DETEX_RESTRICT bitstring) {
+    uint32_t error = CompressBlockETC1Modes(pixel_buffer, flags, bitstring);
+    if ((flags & DETEX_COMPRESS_FLAG_QUALITY) && error > 0) {
+        uint8_t planar[8];
+        if (CompressBlockETC2Planar(pixel_buffer, planar) < error) memcpy(bitstring, planar, sizeof(planar));
+    }
+}
+
+/* Compress a 4x4 block of RGBA8 pixels into a 64-bit ETC2 block. */
+bool detexCompressBlockETC2(const uint8_t *DETEX_RESTRICT pixel_buffer,
+                            uint32_t flags,
+                            uint8_t *DETEX_RESTRICT bitstring) {
+    CompressColorBlockETC2(pixel_buffer, flags, bitstring);
+    return true;
+}
+
+// Best EAC alpha block found so far.
+typedef struct {
+    uint32_t error;
+    int base_codeword;
+    int multiplier;
+    int table;
+    uint64_t indices;
+} EACCandidate;
+
+static void TryParametersEAC(const uint8_t *DETEX_RESTRICT pixel_buffer,
+                             int base_codeword,
+                             int multiplier,
+                             int table,
+                             EACCandidate *DETEX_RESTRICT best) {
+    int palette[8];
+    for (int j = 0; j < 8; j++)
+        palette[j] = detexClamp0To255(base_codeword + eac_modifier_table[table][j] * multiplier);
+    uint64_t indices = 0;
+    uint32_t total_error = 0;
+    for (int i = 0; i < 16; i++) {
+        int alpha = pixel_buffer[PixelOffset(i) + 3];
+        uint32_t best_error = UINT32_MAX;
+        int best_index = 0;
+        for (int j = 0; j < 8; j++) {
+            uint32_t error = (alpha - palette[j]) * (alpha - palette[j]);
+            if (error < best_error) {
+                best_error = error;
+                best_index = j;
+            }
+        }
+        indices |= (uint64_t)best_index << (45 - i * 3);
+        total_error += best_error;
+        if (total_error >= best->error) return;
+    }
+    best->error = total_error;
+    best->base_codeword = base_codeword;
+    best->multiplier = multiplier;
+    best->table = table;
+    best->indices = indices;
+}
+
+// Encode the alpha channel of a block into a 64-bit EAC block. For every
+// modifier table, the multiplier and base codeword that map the range of the
+// modifiers onto the range of the alpha values are tried; in quality mode, a
+// small window around them is searched as well.
+static void CompressAlphaBlockEAC(const uint8_t *DETEX_RESTRICT pixel_buffer,
+                                  uint32_t flags,
+                                  uint8_t *DETEX_RESTRICT bitstring) {
+    int min_alpha = 255, max_alpha = 0;
+    for (int i = 0; i < 16; i++) {
+        int alpha = pixel_buffer[i * 4 + 3];
+        min_alpha = alpha < min_alpha ? alpha : min_alpha;
+        max_alpha = alpha > max_alpha ? alpha : max_alpha;
+    }
+    EACCandidate best;
+    best.error = UINT32_MAX;
+    // A single value is represented exactly by table 13, which has a zero
+    // modifier. A zero multiplier is not allowed in encoding.
+    if (min_alpha == max_alpha) TryParametersEAC(pixel_buffer, min_alpha, 1, 13, &best);
+    for (int table = 0; table < 16 && best.error > 0; table++) {
+        int modifier_min = eac_modifier_table[table][3];
+        int modifier_max = eac_modifier_table[table][7];
+        int modifier_range = modifier_max - modifier_min;
+        int multiplier = (max_alpha - min_alpha + modifier_range / 2) / modifier_range;
+        multiplier = multiplier < 1 ? 1 : (multiplier > 15 ? 15 : multiplier);
+        int search = (flags & DETEX_COMPRESS_FLAG_QUALITY) ? 1 : 0;
+        for (int m = multiplier - search; m <= multiplier + search; m++) {
+            if (m < 1 || m > 15) continue;
+            // Center the modifier range on the alpha range.
+            int base_codeword = (int)floorf((min_alpha + max_alpha - (modifier_min + modifier_max) * m) * 0.5f + 0.5f);
+            for (int b = base_codeword - 2 * search; b <= base_codeword + 2 * search; b++)
+                TryParametersEAC(pixel_buffer, detexClamp0To255(b), m, table, &best);
+        }
+    }
+    bitstring[0] = best.base_codeword;
+    bitstring[1] = (best.multiplier << 4) | best.table;
+    for (int i = 0; i < 6; i++) bitstring[2 + i] = (best.indices >> ((5 - i) * 8)) & 0xFF;
+}
+
+/* Compress a 4x4 block of RGBA8 pixels into a 128-bit ETC2_EAC block. */
+bool detexCompressBlockETC2_EAC(const uint8_t *DETEX_RESTRICT pixel_buffer,
+                                uint32_t flags,
+                                uint8_t *DETEX_RESTRICT bitstring) {
+    CompressAlphaBlockEAC(pixel_buffer, flags, bitstring);
+    CompressColorBlockETC2(pixel_buffer, flags, &bitstring[8]);
+    return true;
+}
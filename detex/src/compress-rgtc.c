@@ -0,0 +1,297 @@
+/*
+
+Copyright (c) 2015 Harm Hanemaaijer <fgenfb@yahoo.com>
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+*/
+
+#include <string.h>
+
+#include "detex.h"
+
+#if defined(DETEX_ARCH_X86)
+#    include <immintrin.h>
+#elif defined(DETEX_ARCH_ARM64)
+#    include <arm_neon.h>
+#endif
+
+// RGTC1 (BC4) and RGTC2 (BC5) encoders, unsigned and signed, the counterparts
+// of the decoders in decompress-rgtc.c. Every channel is encoded separately:
+// a window of endpoint pairs around the range of the values is searched
+// exhaustively, and for every pair the best of the eight palette entries is
+// selected for all sixteen pixels. The palette error is evaluated with SIMD
+// instructions when available, which handle all pixels of a block at once.
+//
+// Signed values are mapped to [0, 254] by adding 127 after the palette has
+// been calculated, so that both variants share the error evaluation.
+
+// Radius of the window of endpoints searched around the minimum and maximum.
+#define SEARCH_RADIUS_FAST 1
+#define SEARCH_RADIUS_QUALITY 8
+
+typedef uint32_t (*PaletteErrorFuncType)(const uint8_t *values, const uint8_t *palette);
+
+// Calculate the eight palette values of an unsigned block in the same way as
+// the decoder.
+static void CalculatePaletteRGTC(int lum0, int lum1, uint8_t *palette) {
+    palette[0] = lum0;
+    palette[1] = lum1;
+    if (lum0 > lum1) {
+        for (int j = 1; j < 7; j++) palette[j + 1] = detexDivide0To1791By7((7 - j) * lum0 + j * lum1);
+    } else {
+        for (int j = 1; j < 5; j++) palette[j + 1] = detexDivide0To1279By5((5 - j) * lum0 + j * lum1);
+        palette[6] = 0;
+        palette[7] = 0xFF;
+    }
+}
+
+// Calculate the eight palette values of a signed block in the same way as
+// the decoder, mapped to [0, 254].
+static void CalculatePaletteSignedRGTC(int lum0, int lum1, uint8_t *palette) {
+    int values[8];
+    values[0] = lum0;
+    values[1] = lum1;
+    if (lum0 > lum1) {
+        for (int j = 1; j < 7; j++) values[j + 1] = detexDivideMinus895To895By7((7 - j) * lum0 + j * lum1);
+    } else {
+        for (int j = 1; j < 5; j++) values[j + 1] = detexDivideMinus639To639By5((5 - j) * lum0 + j * lum1);
+        values[6] = -127;
+        values[7] = 127;
+    }
+    for (int j = 0; j < 8; j++) palette[j] = values[j] + 127;
+}
+
+// Select the best palette entry for every value, storing the 3-bit indices.
+static uint64_t SelectIndices(const uint8_t *values, const uint8_t *palette) {
+    uint64_t indices = 0;
+    for (int i = 0; i < 16; i++) {
+        int best_error = INT32_MAX;
+        int best_index = 0;
+        for (int j = 0; j < 8; j++) {
+            int error = (values[i] - palette[j]) * (values[i] - palette[j]);
+            if (error < best_error) {
+                best_error = error;
+                best_index = j;
+            }
+        }
+        indices |= (uint64_t)best_index << (i * 3);
+    }
+    return indices;
+}
+
+// Total squared error of the values when every value uses the closest palette
+// entry.
+static uint32_t PaletteErrorScalar(const uint8_t *values, const uint8_t *palette) {
+    uint32_t total_error = 0;
+    for (int i = 0; i < 16; i++) {
+        int best_difference = 255;
+        for (int j = 0; j < 8; j++) {
+            int difference = values[i] > palette[j] ? values[i] - palette[j] : palette[j] - values[i];
+            if (difference < best_difference) best_difference = difference;
+        }
+        total_error += best_difference * best_difference;
+    }
+    return total_error;
+}
+
+#ifdef DETEX_ARCH_X86
+
+// The sixteen values of a block fit in one register. The absolute differences
+// with every palette entry are calculated with saturating subtractions, the
+// squares of the smallest ones are summed with a multiply-add.
+DETEX_TARGET("sse2")
+static uint32_t PaletteErrorSSE2(const uint8_t *values, const uint8_t *palette) {
+    __m128i v = _mm_loadu_si128((const __m128i *)values);
+    __m128i best = _mm_set1_epi8((char)0xFF);
+    for (int j = 0; j < 8; j++) {
+        __m128i p = _mm_set1_epi8((char)palette[j]);
+        __m128i difference = _mm_or_si128(_mm_subs_epu8(v, p), _mm_subs_epu8(p, v));
+        best = _mm_min_epu8(best, difference);
+    }
+    __m128i low = _mm_unpacklo_epi8(best, _mm_setzero_si128());
+    __m128i high = _mm_unpackhi_epi8(best, _mm_setzero_si128());
+    __m128i sum = _mm_add_epi32(_mm_madd_epi16(low, low), _mm_madd_epi16(high, high));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return (uint32_t)_mm_cvtsi128_si32(sum);
+}
+
+#endif
+
+#ifdef DETEX_ARCH_ARM64
+
+static uint32_t PaletteErrorNEON(const uint8_t *values, const uint8_t *palette) {
+    uint8x16_t v = vld1q_u8(values);
+    uint8x16_t best = vdupq_n_u8(0xFF);
+    for (int j = 0; j < 8; j++) best = vminq_u8(best, vabdq_u8(v, vdupq_n_u8(palette[j])));
+    uint16x8_t low = vmull_u8(vget_low_u8(best), vget_low_u8(best));
+    uint16x8_t high = vmull_u8(vget_high_u8(best), vget_high_u8(best));
+    return vaddlvq_u16(low) + vaddlvq_u16(high);
+}
+
+#endif
+
+// Indexed by SIMD level.
+static const PaletteErrorFuncType palette_error_functions[] = {
+    [DETEX_SIMD_LEVEL_NONE] = PaletteErrorScalar,
+#ifdef DETEX_ARCH_X86
+    [DETEX_SIMD_LEVEL_SSE2] = PaletteErrorSSE2,
+    [DETEX_SIMD_LEVEL_AVX2] = PaletteErrorSSE2,
+#endif
+#ifdef DETEX_ARCH_ARM64
+    [DETEX_SIMD_LEVEL_NEON] = PaletteErrorNEON,
+#endif
+};
+
+// Best channel block found so far.
+typedef struct {
+    uint32_t error;
+    int lum0;
+    int lum1;
+} RGTCCandidate;
+
+// Search the endpoint pairs (lum0, lum1) with lum0 within radius of center0
+// and lum1 within radius of center1, clamped to [min_value, max_value].
+static void SearchEndpoints(const uint8_t *values,
+                            bool is_signed,
+                            int center0,
+                            int center1,
+                            int radius,
+                            int min_value,
+                            int max_value,
+                            PaletteErrorFuncType palette_error,
+                            RGTCCandidate *DETEX_RESTRICT best) {
+    int lum0_begin = center0 - radius < min_value ? min_value : center0 - radius;
+    int lum0_end = center0 + radius > max_value ? max_value : center0 + radius;
+    int lum1_begin = center1 - radius < min_value ? min_value : center1 - radius;
+    int lum1_end = center1 + radius > max_value ? max_value : center1 + radius;
+    for (int lum0 = lum0_begin; lum0 <= lum0_end; lum0++)
+        for (int lum1 = lum1_begin; lum1 <= lum1_end; lum1++) {
+            uint8_t palette[8];
+            if (is_signed)
+                CalculatePaletteSignedRGTC(lum0, lum1, palette);
+            else
+                CalculatePaletteRGTC(lum0, lum1, palette);
+            uint32_t error = palette_error(values, palette);
+            if (error < best->error) {
+                best->error = error;
+                best->lum0 = lum0;
+                best->lum1 = lum1;
+                if (error == 0) return;
+            }
+        }
+}
+
+// Encode one channel of sixteen values, in [0, 255] for unsigned blocks or in
+// [0, 254] (signed value + 127) for signed blocks, into a 64-bit block.
+static void CompressChannelBlock(const uint8_t *values, bool is_signed, uint32_t flags, uint8_t *bitstring) {
+    PaletteErrorFuncType palette_error = palette_error_functions[detexGetSIMDLevel()];
+    int bias = is_signed ? 127 : 0;
+    int min_value = 255, max_value = 0;
+    // Range of the values excluding the extremes, for the 6-value mode, which
+    // has them as explicit palette entries.
+    int min_inner_value = 255, max_inner_value = 0;
+    for (int i = 0; i < 16; i++) {
+        int value = values[i];
+        min_value = value < min_value ? value : min_value;
+        max_value = value > max_value ? value : max_value;
+        if (value != 0 && value != 255 - is_signed) {
+            min_inner_value = value < min_inner_value ? value : min_inner_value;
+            max_inner_value = value > max_inner_value ? value : max_inner_value;
+        }
+    }
+    if (min_inner_value > max_inner_value) min_inner_value = max_inner_value = min_value;
+    int radius = (flags & DETEX_COMPRESS_FLAG_QUALITY) ? SEARCH_RADIUS_QUALITY : SEARCH_RADIUS_FAST;
+    RGTCCandidate best;
+    best.error = UINT32_MAX;
+    // 8-value mode (lum0 > lum1) around the extremes, followed by the 6-value
+    // mode (lum0 <= lum1) around the inner extremes. Pairs of the other mode
+    // that fall inside a window are valid encodings as well.
+    int max_endpoint = 255 - is_signed - bias;
+    SearchEndpoints(
+        values, is_signed, max_value - bias, min_value - bias, radius, -bias, max_endpoint, palette_error, &best);
+    if (best.error > 0)
+        SearchEndpoints(values,
+                        is_signed,
+                        min_inner_value - bias,
+                        max_inner_value - bias,
+                        radius,
+                        -bias,
+                        max_endpoint,
+                        palette_error,
+                        &best);
+    uint8_t palette[8];
+    if (is_signed)
+        CalculatePaletteSignedRGTC(best.lum0, best.lum1, palette);
+    else
+        CalculatePaletteRGTC(best.lum0, best.lum1, palette);
+    uint64_t indices = SelectIndices(values, palette);
+    bitstring[0] = (uint8_t)best.lum0;
+    bitstring[1] = (uint8_t)best.lum1;
+    for (int i = 0; i < 6; i++) bitstring[2 + i] = (indices >> (i * 8)) & 0xFF;
+}
+
+// Gather one component of an RGBA8 block. Signed values are mapped from
+// [0, 255] to [-127, 127] by subtracting 128 (as the pixel format conversions
+// do) and then stored with a bias of 127.
+static void GatherComponent(const uint8_t *pixel_buffer, int component, bool is_signed, uint8_t *values) {
+    for (int i = 0; i < 16; i++) {
+        int value = pixel_buffer[i * 4 + component];
+        values[i] = is_signed ? (value == 0 ? 0 : value - 1) : value;
+    }
+}
+
+/* Compress a 4x4 block of RGBA8 pixels into a 64-bit unsigned RGTC1 block, using the red component. */
+bool detexCompressBlockRGTC1(const uint8_t *DETEX_RESTRICT pixel_buffer,
+                             uint32_t flags,
+                             uint8_t *DETEX_RESTRICT bitstring) {
+    uint8_t values[16];
+    GatherComponent(pixel_buffer, 0, false, values);
+    CompressChannelBlock(values, false, flags, bitstring);
+    return true;
+}
+
+/* Compress a 4x4 block of RGBA8 pixels into a 128-bit unsigned RGTC2 block, using the red and green components. */
+bool detexCompressBlockRGTC2(const uint8_t *DETEX_RESTRICT pixel_buffer,
+                             uint32_t flags,
+                             uint8_t *DETEX_RESTRICT bitstring) {
+    uint8_t values[16];
+    for (int c = 0; c < 2; c++) {
+        GatherComponent(pixel_buffer, c, false, values);
+        CompressChannelBlock(values, false, flags, &bitstring[c * 8]);
+    }
+    return true;
+}
+
+/* Compress a 4x4 block of RGBA8 pixels into a 64-bit signed RGTC1 block, using the red component. */
+bool detexCompressBlockSIGNED_RGTC1(const uint8_t *DETEX_RESTRICT pixel_buffer,
+                                    uint32_t flags,
+                                    uint8_t *DETEX_RESTRICT bitstring) {
+    uint8_t values[16];
+    GatherComponent(pixel_buffer, 0, true, values);
+    CompressChannelBlock(values, true, flags, bitstring);
+    return true;
+}
+
+/* Compress a 4x4 block of RGBA8 pixels into a 128-bit signed RGTC2 block, using the red and green components. */
+bool detexCompressBlockSIGNED_RGTC2(const uint8_t *DETEX_RESTRICT pixel_buffer,
+                                    uint32_t flags,
+                                    uint8_t *DETEX_RESTRICT bitstring) {
+    uint8_t values[16];
+    for (int c = 0; c < 2; c++) {
+        GatherComponent(pixel_buffer, c, true, values);
+        CompressChannelBlock(values, true, flags, &bitstring[c * 8]);
+    }
+    return true;
+}
@@ -178,6 +178,20 @@ static void ConvertPixel32SignedRG16ToPixel32RG16(uint8_t *DETEX_RESTRICT source
     }
 }
 
+// In-place conversion from signed to unsigned half-float. Negative values
+// (including negative zero) are clamped to zero, like the unsigned BPTC_FLOAT
+// encoder does.
+
+static void ConvertPixel64SignedFloatRGBX16ToPixel64FloatRGBX16(uint8_t *DETEX_RESTRICT source_pixel_buffer,
+                                                               int nu_pixels,
+                                                               uint8_t *DETEX_RESTRICT target_pixel_buffer) {
+    uint16_t *source_pixel16_buffer = (uint16_t *)source_pixel_buffer;
+    for (int i = 0; i < nu_pixels * 4; i++) {
+        if (*source_pixel16_buffer & 0x8000) *source_pixel16_buffer = 0;
+        source_pixel16_buffer++;
+    }
+}
+
 // Reducing the number of components.
 
 static void ConvertPixel32RGBA8ToPixel8R8(uint8_t *DETEX_RESTRICT source_pixel_buffer,
@@ -573,9 +587,9 @@ static void ConvertPixel64RGBX16ToPixel64FloatRGBX16(uint8_t *DETEX_RESTRICT sou
         int nu_stage_pixels = 32;
         if (i + 32 > nu_pixels) nu_stage_pixels = nu_pixels - i;
         for (int j = 0; j < nu_stage_pixels; j++) {
-            int16_t red = source_pixel16_buffer[0];
-            int16_t green = source_pixel16_buffer[1];
-            int16_t blue = source_pixel16_buffer[2];
+            uint16_t red = source_pixel16_buffer[0];
+            uint16_t green = source_pixel16_buffer[1];
+            uint16_t blue = source_pixel16_buffer[2];
             float redf = red * (1.0f / 65535.0f);
             float greenf = green * (1.0f / 65535.0f);
             float bluef = blue * (1.0f / 65535.0f);
@@ -891,6 +905,14 @@ detexConversionType detex_conversion_table[] = {
     {DETEX_PIXEL_FORMAT_FLOAT_RGBX32, DETEX_PIXEL_FORMAT_FLOAT_RGB32, ConvertPixel128RGBX32ToPixel96RGB32},
     {DETEX_PIXEL_FORMAT_FLOAT_RGB32_HDR, DETEX_PIXEL_FORMAT_FLOAT_RGBX32_HDR, ConvertPixel96RGB32ToPixel128RGBX32},
     {DETEX_PIXEL_FORMAT_FLOAT_RGBX32_HDR, DETEX_PIXEL_FORMAT_FLOAT_RGB32_HDR, ConvertPixel128RGBX32ToPixel96RGB32},
+    // Unsigned half-floats are valid signed half-floats, and the alpha
+    // component is ignored (in-place).
+    {DETEX_PIXEL_FORMAT_FLOAT_RGBX16, DETEX_PIXEL_FORMAT_SIGNED_FLOAT_RGBX16, ConvertNoop},
+    {DETEX_PIXEL_FORMAT_FLOAT_RGBA16, DETEX_PIXEL_FORMAT_FLOAT_RGBX16, ConvertNoop},
+    // Signed to unsigned half-float, clamping negative values to zero.
+    {DETEX_PIXEL_FORMAT_SIGNED_FLOAT_RGBX16,
+     DETEX_PIXEL_FORMAT_FLOAT_RGBX16,
+     ConvertPixel64SignedFloatRGBX16ToPixel64FloatRGBX16},
 };
 
 #define NU_CONVERSION_TYPES (sizeof(detex_conversion_table) / sizeof(detex_conversion_table[0]))
@@ -1048,24 +1070,45 @@ static int detexMatchConversion(uint32_t source_pixel_format, uint32_t target_pi
 
 #define DETEX_MAX_TEMP_PIXEL_BUFFERS 3
 
+// Size of the temporary buffer space on the stack, enough for the batches of
+// tiles converted by the texture decompression functions. Larger buffers are
+// allocated on the heap.
+#define DETEX_LOCAL_TEMP_PIXEL_BUFFER_SIZE (DETEX_MAX_TEMP_PIXEL_BUFFERS * 256 * 16)
+
 typedef struct {
     uint8_t *pixel_buffer[DETEX_MAX_TEMP_PIXEL_BUFFERS];
-    uint32_t size[DETEX_MAX_TEMP_PIXEL_BUFFERS];
+    bool allocated[DETEX_MAX_TEMP_PIXEL_BUFFERS];
     int nu_buffers;
+    uint32_t local_used;
+    uint64_t local[DETEX_LOCAL_TEMP_PIXEL_BUFFER_SIZE / 8];
 } TempPixelBufferInfo;
 
-static void InitTemporaryPixelBuffers(TempPixelBufferInfo *info) { info->nu_buffers = 0; }
+static void InitTemporaryPixelBuffers(TempPixelBufferInfo *info) {
+    info->nu_buffers = 0;
+    info->local_used = 0;
+}
 
 static uint8_t *AllocateTemporaryPixelBuffer(TempPixelBufferInfo *info, uint32_t size) {
     if (info->nu_buffers == DETEX_MAX_TEMP_PIXEL_BUFFERS) return NULL;
-    uint8_t *buffer = (uint8_t *)malloc(size);
+    uint8_t *buffer;
+    // Keep the buffers 8-byte aligned.
+    uint32_t aligned_size = (size + 7) & ~7u;
+    bool allocated = aligned_size > DETEX_LOCAL_TEMP_PIXEL_BUFFER_SIZE - info->local_used;
+    if (allocated) {
+        buffer = (uint8_t *)malloc(size);
+    } else {
+        buffer = (uint8_t *)info->local + info->local_used;
+        info->local_used += aligned_size;
+    }
     info->pixel_buffer[info->nu_buffers] = buffer;
+    info->allocated[info->nu_buffers] = allocated;
     info->nu_buffers++;
     return buffer;
 }
 
 static void FreeTemporaryPixelBuffers(TempPixelBufferInfo *info) {
-    for (int i = 0; i < info->nu_buffers; i++) free(info->pixel_buffer[i]);
+    for (int i = 0; i < info->nu_buffers; i++)
+        if (info->allocated[i]) free(info->pixel_buffer[i]);
 }
 
 // Convert pixels between different formats. Return true if successful.
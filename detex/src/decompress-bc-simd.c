@@ -0,0 +1,758 @@
+/*
+
+Copyright (c) 2015 Harm Hanemaaijer <fgenfb@yahoo.com>
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+*/
+
+#include <string.h>
+
+#include "detex.h"
+
+#if defined(DETEX_ARCH_X86)
+#    include <immintrin.h>
+#elif defined(DETEX_ARCH_ARM64)
+#    include <arm_neon.h>
+#endif
+
+// Multi-block BC1-BC3 decoders. The palettes of a block are calculated with
+// scalar code (divisions by multiplication, exact for the ranges involved), the
+// sixteen pixels are then looked up in the palettes with SIMD instructions.
+
+typedef bool (*DecompressBlockFuncType)(const uint8_t *bitstring,
+                                        uint32_t mode_mask,
+                                        uint32_t flags,
+                                        uint8_t *pixel_buffer);
+
+// Palette types of the color part of a block.
+enum {
+    // BC1: three color mode has opaque black as fourth color.
+    COLOR_PALETTE_BC1,
+    // BC1A: three color mode has transparent black as fourth color.
+    COLOR_PALETTE_BC1A,
+    // BC2/BC3: always four colors, alpha zero (it is added separately).
+    COLOR_PALETTE_BC2,
+    // Flag combined with the above: swap red and blue, for BGRA8 output.
+    COLOR_PALETTE_SWAP_RB = 0x10,
+};
+
+static inline uint32_t Divide0To767By3(uint32_t value) { return (value * 0xAAAB) >> 17; }
+
+static inline uint32_t Divide0To1279By5(uint32_t value) { return (value * 0xCCCD) >> 18; }
+
+static inline uint32_t Divide0To1791By7(uint32_t value) { return (value * 0x2493) >> 16; }
+
+static inline uint32_t Load32(const uint8_t *p) {
+    uint32_t value;
+    memcpy(&value, p, 4);
+    return value;
+}
+
+static inline void CalculateColorPalette(uint32_t colors, int type, uint32_t *palette) {
+    int r0 = (colors & 0x0000F800) >> (11 - 3);
+    int g0 = (colors & 0x000007E0) >> (5 - 2);
+    int b0 = (colors & 0x0000001F) << 3;
+    int r1 = (colors & 0xF8000000) >> (27 - 3);
+    int g1 = (colors & 0x07E00000) >> (21 - 2);
+    int b1 = (colors & 0x001F0000) >> (16 - 3);
+    int a = type == COLOR_PALETTE_BC2 ? 0 : 0xFF;
+    palette[0] = detexPack32RGBA8(r0, g0, b0, a);
+    palette[1] = detexPack32RGBA8(r1, g1, b1, a);
+    if (type == COLOR_PALETTE_BC2 || (colors & 0xFFFF) > (colors >> 16)) {
+        palette[2] = detexPack32RGBA8(
+            Divide0To767By3(2 * r0 + r1), Divide0To767By3(2 * g0 + g1), Divide0To767By3(2 * b0 + b1), a);
+        palette[3] = detexPack32RGBA8(
+            Divide0To767By3(r0 + 2 * r1), Divide0To767By3(g0 + 2 * g1), Divide0To767By3(b0 + 2 * b1), a);
+    } else {
+        palette[2] = detexPack32RGBA8((r0 + r1) / 2, (g0 + g1) / 2, (b0 + b1) / 2, a);
+        palette[3] = detexPack32RGBA8(0, 0, 0, type == COLOR_PALETTE_BC1 ? 0xFF : 0);
+    }
+}
+
+// Calculate the color palette of a block, with red and blue swapped when the
+// type includes COLOR_PALETTE_SWAP_RB.
+static inline void CalculateColorPaletteSwapRB(uint32_t colors, int type, uint32_t *palette) {
+    CalculateColorPalette(colors, type & ~COLOR_PALETTE_SWAP_RB, palette);
+    if (type & COLOR_PALETTE_SWAP_RB)
+        for (int k = 0; k < 4; k++)
+            palette[k] = (palette[k] & 0xFF00FF00) | ((palette[k] & 0xFF) << 16) | ((palette[k] >> 16) & 0xFF);
+}
+
+// Calculate the eight alpha values of a BC3 block, stored in the alpha component.
+static inline void CalculateAlphaPaletteBC3(const uint8_t *bitstring, uint32_t *palette) {
+    int alpha0 = bitstring[0];
+    int alpha1 = bitstring[1];
+    palette[0] = detexPack32RGBA8(0, 0, 0, alpha0);
+    palette[1] = detexPack32RGBA8(0, 0, 0, alpha1);
+    if (alpha0 > alpha1) {
+        for (int i = 1; i < 7; i++)
+            palette[i + 1] = detexPack32RGBA8(0, 0, 0, Divide0To1791By7((7 - i) * alpha0 + i * alpha1));
+    } else {
+        for (int i = 1; i < 5; i++)
+            palette[i + 1] = detexPack32RGBA8(0, 0, 0, Divide0To1279By5((5 - i) * alpha0 + i * alpha1));
+        palette[6] = detexPack32RGBA8(0, 0, 0, 0);
+        palette[7] = detexPack32RGBA8(0, 0, 0, 0xFF);
+    }
+}
+
+// The 48 bits of alpha codes of a BC3 block.
+static inline uint64_t GetAlphaBitsBC3(const uint8_t *bitstring) {
+    return (uint32_t)bitstring[2] | ((uint32_t)bitstring[3] << 8) | ((uint64_t)Load32(bitstring + 4) << 16);
+}
+
+// Scalar versions, used when no SIMD instruction set is available.
+
+static bool DecompressBlocksBC1Scalar(const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {
+    for (int i = 0; i < nu_blocks; i++)
+        detexDecompressBlockBC1(bitstring + i * 8, DETEX_MODE_MASK_ALL, 0, pixel_buffer + i * 64);
+    return true;
+}
+
+static bool DecompressBlocksBC1AScalar(const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {
+    for (int i = 0; i < nu_blocks; i++)
+        detexDecompressBlockBC1A(bitstring + i * 8, DETEX_MODE_MASK_ALL, 0, pixel_buffer + i * 64);
+    return true;
+}
+
+static bool DecompressBlocksBC2Scalar(const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {
+    for (int i = 0; i < nu_blocks; i++)
+        detexDecompressBlockBC2(bitstring + i * 16, DETEX_MODE_MASK_ALL, 0, pixel_buffer + i * 64);
+    return true;
+}
+
+static bool DecompressBlocksBC3Scalar(const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {
+    for (int i = 0; i < nu_blocks; i++)
+        detexDecompressBlockBC3(bitstring + i * 16, DETEX_MODE_MASK_ALL, 0, pixel_buffer + i * 64);
+    return true;
+}
+
+// Define the multi-block functions of a SIMD level from its DecompressColorBlocks
+// and AddAlpha functions, both for RGBA8 output and, with red and blue swapped in
+// the palette, for BGRA8 output.
+#define DEFINE_DECOMPRESS_BLOCKS_FUNCTIONS(level, target)                                        \
+    target static bool DecompressBlocksBC1##level(                                               \
+        const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {                        \
+        DecompressColorBlocks##level(bitstring, 8, nu_blocks, COLOR_PALETTE_BC1, pixel_buffer);  \
+        return true;                                                                             \
+    }                                                                                            \
+    target static bool DecompressBlocksBC1ToBGRA8##level(                                        \
+        const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {                        \
+        DecompressColorBlocks##level(                                                            \
+            bitstring, 8, nu_blocks, COLOR_PALETTE_BC1 | COLOR_PALETTE_SWAP_RB, pixel_buffer);   \
+        return true;                                                                             \
+    }                                                                                            \
+    target static bool DecompressBlocksBC1A##level(                                              \
+        const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {                        \
+        DecompressColorBlocks##level(bitstring, 8, nu_blocks, COLOR_PALETTE_BC1A, pixel_buffer); \
+        return true;                                                                             \
+    }                                                                                            \
+    target static bool DecompressBlocksBC1AToBGRA8##level(                                       \
+        const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {                        \
+        DecompressColorBlocks##level(                                                            \
+            bitstring, 8, nu_blocks, COLOR_PALETTE_BC1A | COLOR_PALETTE_SWAP_RB, pixel_buffer);  \
+        return true;                                                                             \
+    }                                                                                            \
+    target static bool DecompressBlocksBC2##level(                                               \
+        const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {                        \
+        DecompressColorBlocks##level(bitstring, 16, nu_blocks, COLOR_PALETTE_BC2, pixel_buffer); \
+        AddAlphaBC2##level(bitstring, nu_blocks, pixel_buffer);                                  \
+        return true;                                                                             \
+    }                                                                                            \
+    target static bool DecompressBlocksBC2ToBGRA8##level(                                        \
+        const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {                        \
+        DecompressColorBlocks##level(                                                            \
+            bitstring, 16, nu_blocks, COLOR_PALETTE_BC2 | COLOR_PALETTE_SWAP_RB, pixel_buffer);  \
+        AddAlphaBC2##level(bitstring, nu_blocks, pixel_buffer);                                  \
+        return true;                                                                             \
+    }                                                                                            \
+    target static bool DecompressBlocksBC3##level(                                               \
+        const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {                        \
+        DecompressColorBlocks##level(bitstring, 16, nu_blocks, COLOR_PALETTE_BC2, pixel_buffer); \
+        AddAlphaBC3##level(bitstring, nu_blocks, pixel_buffer);                                  \
+        return true;                                                                             \
+    }                                                                                            \
+    target static bool DecompressBlocksBC3ToBGRA8##level(                                        \
+        const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {                        \
+        DecompressColorBlocks##level(                                                            \
+            bitstring, 16, nu_blocks, COLOR_PALETTE_BC2 | COLOR_PALETTE_SWAP_RB, pixel_buffer);  \
+        AddAlphaBC3##level(bitstring, nu_blocks, pixel_buffer);                                  \
+        return true;                                                                             \
+    }
+
+#ifdef DETEX_ARCH_X86
+
+// SSE2 has no variable shifts or shuffles, so palette entries are selected by
+// comparing the masked index bits of four pixels with every possible index.
+
+// Select the colors of four pixels, indices holds their four 2-bit indices.
+DETEX_TARGET("sse2")
+static inline __m128i SelectColorsSSE2(uint32_t indices, const __m128i *palette) {
+    __m128i v = _mm_and_si128(_mm_set1_epi32(indices), _mm_setr_epi32(0x03, 0x0C, 0x30, 0xC0));
+    __m128i result = _mm_and_si128(_mm_cmpeq_epi32(v, _mm_setzero_si128()), palette[0]);
+    result = _mm_or_si128(
+        result, _mm_and_si128(_mm_cmpeq_epi32(v, _mm_setr_epi32(0x01, 0x04, 0x10, 0x40)), palette[1]));
+    result = _mm_or_si128(
+        result, _mm_and_si128(_mm_cmpeq_epi32(v, _mm_setr_epi32(0x02, 0x08, 0x20, 0x80)), palette[2]));
+    return _mm_or_si128(result, _mm_and_si128(_mm_cmpeq_epi32(v, _mm_setr_epi32(0x03, 0x0C, 0x30, 0xC0)), palette[3]));
+}
+
+DETEX_TARGET("sse2")
+static void DecompressColorBlocksSSE2(
+    const uint8_t *bitstring, int block_size, int nu_blocks, int type, uint8_t *pixel_buffer) {
+    for (int i = 0; i < nu_blocks; i++) {
+        const uint8_t *color_bits = bitstring + i * block_size + block_size - 8;
+        uint32_t palette[4];
+        CalculateColorPaletteSwapRB(Load32(color_bits), type, palette);
+        __m128i p[4];
+        for (int j = 0; j < 4; j++) p[j] = _mm_set1_epi32(palette[j]);
+        uint32_t indices = Load32(color_bits + 4);
+        __m128i *out = (__m128i *)(pixel_buffer + i * 64);
+        for (int j = 0; j < 4; j++) _mm_storeu_si128(out + j, SelectColorsSSE2(indices >> (j * 8), p));
+    }
+}
+
+// Add the alpha of BC2 blocks to the decompressed colors.
+DETEX_TARGET("sse2")
+static void AddAlphaBC2SSE2(const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {
+    for (int i = 0; i < nu_blocks; i++) {
+        const uint8_t *alpha_bits = bitstring + i * 16;
+        __m128i *out = (__m128i *)(pixel_buffer + i * 64);
+        for (int j = 0; j < 4; j++) {
+            // Move the 4-bit alpha of every pixel to bits 12-15, then expand
+            // it to eight bits (multiply by 17) in the alpha component.
+            __m128i v = _mm_and_si128(_mm_set1_epi32(alpha_bits[j * 2] | (alpha_bits[j * 2 + 1] << 8)),
+                                      _mm_setr_epi32(0x000F, 0x00F0, 0x0F00, 0xF000));
+            v = _mm_mullo_epi16(v, _mm_setr_epi32(0x1000, 0x0100, 0x0010, 0x0001));
+            __m128i alpha = _mm_or_si128(_mm_slli_epi32(v, 16), _mm_slli_epi32(v, 12));
+            _mm_storeu_si128(out + j, _mm_or_si128(_mm_loadu_si128(out + j), alpha));
+        }
+    }
+}
+
+// Add the alpha of BC3 blocks to the decompressed colors.
+DETEX_TARGET("sse2")
+static void AddAlphaBC3SSE2(const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {
+    for (int i = 0; i < nu_blocks; i++) {
+        uint32_t palette[8];
+        CalculateAlphaPaletteBC3(bitstring + i * 16, palette);
+        uint64_t alpha_bits = GetAlphaBitsBC3(bitstring + i * 16);
+        __m128i *out = (__m128i *)(pixel_buffer + i * 64);
+        for (int j = 0; j < 4; j++) {
+            __m128i v = _mm_and_si128(_mm_set1_epi32((uint32_t)(alpha_bits >> (j * 12)) & 0xFFF),
+                                      _mm_setr_epi32(07, 07 << 3, 07 << 6, 07 << 9));
+            __m128i alpha = _mm_setzero_si128();
+            for (int code = 0; code < 8; code++) {
+                __m128i mask = _mm_cmpeq_epi32(v, _mm_setr_epi32(code, code << 3, code << 6, code << 9));
+                alpha = _mm_or_si128(alpha, _mm_and_si128(mask, _mm_set1_epi32(palette[code])));
+            }
+            _mm_storeu_si128(out + j, _mm_or_si128(_mm_loadu_si128(out + j), alpha));
+        }
+    }
+}
+
+// AVX2 looks up eight pixels at a time with a variable shift and a permute.
+
+DETEX_TARGET("avx2")
+static void DecompressColorBlocksAVX2(
+    const uint8_t *bitstring, int block_size, int nu_blocks, int type, uint8_t *pixel_buffer) {
+    const __m256i shifts = _mm256_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14);
+    const __m256i mask = _mm256_set1_epi32(0x3);
+    for (int i = 0; i < nu_blocks; i++) {
+        const uint8_t *color_bits = bitstring + i * block_size + block_size - 8;
+        uint32_t palette[4];
+        CalculateColorPaletteSwapRB(Load32(color_bits), type, palette);
+        __m256i p = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)palette));
+        uint32_t indices = Load32(color_bits + 4);
+        __m256i index0 = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(indices), shifts), mask);
+        __m256i index1 = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(indices >> 16), shifts), mask);
+        __m256i *out = (__m256i *)(pixel_buffer + i * 64);
+        _mm256_storeu_si256(out, _mm256_permutevar8x32_epi32(p, index0));
+        _mm256_storeu_si256(out + 1, _mm256_permutevar8x32_epi32(p, index1));
+    }
+}
+
+DETEX_TARGET("avx2")
+static void AddAlphaBC2AVX2(const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {
+    const __m256i shifts = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+    const __m256i mask = _mm256_set1_epi32(0xF);
+    for (int i = 0; i < nu_blocks; i++) {
+        const uint8_t *alpha_bits = bitstring + i * 16;
+        __m256i *out = (__m256i *)(pixel_buffer + i * 64);
+        for (int j = 0; j < 2; j++) {
+            __m256i bits = _mm256_set1_epi32(Load32(alpha_bits + j * 4));
+            __m256i v = _mm256_and_si256(_mm256_srlv_epi32(bits, shifts), mask);
+            // Expand to eight bits (multiply by 17) in the alpha component.
+            __m256i alpha = _mm256_or_si256(_mm256_slli_epi32(v, 28), _mm256_slli_epi32(v, 24));
+            _mm256_storeu_si256(out + j, _mm256_or_si256(_mm256_loadu_si256(out + j), alpha));
+        }
+    }
+}
+
+DETEX_TARGET("avx2")
+static void AddAlphaBC3AVX2(const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {
+    const __m256i shifts = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+    const __m256i mask = _mm256_set1_epi32(0x7);
+    for (int i = 0; i < nu_blocks; i++) {
+        uint32_t palette[8];
+        CalculateAlphaPaletteBC3(bitstring + i * 16, palette);
+        __m256i p = _mm256_loadu_si256((const __m256i *)palette);
+        uint64_t alpha_bits = GetAlphaBitsBC3(bitstring + i * 16);
+        __m256i *out = (__m256i *)(pixel_buffer + i * 64);
+        for (int j = 0; j < 2; j++) {
+            __m256i bits = _mm256_set1_epi32((uint32_t)(alpha_bits >> (j * 24)));
+            __m256i index = _mm256_and_si256(_mm256_srlv_epi32(bits, shifts), mask);
+            __m256i alpha = _mm256_permutevar8x32_epi32(p, index);
+            _mm256_storeu_si256(out + j, _mm256_or_si256(_mm256_loadu_si256(out + j), alpha));
+        }
+    }
+}
+
+DEFINE_DECOMPRESS_BLOCKS_FUNCTIONS(SSE2, DETEX_TARGET("sse2"))
+DEFINE_DECOMPRESS_BLOCKS_FUNCTIONS(AVX2, DETEX_TARGET("avx2"))
+
+#endif
+
+#ifdef DETEX_ARCH_ARM64
+
+// NEON looks up the bytes of four pixels at a time with a table lookup.
+
+static void DecompressColorBlocksNEON(
+    const uint8_t *bitstring, int block_size, int nu_blocks, int type, uint8_t *pixel_buffer) {
+    const int32_t shift_values[4] = {0, -2, -4, -6};
+    const int32x4_t shifts = vld1q_s32(shift_values);
+    for (int i = 0; i < nu_blocks; i++) {
+        const uint8_t *color_bits = bitstring + i * block_size + block_size - 8;
+        uint32_t palette[4];
+        CalculateColorPaletteSwapRB(Load32(color_bits), type, palette);
+        uint8x16_t p = vreinterpretq_u8_u32(vld1q_u32(palette));
+        uint32_t indices = Load32(color_bits + 4);
+        for (int j = 0; j < 4; j++) {
+            uint32x4_t index = vandq_u32(vshlq_u32(vdupq_n_u32(indices >> (j * 8)), shifts), vdupq_n_u32(0x3));
+            // Byte k of pixel with index n is byte n * 4 + k of the palette.
+            uint32x4_t bytes = vaddq_u32(vmulq_n_u32(index, 0x04040404), vdupq_n_u32(0x03020100));
+            vst1q_u8(pixel_buffer + i * 64 + j * 16, vqtbl1q_u8(p, vreinterpretq_u8_u32(bytes)));
+        }
+    }
+}
+
+static void AddAlphaBC2NEON(const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {
+    const int32_t shift_values[4] = {0, -4, -8, -12};
+    const int32x4_t shifts = vld1q_s32(shift_values);
+    for (int i = 0; i < nu_blocks; i++) {
+        const uint8_t *alpha_bits = bitstring + i * 16;
+        for (int j = 0; j < 4; j++) {
+            uint32_t bits = alpha_bits[j * 2] | (alpha_bits[j * 2 + 1] << 8);
+            uint32x4_t v = vandq_u32(vshlq_u32(vdupq_n_u32(bits), shifts), vdupq_n_u32(0xF));
+            // Expand to eight bits (multiply by 17) in the alpha component.
+            uint32x4_t alpha = vorrq_u32(vshlq_n_u32(v, 28), vshlq_n_u32(v, 24));
+            uint8_t *out = pixel_buffer + i * 64 + j * 16;
+            vst1q_u32((uint32_t *)out, vorrq_u32(vld1q_u32((const uint32_t *)out), alpha));
+        }
+    }
+}
+
+static void AddAlphaBC3NEON(const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {
+    const int32_t shift_values[4] = {0, -3, -6, -9};
+    const int32x4_t shifts = vld1q_s32(shift_values);
+    for (int i = 0; i < nu_blocks; i++) {
+        uint32_t palette[8];
+        CalculateAlphaPaletteBC3(bitstring + i * 16, palette);
+        uint8_t alpha_values[16] = {0};
+        for (int k = 0; k < 8; k++) alpha_values[k] = palette[k] >> 24;
+        uint8x16_t p = vld1q_u8(alpha_values);
+        uint64_t alpha_bits = GetAlphaBitsBC3(bitstring + i * 16);
+        for (int j = 0; j < 4; j++) {
+            uint32_t bits = (uint32_t)(alpha_bits >> (j * 12)) & 0xFFF;
+            uint32x4_t index = vandq_u32(vshlq_u32(vdupq_n_u32(bits), shifts), vdupq_n_u32(0x7));
+            // Look up the alpha byte only, out of range indices give zero.
+            uint32x4_t bytes = vorrq_u32(vshlq_n_u32(index, 24), vdupq_n_u32(0x00FFFFFF));
+            uint32x4_t alpha = vreinterpretq_u32_u8(vqtbl1q_u8(p, vreinterpretq_u8_u32(bytes)));
+            uint8_t *out = pixel_buffer + i * 64 + j * 16;
+            vst1q_u32((uint32_t *)out, vorrq_u32(vld1q_u32((const uint32_t *)out), alpha));
+        }
+    }
+}
+
+DEFINE_DECOMPRESS_BLOCKS_FUNCTIONS(NEON, )
+
+#endif
+
+typedef struct {
+    detexDecompressBlocksFuncType bc1;
+    detexDecompressBlocksFuncType bc1a;
+    detexDecompressBlocksFuncType bc2;
+    detexDecompressBlocksFuncType bc3;
+} DecompressBlocksFunctions;
+
+// Indexed by SIMD level.
+static const DecompressBlocksFunctions decompress_blocks_functions[] = {
+    [DETEX_SIMD_LEVEL_NONE] = {DecompressBlocksBC1Scalar,
+                               DecompressBlocksBC1AScalar,
+                               DecompressBlocksBC2Scalar,
+                               DecompressBlocksBC3Scalar},
+#ifdef DETEX_ARCH_X86
+    [DETEX_SIMD_LEVEL_SSE2] = {DecompressBlocksBC1SSE2,
+                               DecompressBlocksBC1ASSE2,
+                               DecompressBlocksBC2SSE2,
+                               DecompressBlocksBC3SSE2},
+    [DETEX_SIMD_LEVEL_AVX2] = {DecompressBlocksBC1AVX2,
+                               DecompressBlocksBC1AAVX2,
+                               DecompressBlocksBC2AVX2,
+                               DecompressBlocksBC3AVX2},
+#endif
+#ifdef DETEX_ARCH_ARM64
+    [DETEX_SIMD_LEVEL_NEON] = {DecompressBlocksBC1NEON,
+                               DecompressBlocksBC1ANEON,
+                               DecompressBlocksBC2NEON,
+                               DecompressBlocksBC3NEON},
+#endif
+};
+
+// Decompress blocks one by one with the given flags, setting blocks that fail to zero.
+static bool DecompressBlocksWithFlags(DecompressBlockFuncType func,
+                                      const uint8_t *bitstring,
+                                      int block_size,
+                                      int nu_blocks,
+                                      uint32_t flags,
+                                      uint8_t *pixel_buffer) {
+    bool result = true;
+    for (int i = 0; i < nu_blocks; i++)
+        if (!func(bitstring + i * block_size, DETEX_MODE_MASK_ALL, flags, pixel_buffer + i * 64)) {
+            memset(pixel_buffer + i * 64, 0, 64);
+            result = false;
+        }
+    return result;
+}
+
+/* Decompress nu_blocks consecutive BC1 blocks. */
+bool detexDecompressBlocksBC1(const uint8_t *bitstring, int nu_blocks, uint32_t flags, uint8_t *pixel_buffer) {
+    if (flags != 0)
+        return DecompressBlocksWithFlags(detexDecompressBlockBC1, bitstring, 8, nu_blocks, flags, pixel_buffer);
+    decompress_blocks_functions[detexGetSIMDLevel()].bc1(bitstring, nu_blocks, pixel_buffer);
+    return true;
+}
+
+/* Decompress nu_blocks consecutive BC1A blocks. */
+bool detexDecompressBlocksBC1A(const uint8_t *bitstring, int nu_blocks, uint32_t flags, uint8_t *pixel_buffer) {
+    if (flags != 0)
+        return DecompressBlocksWithFlags(detexDecompressBlockBC1A, bitstring, 8, nu_blocks, flags, pixel_buffer);
+    decompress_blocks_functions[detexGetSIMDLevel()].bc1a(bitstring, nu_blocks, pixel_buffer);
+    return true;
+}
+
+/* Decompress nu_blocks consecutive BC2 blocks. */
+bool detexDecompressBlocksBC2(const uint8_t *bitstring, int nu_blocks, uint32_t flags, uint8_t *pixel_buffer) {
+    if (flags != 0)
+        return DecompressBlocksWithFlags(detexDecompressBlockBC2, bitstring, 16, nu_blocks, flags, pixel_buffer);
+    decompress_blocks_functions[detexGetSIMDLevel()].bc2(bitstring, nu_blocks, pixel_buffer);
+    return true;
+}
+
+/* Decompress nu_blocks consecutive BC3 blocks. */
+bool detexDecompressBlocksBC3(const uint8_t *bitstring, int nu_blocks, uint32_t flags, uint8_t *pixel_buffer) {
+    if (flags != 0)
+        return DecompressBlocksWithFlags(detexDecompressBlockBC3, bitstring, 16, nu_blocks, flags, pixel_buffer);
+    decompress_blocks_functions[detexGetSIMDLevel()].bc3(bitstring, nu_blocks, pixel_buffer);
+    return true;
+}
+
+// Fused decoders, which store the pixels of a block straight in another pixel
+// format. The palettes are converted to the target format once per block, so
+// every pixel is a single look-up and store. DecompressBlocksFused is inlined
+// with a constant pixel size and pack function for every target format.
+
+// Convert an RGBA8 pixel to the target format, stored in the low bytes of the result.
+typedef uint64_t (*PackPixelFuncType)(uint32_t pixel);
+
+static inline uint64_t PackPixelBGRA8(uint32_t pixel) {
+    return detexPack32RGBA8(
+        detexPixel32GetB8(pixel), detexPixel32GetG8(pixel), detexPixel32GetR8(pixel), detexPixel32GetA8(pixel));
+}
+
+static inline uint64_t PackPixelRGB8(uint32_t pixel) { return pixel & 0x00FFFFFF; }
+
+// Multiplying by 257 is the same as the v * 65535 / 255 of the conversion functions.
+static inline uint64_t PackPixelRGBA16(uint32_t pixel) {
+    return detexPack64RGBA16(detexPixel32GetR8(pixel) * 257,
+                             detexPixel32GetG8(pixel) * 257,
+                             detexPixel32GetB8(pixel) * 257,
+                             detexPixel32GetA8(pixel) * 257);
+}
+
+static inline uint64_t PackPixelRGBX16(uint32_t pixel) { return PackPixelRGBA16(pixel | 0xFF000000); }
+
+// Store pixel j of a tile. Three byte pixels are stored with four byte writes,
+// the extra byte is overwritten by the next pixel.
+static inline void StorePixel(uint8_t *tile, int j, uint64_t pixel, int pixel_size) {
+    memcpy(tile + j * pixel_size, &pixel, pixel_size == 3 && j < 15 ? 4 : pixel_size);
+}
+
+static inline bool DecompressBlocksFused(const uint8_t *bitstring,
+                                         int nu_blocks,
+                                         uint32_t compressed_format,
+                                         int pixel_size,
+                                         PackPixelFuncType pack,
+                                         uint8_t *pixel_buffer) {
+    int block_size = 16;
+    int type = COLOR_PALETTE_BC2;
+    if (compressed_format == DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_BC1) {
+        block_size = 8;
+        type = COLOR_PALETTE_BC1;
+    } else if (compressed_format == DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_BC1A) {
+        block_size = 8;
+        type = COLOR_PALETTE_BC1A;
+    }
+    // The colors have zero alpha for BC2 and BC3, the alpha values zero color,
+    // so that a pixel is the bitwise or of both.
+    uint64_t alpha[16];
+    if (compressed_format == DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_BC2)
+        for (int k = 0; k < 16; k++) alpha[k] = pack(detexPack32RGBA8(0, 0, 0, k * 17));
+    for (int i = 0; i < nu_blocks; i++) {
+        const uint8_t *block = bitstring + i * block_size;
+        const uint8_t *color_bits = block + block_size - 8;
+        uint32_t palette[8];
+        uint64_t color[4];
+        CalculateColorPalette(Load32(color_bits), type, palette);
+        for (int k = 0; k < 4; k++) color[k] = pack(palette[k]);
+        uint32_t indices = Load32(color_bits + 4);
+        uint8_t *out = pixel_buffer + i * 16 * pixel_size;
+        if (compressed_format == DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_BC2) {
+            uint64_t alpha_bits = Load32(block) | ((uint64_t)Load32(block + 4) << 32);
+            for (int j = 0; j < 16; j++, indices >>= 2, alpha_bits >>= 4)
+                StorePixel(out, j, color[indices & 0x3] | alpha[alpha_bits & 0xF], pixel_size);
+        } else if (compressed_format == DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_BC3) {
+            CalculateAlphaPaletteBC3(block, palette);
+            for (int k = 0; k < 8; k++) alpha[k] = pack(palette[k]);
+            uint64_t alpha_bits = GetAlphaBitsBC3(block);
+            for (int j = 0; j < 16; j++, indices >>= 2, alpha_bits >>= 3)
+                StorePixel(out, j, color[indices & 0x3] | alpha[alpha_bits & 0x7], pixel_size);
+        } else {
+            for (int j = 0; j < 16; j++, indices >>= 2)
+                StorePixel(out, j, color[indices & 0x3], pixel_size);
+        }
+    }
+    return true;
+}
+
+#define DEFINE_FUSED_DECOMPRESS_FUNCTIONS(target, pixel_size)                    \
+    static bool DecompressBlocksBC1To##target(                                   \
+        const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {        \
+        return DecompressBlocksFused(bitstring,                                  \
+                                     nu_blocks,                                  \
+                                     DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_BC1,  \
+                                     pixel_size,                                 \
+                                     PackPixel##target,                          \
+                                     pixel_buffer);                              \
+    }                                                                            \
+    static bool DecompressBlocksBC1ATo##target(                                  \
+        const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {        \
+        return DecompressBlocksFused(bitstring,                                  \
+                                     nu_blocks,                                  \
+                                     DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_BC1A, \
+                                     pixel_size,                                 \
+                                     PackPixel##target,                          \
+                                     pixel_buffer);                              \
+    }                                                                            \
+    static bool DecompressBlocksBC2To##target(                                   \
+        const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {        \
+        return DecompressBlocksFused(bitstring,                                  \
+                                     nu_blocks,                                  \
+                                     DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_BC2,  \
+                                     pixel_size,                                 \
+                                     PackPixel##target,                          \
+                                     pixel_buffer);                              \
+    }                                                                            \
+    static bool DecompressBlocksBC3To##target(                                   \
+        const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {        \
+        return DecompressBlocksFused(bitstring,                                  \
+                                     nu_blocks,                                  \
+                                     DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_BC3,  \
+                                     pixel_size,                                 \
+                                     PackPixel##target,                          \
+                                     pixel_buffer);                              \
+    }
+
+DEFINE_FUSED_DECOMPRESS_FUNCTIONS(BGRA8, 4)
+DEFINE_FUSED_DECOMPRESS_FUNCTIONS(RGB8, 3)
+DEFINE_FUSED_DECOMPRESS_FUNCTIONS(RGBA16, 8)
+DEFINE_FUSED_DECOMPRESS_FUNCTIONS(RGBX16, 8)
+
+typedef struct {
+    uint32_t pixel_format;
+    DecompressBlocksFunctions functions;
+} FusedDecompressBlocksFunctions;
+
+// BGRA8 output, indexed by SIMD level.
+static const DecompressBlocksFunctions decompress_blocks_bgra8_functions[] = {
+    [DETEX_SIMD_LEVEL_NONE] = {DecompressBlocksBC1ToBGRA8,
+                               DecompressBlocksBC1AToBGRA8,
+                               DecompressBlocksBC2ToBGRA8,
+                               DecompressBlocksBC3ToBGRA8},
+#ifdef DETEX_ARCH_X86
+    [DETEX_SIMD_LEVEL_SSE2] = {DecompressBlocksBC1ToBGRA8SSE2,
+                               DecompressBlocksBC1AToBGRA8SSE2,
+                               DecompressBlocksBC2ToBGRA8SSE2,
+                               DecompressBlocksBC3ToBGRA8SSE2},
+    [DETEX_SIMD_LEVEL_AVX2] = {DecompressBlocksBC1ToBGRA8AVX2,
+                               DecompressBlocksBC1AToBGRA8AVX2,
+                               DecompressBlocksBC2ToBGRA8AVX2,
+                               DecompressBlocksBC3ToBGRA8AVX2},
+#endif
+#ifdef DETEX_ARCH_ARM64
+    [DETEX_SIMD_LEVEL_NEON] = {DecompressBlocksBC1ToBGRA8NEON,
+                               DecompressBlocksBC1AToBGRA8NEON,
+                               DecompressBlocksBC2ToBGRA8NEON,
+                               DecompressBlocksBC3ToBGRA8NEON},
+#endif
+};
+
+// Other pixel formats, scalar only.
+static const FusedDecompressBlocksFunctions fused_decompress_blocks_functions[] = {
+    {DETEX_PIXEL_FORMAT_RGB8,
+     {DecompressBlocksBC1ToRGB8, DecompressBlocksBC1AToRGB8, DecompressBlocksBC2ToRGB8, DecompressBlocksBC3ToRGB8}},
+    {DETEX_PIXEL_FORMAT_RGBA16,
+     {DecompressBlocksBC1ToRGBA16,
+      DecompressBlocksBC1AToRGBA16,
+      DecompressBlocksBC2ToRGBA16,
+      DecompressBlocksBC3ToRGBA16}},
+    {DETEX_PIXEL_FORMAT_RGBX16,
+     {DecompressBlocksBC1ToRGBX16,
+      DecompressBlocksBC1AToRGBX16,
+      DecompressBlocksBC2ToRGBX16,
+      DecompressBlocksBC3ToRGBX16}},
+};
+
+#define NU_FUSED_DECOMPRESS_BLOCKS_FUNCTIONS \
+    (sizeof(fused_decompress_blocks_functions) / sizeof(fused_decompress_blocks_functions[0]))
+
+// The ETC decoders (see decompress-etc-simd.c) only decompress into the native
+// pixel format.
+
+static bool DecompressBlocksETC1(const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {
+    return detexDecompressBlocksETC1(bitstring, nu_blocks, 0, pixel_buffer);
+}
+
+static bool DecompressBlocksETC2(const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {
+    return detexDecompressBlocksETC2(bitstring, nu_blocks, 0, pixel_buffer);
+}
+
+static bool DecompressBlocksETC2_PUNCHTHROUGH(const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {
+    return detexDecompressBlocksETC2_PUNCHTHROUGH(bitstring, nu_blocks, 0, pixel_buffer);
+}
+
+static bool DecompressBlocksETC2_EAC(const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {
+    return detexDecompressBlocksETC2_EAC(bitstring, nu_blocks, 0, pixel_buffer);
+}
+
+// The single channel decoders (see decompress-rgtc-simd.c) also only decompress
+// into the native pixel format.
+
+static bool DecompressBlocksRGTC1(const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {
+    return detexDecompressBlocksRGTC1(bitstring, nu_blocks, 0, pixel_buffer);
+}
+
+static bool DecompressBlocksRGTC2(const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {
+    return detexDecompressBlocksRGTC2(bitstring, nu_blocks, 0, pixel_buffer);
+}
+
+static bool DecompressBlocksSIGNED_RGTC1(const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {
+    return detexDecompressBlocksSIGNED_RGTC1(bitstring, nu_blocks, 0, pixel_buffer);
+}
+
+static bool DecompressBlocksSIGNED_RGTC2(const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {
+    return detexDecompressBlocksSIGNED_RGTC2(bitstring, nu_blocks, 0, pixel_buffer);
+}
+
+static bool DecompressBlocksEAC_R11(const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {
+    return detexDecompressBlocksEAC_R11(bitstring, nu_blocks, 0, pixel_buffer);
+}
+
+static bool DecompressBlocksEAC_RG11(const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {
+    return detexDecompressBlocksEAC_RG11(bitstring, nu_blocks, 0, pixel_buffer);
+}
+
+static bool DecompressBlocksEAC_SIGNED_R11(const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {
+    return detexDecompressBlocksEAC_SIGNED_R11(bitstring, nu_blocks, 0, pixel_buffer);
+}
+
+static bool DecompressBlocksEAC_SIGNED_RG11(const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {
+    return detexDecompressBlocksEAC_SIGNED_RG11(bitstring, nu_blocks, 0, pixel_buffer);
+}
+
+// The results of all of these are identical to decompressing in the native
+// pixel format followed by detexConvertPixels.
+
+/*
+ * Return a function that decompresses consecutive blocks of the given texture
+ * format straight into tiles of the given pixel format, or NULL when there is
+ * none for the combination.
+ */
+detexDecompressBlocksFuncType detexGetDecompressBlocksFunction(uint32_t texture_format, uint32_t pixel_format) {
+    const DecompressBlocksFunctions *functions = NULL;
+    uint32_t block_pixel_format = detexGetPixelFormat(texture_format);
+    if (pixel_format == block_pixel_format) {
+        switch (detexGetCompressedFormat(texture_format)) {
+            case DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_RGTC1:
+                return DecompressBlocksRGTC1;
+            case DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_RGTC2:
+                return DecompressBlocksRGTC2;
+            case DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_SIGNED_RGTC1:
+                return DecompressBlocksSIGNED_RGTC1;
+            case DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_SIGNED_RGTC2:
+                return DecompressBlocksSIGNED_RGTC2;
+            case DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_EAC_R11:
+                return DecompressBlocksEAC_R11;
+            case DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_EAC_RG11:
+                return DecompressBlocksEAC_RG11;
+            case DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_EAC_SIGNED_R11:
+                return DecompressBlocksEAC_SIGNED_R11;
+            case DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_EAC_SIGNED_RG11:
+                return DecompressBlocksEAC_SIGNED_RG11;
+        }
+    }
+    // RGBA8 and RGBX8 have the same layout, the alpha byte is kept as is.
+    if ((pixel_format == DETEX_PIXEL_FORMAT_RGBA8 || pixel_format == DETEX_PIXEL_FORMAT_RGBX8) &&
+        (block_pixel_format == DETEX_PIXEL_FORMAT_RGBA8 || block_pixel_format == DETEX_PIXEL_FORMAT_RGBX8)) {
+        switch (detexGetCompressedFormat(texture_format)) {
+            case DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_ETC1:
+                return DecompressBlocksETC1;
+            case DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_ETC2:
+                return DecompressBlocksETC2;
+            case DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_ETC2_PUNCHTHROUGH:
+                return DecompressBlocksETC2_PUNCHTHROUGH;
+            case DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_ETC2_EAC:
+                return DecompressBlocksETC2_EAC;
+        }
+        functions = &decompress_blocks_functions[detexGetSIMDLevel()];
+    } else if (pixel_format == DETEX_PIXEL_FORMAT_BGRA8 || pixel_format == DETEX_PIXEL_FORMAT_BGRX8) {
+        // Red and blue are swapped as in the conversion from RGBA8, the alpha byte is kept as is.
+        functions = &decompress_blocks_bgra8_functions[detexGetSIMDLevel()];
+    } else {
+        for (int i = 0; i < NU_FUSED_DECOMPRESS_BLOCKS_FUNCTIONS; i++)
+            if (fused_decompress_blocks_functions[i].pixel_format == pixel_format)
+                functions = &fused_decompress_blocks_functions[i].functions;
+    }
+    if (functions == NULL) return NULL;
+    switch (detexGetCompressedFormat(texture_format)) {
+        case DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_BC1:
+            return functions->bc1;
+        case DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_BC1A:
+            return functions->bc1a;
+        case DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_BC2:
+            return functions->bc2;
+        case DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_BC3:
+            return functions->bc3;
+    }
+    return NULL;
+}
@@ -22,9 +22,9 @@ static const int8_t map_mode_table[32] = {0,  1,  2, 10, -1, -1, 3, 11, -1, -1,
                                           -1, -1, 6, -1, -1, -1, 7, -1, -1, -1, 8, -1, -1, -1, 9, -1};
 
 static int ExtractMode(detexBlock128 *block) {
-    uint32_t mode = detexBlock128ExtractBits(block, 2);
+    uint32_t mode = detexBlock128ReadBits(block, 2);
     if (mode < 2) return mode;
-    return map_mode_table[mode | (detexBlock128ExtractBits(block, 3) << 2)];
+    return map_mode_table[mode | (detexBlock128ReadBits(block, 3) << 2)];
 }
 
 static int GetPartitionIndex(int nu_subsets, int partition_set_id, int i) {
@@ -114,27 +114,26 @@ static bool DecompressBlockBPTCFloatShared(const uint8_t *DETEX_RESTRICT bitstri
         case 0:
             // m[1:0],g2[4],b2[4],b3[4],r0[9:0],g0[9:0],b0[9:0],r1[4:0],g3[4],g2[3:0],
             // g1[4:0],b3[0],g3[3:0],b1[4:0],b3[1],b2[3:0],r2[4:0],b3[2],r3[4:0],b3[3]
-            g[2] = detexGetBits64(data0, 2, 2) << 4;
-            b[2] = detexGetBits64(data0, 3, 3) << 4;
-            b[3] = detexGetBits64(data0, 4, 4) << 4;
-            r[0] = detexGetBits64(data0, 5, 14);
-            g[0] = detexGetBits64(data0, 15, 24);
-            b[0] = detexGetBits64(data0, 25, 34);
-            r[1] = detexGetBits64(data0, 35, 39);
-            g[3] = detexGetBits64(data0, 40, 40) << 4;
-            g[2] |= detexGetBits64(data0, 41, 44);
-            g[1] = detexGetBits64(data0, 45, 49);
-            b[3] |= detexGetBits64(data0, 50, 50);
-            g[3] |= detexGetBits64(data0, 51, 54);
-            b[1] = detexGetBits64(data0, 55, 59);
-            b[3] |= detexGetBits64(data0, 60, 60) << 1;
-            b[2] |= detexGetBits64(data0, 61, 63);
-            b[2] |= detexGetBits64(data1, 0, 0) << 3;
-            r[2] = detexGetBits64(data1, 1, 5);
-            b[3] |= detexGetBits64(data1, 6, 6) << 2;
-            r[3] = detexGetBits64(data1, 7, 11);
-            b[3] |= detexGetBits64(data1, 12, 12) << 3;
-            partition_set_id = detexGetBits64(data1, 13, 17);
+            g[2] = detexBlock128GetBits(&block, 2, 1) << 4;
+            b[2] = detexBlock128GetBits(&block, 3, 1) << 4;
+            b[3] = detexBlock128GetBits(&block, 4, 1) << 4;
+            r[0] = detexBlock128GetBits(&block, 5, 10);
+            g[0] = detexBlock128GetBits(&block, 15, 10);
+            b[0] = detexBlock128GetBits(&block, 25, 10);
+            r[1] = detexBlock128GetBits(&block, 35, 5);
+            g[3] = detexBlock128GetBits(&block, 40, 1) << 4;
+            g[2] |= detexBlock128GetBits(&block, 41, 4);
+            g[1] = detexBlock128GetBits(&block, 45, 5);
+            b[3] |= detexBlock128GetBits(&block, 50, 1);
+            g[3] |= detexBlock128GetBits(&block, 51, 4);
+            b[1] = detexBlock128GetBits(&block, 55, 5);
+            b[3] |= detexBlock128GetBits(&block, 60, 1) << 1;
+            b[2] |= detexBlock128GetBits(&block, 61, 4);
+            r[2] = detexBlock128GetBits(&block, 65, 5);
+            b[3] |= detexBlock128GetBits(&block, 70, 1) << 2;
+            r[3] = detexBlock128GetBits(&block, 71, 5);
+            b[3] |= detexBlock128GetBits(&block, 76, 1) << 3;
+            partition_set_id = detexBlock128GetBits(&block, 77, 5);
             block.index = 64 + 18;
             delta_bits_r = delta_bits_g = delta_bits_b = 5;
             break;
@@ -142,57 +141,54 @@ static bool DecompressBlockBPTCFloatShared(const uint8_t *DETEX_RESTRICT bitstri
             // m[1:0],g2[5],g3[4],g3[5],r0[6:0],b3[0],b3[1],b2[4],g0[6:0],b2[5],b3[2],
             // g2[4],b0[6:0],b3[3],b3[5],b3[4],r1[5:0],g2[3:0],g1[5:0],g3[3:0],b1[5:0],
             // b2[3:0],r2[5:0],r3[5:0]
-            g[2] = detexGetBits64(data0, 2, 2) << 5;
-            g[3] = detexGetBits64(data0, 3, 3) << 4;
-            g[3] |= detexGetBits64(data0, 4, 4) << 5;
-            r[0] = detexGetBits64(data0, 5, 11);
-            b[3] = detexGetBits64(data0, 12, 12);
-            b[3] |= detexGetBits64(data0, 13, 13) << 1;
-            b[2] = detexGetBits64(data0, 14, 14) << 4;
-            g[0] = detexGetBits64(data0, 15, 21);
-            b[2] |= detexGetBits64(data0, 22, 22) << 5;
-            b[3] |= detexGetBits64(data0, 23, 23) << 2;
-            g[2] |= detexGetBits64(data0, 24, 24) << 4;
-            b[0] = detexGetBits64(data0, 25, 31);
-            b[3] |= detexGetBits64(data0, 32, 32) << 3;
-            b[3] |= detexGetBits64(data0, 33, 33) << 5;
-            b[3] |= detexGetBits64(data0, 34, 34) << 4;
-            r[1] = detexGetBits64(data0, 35, 40);
-            g[2] |= detexGetBits64(data0, 41, 44);
-            g[1] = detexGetBits64(data0, 45, 50);
-            g[3] |= detexGetBits64(data0, 51, 54);
-            b[1] = detexGetBits64(data0, 55, 60);
-            b[2] |= detexGetBits64(data0, 61, 63);
-            b[2] |= detexGetBits64(data1, 0, 0) << 3;
-            r[2] = detexGetBits64(data1, 1, 6);
-            r[3] = detexGetBits64(data1, 7, 12);
-            partition_set_id = detexGetBits64(data1, 13, 17);
+            g[2] = detexBlock128GetBits(&block, 2, 1) << 5;
+            g[3] = detexBlock128GetBits(&block, 3, 1) << 4;
+            g[3] |= detexBlock128GetBits(&block, 4, 1) << 5;
+            r[0] = detexBlock128GetBits(&block, 5, 7);
+            b[3] = detexBlock128GetBits(&block, 12, 2);
+            b[2] = detexBlock128GetBits(&block, 14, 1) << 4;
+            g[0] = detexBlock128GetBits(&block, 15, 7);
+            b[2] |= detexBlock128GetBits(&block, 22, 1) << 5;
+            b[3] |= detexBlock128GetBits(&block, 23, 1) << 2;
+            g[2] |= detexBlock128GetBits(&block, 24, 1) << 4;
+            b[0] = detexBlock128GetBits(&block, 25, 7);
+            b[3] |= detexBlock128GetBits(&block, 32, 1) << 3;
+            b[3] |= detexBlock128GetBits(&block, 33, 1) << 5;
+            b[3] |= detexBlock128GetBits(&block, 34, 1) << 4;
+            r[1] = detexBlock128GetBits(&block, 35, 6);
+            g[2] |= detexBlock128GetBits(&block, 41, 4);
+            g[1] = detexBlock128GetBits(&block, 45, 6);
+            g[3] |= detexBlock128GetBits(&block, 51, 4);
+            b[1] = detexBlock128GetBits(&block, 55, 6);
+            b[2] |= detexBlock128GetBits(&block, 61, 4);
+            r[2] = detexBlock128GetBits(&block, 65, 6);
+            r[3] = detexBlock128GetBits(&block, 71, 6);
+            partition_set_id = detexBlock128GetBits(&block, 77, 5);
             block.index = 64 + 18;
             delta_bits_r = delta_bits_g = delta_bits_b = 6;
             break;
         case 2:
             // m[4:0],r0[9:0],g0[9:0],b0[9:0],r1[4:0],r0[10],g2[3:0],g1[3:0],g0[10],
             // b3[0],g3[3:0],b1[3:0],b0[10],b3[1],b2[3:0],r2[4:0],b3[2],r3[4:0],b3[3]
-            r[0] = detexGetBits64(data0, 5, 14);
-            g[0] = detexGetBits64(data0, 15, 24);
-            b[0] = detexGetBits64(data0, 25, 34);
-            r[1] = detexGetBits64(data0, 35, 39);
-            r[0] |= detexGetBits64(data0, 40, 40) << 10;
-            g[2] = detexGetBits64(data0, 41, 44);
-            g[1] = detexGetBits64(data0, 45, 48);
-            g[0] |= detexGetBits64(data0, 49, 49) << 10;
-            b[3] = detexGetBits64(data0, 50, 50);
-            g[3] = detexGetBits64(data0, 51, 54);
-            b[1] = detexGetBits64(data0, 55, 58);
-            b[0] |= detexGetBits64(data0, 59, 59) << 10;
-            b[3] |= detexGetBits64(data0, 60, 60) << 1;
-            b[2] = detexGetBits64(data0, 61, 63);
-            b[2] |= detexGetBits64(data1, 0, 0) << 3;
-            r[2] = detexGetBits64(data1, 1, 5);
-            b[3] |= detexGetBits64(data1, 6, 6) << 2;
-            r[3] = detexGetBits64(data1, 7, 11);
-            b[3] |= detexGetBits64(data1, 12, 12) << 3;
-            partition_set_id = detexGetBits64(data1, 13, 17);
+            r[0] = detexBlock128GetBits(&block, 5, 10);
+            g[0] = detexBlock128GetBits(&block, 15, 10);
+            b[0] = detexBlock128GetBits(&block, 25, 10);
+            r[1] = detexBlock128GetBits(&block, 35, 5);
+            r[0] |= detexBlock128GetBits(&block, 40, 1) << 10;
+            g[2] = detexBlock128GetBits(&block, 41, 4);
+            g[1] = detexBlock128GetBits(&block, 45, 4);
+            g[0] |= detexBlock128GetBits(&block, 49, 1) << 10;
+            b[3] = detexBlock128GetBits(&block, 50, 1);
+            g[3] = detexBlock128GetBits(&block, 51, 4);
+            b[1] = detexBlock128GetBits(&block, 55, 4);
+            b[0] |= detexBlock128GetBits(&block, 59, 1) << 10;
+            b[3] |= detexBlock128GetBits(&block, 60, 1) << 1;
+            b[2] = detexBlock128GetBits(&block, 61, 4);
+            r[2] = detexBlock128GetBits(&block, 65, 5);
+            b[3] |= detexBlock128GetBits(&block, 70, 1) << 2;
+            r[3] = detexBlock128GetBits(&block, 71, 5);
+            b[3] |= detexBlock128GetBits(&block, 76, 1) << 3;
+            partition_set_id = detexBlock128GetBits(&block, 77, 5);
             block.index = 64 + 18;
             delta_bits_r = 5;
             delta_bits_g = delta_bits_b = 4;
@@ -201,28 +197,27 @@ static bool DecompressBlockBPTCFloatShared(const uint8_t *DETEX_RESTRICT bitstri
             // m[4:0],r0[9:0],g0[9:0],b0[9:0],r1[3:0],r0[10],g3[4],g2[3:0],g1[4:0],
             // g0[10],g3[3:0],b1[3:0],b0[10],b3[1],b2[3:0],r2[3:0],b3[0],b3[2],r3[3:0],
             // g2[4],b3[3]
-            r[0] = detexGetBits64(data0, 5, 14);
-            g[0] = detexGetBits64(data0, 15, 24);
-            b[0] = detexGetBits64(data0, 25, 34);
-            r[1] = detexGetBits64(data0, 35, 38);
-            r[0] |= detexGetBits64(data0, 39, 39) << 10;
-            g[3] = detexGetBits64(data0, 40, 40) << 4;
-            g[2] = detexGetBits64(data0, 41, 44);
-            g[1] = detexGetBits64(data0, 45, 49);
-            g[0] |= detexGetBits64(data0, 50, 50) << 10;
-            g[3] |= detexGetBits64(data0, 51, 54);
-            b[1] = detexGetBits64(data0, 55, 58);
-            b[0] |= detexGetBits64(data0, 59, 59) << 10;
-            b[3] = detexGetBits64(data0, 60, 60) << 1;
-            b[2] = detexGetBits64(data0, 61, 63);
-            b[2] |= detexGetBits64(data1, 0, 0) << 3;
-            r[2] = detexGetBits64(data1, 1, 4);
-            b[3] |= detexGetBits64(data1, 5, 5);
-            b[3] |= detexGetBits64(data1, 6, 6) << 2;
-            r[3] = detexGetBits64(data1, 7, 10);
-            g[2] |= detexGetBits64(data1, 11, 11) << 4;
-            b[3] |= detexGetBits64(data1, 12, 12) << 3;
-            partition_set_id = detexGetBits64(data1, 13, 17);
+            r[0] = detexBlock128GetBits(&block, 5, 10);
+            g[0] = detexBlock128GetBits(&block, 15, 10);
+            b[0] = detexBlock128GetBits(&block, 25, 10);
+            r[1] = detexBlock128GetBits(&block, 35, 4);
+            r[0] |= detexBlock128GetBits(&block, 39, 1) << 10;
+            g[3] = detexBlock128GetBits(&block, 40, 1) << 4;
+            g[2] = detexBlock128GetBits(&block, 41, 4);
+            g[1] = detexBlock128GetBits(&block, 45, 5);
+            g[0] |= detexBlock128GetBits(&block, 50, 1) << 10;
+            g[3] |= detexBlock128GetBits(&block, 51, 4);
+            b[1] = detexBlock128GetBits(&block, 55, 4);
+            b[0] |= detexBlock128GetBits(&block, 59, 1) << 10;
+            b[3] = detexBlock128GetBits(&block, 60, 1) << 1;
+            b[2] = detexBlock128GetBits(&block, 61, 4);
+            r[2] = detexBlock128GetBits(&block, 65, 4);
+            b[3] |= detexBlock128GetBits(&block, 69, 1);
+            b[3] |= detexBlock128GetBits(&block, 70, 1) << 2;
+            r[3] = detexBlock128GetBits(&block, 71, 4);
+            g[2] |= detexBlock128GetBits(&block, 75, 1) << 4;
+            b[3] |= detexBlock128GetBits(&block, 76, 1) << 3;
+            partition_set_id = detexBlock128GetBits(&block, 77, 5);
             block.index = 64 + 18;
             delta_bits_r = delta_bits_b = 4;
             delta_bits_g = 5;
@@ -231,28 +226,27 @@ static bool DecompressBlockBPTCFloatShared(const uint8_t *DETEX_RESTRICT bitstri
             // m[4:0],r0[9:0],g0[9:0],b0[9:0],r1[3:0],r0[10],b2[4],g2[3:0],g1[3:0],
             // g0[10],b3[0],g3[3:0],b1[4:0],b0[10],b2[3:0],r2[3:0],b3[1],b3[2],r3[3:0],
             // b3[4],b3[3]
-            r[0] = detexGetBits64(data0, 5, 14);
-            g[0] = detexGetBits64(data0, 15, 24);
-            b[0] = detexGetBits64(data0, 25, 34);
-            r[1] = detexGetBits64(data0, 35, 38);
-            r[0] |= detexGetBits64(data0, 39, 39) << 10;
-            b[2] = detexGetBits64(data0, 40, 40) << 4;
-            g[2] = detexGetBits64(data0, 41, 44);
-            g[1] = detexGetBits64(data0, 45, 48);
-            g[0] |= detexGetBits64(data0, 49, 49) << 10;
-            b[3] = detexGetBits64(data0, 50, 50);
-            g[3] = detexGetBits64(data0, 51, 54);
-            b[1] = detexGetBits64(data0, 55, 59);
-            b[0] |= detexGetBits64(data0, 60, 60) << 10;
-            b[2] |= detexGetBits64(data0, 61, 63);
-            b[2] |= detexGetBits64(data1, 0, 0) << 3;
-            r[2] = detexGetBits64(data1, 1, 4);
-            b[3] |= detexGetBits64(data1, 5, 5) << 1;
-            b[3] |= detexGetBits64(data1, 6, 6) << 2;
-            r[3] = detexGetBits64(data1, 7, 10);
-            b[3] |= detexGetBits64(data1, 11, 11) << 4;
-            b[3] |= detexGetBits64(data1, 12, 12) << 3;
-            partition_set_id = detexGetBits64(data1, 13, 17);
+            r[0] = detexBlock128GetBits(&block, 5, 10);
+            g[0] = detexBlock128GetBits(&block, 15, 10);
+            b[0] = detexBlock128GetBits(&block, 25, 10);
+            r[1] = detexBlock128GetBits(&block, 35, 4);
+            r[0] |= detexBlock128GetBits(&block, 39, 1) << 10;
+            b[2] = detexBlock128GetBits(&block, 40, 1) << 4;
+            g[2] = detexBlock128GetBits(&block, 41, 4);
+            g[1] = detexBlock128GetBits(&block, 45, 4);
+            g[0] |= detexBlock128GetBits(&block, 49, 1) << 10;
+            b[3] = detexBlock128GetBits(&block, 50, 1);
+            g[3] = detexBlock128GetBits(&block, 51, 4);
+            b[1] = detexBlock128GetBits(&block, 55, 5);
+            b[0] |= detexBlock128GetBits(&block, 60, 1) << 10;
+            b[2] |= detexBlock128GetBits(&block, 61, 4);
+            r[2] = detexBlock128GetBits(&block, 65, 4);
+            b[3] |= detexBlock128GetBits(&block, 69, 1) << 1;
+            b[3] |= detexBlock128GetBits(&block, 70, 1) << 2;
+            r[3] = detexBlock128GetBits(&block, 71, 4);
+            b[3] |= detexBlock128GetBits(&block, 75, 1) << 4;
+            b[3] |= detexBlock128GetBits(&block, 76, 1) << 3;
+            partition_set_id = detexBlock128GetBits(&block, 77, 5);
             block.index = 64 + 18;
             delta_bits_r = delta_bits_g = 4;
             delta_bits_b = 5;
@@ -260,54 +254,52 @@ static bool DecompressBlockBPTCFloatShared(const uint8_t *DETEX_RESTRICT bitstri
         case 5:  // Original mode 14
             // m[4:0],r0[8:0],b2[4],g0[8:0],g2[4],b0[8:0],b3[4],r1[4:0],g3[4],g2[3:0],
             // g1[4:0],b3[0],g3[3:0],b1[4:0],b3[1],b2[3:0],r2[4:0],b3[2],r3[4:0],b3[3]
-            r[0] = detexGetBits64(data0, 5, 13);
-            b[2] = detexGetBits64(data0, 14, 14) << 4;
-            g[0] = detexGetBits64(data0, 15, 23);
-            g[2] = detexGetBits64(data0, 24, 24) << 4;
-            b[0] = detexGetBits64(data0, 25, 33);
-            b[3] = detexGetBits64(data0, 34, 34) << 4;
-            r[1] = detexGetBits64(data0, 35, 39);
-            g[3] = detexGetBits64(data0, 40, 40) << 4;
-            g[2] |= detexGetBits64(data0, 41, 44);
-            g[1] = detexGetBits64(data0, 45, 49);
-            b[3] |= detexGetBits64(data0, 50, 50);
-            g[3] |= detexGetBits64(data0, 51, 54);
-            b[1] = detexGetBits64(data0, 55, 59);
-            b[3] |= detexGetBits64(data0, 60, 60) << 1;
-            b[2] |= detexGetBits64(data0, 61, 63);
-            b[2] |= detexGetBits64(data1, 0, 0) << 3;
-            r[2] = detexGetBits64(data1, 1, 5);
-            b[3] |= detexGetBits64(data1, 6, 6) << 2;
-            r[3] = detexGetBits64(data1, 7, 11);
-            b[3] |= detexGetBits64(data1, 12, 12) << 3;
-            partition_set_id = detexGetBits64(data1, 13, 17);
+            r[0] = detexBlock128GetBits(&block, 5, 9);
+            b[2] = detexBlock128GetBits(&block, 14, 1) << 4;
+            g[0] = detexBlock128GetBits(&block, 15, 9);
+            g[2] = detexBlock128GetBits(&block, 24, 1) << 4;
+            b[0] = detexBlock128GetBits(&block, 25, 9);
+            b[3] = detexBlock128GetBits(&block, 34, 1) << 4;
+            r[1] = detexBlock128GetBits(&block, 35, 5);
+            g[3] = detexBlock128GetBits(&block, 40, 1) << 4;
+            g[2] |= detexBlock128GetBits(&block, 41, 4);
+            g[1] = detexBlock128GetBits(&block, 45, 5);
+            b[3] |= detexBlock128GetBits(&block, 50, 1);
+            g[3] |= detexBlock128GetBits(&block, 51, 4);
+            b[1] = detexBlock128GetBits(&block, 55, 5);
+            b[3] |= detexBlock128GetBits(&block, 60, 1) << 1;
+            b[2] |= detexBlock128GetBits(&block, 61, 4);
+            r[2] = detexBlock128GetBits(&block, 65, 5);
+            b[3] |= detexBlock128GetBits(&block, 70, 1) << 2;
+            r[3] = detexBlock128GetBits(&block, 71, 5);
+            b[3] |= detexBlock128GetBits(&block, 76, 1) << 3;
+            partition_set_id = detexBlock128GetBits(&block, 77, 5);
             block.index = 64 + 18;
             delta_bits_r = delta_bits_g = delta_bits_b = 5;
             break;
         case 6:  // Original mode 18
             // m[4:0],r0[7:0],g3[4],b2[4],g0[7:0],b3[2],g2[4],b0[7:0],b3[3],b3[4],
             // r1[5:0],g2[3:0],g1[4:0],b3[0],g3[3:0],b1[4:0],b3[1],b2[3:0],r2[5:0],r3[5:0]
-            r[0] = detexGetBits64(data0, 5, 12);
-            g[3] = detexGetBits64(data0, 13, 13) << 4;
-            b[2] = detexGetBits64(data0, 14, 14) << 4;
-            g[0] = detexGetBits64(data0, 15, 22);
-            b[3] = detexGetBits64(data0, 23, 23) << 2;
-            g[2] = detexGetBits64(data0, 24, 24) << 4;
-            b[0] = detexGetBits64(data0, 25, 32);
-            b[3] |= detexGetBits64(data0, 33, 33) << 3;
-            b[3] |= detexGetBits64(data0, 34, 34) << 4;
-            r[1] = detexGetBits64(data0, 35, 40);
-            g[2] |= detexGetBits64(data0, 41, 44);
-            g[1] = detexGetBits64(data0, 45, 49);
-            b[3] |= detexGetBits64(data0, 50, 50);
-            g[3] |= detexGetBits64(data0, 51, 54);
-            b[1] = detexGetBits64(data0, 55, 59);
-            b[3] |= detexGetBits64(data0, 60, 60) << 1;
-            b[2] |= detexGetBits64(data0, 61, 63);
-            b[2] |= detexGetBits64(data1, 0, 0) << 3;
-            r[2] = detexGetBits64(data1, 1, 6);
-            r[3] = detexGetBits64(data1, 7, 12);
-            partition_set_id = detexGetBits64(data1, 13, 17);
+            r[0] = detexBlock128GetBits(&block, 5, 8);
+            g[3] = detexBlock128GetBits(&block, 13, 1) << 4;
+            b[2] = detexBlock128GetBits(&block, 14, 1) << 4;
+            g[0] = detexBlock128GetBits(&block, 15, 8);
+            b[3] = detexBlock128GetBits(&block, 23, 1) << 2;
+            g[2] = detexBlock128GetBits(&block, 24, 1) << 4;
+            b[0] = detexBlock128GetBits(&block, 25, 8);
+            b[3] |= detexBlock128GetBits(&block, 33, 1) << 3;
+            b[3] |= detexBlock128GetBits(&block, 34, 1) << 4;
+            r[1] = detexBlock128GetBits(&block, 35, 6);
+            g[2] |= detexBlock128GetBits(&block, 41, 4);
+            g[1] = detexBlock128GetBits(&block, 45, 5);
+            b[3] |= detexBlock128GetBits(&block, 50, 1);
+            g[3] |= detexBlock128GetBits(&block, 51, 4);
+            b[1] = detexBlock128GetBits(&block, 55, 5);
+            b[3] |= detexBlock128GetBits(&block, 60, 1) << 1;
+            b[2] |= detexBlock128GetBits(&block, 61, 4);
+            r[2] = detexBlock128GetBits(&block, 65, 6);
+            r[3] = detexBlock128GetBits(&block, 71, 6);
+            partition_set_id = detexBlock128GetBits(&block, 77, 5);
             block.index = 64 + 18;
             delta_bits_r = 6;
             delta_bits_g = delta_bits_b = 5;
@@ -316,29 +308,28 @@ static bool DecompressBlockBPTCFloatShared(const uint8_t *DETEX_RESTRICT bitstri
             // m[4:0],r0[7:0],b3[0],b2[4],g0[7:0],g2[5],g2[4],b0[7:0],g3[5],b3[4],
             // r1[4:0],g3[4],g2[3:0],g1[5:0],g3[3:0],b1[4:0],b3[1],b2[3:0],r2[4:0],
             // b3[2],r3[4:0],b3[3]
-            r[0] = detexGetBits64(data0, 5, 12);
-            b[3] = detexGetBits64(data0, 13, 13);
-            b[2] = detexGetBits64(data0, 14, 14) << 4;
-            g[0] = detexGetBits64(data0, 15, 22);
-            g[2] = detexGetBits64(data0, 23, 23) << 5;
-            g[2] |= detexGetBits64(data0, 24, 24) << 4;
-            b[0] = detexGetBits64(data0, 25, 32);
-            g[3] = detexGetBits64(data0, 33, 33) << 5;
-            b[3] |= detexGetBits64(data0, 34, 34) << 4;
-            r[1] = detexGetBits64(data0, 35, 39);
-            g[3] |= detexGetBits64(data0, 40, 40) << 4;
-            g[2] |= detexGetBits64(data0, 41, 44);
-            g[1] = detexGetBits64(data0, 45, 50);
-            g[3] |= detexGetBits64(data0, 51, 54);
-            b[1] = detexGetBits64(data0, 55, 59);
-            b[3] |= detexGetBits64(data0, 60, 60) << 1;
-            b[2] |= detexGetBits64(data0, 61, 63);
-            b[2] |= detexGetBits64(data1, 0, 0) << 3;
-            r[2] = detexGetBits64(data1, 1, 5);
-            b[3] |= detexGetBits64(data1, 6, 6) << 2;
-            r[3] = detexGetBits64(data1, 7, 11);
-            b[3] |= detexGetBits64(data1, 12, 12) << 3;
-            partition_set_id = detexGetBits64(data1, 13, 17);
+            r[0] = detexBlock128GetBits(&block, 5, 8);
+            b[3] = detexBlock128GetBits(&block, 13, 1);
+            b[2] = detexBlock128GetBits(&block, 14, 1) << 4;
+            g[0] = detexBlock128GetBits(&block, 15, 8);
+            g[2] = detexBlock128GetBits(&block, 23, 1) << 5;
+            g[2] |= detexBlock128GetBits(&block, 24, 1) << 4;
+            b[0] = detexBlock128GetBits(&block, 25, 8);
+            g[3] = detexBlock128GetBits(&block, 33, 1) << 5;
+            b[3] |= detexBlock128GetBits(&block, 34, 1) << 4;
+            r[1] = detexBlock128GetBits(&block, 35, 5);
+            g[3] |= detexBlock128GetBits(&block, 40, 1) << 4;
+            g[2] |= detexBlock128GetBits(&block, 41, 4);
+            g[1] = detexBlock128GetBits(&block, 45, 6);
+            g[3] |= detexBlock128GetBits(&block, 51, 4);
+            b[1] = detexBlock128GetBits(&block, 55, 5);
+            b[3] |= detexBlock128GetBits(&block, 60, 1) << 1;
+            b[2] |= detexBlock128GetBits(&block, 61, 4);
+            r[2] = detexBlock128GetBits(&block, 65, 5);
+            b[3] |= detexBlock128GetBits(&block, 70, 1) << 2;
+            r[3] = detexBlock128GetBits(&block, 71, 5);
+            b[3] |= detexBlock128GetBits(&block, 76, 1) << 3;
+            partition_set_id = detexBlock128GetBits(&block, 77, 5);
             block.index = 64 + 18;
             delta_bits_r = delta_bits_b = 5;
             delta_bits_g = 6;
@@ -347,29 +338,28 @@ static bool DecompressBlockBPTCFloatShared(const uint8_t *DETEX_RESTRICT bitstri
             // m[4:0],r0[7:0],b3[1],b2[4],g0[7:0],b2[5],g2[4],b0[7:0],b3[5],b3[4],
             // r1[4:0],g3[4],g2[3:0],g1[4:0],b3[0],g3[3:0],b1[5:0],b2[3:0],r2[4:0],
             // b3[2],r3[4:0],b3[3]
-            r[0] = detexGetBits64(data0, 5, 12);
-            b[3] = detexGetBits64(data0, 13, 13) << 1;
-            b[2] = detexGetBits64(data0, 14, 14) << 4;
-            g[0] = detexGetBits64(data0, 15, 22);
-            b[2] |= detexGetBits64(data0, 23, 23) << 5;
-            g[2] = detexGetBits64(data0, 24, 24) << 4;
-            b[0] = detexGetBits64(data0, 25, 32);
-            b[3] |= detexGetBits64(data0, 33, 33) << 5;
-            b[3] |= detexGetBits64(data0, 34, 34) << 4;
-            r[1] = detexGetBits64(data0, 35, 39);
-            g[3] = detexGetBits64(data0, 40, 40) << 4;
-            g[2] |= detexGetBits64(data0, 41, 44);
-            g[1] = detexGetBits64(data0, 45, 49);
-            b[3] |= detexGetBits64(data0, 50, 50);
-            g[3] |= detexGetBits64(data0, 51, 54);
-            b[1] = detexGetBits64(data0, 55, 60);
-            b[2] |= detexGetBits64(data0, 61, 63);
-            b[2] |= detexGetBits64(data1, 0, 0) << 3;
-            r[2] = detexGetBits64(data1, 1, 5);
-            b[3] |= detexGetBits64(data1, 6, 6) << 2;
-            r[3] = detexGetBits64(data1, 7, 11);
-            b[3] |= detexGetBits64(data1, 12, 12) << 3;
-            partition_set_id = detexGetBits64(data1, 13, 17);
+            r[0] = detexBlock128GetBits(&block, 5, 8);
+            b[3] = detexBlock128GetBits(&block, 13, 1) << 1;
+            b[2] = detexBlock128GetBits(&block, 14, 1) << 4;
+            g[0] = detexBlock128GetBits(&block, 15, 8);
+            b[2] |= detexBlock128GetBits(&block, 23, 1) << 5;
+            g[2] = detexBlock128GetBits(&block, 24, 1) << 4;
+            b[0] = detexBlock128GetBits(&block, 25, 8);
+            b[3] |= detexBlock128GetBits(&block, 33, 1) << 5;
+            b[3] |= detexBlock128GetBits(&block, 34, 1) << 4;
+            r[1] = detexBlock128GetBits(&block, 35, 5);
+            g[3] = detexBlock128GetBits(&block, 40, 1) << 4;
+            g[2] |= detexBlock128GetBits(&block, 41, 4);
+            g[1] = detexBlock128GetBits(&block, 45, 5);
+            b[3] |= detexBlock128GetBits(&block, 50, 1);
+            g[3] |= detexBlock128GetBits(&block, 51, 4);
+            b[1] = detexBlock128GetBits(&block, 55, 6);
+            b[2] |= detexBlock128GetBits(&block, 61, 4);
+            r[2] = detexBlock128GetBits(&block, 65, 5);
+            b[3] |= detexBlock128GetBits(&block, 70, 1) << 2;
+            r[3] = detexBlock128GetBits(&block, 71, 5);
+            b[3] |= detexBlock128GetBits(&block, 76, 1) << 3;
+            partition_set_id = detexBlock128GetBits(&block, 77, 5);
             block.index = 64 + 18;
             delta_bits_r = delta_bits_g = 5;
             delta_bits_b = 6;
@@ -378,57 +368,55 @@ static bool DecompressBlockBPTCFloatShared(const uint8_t *DETEX_RESTRICT bitstri
             // m[4:0],r0[5:0],g3[4],b3[0],b3[1],b2[4],g0[5:0],g2[5],b2[5],b3[2],
             // g2[4],b0[5:0],g3[5],b3[3],b3[5],b3[4],r1[5:0],g2[3:0],g1[5:0],g3[3:0],
             // b1[5:0],b2[3:0],r2[5:0],r3[5:0]
-            r[0] = detexGetBits64(data0, 5, 10);
-            g[3] = detexGetBits64(data0, 11, 11) << 4;
-            b[3] = detexGetBits64(data0, 12, 13);
-            b[2] = detexGetBits64(data0, 14, 14) << 4;
-            g[0] = detexGetBits64(data0, 15, 20);
-            g[2] = detexGetBits64(data0, 21, 21) << 5;
-            b[2] |= detexGetBits64(data0, 22, 22) << 5;
-            b[3] |= detexGetBits64(data0, 23, 23) << 2;
-            g[2] |= detexGetBits64(data0, 24, 24) << 4;
-            b[0] = detexGetBits64(data0, 25, 30);
-            g[3] |= detexGetBits64(data0, 31, 31) << 5;
-            b[3] |= detexGetBits64(data0, 32, 32) << 3;
-            b[3] |= detexGetBits64(data0, 33, 33) << 5;
-            b[3] |= detexGetBits64(data0, 34, 34) << 4;
-            r[1] = detexGetBits64(data0, 35, 40);
-            g[2] |= detexGetBits64(data0, 41, 44);
-            g[1] = detexGetBits64(data0, 45, 50);
-            g[3] |= detexGetBits64(data0, 51, 54);
-            b[1] = detexGetBits64(data0, 55, 60);
-            b[2] |= detexGetBits64(data0, 61, 63);
-            b[2] |= detexGetBits64(data1, 0, 0) << 3;
-            r[2] = detexGetBits64(data1, 1, 6);
-            r[3] = detexGetBits64(data1, 7, 12);
-            partition_set_id = detexGetBits64(data1, 13, 17);
+            r[0] = detexBlock128GetBits(&block, 5, 6);
+            g[3] = detexBlock128GetBits(&block, 11, 1) << 4;
+            b[3] = detexBlock128GetBits(&block, 12, 2);
+            b[2] = detexBlock128GetBits(&block, 14, 1) << 4;
+            g[0] = detexBlock128GetBits(&block, 15, 6);
+            g[2] = detexBlock128GetBits(&block, 21, 1) << 5;
+            b[2] |= detexBlock128GetBits(&block, 22, 1) << 5;
+            b[3] |= detexBlock128GetBits(&block, 23, 1) << 2;
+            g[2] |= detexBlock128GetBits(&block, 24, 1) << 4;
+            b[0] = detexBlock128GetBits(&block, 25, 6);
+            g[3] |= detexBlock128GetBits(&block, 31, 1) << 5;
+            b[3] |= detexBlock128GetBits(&block, 32, 1) << 3;
+            b[3] |= detexBlock128GetBits(&block, 33, 1) << 5;
+            b[3] |= detexBlock128GetBits(&block, 34, 1) << 4;
+            r[1] = detexBlock128GetBits(&block, 35, 6);
+            g[2] |= detexBlock128GetBits(&block, 41, 4);
+            g[1] = detexBlock128GetBits(&block, 45, 6);
+            g[3] |= detexBlock128GetBits(&block, 51, 4);
+            b[1] = detexBlock128GetBits(&block, 55, 6);
+            b[2] |= detexBlock128GetBits(&block, 61, 4);
+            r[2] = detexBlock128GetBits(&block, 65, 6);
+            r[3] = detexBlock128GetBits(&block, 71, 6);
+            partition_set_id = detexBlock128GetBits(&block, 77, 5);
             block.index = 64 + 18;
             //		delta_bits_r = delta_bits_g = delta_bits_b = 6;
             break;
         case 10:  // Original mode 3
             // m[4:0],r0[9:0],g0[9:0],b0[9:0],r1[9:0],g1[9:0],b1[9:0]
-            r[0] = detexGetBits64(data0, 5, 14);
-            g[0] = detexGetBits64(data0, 15, 24);
-            b[0] = detexGetBits64(data0, 25, 34);
-            r[1] = detexGetBits64(data0, 35, 44);
-            g[1] = detexGetBits64(data0, 45, 54);
-            b[1] = detexGetBits64(data0, 55, 63);
-            b[1] |= detexGetBits64(data1, 0, 0) << 9;
+            r[0] = detexBlock128GetBits(&block, 5, 10);
+            g[0] = detexBlock128GetBits(&block, 15, 10);
+            b[0] = detexBlock128GetBits(&block, 25, 10);
+            r[1] = detexBlock128GetBits(&block, 35, 10);
+            g[1] = detexBlock128GetBits(&block, 45, 10);
+            b[1] = detexBlock128GetBits(&block, 55, 10);
             partition_set_id = 0;
             block.index = 65;
             //		delta_bits_r = delta_bits_g = delta_bits_b = 10;
             break;
         case 11:  // Original mode 7
             // m[4:0],r0[9:0],g0[9:0],b0[9:0],r1[8:0],r0[10],g1[8:0],g0[10],b1[8:0],b0[10]
-            r[0] = detexGetBits64(data0, 5, 14);
-            g[0] = detexGetBits64(data0, 15, 24);
-            b[0] = detexGetBits64(data0, 25, 34);
-            r[1] = detexGetBits64(data0, 35, 43);
-            r[0] |= detexGetBits64(data0, 44, 44) << 10;
-            g[1] = detexGetBits64(data0, 45, 53);
-            g[0] |= detexGetBits64(data0, 54, 54) << 10;
-            b[1] = detexGetBits64(data0, 55, 63);
-            b[0] |= detexGetBits64(data1, 0, 0) << 10;
+            r[0] = detexBlock128GetBits(&block, 5, 10);
+            g[0] = detexBlock128GetBits(&block, 15, 10);
+            b[0] = detexBlock128GetBits(&block, 25, 10);
+            r[1] = detexBlock128GetBits(&block, 35, 9);
+            r[0] |= detexBlock128GetBits(&block, 44, 1) << 10;
+            g[1] = detexBlock128GetBits(&block, 45, 9);
+            g[0] |= detexBlock128GetBits(&block, 54, 1) << 10;
+            b[1] = detexBlock128GetBits(&block, 55, 9);
+            b[0] |= detexBlock128GetBits(&block, 64, 1) << 10;
             partition_set_id = 0;
             block.index = 65;
             delta_bits_r = delta_bits_g = delta_bits_b = 9;
@@ -436,16 +424,16 @@ static bool DecompressBlockBPTCFloatShared(const uint8_t *DETEX_RESTRICT bitstri
         case 12:  // Original mode 11
             // m[4:0],r0[9:0],g0[9:0],b0[9:0],r1[7:0],r0[10:11],g1[7:0],g0[10:11],
             // b1[7:0],b0[10:11]
-            r[0] = detexGetBits64(data0, 5, 14);
-            g[0] = detexGetBits64(data0, 15, 24);
-            b[0] = detexGetBits64(data0, 25, 34);
-            r[1] = detexGetBits64(data0, 35, 42);
+            r[0] = detexBlock128GetBits(&block, 5, 10);
+            g[0] = detexBlock128GetBits(&block, 15, 10);
+            b[0] = detexBlock128GetBits(&block, 25, 10);
+            r[1] = detexBlock128GetBits(&block, 35, 8);
             r[0] |= detexGetBits64Reversed(data0, 44, 43) << 10;  // Reversed.
-            g[1] = detexGetBits64(data0, 45, 52);
+            g[1] = detexBlock128GetBits(&block, 45, 8);
             g[0] |= detexGetBits64Reversed(data0, 54, 53) << 10;  // Reversed.
-            b[1] = detexGetBits64(data0, 55, 62);
-            b[0] |= detexGetBits64(data0, 63, 63) << 11;  // MSB
-            b[0] |= detexGetBits64(data1, 0, 0) << 10;    // LSB
+            b[1] = detexBlock128GetBits(&block, 55, 8);
+            b[0] |= detexBlock128GetBits(&block, 63, 1) << 11;  // MSB
+            b[0] |= detexBlock128GetBits(&block, 64, 1) << 10;  // LSB
             partition_set_id = 0;
             block.index = 65;
             delta_bits_r = delta_bits_g = delta_bits_b = 8;
@@ -453,16 +441,16 @@ static bool DecompressBlockBPTCFloatShared(const uint8_t *DETEX_RESTRICT bitstri
         case 13:  // Original mode 15
             // m[4:0],r0[9:0],g0[9:0],b0[9:0],r1[3:0],r0[10:15],g1[3:0],g0[10:15],
             // b1[3:0],b0[10:15]
-            r[0] = detexGetBits64(data0, 5, 14);
-            g[0] = detexGetBits64(data0, 15, 24);
-            b[0] = detexGetBits64(data0, 25, 34);
-            r[1] = detexGetBits64(data0, 35, 38);
+            r[0] = detexBlock128GetBits(&block, 5, 10);
+            g[0] = detexBlock128GetBits(&block, 15, 10);
+            b[0] = detexBlock128GetBits(&block, 25, 10);
+            r[1] = detexBlock128GetBits(&block, 35, 4);
             r[0] |= detexGetBits64Reversed(data0, 44, 39) << 10;  // Reversed.
-            g[1] = detexGetBits64(data0, 45, 48);
+            g[1] = detexBlock128GetBits(&block, 45, 4);
             g[0] |= detexGetBits64Reversed(data0, 54, 49) << 10;  // Reversed.
-            b[1] = detexGetBits64(data0, 55, 58);
+            b[1] = detexBlock128GetBits(&block, 55, 4);
             b[0] |= detexGetBits64Reversed(data0, 63, 59) << 11;  // Reversed.
-            b[0] |= detexGetBits64(data1, 0, 0) << 10;
+            b[0] |= detexBlock128GetBits(&block, 64, 1) << 10;
             partition_set_id = 0;
             block.index = 65;
             delta_bits_r = delta_bits_g = delta_bits_b = 4;
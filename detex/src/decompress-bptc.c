@@ -39,180 +39,17 @@ OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 // (*) For formats without alpha, the number of index bits is reduced by #subsets anchor bits.
 //     For formats with alpha, the number of index bits is reduced by 2 * #subsets by the anchor bits.
 
-static const uint8_t color_precision_table[8] = {4, 6, 5, 7, 5, 7, 7, 5};
-
-// Note: precision includes P-bits!
-static const uint8_t color_precision_plus_pbit_table[8] = {5, 7, 5, 8, 5, 7, 8, 6};
-
-DETEX_INLINE_ONLY uint8_t GetColorComponentPrecision(int mode) { return color_precision_table[mode]; }
-
-DETEX_INLINE_ONLY uint8_t GetColorComponentPrecisionPlusPbit(int mode) { return color_precision_plus_pbit_table[mode]; }
-
-static const int8_t alpha_precision_table[8] = {0, 0, 0, 0, 6, 8, 7, 5};
-
-// Note: precision include P-bits!
-static const uint8_t alpha_precision_plus_pbit_table[8] = {0, 0, 0, 0, 6, 8, 8, 6};
-
-DETEX_INLINE_ONLY uint8_t GetAlphaComponentPrecision(int mode) { return alpha_precision_table[mode]; }
-
-DETEX_INLINE_ONLY uint8_t GetAlphaComponentPrecisionPlusPbit(int mode) { return alpha_precision_plus_pbit_table[mode]; }
-
-static const int8_t components_in_qword0_table[8] = {2, -1, 1, 1, 3, 3, 3, 2};
-
-/* Extract endpoint colors. */
-static void ExtractEndpoints(int mode,
-                             int nu_subsets,
-                             detexBlock128 *DETEX_RESTRICT block,
-                             uint8_t *DETEX_RESTRICT endpoint_array) {
-    // Optimized version avoiding the use of block_extract_bits().
-    int components_in_qword0 = components_in_qword0_table[mode];
-    uint64_t data = block->data0 >> block->index;
-    uint8_t precision = GetColorComponentPrecision(mode);
-    uint8_t mask = (1 << precision) - 1;
-    int total_bits_per_component = nu_subsets * 2 * precision;
-    for (int i = 0; i < components_in_qword0; i++)  // For each color component.
-        for (int j = 0; j < nu_subsets; j++)        // For each subset.
-            for (int k = 0; k < 2; k++) {           // For each endpoint.
-                endpoint_array[j * 8 + k * 4 + i] = data & mask;
-                data >>= precision;
-            }
-    block->index += components_in_qword0 * total_bits_per_component;
-    if (components_in_qword0 < 3) {
-        // Handle the color component that crosses the boundary between data0 and data1
-        data = block->data0 >> block->index;
-        data |= block->data1 << (64 - block->index);
-        int i = components_in_qword0;
-        for (int j = 0; j < nu_subsets; j++)  // For each subset.
-            for (int k = 0; k < 2; k++) {     // For each endpoint.
-                endpoint_array[j * 8 + k * 4 + i] = data & mask;
-                data >>= precision;
-            }
-        block->index += total_bits_per_component;
-    }
-    if (components_in_qword0 < 2) {
-        // Handle the color component that is wholly in data1.
-        data = block->data1 >> (block->index - 64);
-        int i = 2;
-        for (int j = 0; j < nu_subsets; j++)  // For each subset.
-            for (int k = 0; k < 2; k++) {     // For each endpoint.
-                endpoint_array[j * 8 + k * 4 + i] = data & mask;
-                data >>= precision;
-            }
-        block->index += total_bits_per_component;
-    }
-    // Alpha component.
-    if (GetAlphaComponentPrecision(mode) > 0) {
-        // For mode 7, the alpha data is wholly in data1.
-        // For modes 4 and 6, the alpha data is wholly in data0.
-        // For mode 5, the alpha data is in data0 and data1.
-        if (mode == 7)
-            data = block->data1 >> (block->index - 64);
-        else if (mode == 5)
-            data = (block->data0 >> block->index) | ((block->data1 & 0x3) << 14);
-        else
-            data = block->data0 >> block->index;
-        uint8_t alpha_precision = GetAlphaComponentPrecision(mode);
-        uint8_t mask = (1 << alpha_precision) - 1;
-        for (int j = 0; j < nu_subsets; j++)
-            for (int k = 0; k < 2; k++) {  // For each endpoint.
-                endpoint_array[j * 8 + k * 4 + 3] = data & mask;
-                data >>= alpha_precision;
-            }
-        block->index += nu_subsets * 2 * alpha_precision;
-    }
-}
-
-static const uint8_t mode_has_p_bits[8] = {1, 1, 0, 1, 0, 0, 1, 1};
-
-static void FullyDecodeEndpoints(uint8_t *DETEX_RESTRICT endpoint_array,
-                                 int nu_subsets,
-                                 int mode,
-                                 detexBlock128 *DETEX_RESTRICT block) {
-    if (mode_has_p_bits[mode]) {
-        // Mode 1 (shared P-bits) handled elsewhere.
-        // Extract end-point P-bits. Take advantage of the fact that they don't cross the
-        // 64-bit word boundary in any mode.
-        uint32_t bits;
-        if (block->index < 64)
-            bits = block->data0 >> block->index;
-        else
-            bits = block->data1 >> (block->index - 64);
-        for (int i = 0; i < nu_subsets * 2; i++) {
-            endpoint_array[i * 4 + 0] <<= 1;
-            endpoint_array[i * 4 + 1] <<= 1;
-            endpoint_array[i * 4 + 2] <<= 1;
-            endpoint_array[i * 4 + 3] <<= 1;
-            endpoint_array[i * 4 + 0] |= (bits & 1);
-            endpoint_array[i * 4 + 1] |= (bits & 1);
-            endpoint_array[i * 4 + 2] |= (bits & 1);
-            endpoint_array[i * 4 + 3] |= (bits & 1);
-            bits >>= 1;
-        }
-        block->index += nu_subsets * 2;
-    }
-    int color_prec = GetColorComponentPrecisionPlusPbit(mode);
-    int alpha_prec = GetAlphaComponentPrecisionPlusPbit(mode);
-    for (int i = 0; i < nu_subsets * 2; i++) {
-        // Color_component_precision & alpha_component_precision includes pbit
-        // left shift endpoint components so that their MSB lies in bit 7
-        endpoint_array[i * 4 + 0] <<= (8 - color_prec);
-        endpoint_array[i * 4 + 1] <<= (8 - color_prec);
-        endpoint_array[i * 4 + 2] <<= (8 - color_prec);
-        endpoint_array[i * 4 + 3] <<= (8 - alpha_prec);
-
-        // Replicate each component's MSB into the LSBs revealed by the left-shift operation above.
-        endpoint_array[i * 4 + 0] |= (endpoint_array[i * 4 + 0] >> color_prec);
-        endpoint_array[i * 4 + 1] |= (endpoint_array[i * 4 + 1] >> color_prec);
-        endpoint_array[i * 4 + 2] |= (endpoint_array[i * 4 + 2] >> color_prec);
-        endpoint_array[i * 4 + 3] |= (endpoint_array[i * 4 + 3] >> alpha_prec);
-    }
-    if (mode <= 3) {
-        for (int i = 0; i < nu_subsets * 2; i++) endpoint_array[i * 4 + 3] = 0xFF;
-    }
-}
-
-static uint8_t Interpolate(uint8_t e0, uint8_t e1, uint8_t index, uint8_t indexprecision) {
-    if (indexprecision == 2)
-        return (uint8_t)(((64 - detex_bptc_table_aWeight2[index]) * (uint16_t)e0 +
-                          detex_bptc_table_aWeight2[index] * (uint16_t)e1 + 32) >>
-                         6);
-    else if (indexprecision == 3)
-        return (uint8_t)(((64 - detex_bptc_table_aWeight3[index]) * (uint16_t)e0 +
-                          detex_bptc_table_aWeight3[index] * (uint16_t)e1 + 32) >>
-                         6);
-    else  // indexprecision == 4
-        return (uint8_t)(((64 - detex_bptc_table_aWeight4[index]) * (uint16_t)e0 +
-                          detex_bptc_table_aWeight4[index] * (uint16_t)e1 + 32) >>
-                         6);
-}
-
-static const uint8_t bptc_color_index_bitcount[8] = {3, 3, 2, 2, 2, 2, 4, 2};
-
-DETEX_INLINE_ONLY int GetColorIndexBitcount(int mode, int index_selection_bit) {
-    // If the index selection bit is set for mode 4, return 3, otherwise 2.
-    return bptc_color_index_bitcount[mode] + index_selection_bit;
-}
-
-static uint8_t bptc_alpha_index_bitcount[8] = {3, 3, 2, 2, 3, 2, 4, 2};
-
-DETEX_INLINE_ONLY int GetAlphaIndexBitcount(int mode, int index_selection_bit) {
-    // If the index selection bit is set for mode 4, return 2, otherwise 3.
-    return bptc_alpha_index_bitcount[mode] - index_selection_bit;
-}
-
-static const uint8_t bptc_NS[8] = {3, 2, 3, 2, 1, 1, 1, 2};
-
-DETEX_INLINE_ONLY int GetNumberOfSubsets(int mode) { return bptc_NS[mode]; }
-
-static const uint8_t PB[8] = {4, 6, 6, 6, 0, 0, 0, 6};
-
-DETEX_INLINE_ONLY int GetNumberOfPartitionBits(int mode) { return PB[mode]; }
-
-static const uint8_t RB[8] = {0, 0, 0, 0, 2, 2, 0, 0};
-
-DETEX_INLINE_ONLY int GetNumberOfRotationBits(int mode) { return RB[mode]; }
-
-// Functions to extract parameters. */
+// Layout of the modes.
+static const uint8_t bptc_NS[8] = {3, 2, 3, 2, 1, 1, 1, 2};   // Number of subsets.
+static const uint8_t PB[8] = {4, 6, 6, 6, 0, 0, 0, 6};        // Partition bits.
+static const uint8_t RB[8] = {0, 0, 0, 0, 2, 2, 0, 0};        // Rotation bits.
+static const uint8_t ISB[8] = {0, 0, 0, 0, 1, 0, 0, 0};       // Index selection bits.
+static const uint8_t CB[8] = {4, 6, 5, 7, 5, 7, 7, 5};        // Color bits, without P-bit.
+static const uint8_t AB[8] = {0, 0, 0, 0, 6, 8, 7, 5};        // Alpha bits, without P-bit.
+static const uint8_t EPB[8] = {1, 0, 0, 1, 0, 0, 1, 1};       // P-bit per endpoint.
+static const uint8_t SPB[8] = {0, 1, 0, 0, 0, 0, 0, 0};       // P-bit per subset.
+static const uint8_t IB[8] = {3, 3, 2, 2, 2, 2, 4, 2};        // Primary index bits.
+static const uint8_t IB2[8] = {0, 0, 0, 0, 3, 2, 0, 0};       // Secondary index bits.
 
 static int ExtractMode(detexBlock128 *block) {
     for (int i = 0; i < 8; i++)
@@ -224,112 +61,171 @@ static int ExtractMode(detexBlock128 *block) {
     return -1;
 }
 
-DETEX_INLINE_ONLY int ExtractPartitionSetID(detexBlock128 *block, int mode) {
-    return detexBlock128ExtractBits(block, GetNumberOfPartitionBits(mode));
+// Return the (up to) 64 bits of a block starting at bit index bit0.
+DETEX_INLINE_ONLY uint64_t GetBitWindow(const detexBlock128 *block, int bit0) {
+    if (bit0 >= 64) return block->data1 >> (bit0 - 64);
+    return (block->data0 >> bit0) | (block->data1 << (64 - bit0));
 }
 
-DETEX_INLINE_ONLY int GetPartitionIndex(int nu_subsets, int partition_set_id, int i) {
-    if (nu_subsets == 1) return 0;
-    if (nu_subsets == 2) return detex_bptc_table_P2[partition_set_id * 16 + i];
-    return detex_bptc_table_P3[partition_set_id * 16 + i];
+DETEX_INLINE_ONLY const uint16_t *GetWeights(int index_bits) {
+    if (index_bits == 2) return detex_bptc_table_aWeight2;
+    if (index_bits == 3) return detex_bptc_table_aWeight3;
+    return detex_bptc_table_aWeight4;
 }
 
-DETEX_INLINE_ONLY int ExtractRotationBits(detexBlock128 *block, int mode) {
-    return detexBlock128ExtractBits(block, GetNumberOfRotationBits(mode));
+DETEX_INLINE_ONLY uint8_t Interpolate(uint8_t e0, uint8_t e1, int weight) {
+    return (uint8_t)(((64 - weight) * (uint16_t)e0 + weight * (uint16_t)e1 + 32) >> 6);
 }
 
-DETEX_INLINE_ONLY int GetAnchorIndex(int partition_set_id, int partition, int nu_subsets) {
-    if (partition == 0) return 0;
-    if (nu_subsets == 2) return detex_bptc_table_anchor_index_second_subset[partition_set_id];
-    if (partition == 1) return detex_bptc_table_anchor_index_second_subset_of_three[partition_set_id];
-    return detex_bptc_table_anchor_index_third_subset[partition_set_id];
+// Extract the 16 indices of index_bits bits starting at bit index, anchor pixels having one bit
+// less. anchors holds the per-pixel anchor flags of the partition, or is NULL for one subset.
+DETEX_INLINE_ONLY void ExtractIndices(const detexBlock128 *block,
+                                      int index,
+                                      int index_bits,
+                                      const uint8_t *anchors,
+                                      uint8_t *DETEX_RESTRICT indices) {
+    uint64_t data = GetBitWindow(block, index);
+    for (int i = 0; i < 16; i++) {
+        int bits = index_bits - (anchors != NULL ? anchors[i] : i == 0);
+        indices[i] = data & ((1 << bits) - 1);
+        data >>= bits;
+    }
 }
 
-static const uint8_t IB[8] = {3, 3, 2, 2, 2, 2, 4, 2};
-static const uint8_t IB2[8] = {0, 0, 0, 0, 3, 2, 0, 0};
-static const uint8_t mode_has_partition_bits[8] = {1, 1, 1, 1, 0, 0, 0, 1};
-
-/* Decompress a 128-bit 4x4 pixel texture block compressed using BPTC mode 1. */
-
-static bool DecompressBlockBPTCMode1(detexBlock128 *DETEX_RESTRICT block, uint8_t *DETEX_RESTRICT pixel_buffer) {
-    uint64_t data0 = block->data0;
-    uint64_t data1 = block->data1;
-    int partition_set_id = detexGetBits64(data0, 2, 7);
-    uint8_t endpoint[2 * 2 * 3];                   // 2 subsets.
-    endpoint[0] = detexGetBits64(data0, 8, 13);    // red, subset 0, endpoint 0
-    endpoint[3] = detexGetBits64(data0, 14, 19);   // red, subset 0, endpoint 1
-    endpoint[6] = detexGetBits64(data0, 20, 25);   // red, subset 1, endpoint 0
-    endpoint[9] = detexGetBits64(data0, 26, 31);   // red, subset 1, endpoint 1
-    endpoint[1] = detexGetBits64(data0, 32, 37);   // green, subset 0, endpoint 0
-    endpoint[4] = detexGetBits64(data0, 38, 43);   // green, subset 0, endpoint 1
-    endpoint[7] = detexGetBits64(data0, 44, 49);   // green, subset 1, endpoint 0
-    endpoint[10] = detexGetBits64(data0, 50, 55);  // green, subset 1, endpoint 1
-    endpoint[2] = detexGetBits64(data0, 56, 61);   // blue, subset 0, endpoint 0
-    endpoint[5] = detexGetBits64(data0, 62, 63)    // blue, subset 0, endpoint 1
-                  | (detexGetBits64(data1, 0, 3) << 2);
-    endpoint[8] = detexGetBits64(data1, 4, 9);     // blue, subset 1, endpoint 0
-    endpoint[11] = detexGetBits64(data1, 10, 15);  // blue, subset 1, endpoint 1
-    // Decode endpoints.
-    for (int i = 0; i < 2 * 2; i++) {
-        // component-wise left-shift
-        endpoint[i * 3 + 0] <<= 2;
-        endpoint[i * 3 + 1] <<= 2;
-        endpoint[i * 3 + 2] <<= 2;
+// Decompress a block of the given mode. It is instantiated for every mode with
+// DEFINE_DECOMPRESS_MODE, so that the layout of the mode is known at compile time: the fields
+// are extracted at constant bit positions and the loops have constant bounds.
+DETEX_ALWAYS_INLINE void DecompressBlockBPTCModeShared(const detexBlock128 *DETEX_RESTRICT block,
+                                                       int mode,
+                                                       uint8_t *DETEX_RESTRICT pixel_buffer) {
+    int nu_subsets = bptc_NS[mode];
+    int index = mode + 1;
+    int partition_set_id = detexBlock128GetBits(block, index, PB[mode]);
+    index += PB[mode];
+    int rotation = detexBlock128GetBits(block, index, RB[mode]);
+    index += RB[mode];
+    int index_selection_bit = detexBlock128GetBits(block, index, ISB[mode]);
+    index += ISB[mode];
+
+    // Endpoints are stored per component, then per subset and endpoint.
+    uint8_t endpoints[3 * 2][4];
+    for (int j = 0; j < 3; j++)
+        for (int i = 0; i < nu_subsets * 2; i++) {
+            endpoints[i][j] = detexBlock128GetBits(block, index, CB[mode]);
+            index += CB[mode];
+        }
+    for (int i = 0; i < nu_subsets * 2; i++) {
+        endpoints[i][3] = detexBlock128GetBits(block, index, AB[mode]);
+        index += AB[mode];
     }
-    // P-bit is shared.
-    uint8_t pbit_zero = detexGetBits64(data1, 16, 16) << 1;
-    uint8_t pbit_one = detexGetBits64(data1, 17, 17) << 1;
-    // RGB only pbits for mode 1, one for each subset.
-    for (int j = 0; j < 3; j++) {
-        endpoint[0 * 3 + j] |= pbit_zero;
-        endpoint[1 * 3 + j] |= pbit_zero;
-        endpoint[2 * 3 + j] |= pbit_one;
-        endpoint[3 * 3 + j] |= pbit_one;
+    int color_precision = CB[mode];
+    int alpha_precision = AB[mode];
+    if (EPB[mode] || SPB[mode]) {
+        for (int i = 0; i < nu_subsets * 2; i++) {
+            uint8_t p_bit = detexBlock128GetBits(block, index + (EPB[mode] ? i : i / 2), 1);
+            for (int j = 0; j < 4; j++) endpoints[i][j] = (endpoints[i][j] << 1) | p_bit;
+        }
+        index += EPB[mode] ? nu_subsets * 2 : nu_subsets;
+        color_precision++;
+        alpha_precision += AB[mode] > 0;
     }
-    for (int i = 0; i < 2 * 2; i++) {
-        // Replicate each component's MSB into the LSB.
-        endpoint[i * 3 + 0] |= endpoint[i * 3 + 0] >> 7;
-        endpoint[i * 3 + 1] |= endpoint[i * 3 + 1] >> 7;
-        endpoint[i * 3 + 2] |= endpoint[i * 3 + 2] >> 7;
+    for (int i = 0; i < nu_subsets * 2; i++) {
+        // Shift the components so that their MSB lies in bit 7 and replicate the MSBs into the
+        // revealed LSBs.
+        for (int j = 0; j < 3; j++) {
+            endpoints[i][j] <<= 8 - color_precision;
+            endpoints[i][j] |= endpoints[i][j] >> color_precision;
+        }
+        if (AB[mode] > 0) {
+            endpoints[i][3] <<= 8 - alpha_precision;
+            endpoints[i][3] |= endpoints[i][3] >> alpha_precision;
+        } else {
+            endpoints[i][3] = 0xFF;
+        }
     }
 
-    uint8_t subset_index[16];
-    for (int i = 0; i < 16; i++)
-        // subset_index[i] is a number from 0 to 1.
-        subset_index[i] = detex_bptc_table_P2[partition_set_id * 16 + i];
-    uint8_t anchor_index[2];
-    anchor_index[0] = 0;
-    anchor_index[1] = detex_bptc_table_anchor_index_second_subset[partition_set_id];
-    uint8_t color_index[16];
-    // Extract primary index bits.
-    data1 >>= 18;
-    for (int i = 0; i < 16; i++)
-        if (i == anchor_index[subset_index[i]]) {
-            // Highest bit is zero.
-            color_index[i] = data1 & 3;  // Get two bits.
-            data1 >>= 2;
-        } else {
-            color_index[i] = data1 & 7;  // Get three bits.
-            data1 >>= 3;
+    const uint8_t *subsets = NULL;
+    const uint8_t *anchors = NULL;
+    if (nu_subsets == 2) {
+        subsets = &detex_bptc_table_P2[partition_set_id * 16];
+        anchors = &detex_bptc_table_anchor_P2[partition_set_id * 16];
+    } else if (nu_subsets == 3) {
+        subsets = &detex_bptc_table_P3[partition_set_id * 16];
+        anchors = &detex_bptc_table_anchor_P3[partition_set_id * 16];
+    }
+    uint8_t primary_index[16];
+    uint8_t secondary_index[16];
+    ExtractIndices(block, index, IB[mode], anchors, primary_index);
+    const uint8_t *color_index = primary_index;
+    const uint8_t *alpha_index = primary_index;
+    const uint16_t *color_weights = GetWeights(IB[mode]);
+    const uint16_t *alpha_weights = color_weights;
+    if (IB2[mode] > 0) {
+        // Modes 4 and 5 have separate alpha indices, which mode 4 can swap with the color indices.
+        ExtractIndices(block, index + 16 * IB[mode] - 1, IB2[mode], NULL, secondary_index);
+        alpha_index = secondary_index;
+        alpha_weights = GetWeights(IB2[mode]);
+        if (index_selection_bit) {
+            color_index = secondary_index;
+            alpha_index = primary_index;
+            color_weights = alpha_weights;
+            alpha_weights = GetWeights(IB[mode]);
         }
+    }
+
     uint32_t *pixel32_buffer = (uint32_t *)pixel_buffer;
     for (int i = 0; i < 16; i++) {
-        uint8_t endpoint_start[3];
-        uint8_t endpoint_end[3];
-        for (int j = 0; j < 3; j++) {
-            endpoint_start[j] = endpoint[2 * subset_index[i] * 3 + j];
-            endpoint_end[j] = endpoint[(2 * subset_index[i] + 1) * 3 + j];
+        int subset = subsets != NULL ? subsets[i] : 0;
+        const uint8_t *e0 = endpoints[subset * 2];
+        const uint8_t *e1 = endpoints[subset * 2 + 1];
+        int color_weight = color_weights[color_index[i]];
+        uint8_t r = Interpolate(e0[0], e1[0], color_weight);
+        uint8_t g = Interpolate(e0[1], e1[1], color_weight);
+        uint8_t b = Interpolate(e0[2], e1[2], color_weight);
+        uint8_t a = Interpolate(e0[3], e1[3], alpha_weights[alpha_index[i]]);
+        uint8_t t = a;
+        if (rotation == 1) {
+            a = r;
+            r = t;
+        } else if (rotation == 2) {
+            a = g;
+            g = t;
+        } else if (rotation == 3) {
+            a = b;
+            b = t;
         }
-        uint32_t output;
-        output = detexPack32R8(Interpolate(endpoint_start[0], endpoint_end[0], color_index[i], 3));
-        output |= detexPack32G8(Interpolate(endpoint_start[1], endpoint_end[1], color_index[i], 3));
-        output |= detexPack32B8(Interpolate(endpoint_start[2], endpoint_end[2], color_index[i], 3));
-        output |= detexPack32A8(0xFF);
-        pixel32_buffer[i] = output;
+        pixel32_buffer[i] = detexPack32RGBA8(r, g, b, a);
     }
-    return true;
 }
 
+#define DEFINE_DECOMPRESS_MODE(mode)                                                                 \
+    static void DecompressBlockBPTCMode##mode(const detexBlock128 *DETEX_RESTRICT block,             \
+                                              uint8_t *DETEX_RESTRICT pixel_buffer) {                \
+        DecompressBlockBPTCModeShared(block, mode, pixel_buffer);                                    \
+    }
+
+DEFINE_DECOMPRESS_MODE(0)
+DEFINE_DECOMPRESS_MODE(1)
+DEFINE_DECOMPRESS_MODE(2)
+DEFINE_DECOMPRESS_MODE(3)
+DEFINE_DECOMPRESS_MODE(4)
+DEFINE_DECOMPRESS_MODE(5)
+DEFINE_DECOMPRESS_MODE(6)
+DEFINE_DECOMPRESS_MODE(7)
+
+typedef void (*DecompressBlockModeFuncType)(const detexBlock128 *block, uint8_t *pixel_buffer);
+
+static const DecompressBlockModeFuncType decompress_mode_function[8] = {
+    DecompressBlockBPTCMode0,
+    DecompressBlockBPTCMode1,
+    DecompressBlockBPTCMode2,
+    DecompressBlockBPTCMode3,
+    DecompressBlockBPTCMode4,
+    DecompressBlockBPTCMode5,
+    DecompressBlockBPTCMode6,
+    DecompressBlockBPTCMode7,
+};
+
 /* Decompress a 128-bit 4x4 pixel texture block compressed using the BPTC */
 /* (BC7) format. */
 bool detexDecompressBlockBPTC(const uint8_t *DETEX_RESTRICT bitstring,
@@ -346,141 +242,7 @@ bool detexDecompressBlockBPTC(const uint8_t *DETEX_RESTRICT bitstring,
     if (!(mode_mask & ((int)1 << mode))) return 0;
     if (mode >= 4 && (flags & DETEX_DECOMPRESS_FLAG_OPAQUE_ONLY)) return 0;
     if (mode < 4 && (flags & DETEX_DECOMPRESS_FLAG_NON_OPAQUE_ONLY)) return 0;
-    if (mode == 1) return DecompressBlockBPTCMode1(&block, pixel_buffer);
-
-    int nu_subsets = 1;
-    int partition_set_id = 0;
-    if (mode_has_partition_bits[mode]) {
-        nu_subsets = GetNumberOfSubsets(mode);
-        partition_set_id = ExtractPartitionSetID(&block, mode);
-    }
-    int rotation = ExtractRotationBits(&block, mode);
-    int index_selection_bit = 0;
-    if (mode == 4) index_selection_bit = detexBlock128ExtractBits(&block, 1);
-
-    int alpha_index_bitcount = GetAlphaIndexBitcount(mode, index_selection_bit);
-    int color_index_bitcount = GetColorIndexBitcount(mode, index_selection_bit);
-
-    uint8_t endpoint_array[3 * 2 * 4];  // Max. 3 subsets.
-    ExtractEndpoints(mode, nu_subsets, &block, endpoint_array);
-    FullyDecodeEndpoints(endpoint_array, nu_subsets, mode, &block);
-
-    uint8_t subset_index[16];
-    for (int i = 0; i < 16; i++)
-        // subset_index[i] is a number from 0 to 2, or 0 to 1, or 0 depending on the number of subsets.
-        subset_index[i] = GetPartitionIndex(nu_subsets, partition_set_id, i);
-    uint8_t anchor_index[4];  // Only need max. 3 elements.
-    for (int i = 0; i < nu_subsets; i++) anchor_index[i] = GetAnchorIndex(partition_set_id, i, nu_subsets);
-    uint8_t color_index[16];
-    uint8_t alpha_index[16];
-    // Extract primary index bits.
-    uint64_t data1;
-    if (block.index >= 64) {
-        // Because the index bits are all in the second 64-bit word, there is no need to use
-        // block_extract_bits().
-        // This implies the mode is not 4.
-        data1 = block.data1 >> (block.index - 64);
-        uint8_t mask1 = (1 << IB[mode]) - 1;
-        uint8_t mask2 = (1 << (IB[mode] - 1)) - 1;
-        for (int i = 0; i < 16; i++)
-            if (i == anchor_index[subset_index[i]]) {
-                // Highest bit is zero.
-                color_index[i] = data1 & mask2;
-                data1 >>= IB[mode] - 1;
-                alpha_index[i] = color_index[i];
-            } else {
-                color_index[i] = data1 & mask1;
-                data1 >>= IB[mode];
-                alpha_index[i] = color_index[i];
-            }
-    } else {  // Implies mode 4.
-        // Because the bits cross the 64-bit word boundary, we have to be careful.
-        // Block index is 50 at this point.
-        uint64_t data = block.data0 >> 50;
-        data |= block.data1 << 14;
-        for (int i = 0; i < 16; i++)
-            if (i == anchor_index[subset_index[i]]) {
-                // Highest bit is zero.
-                if (index_selection_bit) {  // Implies mode == 4.
-                    alpha_index[i] = data & 0x1;
-                    data >>= 1;
-                } else {
-                    color_index[i] = data & 0x1;
-                    data >>= 1;
-                }
-            } else {
-                if (index_selection_bit) {  // Implies mode == 4.
-                    alpha_index[i] = data & 0x3;
-                    data >>= 2;
-                } else {
-                    color_index[i] = data & 0x3;
-                    data >>= 2;
-                }
-            }
-        // Block index is 81 at this point.
-        data1 = block.data1 >> (81 - 64);
-    }
-    // Extract secondary index bits.
-    if (IB2[mode] > 0) {
-        uint8_t mask1 = (1 << IB2[mode]) - 1;
-        uint8_t mask2 = (1 << (IB2[mode] - 1)) - 1;
-        for (int i = 0; i < 16; i++)
-            if (i == anchor_index[subset_index[i]]) {
-                // Highest bit is zero.
-                if (index_selection_bit) {
-                    color_index[i] = data1 & 0x3;
-                    data1 >>= 2;
-                } else {
-                    //					alpha_index[i] = block_extract_bits(&block, IB2[mode] - 1);
-                    alpha_index[i] = data1 & mask2;
-                    data1 >>= IB2[mode] - 1;
-                }
-            } else {
-                if (index_selection_bit) {
-                    color_index[i] = data1 & 0x7;
-                    data1 >>= 3;
-                } else {
-                    //					alpha_index[i] = block_extract_bits(&block, IB2[mode]);
-                    alpha_index[i] = data1 & mask1;
-                    data1 >>= IB2[mode];
-                }
-            }
-    }
-
-    uint32_t *pixel32_buffer = (uint32_t *)pixel_buffer;
-    for (int i = 0; i < 16; i++) {
-        uint8_t endpoint_start[4];
-        uint8_t endpoint_end[4];
-        for (int j = 0; j < 4; j++) {
-            endpoint_start[j] = endpoint_array[2 * subset_index[i] * 4 + j];
-            endpoint_end[j] = endpoint_array[(2 * subset_index[i] + 1) * 4 + j];
-        }
-
-        uint32_t output = 0;
-        output = detexPack32R8(Interpolate(endpoint_start[0], endpoint_end[0], color_index[i], color_index_bitcount));
-        output |= detexPack32G8(Interpolate(endpoint_start[1], endpoint_end[1], color_index[i], color_index_bitcount));
-        output |= detexPack32B8(Interpolate(endpoint_start[2], endpoint_end[2], color_index[i], color_index_bitcount));
-        output |= detexPack32A8(Interpolate(endpoint_start[3], endpoint_end[3], alpha_index[i], alpha_index_bitcount));
-
-        if (rotation > 0) {
-            if (rotation == 1)
-                output = detexPack32RGBA8(detexPixel32GetA8(output),
-                                          detexPixel32GetG8(output),
-                                          detexPixel32GetB8(output),
-                                          detexPixel32GetR8(output));
-            else if (rotation == 2)
-                output = detexPack32RGBA8(detexPixel32GetR8(output),
-                                          detexPixel32GetA8(output),
-                                          detexPixel32GetB8(output),
-                                          detexPixel32GetG8(output));
-            else  // rotation == 3
-                output = detexPack32RGBA8(detexPixel32GetR8(output),
-                                          detexPixel32GetG8(output),
-                                          detexPixel32GetA8(output),
-                                          detexPixel32GetB8(output));
-        }
-        pixel32_buffer[i] = output;
-    }
+    decompress_mode_function[mode](&block, pixel_buffer);
     return true;
 }
 
@@ -111,13 +111,15 @@ DETEX_INLINE_ONLY void DecodeBlockEAC11Bit(uint64_t qword,
     const int8_t *modifier_table = eac_modifier_table[modifier_index];
     int multiplier_times_8 = (qword & 0x00F0000000000000) >> (52 - 3);
     if (multiplier_times_8 == 0) multiplier_times_8 = 1;
+    uint16_t palette[8];
+    for (int k = 0; k < 8; k++) {
+        uint32_t value = Clamp0To2047(base_codeword_times_8_plus_4 + modifier_table[k] * multiplier_times_8);
+        palette[k] = (value << 5) | (value >> 6);  // Replicate bits to 16-bit.
+    }
     uint16_t *buffer = (uint16_t *)pixel_buffer;
     for (int i = 0; i < 16; i++) {
         int pixel_index = (qword & (0x0000E00000000000 >> (i * 3))) >> (45 - i * 3);
-        int modifier = modifier_table[pixel_index];
-        uint32_t value = Clamp0To2047(base_codeword_times_8_plus_4 + modifier * multiplier_times_8);
-        buffer[(((i & 3) * 4 + ((i & 12) >> 2)) << shift) + offset] =
-            (value << 5) | (value >> 6);  // Replicate bits to 16-bit.
+        buffer[(((i & 3) * 4 + ((i & 12) >> 2)) << shift) + offset] = palette[pixel_index];
     }
 }
 
@@ -181,13 +183,15 @@ DETEX_INLINE_ONLY bool DecodeBlockEACSigned11Bit(uint64_t qword, int shift, int
     const int8_t *modifier_table = eac_modifier_table[modifier_index];
     int multiplier_times_8 = (qword & 0x00F0000000000000) >> (52 - 3);
     if (multiplier_times_8 == 0) multiplier_times_8 = 1;
+    uint16_t palette[8];
+    for (int k = 0; k < 8; k++) {
+        int value = ClampMinus1023To1023(base_codeword_times_8 + modifier_table[k] * multiplier_times_8);
+        palette[k] = ReplicateSigned11BitsTo16Bits(value);
+    }
     uint16_t *buffer = (uint16_t *)pixel_buffer;
     for (int i = 0; i < 16; i++) {
         int pixel_index = (qword & (0x0000E00000000000 >> (i * 3))) >> (45 - i * 3);
-        int modifier = modifier_table[pixel_index];
-        int value = ClampMinus1023To1023(base_codeword_times_8 + modifier * multiplier_times_8);
-        uint32_t bits = ReplicateSigned11BitsTo16Bits(value);
-        buffer[(((i & 3) * 4 + ((i & 12) >> 2)) << shift) + offset] = bits;
+        buffer[(((i & 3) * 4 + ((i & 12) >> 2)) << shift) + offset] = palette[pixel_index];
     }
     return true;
 }
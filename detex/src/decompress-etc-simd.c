@@ -0,0 +1,622 @@
+/*
+
+Copyright (c) 2015 Harm Hanemaaijer <fgenfb@yahoo.com>
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+*/
+
+#include <string.h>
+
+#include "detex.h"
+
+#if defined(DETEX_ARCH_X86)
+#    include <immintrin.h>
+#elif defined(DETEX_ARCH_ARM64)
+#    include <arm_neon.h>
+#endif
+
+// Multi-block ETC1, ETC2, ETC2_PUNCHTHROUGH and ETC2_EAC decoders. The mode of
+// a block is decoded with scalar code into a palette of eight colors: the four
+// modified base colors of both subblocks in individual and differential mode,
+// the four paint colors in T and H mode. The components are left unclamped and
+// saturated to 0-255 with SIMD instructions when the palette is packed. The
+// sixteen pixels are then selected from the palette in the same way for every
+// mode; only planar mode blocks are interpolated instead.
+
+typedef bool (*DecompressBlockFuncType)(const uint8_t *bitstring,
+                                        uint32_t mode_mask,
+                                        uint32_t flags,
+                                        uint8_t *pixel_buffer);
+
+static const int complement3bit_table[8] = {0, 1, 2, 3, -4, -3, -2, -1};
+
+static const int modifier_table[8][4] = {{2, 8, -2, -8},
+                                         {5, 17, -5, -17},
+                                         {9, 29, -9, -29},
+                                         {13, 42, -13, -42},
+                                         {18, 60, -18, -60},
+                                         {24, 80, -24, -80},
+                                         {33, 106, -33, -106},
+                                         {47, 183, -47, -183}};
+
+static const int punchthrough_modifier_table[8][4] = {{0, 8, 0, -8},
+                                                      {0, 17, 0, -17},
+                                                      {0, 29, 0, -29},
+                                                      {0, 42, 0, -42},
+                                                      {0, 60, 0, -60},
+                                                      {0, 80, 0, -80},
+                                                      {0, 106, 0, -106},
+                                                      {0, 183, 0, -183}};
+
+static const int etc2_distance_table[8] = {3, 6, 11, 16, 23, 32, 41, 64};
+
+static const int8_t eac_modifier_table[16][8] = {{-3, -6, -9, -15, 2, 5, 8, 14},
+                                                 {-3, -7, -10, -13, 2, 6, 9, 12},
+                                                 {-2, -5, -8, -13, 1, 4, 7, 12},
+                                                 {-2, -4, -6, -13, 1, 3, 5, 12},
+                                                 {-3, -6, -8, -12, 2, 5, 7, 11},
+                                                 {-3, -7, -9, -11, 2, 6, 8, 10},
+                                                 {-4, -7, -8, -11, 3, 6, 7, 10},
+                                                 {-3, -5, -8, -11, 2, 4, 7, 10},
+                                                 {-2, -6, -8, -10, 1, 5, 7, 9},
+                                                 {-2, -5, -8, -10, 1, 4, 7, 9},
+                                                 {-2, -4, -8, -10, 1, 3, 7, 9},
+                                                 {-2, -5, -7, -10, 1, 4, 6, 9},
+                                                 {-3, -4, -7, -10, 2, 3, 6, 9},
+                                                 {-1, -2, -3, -10, 0, 1, 2, 9},
+                                                 {-4, -6, -8, -9, 3, 5, 7, 8},
+                                                 {-3, -5, -7, -9, 2, 4, 6, 8}};
+
+// How the pixels of a block are decoded.
+enum {
+    // The pixels are selected from the palette.
+    BLOCK_TYPE_PALETTE,
+    // Planar mode, the pixels are interpolated.
+    BLOCK_TYPE_PLANAR,
+    // ETC1 block with an out of range differential color.
+    BLOCK_TYPE_INVALID,
+};
+
+typedef struct {
+    // Eight unclamped RGBA colors. In planar mode, the first two entries hold the components
+    // of the pixels (0, 0) and (1, 0) times four plus two (for rounding), the next two the
+    // increments for two pixels to the right and the two after that for one pixel down.
+    int16_t palette[8][4];
+    // Bits i and i + 16 are the least and most significant bit of the palette index of
+    // pixel i, the pixels being numbered column by column.
+    uint32_t pixel_index_word;
+    // Bit i is set when pixel i selects from the second half of the palette.
+    uint32_t subblock_mask;
+} BlockETC;
+
+static inline uint32_t Load32BigEndian(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static inline int Extend4To8Bits(int x) { return x | (x << 4); }
+
+static inline int Extend5To8Bits(int x) { return (x << 3) | (x >> 2); }
+
+static inline int Extend6To8Bits(int x) { return (x << 2) | (x >> 4); }
+
+static inline int Extend7To8Bits(int x) { return (x << 1) | (x >> 6); }
+
+static inline void SetColor(int16_t *color, int r, int g, int b, int a) {
+    color[0] = r;
+    color[1] = g;
+    color[2] = b;
+    color[3] = a;
+}
+
+// Set four palette entries to a base color plus each of four modifiers.
+static inline void SetModifiedColors(int16_t (*palette)[4], int r, int g, int b, const int *modifiers) {
+    for (int k = 0; k < 4; k++) SetColor(palette[k], r + modifiers[k], g + modifiers[k], b + modifiers[k], 0xFF);
+}
+
+static void SetPaletteTOrHMode(const uint8_t *bitstring, bool t_mode, BlockETC *block) {
+    int16_t(*palette)[4] = block->palette;
+    if (t_mode) {
+        int r1 = Extend4To8Bits(((bitstring[0] & 0x18) >> 1) | (bitstring[0] & 0x3));
+        int g1 = Extend4To8Bits(bitstring[1] >> 4);
+        int b1 = Extend4To8Bits(bitstring[1] & 0x0F);
+        int r2 = Extend4To8Bits(bitstring[2] >> 4);
+        int g2 = Extend4To8Bits(bitstring[2] & 0x0F);
+        int b2 = Extend4To8Bits(bitstring[3] >> 4);
+        // index = (da << 1) | db
+        int distance = etc2_distance_table[((bitstring[3] & 0x0C) >> 1) | (bitstring[3] & 0x1)];
+        SetColor(palette[0], r1, g1, b1, 0xFF);
+        SetColor(palette[1], r2 + distance, g2 + distance, b2 + distance, 0xFF);
+        SetColor(palette[2], r2, g2, b2, 0xFF);
+        SetColor(palette[3], r2 - distance, g2 - distance, b2 - distance, 0xFF);
+    } else {
+        int r1 = Extend4To8Bits((bitstring[0] & 0x78) >> 3);
+        int g1 = Extend4To8Bits(((bitstring[0] & 0x07) << 1) | ((bitstring[1] & 0x10) >> 4));
+        int b1 = Extend4To8Bits((bitstring[1] & 0x08) | ((bitstring[1] & 0x03) << 1) | ((bitstring[2] & 0x80) >> 7));
+        int r2 = Extend4To8Bits((bitstring[2] & 0x78) >> 3);
+        int g2 = Extend4To8Bits(((bitstring[2] & 0x07) << 1) | ((bitstring[3] & 0x80) >> 7));
+        int b2 = Extend4To8Bits((bitstring[3] & 0x78) >> 3);
+        // da is most significant bit, db is middle bit, least significant bit is
+        // (base_color1 value >= base_color2 value).
+        int bit = (r1 << 16) + (g1 << 8) + b1 >= (r2 << 16) + (g2 << 8) + b2;
+        int distance = etc2_distance_table[(bitstring[3] & 0x04) | ((bitstring[3] & 0x01) << 1) | bit];
+        SetColor(palette[0], r1 + distance, g1 + distance, b1 + distance, 0xFF);
+        SetColor(palette[1], r1 - distance, g1 - distance, b1 - distance, 0xFF);
+        SetColor(palette[2], r2 + distance, g2 + distance, b2 + distance, 0xFF);
+        SetColor(palette[3], r2 - distance, g2 - distance, b2 - distance, 0xFF);
+    }
+    memcpy(palette[4], palette[0], sizeof(palette[0]) * 4);
+    block->subblock_mask = 0;
+}
+
+static void SetPlanarMode(const uint8_t *bitstring, BlockETC *block) {
+    // Each color O, H and V is in 6-7-6 format.
+    int o[4], h[4], v[4];
+    o[0] = Extend6To8Bits((bitstring[0] & 0x7E) >> 1);
+    o[1] = Extend7To8Bits(((bitstring[0] & 0x1) << 6) | ((bitstring[1] & 0x7E) >> 1));
+    o[2] = Extend6To8Bits(((bitstring[1] & 0x1) << 5) | (bitstring[2] & 0x18) | ((bitstring[2] & 0x03) << 1) |
+                          ((bitstring[3] & 0x80) >> 7));
+    h[0] = Extend6To8Bits(((bitstring[3] & 0x7C) >> 1) | (bitstring[3] & 0x1));
+    h[1] = Extend7To8Bits((bitstring[4] & 0xFE) >> 1);
+    h[2] = Extend6To8Bits(((bitstring[4] & 0x1) << 5) | ((bitstring[5] & 0xF8) >> 3));
+    v[0] = Extend6To8Bits(((bitstring[5] & 0x7) << 3) | ((bitstring[6] & 0xE0) >> 5));
+    v[1] = Extend7To8Bits(((bitstring[6] & 0x1F) << 2) | ((bitstring[7] & 0xC0) >> 6));
+    v[2] = Extend6To8Bits(bitstring[7] & 0x3F);
+    o[3] = h[3] = v[3] = 0xFF;
+    // A component is (4 * O + x * (H - O) + y * (V - O) + 2) >> 2.
+    for (int j = 0; j < 4; j++) {
+        block->palette[0][j] = 4 * o[j] + 2;
+        block->palette[1][j] = 4 * o[j] + 2 + h[j] - o[j];
+        block->palette[2][j] = block->palette[3][j] = 2 * (h[j] - o[j]);
+        block->palette[4][j] = block->palette[5][j] = v[j] - o[j];
+    }
+}
+
+// Decode the mode and colors of the 64-bit color part of a block.
+DETEX_ALWAYS_INLINE int DecodeBlockETC(const uint8_t *bitstring, uint32_t compressed_format, BlockETC *block) {
+    bool punchthrough = compressed_format == DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_ETC2_PUNCHTHROUGH;
+    // ETC2_PUNCHTHROUGH has no individual mode, the bit selects punchthrough alpha instead.
+    bool differential = punchthrough || (bitstring[3] & 2);
+    bool opaque = !punchthrough || (bitstring[3] & 2);
+    block->pixel_index_word = Load32BigEndian(bitstring + 4);
+    int r1, g1, b1, r2, g2, b2;
+    if (differential) {
+        r1 = bitstring[0] >> 3;
+        g1 = bitstring[1] >> 3;
+        b1 = bitstring[2] >> 3;
+        r2 = r1 + complement3bit_table[bitstring[0] & 7];
+        g2 = g1 + complement3bit_table[bitstring[1] & 7];
+        b2 = b1 + complement3bit_table[bitstring[2] & 7];
+        bool r_overflow = r2 < 0 || r2 > 31;
+        bool g_overflow = g2 < 0 || g2 > 31;
+        bool b_overflow = b2 < 0 || b2 > 31;
+        if (compressed_format == DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_ETC1) {
+            if (r_overflow || g_overflow || b_overflow) return BLOCK_TYPE_INVALID;
+        } else if (r_overflow || g_overflow) {
+            SetPaletteTOrHMode(bitstring, r_overflow, block);
+            if (!opaque) SetColor(block->palette[2], 0, 0, 0, 0);
+            return BLOCK_TYPE_PALETTE;
+        } else if (b_overflow) {
+            SetPlanarMode(bitstring, block);
+            return BLOCK_TYPE_PLANAR;
+        }
+        r1 = Extend5To8Bits(r1);
+        g1 = Extend5To8Bits(g1);
+        b1 = Extend5To8Bits(b1);
+        r2 = Extend5To8Bits(r2);
+        g2 = Extend5To8Bits(g2);
+        b2 = Extend5To8Bits(b2);
+    } else {
+        r1 = Extend4To8Bits(bitstring[0] >> 4);
+        g1 = Extend4To8Bits(bitstring[1] >> 4);
+        b1 = Extend4To8Bits(bitstring[2] >> 4);
+        r2 = Extend4To8Bits(bitstring[0] & 0x0F);
+        g2 = Extend4To8Bits(bitstring[1] & 0x0F);
+        b2 = Extend4To8Bits(bitstring[2] & 0x0F);
+    }
+    const int(*modifiers)[4] = opaque ? modifier_table : punchthrough_modifier_table;
+    SetModifiedColors(block->palette, r1, g1, b1, modifiers[(bitstring[3] & 224) >> 5]);
+    SetModifiedColors(block->palette + 4, r2, g2, b2, modifiers[(bitstring[3] & 28) >> 2]);
+    if (!opaque) {
+        SetColor(block->palette[2], 0, 0, 0, 0);
+        SetColor(block->palette[6], 0, 0, 0, 0);
+    }
+    // The second subblock is the right half of the block, or the bottom half when flipped.
+    block->subblock_mask = (bitstring[3] & 1) ? 0xCCCC : 0xFF00;
+    return BLOCK_TYPE_PALETTE;
+}
+
+// Calculate the eight alpha values of an EAC block, stored in the alpha component.
+static inline void CalculateAlphaPaletteEAC(const uint8_t *bitstring, uint32_t *palette) {
+    int base_codeword = bitstring[0];
+    int multiplier = bitstring[1] >> 4;
+    const int8_t *modifiers = eac_modifier_table[bitstring[1] & 0x0F];
+    for (int k = 0; k < 8; k++) {
+        int alpha = base_codeword + modifiers[k] * multiplier;
+        palette[k] = detexPack32RGBA8(0, 0, 0, alpha < 0 ? 0 : alpha > 255 ? 255 : alpha);
+    }
+}
+
+// The twelve bits of alpha indices of each column of an EAC block. The index of the pixel in
+// row y is stored in bits 9 - 3 * y to 11 - 3 * y.
+static inline void GetAlphaColumnsEAC(const uint8_t *bitstring, uint32_t *columns) {
+    uint64_t bits = ((uint64_t)bitstring[2] << 40) | ((uint64_t)Load32BigEndian(bitstring + 3) << 8) | bitstring[7];
+    for (int x = 0; x < 4; x++) columns[x] = (bits >> (36 - x * 12)) & 0xFFF;
+}
+
+// Scalar versions, used when no SIMD instruction set is available.
+
+// Decompress blocks one by one with the given flags, setting blocks that fail to zero.
+static bool DecompressBlocksWithFlags(DecompressBlockFuncType func,
+                                      const uint8_t *bitstring,
+                                      int block_size,
+                                      int nu_blocks,
+                                      uint32_t flags,
+                                      uint8_t *pixel_buffer) {
+    bool result = true;
+    for (int i = 0; i < nu_blocks; i++)
+        if (!func(bitstring + i * block_size, DETEX_MODE_MASK_ALL, flags, pixel_buffer + i * 64)) {
+            memset(pixel_buffer + i * 64, 0, 64);
+            result = false;
+        }
+    return result;
+}
+
+static bool DecompressBlocksETC1Scalar(const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {
+    return DecompressBlocksWithFlags(detexDecompressBlockETC1, bitstring, 8, nu_blocks, 0, pixel_buffer);
+}
+
+static bool DecompressBlocksETC2Scalar(const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {
+    return DecompressBlocksWithFlags(detexDecompressBlockETC2, bitstring, 8, nu_blocks, 0, pixel_buffer);
+}
+
+static bool DecompressBlocksETC2_PUNCHTHROUGHScalar(const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {
+    return DecompressBlocksWithFlags(
+        detexDecompressBlockETC2_PUNCHTHROUGH, bitstring, 8, nu_blocks, 0, pixel_buffer);
+}
+
+static bool DecompressBlocksETC2_EACScalar(const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {
+    return DecompressBlocksWithFlags(detexDecompressBlockETC2_EAC, bitstring, 16, nu_blocks, 0, pixel_buffer);
+}
+
+// Define the multi-block functions of a SIMD level from its StorePaletteBlock,
+// StorePlanarBlock and AddAlphaEAC functions. DecompressColorBlocks decodes the
+// last eight bytes of blocks of block_size bytes as blocks of compressed_format.
+#define DEFINE_DECOMPRESS_BLOCKS_FUNCTIONS(level, target)                                                    \
+    target static bool DecompressColorBlocks##level(const uint8_t *bitstring,                                \
+                                                    int block_size,                                          \
+                                                    int nu_blocks,                                           \
+                                                    uint32_t compressed_format,                              \
+                                                    uint8_t *pixel_buffer) {                                 \
+        bool result = true;                                                                                  \
+        for (int i = 0; i < nu_blocks; i++) {                                                                \
+            const uint8_t *color_bits = bitstring + i * block_size + block_size - 8;                         \
+            uint8_t *tile = pixel_buffer + i * 64;                                                           \
+            BlockETC block;                                                                                  \
+            switch (DecodeBlockETC(color_bits, compressed_format, &block)) {                                 \
+                case BLOCK_TYPE_PALETTE:                                                                     \
+                    StorePaletteBlock##level(&block, tile);                                                  \
+                    break;                                                                                   \
+                case BLOCK_TYPE_PLANAR:                                                                      \
+                    StorePlanarBlock##level(&block, tile);                                                   \
+                    break;                                                                                   \
+                default:                                                                                     \
+                    memset(tile, 0, 64);                                                                     \
+                    result = false;                                                                          \
+                    break;                                                                                   \
+            }                                                                                                \
+        }                                                                                                    \
+        return result;                                                                                       \
+    }                                                                                                        \
+    target static bool DecompressBlocksETC1##level(                                                          \
+        const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {                                    \
+        return DecompressColorBlocks##level(                                                                 \
+            bitstring, 8, nu_blocks, DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_ETC1, pixel_buffer);              \
+    }                                                                                                        \
+    target static bool DecompressBlocksETC2##level(                                                          \
+        const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {                                    \
+        return DecompressColorBlocks##level(                                                                 \
+            bitstring, 8, nu_blocks, DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_ETC2, pixel_buffer);              \
+    }                                                                                                        \
+    target static bool DecompressBlocksETC2_PUNCHTHROUGH##level(                                             \
+        const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {                                    \
+        return DecompressColorBlocks##level(                                                                 \
+            bitstring, 8, nu_blocks, DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_ETC2_PUNCHTHROUGH, pixel_buffer); \
+    }                                                                                                        \
+    target static bool DecompressBlocksETC2_EAC##level(                                                      \
+        const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {                                    \
+        DecompressColorBlocks##level(                                                                        \
+            bitstring, 16, nu_blocks, DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_ETC2, pixel_buffer);             \
+        AddAlphaEAC##level(bitstring, nu_blocks, pixel_buffer);                                              \
+        return true;                                                                                         \
+    }
+
+#ifdef DETEX_ARCH_X86
+
+// SSE2 has no variable shifts or shuffles, so a palette entry is selected with
+// a tree of bitwise selections, one level for every bit of the palette index.
+
+// Pack the palette of a block into eight RGBA8 colors, saturating the components.
+// The colors are returned in registers, which avoids reloading them from memory
+// with a differently sized load.
+DETEX_TARGET("sse2")
+static inline void PackPaletteSSE2(const BlockETC *block, __m128i *low, __m128i *high) {
+    const __m128i *components = (const __m128i *)block->palette;
+    *low = _mm_packus_epi16(_mm_loadu_si128(components), _mm_loadu_si128(components + 1));
+    *high = _mm_packus_epi16(_mm_loadu_si128(components + 2), _mm_loadu_si128(components + 3));
+}
+
+// Select b where the bits of mask are set and a elsewhere.
+DETEX_TARGET("sse2")
+static inline __m128i SelectSSE2(__m128i mask, __m128i a, __m128i b) {
+    return _mm_or_si128(_mm_andnot_si128(mask, a), _mm_and_si128(mask, b));
+}
+
+// Return all ones in the lanes of value in which the bit of the lane of bits is set.
+DETEX_TARGET("sse2")
+static inline __m128i TestBitsSSE2(__m128i value, __m128i bits) {
+    return _mm_cmpeq_epi32(_mm_and_si128(value, bits), bits);
+}
+
+// Select the palette entries of four pixels, the three bits of the indices
+// given as masks (see TestBitsSSE2).
+DETEX_TARGET("sse2")
+static inline __m128i SelectFromPaletteSSE2(__m128i bit0, __m128i bit1, __m128i bit2, const __m128i *palette) {
+    __m128i c0 = SelectSSE2(bit0, palette[0], palette[1]);
+    __m128i c1 = SelectSSE2(bit0, palette[2], palette[3]);
+    __m128i c2 = SelectSSE2(bit0, palette[4], palette[5]);
+    __m128i c3 = SelectSSE2(bit0, palette[6], palette[7]);
+    return SelectSSE2(bit2, SelectSSE2(bit1, c0, c1), SelectSSE2(bit1, c2, c3));
+}
+
+DETEX_TARGET("sse2")
+static void StorePaletteBlockSSE2(const BlockETC *block, uint8_t *pixel_buffer) {
+    __m128i low, high;
+    PackPaletteSSE2(block, &low, &high);
+    __m128i palette[8] = {_mm_shuffle_epi32(low, 0x00),
+                          _mm_shuffle_epi32(low, 0x55),
+                          _mm_shuffle_epi32(low, 0xAA),
+                          _mm_shuffle_epi32(low, 0xFF),
+                          _mm_shuffle_epi32(high, 0x00),
+                          _mm_shuffle_epi32(high, 0x55),
+                          _mm_shuffle_epi32(high, 0xAA),
+                          _mm_shuffle_epi32(high, 0xFF)};
+    __m128i index_word = _mm_set1_epi32(block->pixel_index_word);
+    __m128i subblock_mask = _mm_set1_epi32(block->subblock_mask);
+    // The bits of the four pixels of a row, which are numbered column by column.
+    __m128i bits = _mm_setr_epi32(0x0001, 0x0010, 0x0100, 0x1000);
+    __m128i *out = (__m128i *)pixel_buffer;
+    for (int y = 0; y < 4; y++) {
+        __m128i lsb = TestBitsSSE2(index_word, bits);
+        __m128i msb = TestBitsSSE2(index_word, _mm_slli_epi32(bits, 16));
+        __m128i subblock = TestBitsSSE2(subblock_mask, bits);
+        _mm_storeu_si128(out + y, SelectFromPaletteSSE2(lsb, msb, subblock, palette));
+        bits = _mm_add_epi32(bits, bits);
+    }
+}
+
+// Interpolate the pixels of a planar mode block in 16-bit components, two pixels
+// at a time. Negative components and components above 255 are saturated when packing.
+DETEX_TARGET("sse2")
+static void StorePlanarBlockSSE2(const BlockETC *block, uint8_t *pixel_buffer) {
+    const __m128i *components = (const __m128i *)block->palette;
+    __m128i row = _mm_loadu_si128(components);
+    __m128i step_x = _mm_loadu_si128(components + 1);
+    __m128i step_y = _mm_loadu_si128(components + 2);
+    __m128i *out = (__m128i *)pixel_buffer;
+    for (int y = 0; y < 4; y++) {
+        __m128i left = _mm_srai_epi16(row, 2);
+        __m128i right = _mm_srai_epi16(_mm_add_epi16(row, step_x), 2);
+        _mm_storeu_si128(out + y, _mm_packus_epi16(left, right));
+        row = _mm_add_epi16(row, step_y);
+    }
+}
+
+// Replace the alpha of ETC2_EAC blocks with the decompressed EAC alpha. Without
+// shuffles a selection tree costs more than storing the alpha bytes one by one.
+DETEX_TARGET("sse2")
+static void AddAlphaEACSSE2(const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {
+    for (int i = 0; i < nu_blocks; i++) {
+        uint32_t alpha_palette[8];
+        CalculateAlphaPaletteEAC(bitstring + i * 16, alpha_palette);
+        uint32_t columns[4];
+        GetAlphaColumnsEAC(bitstring + i * 16, columns);
+        uint8_t *tile = pixel_buffer + i * 64;
+        for (int x = 0; x < 4; x++)
+            for (int y = 0; y < 4; y++)
+                tile[(y * 4 + x) * 4 + 3] = alpha_palette[(columns[x] >> (9 - y * 3)) & 7] >> 24;
+    }
+}
+
+// AVX2 selects the entries of eight pixels at a time with variable shifts and a
+// permute. Planar mode blocks are interpolated as with SSE2.
+
+DETEX_TARGET("avx2")
+static void StorePaletteBlockAVX2(const BlockETC *block, uint8_t *pixel_buffer) {
+    __m128i low, high;
+    PackPaletteSSE2(block, &low, &high);
+    __m256i palette = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+    __m256i index_word = _mm256_set1_epi32(block->pixel_index_word);
+    __m256i subblock_mask = _mm256_set1_epi32(block->subblock_mask << 2);
+    // The numbers of the pixels of two rows, which are numbered column by column.
+    __m256i shifts = _mm256_setr_epi32(0, 4, 8, 12, 1, 5, 9, 13);
+    __m256i *out = (__m256i *)pixel_buffer;
+    for (int j = 0; j < 2; j++) {
+        __m256i lsb = _mm256_and_si256(_mm256_srlv_epi32(index_word, shifts), _mm256_set1_epi32(1));
+        __m256i msb = _mm256_and_si256(_mm256_srlv_epi32(index_word, _mm256_add_epi32(shifts, _mm256_set1_epi32(15))),
+                                       _mm256_set1_epi32(2));
+        __m256i subblock = _mm256_and_si256(_mm256_srlv_epi32(subblock_mask, shifts), _mm256_set1_epi32(4));
+        __m256i index = _mm256_or_si256(_mm256_or_si256(lsb, msb), subblock);
+        _mm256_storeu_si256(out + j, _mm256_permutevar8x32_epi32(palette, index));
+        shifts = _mm256_add_epi32(shifts, _mm256_set1_epi32(2));
+    }
+}
+
+DETEX_TARGET("avx2")
+static void StorePlanarBlockAVX2(const BlockETC *block, uint8_t *pixel_buffer) {
+    StorePlanarBlockSSE2(block, pixel_buffer);
+}
+
+DETEX_TARGET("avx2")
+static void AddAlphaEACAVX2(const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {
+    for (int i = 0; i < nu_blocks; i++) {
+        uint32_t alpha_palette[8];
+        CalculateAlphaPaletteEAC(bitstring + i * 16, alpha_palette);
+        __m256i palette = _mm256_loadu_si256((const __m256i *)alpha_palette);
+        uint32_t column_values[4];
+        GetAlphaColumnsEAC(bitstring + i * 16, column_values);
+        __m256i columns = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)column_values));
+        __m256i shifts = _mm256_setr_epi32(9, 9, 9, 9, 6, 6, 6, 6);
+        __m256i *out = (__m256i *)(pixel_buffer + i * 64);
+        for (int j = 0; j < 2; j++) {
+            __m256i index = _mm256_and_si256(_mm256_srlv_epi32(columns, shifts), _mm256_set1_epi32(0x7));
+            __m256i alpha = _mm256_permutevar8x32_epi32(palette, index);
+            __m256i color = _mm256_and_si256(_mm256_loadu_si256(out + j), _mm256_set1_epi32(0x00FFFFFF));
+            _mm256_storeu_si256(out + j, _mm256_or_si256(color, alpha));
+            shifts = _mm256_sub_epi32(shifts, _mm256_set1_epi32(6));
+        }
+    }
+}
+
+DEFINE_DECOMPRESS_BLOCKS_FUNCTIONS(SSE2, DETEX_TARGET("sse2"))
+DEFINE_DECOMPRESS_BLOCKS_FUNCTIONS(AVX2, DETEX_TARGET("avx2"))
+
+#endif
+
+#ifdef DETEX_ARCH_ARM64
+
+// NEON looks up the bytes of four pixels at a time with a table lookup in the
+// 32-byte palette.
+
+static void StorePaletteBlockNEON(const BlockETC *block, uint8_t *pixel_buffer) {
+    const int16_t *components = block->palette[0];
+    uint8x16x2_t palette;
+    palette.val[0] = vcombine_u8(vqmovun_s16(vld1q_s16(components)), vqmovun_s16(vld1q_s16(components + 8)));
+    palette.val[1] = vcombine_u8(vqmovun_s16(vld1q_s16(components + 16)), vqmovun_s16(vld1q_s16(components + 24)));
+    // Minus the numbers of the pixels of a row, which are numbered column by column.
+    const int32_t shift_values[4] = {0, -4, -8, -12};
+    int32x4_t shifts = vld1q_s32(shift_values);
+    uint32x4_t index_word = vdupq_n_u32(block->pixel_index_word);
+    uint32x4_t subblock_mask = vdupq_n_u32(block->subblock_mask << 2);
+    for (int y = 0; y < 4; y++) {
+        uint32x4_t lsb = vandq_u32(vshlq_u32(index_word, shifts), vdupq_n_u32(1));
+        uint32x4_t msb = vandq_u32(vshlq_u32(index_word, vsubq_s32(shifts, vdupq_n_s32(15))), vdupq_n_u32(2));
+        uint32x4_t subblock = vandq_u32(vshlq_u32(subblock_mask, shifts), vdupq_n_u32(4));
+        uint32x4_t index = vorrq_u32(vorrq_u32(lsb, msb), subblock);
+        // Byte k of pixel with index n is byte n * 4 + k of the palette.
+        uint32x4_t bytes = vaddq_u32(vmulq_n_u32(index, 0x04040404), vdupq_n_u32(0x03020100));
+        vst1q_u8(pixel_buffer + y * 16, vqtbl2q_u8(palette, vreinterpretq_u8_u32(bytes)));
+        shifts = vsubq_s32(shifts, vdupq_n_s32(1));
+    }
+}
+
+static void StorePlanarBlockNEON(const BlockETC *block, uint8_t *pixel_buffer) {
+    const int16_t *components = block->palette[0];
+    int16x8_t row = vld1q_s16(components);
+    int16x8_t step_x = vld1q_s16(components + 8);
+    int16x8_t step_y = vld1q_s16(components + 16);
+    for (int y = 0; y < 4; y++) {
+        uint8x8_t left = vqmovun_s16(vshrq_n_s16(row, 2));
+        uint8x8_t right = vqmovun_s16(vshrq_n_s16(vaddq_s16(row, step_x), 2));
+        vst1q_u8(pixel_buffer + y * 16, vcombine_u8(left, right));
+        row = vaddq_s16(row, step_y);
+    }
+}
+
+static void AddAlphaEACNEON(const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {
+    for (int i = 0; i < nu_blocks; i++) {
+        uint32_t palette[8];
+        CalculateAlphaPaletteEAC(bitstring + i * 16, palette);
+        uint8_t alpha_values[16] = {0};
+        for (int k = 0; k < 8; k++) alpha_values[k] = palette[k] >> 24;
+        uint8x16_t p = vld1q_u8(alpha_values);
+        uint32_t column_values[4];
+        GetAlphaColumnsEAC(bitstring + i * 16, column_values);
+        uint32x4_t columns = vld1q_u32(column_values);
+        for (int y = 0; y < 4; y++) {
+            uint32x4_t index = vandq_u32(vshlq_u32(columns, vdupq_n_s32(-(9 - y * 3))), vdupq_n_u32(0x7));
+            // Look up the alpha byte only, out of range indices give zero.
+            uint32x4_t bytes = vorrq_u32(vshlq_n_u32(index, 24), vdupq_n_u32(0x00FFFFFF));
+            uint32x4_t alpha = vreinterpretq_u32_u8(vqtbl1q_u8(p, vreinterpretq_u8_u32(bytes)));
+            uint32_t *out = (uint32_t *)(pixel_buffer + i * 64 + y * 16);
+            vst1q_u32(out, vorrq_u32(vandq_u32(vld1q_u32(out), vdupq_n_u32(0x00FFFFFF)), alpha));
+        }
+    }
+}
+
+DEFINE_DECOMPRESS_BLOCKS_FUNCTIONS(NEON, )
+
+#endif
+
+typedef struct {
+    detexDecompressBlocksFuncType etc1;
+    detexDecompressBlocksFuncType etc2;
+    detexDecompressBlocksFuncType etc2_punchthrough;
+    detexDecompressBlocksFuncType etc2_eac;
+} DecompressBlocksFunctions;
+
+// Indexed by SIMD level.
+static const DecompressBlocksFunctions decompress_blocks_functions[] = {
+    [DETEX_SIMD_LEVEL_NONE] = {DecompressBlocksETC1Scalar,
+                               DecompressBlocksETC2Scalar,
+                               DecompressBlocksETC2_PUNCHTHROUGHScalar,
+                               DecompressBlocksETC2_EACScalar},
+#ifdef DETEX_ARCH_X86
+    [DETEX_SIMD_LEVEL_SSE2] = {DecompressBlocksETC1SSE2,
+                               DecompressBlocksETC2SSE2,
+                               DecompressBlocksETC2_PUNCHTHROUGHSSE2,
+                               DecompressBlocksETC2_EACSSE2},
+    [DETEX_SIMD_LEVEL_AVX2] = {DecompressBlocksETC1AVX2,
+                               DecompressBlocksETC2AVX2,
+                               DecompressBlocksETC2_PUNCHTHROUGHAVX2,
+                               DecompressBlocksETC2_EACAVX2},
+#endif
+#ifdef DETEX_ARCH_ARM64
+    [DETEX_SIMD_LEVEL_NEON] = {DecompressBlocksETC1NEON,
+                               DecompressBlocksETC2NEON,
+                               DecompressBlocksETC2_PUNCHTHROUGHNEON,
+                               DecompressBlocksETC2_EACNEON},
+#endif
+};
+
+/* Decompress nu_blocks consecutive ETC1 blocks. */
+bool detexDecompressBlocksETC1(const uint8_t *bitstring, int nu_blocks, uint32_t flags, uint8_t *pixel_buffer) {
+    if (flags != 0)
+        return DecompressBlocksWithFlags(detexDecompressBlockETC1, bitstring, 8, nu_blocks, flags, pixel_buffer);
+    return decompress_blocks_functions[detexGetSIMDLevel()].etc1(bitstring, nu_blocks, pixel_buffer);
+}
+
+/* Decompress nu_blocks consecutive ETC2 blocks. */
+bool detexDecompressBlocksETC2(const uint8_t *bitstring, int nu_blocks, uint32_t flags, uint8_t *pixel_buffer) {
+    if (flags != 0)
+        return DecompressBlocksWithFlags(detexDecompressBlockETC2, bitstring, 8, nu_blocks, flags, pixel_buffer);
+    return decompress_blocks_functions[detexGetSIMDLevel()].etc2(bitstring, nu_blocks, pixel_buffer);
+}
+
+/* Decompress nu_blocks consecutive ETC2_PUNCHTHROUGH blocks. */
+bool detexDecompressBlocksETC2_PUNCHTHROUGH(const uint8_t *bitstring,
+                                            int nu_blocks,
+                                            uint32_t flags,
+                                            uint8_t *pixel_buffer) {
+    if (flags != 0)
+        return DecompressBlocksWithFlags(
+            detexDecompressBlockETC2_PUNCHTHROUGH, bitstring, 8, nu_blocks, flags, pixel_buffer);
+    return decompress_blocks_functions[detexGetSIMDLevel()].etc2_punchthrough(bitstring, nu_blocks, pixel_buffer);
+}
+
+/* Decompress nu_blocks consecutive ETC2_EAC blocks. */
+bool detexDecompressBlocksETC2_EAC(const uint8_t *bitstring, int nu_blocks, uint32_t flags, uint8_t *pixel_buffer) {
+    if (flags != 0)
+        return DecompressBlocksWithFlags(detexDecompressBlockETC2_EAC, bitstring, 16, nu_blocks, flags, pixel_buffer);
+    return decompress_blocks_functions[detexGetSIMDLevel()].etc2_eac(bitstring, nu_blocks, pixel_buffer);
+}
@@ -0,0 +1,634 @@
+/*
+
+Copyright (c) 2015 Harm Hanemaaijer <fgenfb@yahoo.com>
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+*/
+
+#include <string.h>
+
+#include "detex.h"
+
+#if defined(DETEX_ARCH_X86)
+#    include <immintrin.h>
+#elif defined(DETEX_ARCH_ARM64)
+#    include <arm_neon.h>
+#endif
+
+// Multi-block decoders of the single channel formats: RGTC1 and RGTC2 (BC4 and
+// BC5), their signed variants, and EAC R11 and RG11. The eight values a channel
+// of a block can take are calculated once per block. The sixteen 3-bit indices
+// are then extracted with a byte shuffle and a multiply (a variable shift in
+// every 16-bit lane), and looked up in the palette with another byte shuffle.
+
+typedef bool (*DecompressBlockFuncType)(const uint8_t *bitstring,
+                                        uint32_t mode_mask,
+                                        uint32_t flags,
+                                        uint8_t *pixel_buffer);
+
+static const int8_t eac_modifier_table[16][8] = {{-3, -6, -9, -15, 2, 5, 8, 14},
+                                                 {-3, -7, -10, -13, 2, 6, 9, 12},
+                                                 {-2, -5, -8, -13, 1, 4, 7, 12},
+                                                 {-2, -4, -6, -13, 1, 3, 5, 12},
+                                                 {-3, -6, -8, -12, 2, 5, 7, 11},
+                                                 {-3, -7, -9, -11, 2, 6, 8, 10},
+                                                 {-4, -7, -8, -11, 3, 6, 7, 10},
+                                                 {-3, -5, -8, -11, 2, 4, 7, 10},
+                                                 {-2, -6, -8, -10, 1, 5, 7, 9},
+                                                 {-2, -5, -8, -10, 1, 4, 7, 9},
+                                                 {-2, -4, -8, -10, 1, 3, 7, 9},
+                                                 {-2, -5, -7, -10, 1, 4, 6, 9},
+                                                 {-3, -4, -7, -10, 2, 3, 6, 9},
+                                                 {-1, -2, -3, -10, 0, 1, 2, 9},
+                                                 {-4, -6, -8, -9, 3, 5, 7, 8},
+                                                 {-3, -5, -7, -9, 2, 4, 6, 8}};
+
+// For every pixel, in row-major order, the two bytes of the block that hold its
+// index, and the multiplier that moves the index to bits 13-15 of the 16-bit word
+// formed by them.
+typedef struct {
+    uint8_t bytes[32];
+    uint16_t multipliers[16];
+} IndexLayout;
+
+// The indices of RGTC blocks are stored from the least significant bit of the
+// little-endian block onwards, row by row.
+static const IndexLayout rgtc_index_layout = {
+    {2, 3, 2, 3, 2, 3, 3, 4, 3, 4, 3, 4, 4, 5, 4, 5, 5, 6, 5, 6, 5, 6, 6, 7, 6, 7, 6, 7, 6, 7, 6, 7},
+    {8192, 1024, 128, 4096, 512, 64, 2048, 256, 8192, 1024, 128, 4096, 512, 64, 8, 1}};
+
+// The indices of EAC blocks are stored from the most significant bit of the
+// big-endian block onwards, column by column.
+static const IndexLayout eac_index_layout = {
+    {3, 2, 4, 3, 6, 5, 7, 6, 3, 2, 4, 3, 6, 5, 7, 6, 3, 2, 5, 4, 6, 5, 7, 6, 4, 3, 5, 4, 7, 6, 7, 6},
+    {1, 16, 1, 16, 8, 128, 8, 128, 64, 4, 64, 1024, 2, 32, 2, 8192}};
+
+static inline uint64_t Load64(const uint8_t *p) {
+    uint64_t value;
+    memcpy(&value, p, 8);
+    return value;
+}
+
+// Scalar versions, also used for SSE2, which has no byte shuffle: looking up the
+// palette with a tree of selections is not faster than the scalar lookups.
+
+// Decompress blocks one by one with the given flags, setting blocks that fail to zero.
+static bool DecompressBlocksWithFlags(DecompressBlockFuncType func,
+                                      const uint8_t *bitstring,
+                                      int block_size,
+                                      int tile_size,
+                                      int nu_blocks,
+                                      uint32_t flags,
+                                      uint8_t *pixel_buffer) {
+    bool result = true;
+    for (int i = 0; i < nu_blocks; i++)
+        if (!func(bitstring + i * block_size, DETEX_MODE_MASK_ALL, flags, pixel_buffer + i * tile_size)) {
+            memset(pixel_buffer + i * tile_size, 0, tile_size);
+            result = false;
+        }
+    return result;
+}
+
+static bool DecompressBlocksRGTC1Scalar(const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {
+    return DecompressBlocksWithFlags(detexDecompressBlockRGTC1, bitstring, 8, 16, nu_blocks, 0, pixel_buffer);
+}
+
+static bool DecompressBlocksRGTC2Scalar(const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {
+    return DecompressBlocksWithFlags(detexDecompressBlockRGTC2, bitstring, 16, 32, nu_blocks, 0, pixel_buffer);
+}
+
+static bool DecompressBlocksSIGNED_RGTC1Scalar(const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {
+    return DecompressBlocksWithFlags(
+        detexDecompressBlockSIGNED_RGTC1, bitstring, 8, 32, nu_blocks, 0, pixel_buffer);
+}
+
+static bool DecompressBlocksSIGNED_RGTC2Scalar(const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {
+    return DecompressBlocksWithFlags(
+        detexDecompressBlockSIGNED_RGTC2, bitstring, 16, 64, nu_blocks, 0, pixel_buffer);
+}
+
+static bool DecompressBlocksEAC_R11Scalar(const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {
+    return DecompressBlocksWithFlags(detexDecompressBlockEAC_R11, bitstring, 8, 32, nu_blocks, 0, pixel_buffer);
+}
+
+static bool DecompressBlocksEAC_RG11Scalar(const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {
+    return DecompressBlocksWithFlags(detexDecompressBlockEAC_RG11, bitstring, 16, 64, nu_blocks, 0, pixel_buffer);
+}
+
+static bool DecompressBlocksEAC_SIGNED_R11Scalar(const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {
+    return DecompressBlocksWithFlags(
+        detexDecompressBlockEAC_SIGNED_R11, bitstring, 8, 32, nu_blocks, 0, pixel_buffer);
+}
+
+static bool DecompressBlocksEAC_SIGNED_RG11Scalar(const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {
+    return DecompressBlocksWithFlags(
+        detexDecompressBlockEAC_SIGNED_RG11, bitstring, 16, 64, nu_blocks, 0, pixel_buffer);
+}
+
+// Define the multi-block functions of a SIMD level from its Palette type (the
+// eight values of a channel of a block) and CalculatePalette functions, which
+// return false if the compressed block is invalid, its Values8 and Values16 types
+// (the sixteen 8-bit or 16-bit values of a channel of a block), its GetIndices,
+// LookUp8 and LookUp16 functions, and its Store functions, of which the
+// Interleaved versions store the two channels of RGTC2 and EAC RG11 blocks.
+#define DEFINE_DECOMPRESS_BLOCKS_FUNCTIONS(level, target)                                                     \
+    target static inline bool DecompressBlocks8##level(const uint8_t *bitstring,                              \
+                                                       int nu_blocks,                                         \
+                                                       int nu_channels,                                       \
+                                                       uint8_t *pixel_buffer) {                               \
+        for (int i = 0; i < nu_blocks; i++) {                                                                 \
+            const uint8_t *block = bitstring + i * nu_channels * 8;                                           \
+            uint8_t *tile = pixel_buffer + i * nu_channels * 16;                                              \
+            Palette##level palette;                                                                           \
+            CalculatePaletteRGTC##level(block, &palette);                                                     \
+            Values8##level red = LookUp8##level(palette, GetIndices##level(block, &rgtc_index_layout));       \
+            if (nu_channels == 1) {                                                                           \
+                Store8##level(tile, red);                                                                     \
+                continue;                                                                                     \
+            }                                                                                                 \
+            CalculatePaletteRGTC##level(block + 8, &palette);                                                 \
+            Values8##level green = LookUp8##level(palette, GetIndices##level(block + 8, &rgtc_index_layout)); \
+            StoreInterleaved8##level(tile, red, green);                                                       \
+        }                                                                                                     \
+        return true;                                                                                          \
+    }                                                                                                         \
+    target static inline bool DecompressBlocks16##level(const uint8_t *bitstring,                             \
+                                                        int nu_blocks,                                        \
+                                                        int nu_channels,                                      \
+                                                        CalculatePaletteFuncType##level calculate_palette,    \
+                                                        const IndexLayout *layout,                            \
+                                                        uint8_t *pixel_buffer) {                              \
+        bool result = true;                                                                                   \
+        for (int i = 0; i < nu_blocks; i++) {                                                                 \
+            const uint8_t *block = bitstring + i * nu_channels * 8;                                           \
+            uint8_t *tile = pixel_buffer + i * nu_channels * 32;                                              \
+            Palette##level palette[2];                                                                        \
+            if (!calculate_palette(block, &palette[0]) ||                                                     \
+                (nu_channels == 2 && !calculate_palette(block + 8, &palette[1]))) {                           \
+                memset(tile, 0, nu_channels * 32);                                                            \
+                result = false;                                                                               \
+                continue;                                                                                     \
+            }                                                                                                 \
+            Values16##level red = LookUp16##level(palette[0], GetIndices##level(block, layout));              \
+            if (nu_channels == 1) {                                                                           \
+                Store16##level(tile, red);                                                                    \
+                continue;                                                                                     \
+            }                                                                                                 \
+            Values16##level green = LookUp16##level(palette[1], GetIndices##level(block + 8, layout));        \
+            StoreInterleaved16##level(tile, red, green);                                                      \
+        }                                                                                                     \
+        return result;                                                                                        \
+    }                                                                                                         \
+    target static bool DecompressBlocksRGTC1##level(                                                          \
+        const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {                                     \
+        return DecompressBlocks8##level(bitstring, nu_blocks, 1, pixel_buffer);                               \
+    }                                                                                                         \
+    target static bool DecompressBlocksRGTC2##level(                                                          \
+        const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {                                     \
+        return DecompressBlocks8##level(bitstring, nu_blocks, 2, pixel_buffer);                               \
+    }                                                                                                         \
+    target static bool DecompressBlocksSIGNED_RGTC1##level(                                                   \
+        const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {                                     \
+        return DecompressBlocks16##level(                                                                     \
+            bitstring, nu_blocks, 1, CalculatePaletteSignedRGTC##level, &rgtc_index_layout, pixel_buffer);    \
+    }                                                                                                         \
+    target static bool DecompressBlocksSIGNED_RGTC2##level(                                                   \
+        const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {                                     \
+        return DecompressBlocks16##level(                                                                     \
+            bitstring, nu_blocks, 2, CalculatePaletteSignedRGTC##level, &rgtc_index_layout, pixel_buffer);    \
+    }                                                                                                         \
+    target static bool DecompressBlocksEAC_R11##level(                                                        \
+        const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {                                     \
+        return DecompressBlocks16##level(                                                                     \
+            bitstring, nu_blocks, 1, CalculatePaletteEAC11##level, &eac_index_layout, pixel_buffer);          \
+    }                                                                                                         \
+    target static bool DecompressBlocksEAC_RG11##level(                                                       \
+        const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {                                     \
+        return DecompressBlocks16##level(                                                                     \
+            bitstring, nu_blocks, 2, CalculatePaletteEAC11##level, &eac_index_layout, pixel_buffer);          \
+    }                                                                                                         \
+    target static bool DecompressBlocksEAC_SIGNED_R11##level(                                                 \
+        const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {                                     \
+        return DecompressBlocks16##level(                                                                     \
+            bitstring, nu_blocks, 1, CalculatePaletteSignedEAC11##level, &eac_index_layout, pixel_buffer);    \
+    }                                                                                                         \
+    target static bool DecompressBlocksEAC_SIGNED_RG11##level(                                                \
+        const uint8_t *bitstring, int nu_blocks, uint8_t *pixel_buffer) {                                     \
+        return DecompressBlocks16##level(                                                                     \
+            bitstring, nu_blocks, 2, CalculatePaletteSignedEAC11##level, &eac_index_layout, pixel_buffer);    \
+    }
+
+#ifdef DETEX_ARCH_X86
+
+// AVX2 handles the sixteen pixels of a block in the 16-bit lanes of one register.
+// The byte shuffles of SSSE3 are available to AVX2 code.
+
+typedef __m128i PaletteAVX2;
+typedef __m128i Values8AVX2;
+typedef __m256i Values16AVX2;
+
+typedef bool (*CalculatePaletteFuncTypeAVX2)(const uint8_t *bitstring, __m128i *palette);
+
+// Interpolate the RGTC values of the endpoints lum0 and lum1, which may be
+// negative, in 16-bit lanes. There are six interpolated values when lum0 > lum1,
+// otherwise four, followed by the given extremes. The divisions truncate and are
+// done by multiplication, which is exact for the ranges involved.
+DETEX_TARGET("avx2")
+static inline __m128i InterpolateRGTCAVX2(int lum0, int lum1, __m128i extremes) {
+    __m128i l0 = _mm_set1_epi16(lum0);
+    __m128i l1 = _mm_set1_epi16(lum1);
+    __m128i sum7 = _mm_add_epi16(_mm_mullo_epi16(l0, _mm_setr_epi16(7, 0, 6, 5, 4, 3, 2, 1)),
+                                 _mm_mullo_epi16(l1, _mm_setr_epi16(0, 7, 1, 2, 3, 4, 5, 6)));
+    __m128i sum5 = _mm_add_epi16(_mm_mullo_epi16(l0, _mm_setr_epi16(5, 0, 4, 3, 2, 1, 0, 0)),
+                                 _mm_mullo_epi16(l1, _mm_setr_epi16(0, 5, 1, 2, 3, 4, 0, 0)));
+    __m128i div7 = _mm_mulhi_epu16(_mm_abs_epi16(sum7), _mm_set1_epi16(0x2493));
+    __m128i div5 = _mm_srli_epi16(_mm_mulhi_epu16(_mm_abs_epi16(sum5), _mm_set1_epi16((short)0xCCCD)), 2);
+    return _mm_blendv_epi8(_mm_add_epi16(_mm_sign_epi16(div5, sum5), extremes),
+                           _mm_sign_epi16(div7, sum7),
+                           _mm_set1_epi16(-(lum0 > lum1)));
+}
+
+DETEX_TARGET("avx2")
+static inline bool CalculatePaletteRGTCAVX2(const uint8_t *bitstring, __m128i *palette) {
+    __m128i values = InterpolateRGTCAVX2(bitstring[0], bitstring[1], _mm_setr_epi16(0, 0, 0, 0, 0, 0, 0, 0xFF));
+    *palette = _mm_packus_epi16(values, _mm_setzero_si128());
+    return true;
+}
+
+DETEX_TARGET("avx2")
+static inline bool CalculatePaletteSignedRGTCAVX2(const uint8_t *bitstring, __m128i *palette) {
+    int lum0 = (int8_t)bitstring[0];
+    int lum1 = (int8_t)bitstring[1];
+    if (lum0 == -127 && lum1 == -128) return false;
+    if (lum0 == -128) lum0 = -127;
+    if (lum1 == -128) lum1 = -127;
+    __m128i values = _mm_add_epi16(InterpolateRGTCAVX2(lum0, lum1, _mm_setr_epi16(0, 0, 0, 0, 0, 0, -127, 127)),
+                                   _mm_set1_epi16(127));
+    // Map from [0, 254] to [0, 65535]: v * 65535 / 254 is v * 258 + v * 3 / 254,
+    // of which the second term is the number of thresholds 85, 170 and 254 reached.
+    __m128i mapped = _mm_mullo_epi16(values, _mm_set1_epi16(258));
+    mapped = _mm_sub_epi16(mapped, _mm_cmpgt_epi16(values, _mm_set1_epi16(84)));
+    mapped = _mm_sub_epi16(mapped, _mm_cmpgt_epi16(values, _mm_set1_epi16(169)));
+    mapped = _mm_sub_epi16(mapped, _mm_cmpgt_epi16(values, _mm_set1_epi16(253)));
+    // Subtract 32768 to map to [-32768, 32767].
+    *palette = _mm_xor_si128(mapped, _mm_set1_epi16((short)0x8000));
+    return true;
+}
+
+// Return the EAC modifiers of a block times its multiplier (times eight).
+DETEX_TARGET("avx2")
+static inline __m128i GetModifiersEACAVX2(const uint8_t *bitstring) {
+    int multiplier_times_8 = (bitstring[1] >> 4) * 8;
+    if (multiplier_times_8 == 0) multiplier_times_8 = 1;
+    __m128i modifiers = _mm_cvtepi8_epi16(_mm_loadl_epi64((const __m128i *)eac_modifier_table[bitstring[1] & 0x0F]));
+    return _mm_mullo_epi16(modifiers, _mm_set1_epi16(multiplier_times_8));
+}
+
+DETEX_TARGET("avx2")
+static inline bool CalculatePaletteEAC11AVX2(const uint8_t *bitstring, __m128i *palette) {
+    __m128i values = _mm_add_epi16(_mm_set1_epi16(bitstring[0] * 8 + 4), GetModifiersEACAVX2(bitstring));
+    values = _mm_min_epi16(_mm_max_epi16(values, _mm_setzero_si128()), _mm_set1_epi16(2047));
+    *palette = _mm_or_si128(_mm_slli_epi16(values, 5), _mm_srli_epi16(values, 6));
+    return true;
+}
+
+DETEX_TARGET("avx2")
+static inline bool CalculatePaletteSignedEAC11AVX2(const uint8_t *bitstring, __m128i *palette) {
+    int base_codeword = (int8_t)bitstring[0];
+    if (base_codeword == -128) return false;
+    __m128i values = _mm_add_epi16(_mm_set1_epi16(base_codeword * 8), GetModifiersEACAVX2(bitstring));
+    values = _mm_min_epi16(_mm_max_epi16(values, _mm_set1_epi16(-1023)), _mm_set1_epi16(1023));
+    // Replicate the bits of the magnitude.
+    __m128i magnitude = _mm_abs_epi16(values);
+    magnitude = _mm_or_si128(_mm_slli_epi16(magnitude, 5), _mm_srli_epi16(magnitude, 5));
+    *palette = _mm_sign_epi16(magnitude, values);
+    return true;
+}
+
+// Return the indices of the pixels of a block in 16-bit lanes.
+DETEX_TARGET("avx2")
+static inline __m256i GetIndicesAVX2(const uint8_t *bitstring, const IndexLayout *layout) {
+    __m256i words = _mm256_shuffle_epi8(_mm256_set1_epi64x(Load64(bitstring)),
+                                        _mm256_loadu_si256((const __m256i *)layout->bytes));
+    return _mm256_srli_epi16(_mm256_mullo_epi16(words, _mm256_loadu_si256((const __m256i *)layout->multipliers)), 13);
+}
+
+DETEX_TARGET("avx2")
+static inline __m128i LookUp8AVX2(__m128i palette, __m256i indices) {
+    __m128i index = _mm_packus_epi16(_mm256_castsi256_si128(indices), _mm256_extracti128_si256(indices, 1));
+    return _mm_shuffle_epi8(palette, index);
+}
+
+DETEX_TARGET("avx2")
+static inline __m256i LookUp16AVX2(__m128i palette, __m256i indices) {
+    // Value n consists of bytes n * 2 and n * 2 + 1 of the palette.
+    __m256i bytes = _mm256_add_epi16(_mm256_mullo_epi16(indices, _mm256_set1_epi16(0x0202)),
+                                     _mm256_set1_epi16(0x0100));
+    return _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(palette), bytes);
+}
+
+DETEX_TARGET("avx2")
+static inline void Store8AVX2(uint8_t *pixel_buffer, __m128i values) {
+    _mm_storeu_si128((__m128i *)pixel_buffer, values);
+}
+
+DETEX_TARGET("avx2")
+static inline void StoreInterleaved8AVX2(uint8_t *pixel_buffer, __m128i red, __m128i green) {
+    _mm_storeu_si128((__m128i *)pixel_buffer, _mm_unpacklo_epi8(red, green));
+    _mm_storeu_si128((__m128i *)pixel_buffer + 1, _mm_unpackhi_epi8(red, green));
+}
+
+DETEX_TARGET("avx2")
+static inline void Store16AVX2(uint8_t *pixel_buffer, __m256i values) {
+    _mm256_storeu_si256((__m256i *)pixel_buffer, values);
+}
+
+DETEX_TARGET("avx2")
+static inline void StoreInterleaved16AVX2(uint8_t *pixel_buffer, __m256i red, __m256i green) {
+    // The unpack instructions work within 128-bit halves, pixels 0-3 and 8-11
+    // end up in the first register.
+    __m256i low = _mm256_unpacklo_epi16(red, green);
+    __m256i high = _mm256_unpackhi_epi16(red, green);
+    _mm256_storeu_si256((__m256i *)pixel_buffer, _mm256_permute2x128_si256(low, high, 0x20));
+    _mm256_storeu_si256((__m256i *)pixel_buffer + 1, _mm256_permute2x128_si256(low, high, 0x31));
+}
+
+DEFINE_DECOMPRESS_BLOCKS_FUNCTIONS(AVX2, DETEX_TARGET("avx2"))
+
+#endif
+
+#ifdef DETEX_ARCH_ARM64
+
+// NEON handles the sixteen pixels of a block in two registers of eight 16-bit lanes.
+
+typedef uint8x16_t PaletteNEON;
+typedef uint8x16_t Values8NEON;
+typedef uint16x8x2_t Values16NEON;
+
+typedef bool (*CalculatePaletteFuncTypeNEON)(const uint8_t *bitstring, uint8x16_t *palette);
+
+// NEON calculates the palettes with scalar code.
+
+// Pack eight 16-bit values into a register. They are combined in two 64-bit words
+// first, which avoids a store and reload.
+static inline uint8x16_t PackPalette16NEON(const int *values) {
+    uint64_t words[2] = {0, 0};
+    for (int k = 0; k < 8; k++) words[k >> 2] |= (uint64_t)(uint16_t)values[k] << ((k & 3) * 16);
+    return vcombine_u8(vcreate_u8(words[0]), vcreate_u8(words[1]));
+}
+
+// Calculate the eight values of an unsigned RGTC block, one per byte.
+static inline bool CalculatePaletteRGTCNEON(const uint8_t *bitstring, uint8x16_t *palette) {
+    unsigned int lum0 = bitstring[0];
+    unsigned int lum1 = bitstring[1];
+    unsigned int values[8];
+    values[0] = lum0;
+    values[1] = lum1;
+    if (lum0 > lum1) {
+        for (int i = 1; i < 7; i++) values[i + 1] = ((7 - i) * lum0 + i * lum1) / 7;
+    } else {
+        for (int i = 1; i < 5; i++) values[i + 1] = ((5 - i) * lum0 + i * lum1) / 5;
+        values[6] = 0;
+        values[7] = 0xFF;
+    }
+    uint64_t word = 0;
+    for (int k = 0; k < 8; k++) word |= (uint64_t)values[k] << (k * 8);
+    *palette = vcombine_u8(vcreate_u8(word), vdup_n_u8(0));
+    return true;
+}
+
+// Calculate the eight values of a signed RGTC block, mapped to 16-bit.
+static inline bool CalculatePaletteSignedRGTCNEON(const uint8_t *bitstring, uint8x16_t *palette) {
+    int lum0 = (int8_t)bitstring[0];
+    int lum1 = (int8_t)bitstring[1];
+    if (lum0 == -127 && lum1 == -128) return false;
+    if (lum0 == -128) lum0 = -127;
+    if (lum1 == -128) lum1 = -127;
+    int values[8];
+    values[0] = lum0;
+    values[1] = lum1;
+    if (lum0 > lum1) {
+        for (int i = 1; i < 7; i++) values[i + 1] = ((7 - i) * lum0 + i * lum1) / 7;
+    } else {
+        for (int i = 1; i < 5; i++) values[i + 1] = ((5 - i) * lum0 + i * lum1) / 5;
+        values[6] = -127;
+        values[7] = 127;
+    }
+    // Map from [-127, 127] to [-32768, 32767].
+    for (int k = 0; k < 8; k++) values[k] = (values[k] + 127) * 65535 / 254 - 32768;
+    *palette = PackPalette16NEON(values);
+    return true;
+}
+
+// Calculate the eight values of an unsigned EAC R11 block, replicated to 16-bit.
+static inline bool CalculatePaletteEAC11NEON(const uint8_t *bitstring, uint8x16_t *palette) {
+    int base_codeword_times_8_plus_4 = bitstring[0] * 8 + 4;
+    int multiplier_times_8 = (bitstring[1] >> 4) * 8;
+    if (multiplier_times_8 == 0) multiplier_times_8 = 1;
+    const int8_t *modifiers = eac_modifier_table[bitstring[1] & 0x0F];
+    int values[8];
+    for (int k = 0; k < 8; k++) {
+        int value = base_codeword_times_8_plus_4 + modifiers[k] * multiplier_times_8;
+        value = value < 0 ? 0 : value > 2047 ? 2047 : value;
+        values[k] = (value << 5) | (value >> 6);
+    }
+    *palette = PackPalette16NEON(values);
+    return true;
+}
+
+// Calculate the eight values of a signed EAC R11 block, replicated to 16-bit.
+static inline bool CalculatePaletteSignedEAC11NEON(const uint8_t *bitstring, uint8x16_t *palette) {
+    int base_codeword = (int8_t)bitstring[0];
+    if (base_codeword == -128) return false;
+    int multiplier_times_8 = (bitstring[1] >> 4) * 8;
+    if (multiplier_times_8 == 0) multiplier_times_8 = 1;
+    const int8_t *modifiers = eac_modifier_table[bitstring[1] & 0x0F];
+    int values[8];
+    for (int k = 0; k < 8; k++) {
+        int value = base_codeword * 8 + modifiers[k] * multiplier_times_8;
+        value = value < -1023 ? -1023 : value > 1023 ? 1023 : value;
+        int magnitude = value < 0 ? -value : value;
+        magnitude = (magnitude << 5) | (magnitude >> 5);
+        values[k] = value < 0 ? -magnitude : magnitude;
+    }
+    *palette = PackPalette16NEON(values);
+    return true;
+}
+
+static inline uint16x8x2_t GetIndicesNEON(const uint8_t *bitstring, const IndexLayout *layout) {
+    uint8x8_t bits = vld1_u8(bitstring);
+    uint8x16_t table = vcombine_u8(bits, bits);
+    uint16x8x2_t indices;
+    for (int j = 0; j < 2; j++) {
+        uint16x8_t words = vreinterpretq_u16_u8(vqtbl1q_u8(table, vld1q_u8(layout->bytes + j * 16)));
+        indices.val[j] = vshrq_n_u16(vmulq_u16(words, vld1q_u16(layout->multipliers + j * 8)), 13);
+    }
+    return indices;
+}
+
+static inline uint8x16_t LookUp8NEON(uint8x16_t palette, uint16x8x2_t indices) {
+    uint8x16_t index = vcombine_u8(vmovn_u16(indices.val[0]), vmovn_u16(indices.val[1]));
+    return vqtbl1q_u8(palette, index);
+}
+
+static inline uint16x8x2_t LookUp16NEON(uint8x16_t palette, uint16x8x2_t indices) {
+    uint16x8x2_t values;
+    for (int j = 0; j < 2; j++) {
+        // Value n consists of bytes n * 2 and n * 2 + 1 of the palette.
+        uint16x8_t bytes = vmlaq_n_u16(vdupq_n_u16(0x0100), indices.val[j], 0x0202);
+        values.val[j] = vreinterpretq_u16_u8(vqtbl1q_u8(palette, vreinterpretq_u8_u16(bytes)));
+    }
+    return values;
+}
+
+static inline void Store8NEON(uint8_t *pixel_buffer, uint8x16_t values) { vst1q_u8(pixel_buffer, values); }
+
+static inline void StoreInterleaved8NEON(uint8_t *pixel_buffer, uint8x16_t red, uint8x16_t green) {
+    uint8x16x2_t values = {{red, green}};
+    vst2q_u8(pixel_buffer, values);
+}
+
+static inline void Store16NEON(uint8_t *pixel_buffer, uint16x8x2_t values) {
+    vst1q_u16((uint16_t *)pixel_buffer, values.val[0]);
+    vst1q_u16((uint16_t *)pixel_buffer + 8, values.val[1]);
+}
+
+static inline void StoreInterleaved16NEON(uint8_t *pixel_buffer, uint16x8x2_t red, uint16x8x2_t green) {
+    for (int j = 0; j < 2; j++) {
+        uint16x8x2_t values = {{red.val[j], green.val[j]}};
+        vst2q_u16((uint16_t *)pixel_buffer + j * 16, values);
+    }
+}
+
+DEFINE_DECOMPRESS_BLOCKS_FUNCTIONS(NEON, )
+
+#endif
+
+typedef struct {
+    detexDecompressBlocksFuncType rgtc1;
+    detexDecompressBlocksFuncType rgtc2;
+    detexDecompressBlocksFuncType signed_rgtc1;
+    detexDecompressBlocksFuncType signed_rgtc2;
+    detexDecompressBlocksFuncType eac_r11;
+    detexDecompressBlocksFuncType eac_rg11;
+    detexDecompressBlocksFuncType eac_signed_r11;
+    detexDecompressBlocksFuncType eac_signed_rg11;
+} DecompressBlocksFunctions;
+
+// Indexed by SIMD level.
+static const DecompressBlocksFunctions decompress_blocks_functions[] = {
+    [DETEX_SIMD_LEVEL_NONE] = {DecompressBlocksRGTC1Scalar,
+                               DecompressBlocksRGTC2Scalar,
+                               DecompressBlocksSIGNED_RGTC1Scalar,
+                               DecompressBlocksSIGNED_RGTC2Scalar,
+                               DecompressBlocksEAC_R11Scalar,
+                               DecompressBlocksEAC_RG11Scalar,
+                               DecompressBlocksEAC_SIGNED_R11Scalar,
+                               DecompressBlocksEAC_SIGNED_RG11Scalar},
+#ifdef DETEX_ARCH_X86
+    [DETEX_SIMD_LEVEL_SSE2] = {DecompressBlocksRGTC1Scalar,
+                               DecompressBlocksRGTC2Scalar,
+                               DecompressBlocksSIGNED_RGTC1Scalar,
+                               DecompressBlocksSIGNED_RGTC2Scalar,
+                               DecompressBlocksEAC_R11Scalar,
+                               DecompressBlocksEAC_RG11Scalar,
+                               DecompressBlocksEAC_SIGNED_R11Scalar,
+                               DecompressBlocksEAC_SIGNED_RG11Scalar},
+    [DETEX_SIMD_LEVEL_AVX2] = {DecompressBlocksRGTC1AVX2,
+                               DecompressBlocksRGTC2AVX2,
+                               DecompressBlocksSIGNED_RGTC1AVX2,
+                               DecompressBlocksSIGNED_RGTC2AVX2,
+                               DecompressBlocksEAC_R11AVX2,
+                               DecompressBlocksEAC_RG11AVX2,
+                               DecompressBlocksEAC_SIGNED_R11AVX2,
+                               DecompressBlocksEAC_SIGNED_RG11AVX2},
+#endif
+#ifdef DETEX_ARCH_ARM64
+    [DETEX_SIMD_LEVEL_NEON] = {DecompressBlocksRGTC1NEON,
+                               DecompressBlocksRGTC2NEON,
+                               DecompressBlocksSIGNED_RGTC1NEON,
+                               DecompressBlocksSIGNED_RGTC2NEON,
+                               DecompressBlocksEAC_R11NEON,
+                               DecompressBlocksEAC_RG11NEON,
+                               DecompressBlocksEAC_SIGNED_R11NEON,
+                               DecompressBlocksEAC_SIGNED_RG11NEON},
+#endif
+};
+
+/* Decompress nu_blocks consecutive RGTC1 blocks. */
+bool detexDecompressBlocksRGTC1(const uint8_t *bitstring, int nu_blocks, uint32_t flags, uint8_t *pixel_buffer) {
+    if (flags != 0)
+        return DecompressBlocksWithFlags(detexDecompressBlockRGTC1, bitstring, 8, 16, nu_blocks, flags, pixel_buffer);
+    return decompress_blocks_functions[detexGetSIMDLevel()].rgtc1(bitstring, nu_blocks, pixel_buffer);
+}
+
+/* Decompress nu_blocks consecutive RGTC2 blocks. */
+bool detexDecompressBlocksRGTC2(const uint8_t *bitstring, int nu_blocks, uint32_t flags, uint8_t *pixel_buffer) {
+    if (flags != 0)
+        return DecompressBlocksWithFlags(detexDecompressBlockRGTC2, bitstring, 16, 32, nu_blocks, flags, pixel_buffer);
+    return decompress_blocks_functions[detexGetSIMDLevel()].rgtc2(bitstring, nu_blocks, pixel_buffer);
+}
+
+/* Decompress nu_blocks consecutive signed RGTC1 blocks. */
+bool detexDecompressBlocksSIGNED_RGTC1(const uint8_t *bitstring, int nu_blocks, uint32_t flags, uint8_t *pixel_buffer) {
+    if (flags != 0)
+        return DecompressBlocksWithFlags(
+            detexDecompressBlockSIGNED_RGTC1, bitstring, 8, 32, nu_blocks, flags, pixel_buffer);
+    return decompress_blocks_functions[detexGetSIMDLevel()].signed_rgtc1(bitstring, nu_blocks, pixel_buffer);
+}
+
+/* Decompress nu_blocks consecutive signed RGTC2 blocks. */
+bool detexDecompressBlocksSIGNED_RGTC2(const uint8_t *bitstring, int nu_blocks, uint32_t flags, uint8_t *pixel_buffer) {
+    if (flags != 0)
+        return DecompressBlocksWithFlags(
+            detexDecompressBlockSIGNED_RGTC2, bitstring, 16, 64, nu_blocks, flags, pixel_buffer);
+    return decompress_blocks_functions[detexGetSIMDLevel()].signed_rgtc2(bitstring, nu_blocks, pixel_buffer);
+}
+
+/* Decompress nu_blocks consecutive EAC_R11 blocks. */
+bool detexDecompressBlocksEAC_R11(const uint8_t *bitstring, int nu_blocks, uint32_t flags, uint8_t *pixel_buffer) {
+    if (flags != 0)
+        return DecompressBlocksWithFlags(detexDecompressBlockEAC_R11, bitstring, 8, 32, nu_blocks, flags, pixel_buffer);
+    return decompress_blocks_functions[detexGetSIMDLevel()].eac_r11(bitstring, nu_blocks, pixel_buffer);
+}
+
+/* Decompress nu_blocks consecutive EAC_RG11 blocks. */
+bool detexDecompressBlocksEAC_RG11(const uint8_t *bitstring, int nu_blocks, uint32_t flags, uint8_t *pixel_buffer) {
+    if (flags != 0)
+        return DecompressBlocksWithFlags(
+            detexDecompressBlockEAC_RG11, bitstring, 16, 64, nu_blocks, flags, pixel_buffer);
+    return decompress_blocks_functions[detexGetSIMDLevel()].eac_rg11(bitstring, nu_blocks, pixel_buffer);
+}
+
+/* Decompress nu_blocks consecutive EAC_SIGNED_R11 blocks. */
+bool detexDecompressBlocksEAC_SIGNED_R11(const uint8_t *bitstring,
+                                         int nu_blocks,
+                                         uint32_t flags,
+                                         uint8_t *pixel_buffer) {
+    if (flags != 0)
+        return DecompressBlocksWithFlags(
+            detexDecompressBlockEAC_SIGNED_R11, bitstring, 8, 32, nu_blocks, flags, pixel_buffer);
+    return decompress_blocks_functions[detexGetSIMDLevel()].eac_signed_r11(bitstring, nu_blocks, pixel_buffer);
+}
+
+/* Decompress nu_blocks consecutive EAC_SIGNED_RG11 blocks. */
+bool detexDecompressBlocksEAC_SIGNED_RG11(const uint8_t *bitstring,
+                                          int nu_blocks,
+                                          uint32_t flags,
+                                          uint8_t *pixel_buffer) {
+    if (flags != 0)
+        return DecompressBlocksWithFlags(
+            detexDecompressBlockEAC_SIGNED_RG11, bitstring, 16, 64, nu_blocks, flags, pixel_buffer);
+    return decompress_blocks_functions[detexGetSIMDLevel()].eac_signed_rg11(bitstring, nu_blocks, pixel_buffer);
+}
@@ -18,6 +18,19 @@ OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 
 #include "detex.h"
 
+// Calculate the eight values of an unsigned RGTC block.
+DETEX_INLINE_ONLY void CalculatePaletteRGTC(int lum0, int lum1, uint8_t *palette) {
+    palette[0] = lum0;
+    palette[1] = lum1;
+    if (lum0 > lum1) {
+        for (int i = 1; i < 7; i++) palette[i + 1] = detexDivide0To1791By7((7 - i) * lum0 + i * lum1);
+    } else {
+        for (int i = 1; i < 5; i++) palette[i + 1] = detexDivide0To1279By5((5 - i) * lum0 + i * lum1);
+        palette[6] = 0;
+        palette[7] = 0xFF;
+    }
+}
+
 // For each pixel, decode an 8-bit integer and store as follows:
 // If shift and offset are zero, store each value in consecutive 8 bit values in pixel_buffer.
 // If shift is one, store each value in consecutive 16-bit words in pixel_buffer; if offset
@@ -29,65 +42,10 @@ DETEX_INLINE_ONLY void DecodeBlockRGTC(const uint8_t *DETEX_RESTRICT bitstring,
                                        uint8_t *DETEX_RESTRICT pixel_buffer) {
     // LSBFirst byte order only.
     uint64_t bits = (*(uint64_t *)&bitstring[0]) >> 16;
-    int lum0 = bitstring[0];
-    int lum1 = bitstring[1];
+    uint8_t palette[8];
+    CalculatePaletteRGTC(bitstring[0], bitstring[1], palette);
     for (int i = 0; i < 16; i++) {
-        int control_code = bits & 0x7;
-        uint8_t output;
-        if (lum0 > lum1) switch (control_code) {
-                case 0:
-                    output = lum0;
-                    break;
-                case 1:
-                    output = lum1;
-                    break;
-                case 2:
-                    output = detexDivide0To1791By7(6 * lum0 + lum1);
-                    break;
-                case 3:
-                    output = detexDivide0To1791By7(5 * lum0 + 2 * lum1);
-                    break;
-                case 4:
-                    output = detexDivide0To1791By7(4 * lum0 + 3 * lum1);
-                    break;
-                case 5:
-                    output = detexDivide0To1791By7(3 * lum0 + 4 * lum1);
-                    break;
-                case 6:
-                    output = detexDivide0To1791By7(2 * lum0 + 5 * lum1);
-                    break;
-                case 7:
-                    output = detexDivide0To1791By7(lum0 + 6 * lum1);
-                    break;
-            }
-        else
-            switch (control_code) {
-                case 0:
-                    output = lum0;
-                    break;
-                case 1:
-                    output = lum1;
-                    break;
-                case 2:
-                    output = detexDivide0To1279By5(4 * lum0 + lum1);
-                    break;
-                case 3:
-                    output = detexDivide0To1279By5(3 * lum0 + 2 * lum1);
-                    break;
-                case 4:
-                    output = detexDivide0To1279By5(2 * lum0 + 3 * lum1);
-                    break;
-                case 5:
-                    output = detexDivide0To1279By5(lum0 + 4 * lum1);
-                    break;
-                case 6:
-                    output = 0;
-                    break;
-                case 7:
-                    output = 0xFF;
-                    break;
-            }
-        pixel_buffer[(i << shift) + offset] = output;
+        pixel_buffer[(i << shift) + offset] = palette[bits & 0x7];
         bits >>= 3;
     }
 }
@@ -113,6 +71,30 @@ bool detexDecompressBlockRGTC2(const uint8_t *DETEX_RESTRICT bitstring,
     return true;
 }
 
+// Calculate the eight values of a signed RGTC block, mapped to 16-bit. Returns false
+// if the compressed block is invalid.
+DETEX_INLINE_ONLY bool CalculatePaletteSignedRGTC(int lum0, int lum1, uint16_t *palette) {
+    if (lum0 == -127 && lum1 == -128)
+        // Not allowed.
+        return false;
+    if (lum0 == -128) lum0 = -127;
+    if (lum1 == -128) lum1 = -127;
+    // Note: values are mapped to a red value of -127 to 127.
+    int values[8];
+    values[0] = lum0;
+    values[1] = lum1;
+    if (lum0 > lum1) {
+        for (int i = 1; i < 7; i++) values[i + 1] = detexDivideMinus895To895By7((7 - i) * lum0 + i * lum1);
+    } else {
+        for (int i = 1; i < 5; i++) values[i + 1] = detexDivideMinus639To639By5((5 - i) * lum0 + i * lum1);
+        values[6] = -127;
+        values[7] = 127;
+    }
+    // Map from [-127, 127] to [-32768, 32767].
+    for (int i = 0; i < 8; i++) palette[i] = (uint16_t)(int16_t)((values[i] + 127) * 65535 / 254 - 32768);
+    return true;
+}
+
 // For each pixel, decode an 16-bit integer and store as follows:
 // If shift and offset are zero, store each value in consecutive 16 bit values in pixel_buffer.
 // If shift is one, store each value in consecutive 32-bit words in pixel_buffer; if offset
@@ -124,73 +106,11 @@ DETEX_INLINE_ONLY bool DecodeBlockSignedRGTC(const uint8_t *DETEX_RESTRICT bitst
                                              uint8_t *DETEX_RESTRICT pixel_buffer) {
     // LSBFirst byte order only.
     uint64_t bits = (*(uint64_t *)&bitstring[0]) >> 16;
-    int lum0 = (int8_t)bitstring[0];
-    int lum1 = (int8_t)bitstring[1];
-    if (lum0 == -127 && lum1 == -128)
-        // Not allowed.
-        return false;
-    if (lum0 == -128) lum0 = -127;
-    if (lum1 == -128) lum1 = -127;
-    // Note: values are mapped to a red value of -127 to 127.
+    uint16_t palette[8];
+    if (!CalculatePaletteSignedRGTC((int8_t)bitstring[0], (int8_t)bitstring[1], palette)) return false;
     uint16_t *pixel16_buffer = (uint16_t *)pixel_buffer;
     for (int i = 0; i < 16; i++) {
-        int control_code = bits & 0x7;
-        int32_t result;
-        if (lum0 > lum1) switch (control_code) {
-                case 0:
-                    result = lum0;
-                    break;
-                case 1:
-                    result = lum1;
-                    break;
-                case 2:
-                    result = detexDivideMinus895To895By7(6 * lum0 + lum1);
-                    break;
-                case 3:
-                    result = detexDivideMinus895To895By7(5 * lum0 + 2 * lum1);
-                    break;
-                case 4:
-                    result = detexDivideMinus895To895By7(4 * lum0 + 3 * lum1);
-                    break;
-                case 5:
-                    result = detexDivideMinus895To895By7(3 * lum0 + 4 * lum1);
-                    break;
-                case 6:
-                    result = detexDivideMinus895To895By7(2 * lum0 + 5 * lum1);
-                    break;
-                case 7:
-                    result = detexDivideMinus895To895By7(lum0 + 6 * lum1);
-                    break;
-            }
-        else
-            switch (control_code) {
-                case 0:
-                    result = lum0;
-                    break;
-                case 1:
-                    result = lum1;
-                    break;
-                case 2:
-                    result = detexDivideMinus639To639By5(4 * lum0 + lum1);
-                    break;
-                case 3:
-                    result = detexDivideMinus639To639By5(3 * lum0 + 2 * lum1);
-                    break;
-                case 4:
-                    result = detexDivideMinus639To639By5(2 * lum0 + 3 * lum1);
-                    break;
-                case 5:
-                    result = detexDivideMinus639To639By5(lum0 + 4 * lum1);
-                    break;
-                case 6:
-                    result = -127;
-                    break;
-                case 7:
-                    result = 127;
-                    break;
-            }
-        // Map from [-127, 127] to [-32768, 32767].
-        pixel16_buffer[(i << shift) + offset] = (uint16_t)(int16_t)((result + 127) * 65535 / 254 - 32768);
+        pixel16_buffer[(i << shift) + offset] = palette[bits & 0x7];
         bits >>= 3;
     }
     return true;
@@ -67,12 +67,106 @@ typedef struct {
     uint32_t reserved2;           // 120
 } DDS_HEADER;
 
+// Look up the texture format of a DDS file. Returns NULL if it is not supported.
+static const detexTextureFileInfo *LookupDDSHeaderFileInfo(const DDS_HEADER *header, const DX10_HEADER *dx10_header) {
+    if (strncmp(header->pixelFormat.fourCC, "DX10", 4) == 0 && dx10_header->resource_dimension != 3) {
+        detexSetErrorMessage("detexFileLoadDDS: Only 2D textures supported for .dds files");
+        return NULL;
+    }
+    const detexTextureFileInfo *info = detexLookupDDSFileInfo(header->pixelFormat.fourCC,
+                                                              dx10_header->format,
+                                                              header->pixelFormat.flags,
+                                                              header->pixelFormat.bitCountRGB,
+                                                              header->pixelFormat.bitMaskR,
+                                                              header->pixelFormat.bitMaskG,
+                                                              header->pixelFormat.bitMaskB,
+                                                              header->pixelFormat.bitMaskA);
+    if (info == NULL) {
+        detexSetErrorMessage("detexFileLoadDDS: Unsupported format in .dds file (DX10 format = %d).",
+                             dx10_header->format);
+    }
+    return info;
+}
+
+// Read the header of a DDS file and calculate the layout of its levels. Returns true if successful.
+bool detexFileProbeDDS(const char *filename, detexFileLayout *layout) {
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL) {
+        detexSetErrorMessage("detexFileProbeDDS: Could not open file %s", filename);
+        return false;
+    }
+
+    DDS_HEADER header = {0};
+    DX10_HEADER dx10_header = {0};
+    char magic[4];
+    if (fread(magic, 1, 4, file) != 4 || memcmp(magic, "DDS ", 4) != 0 ||
+        fread(&header, 1, sizeof(DDS_HEADER), file) != sizeof(DDS_HEADER)) {
+        detexSetErrorMessage("detexFileProbeDDS: Couldn't find DDS signature %s", filename);
+        fclose(file);
+        return false;
+    }
+    size_t offset = 4 + sizeof(DDS_HEADER);
+    if (strncmp(header.pixelFormat.fourCC, "DX10", 4) == 0) {
+        if (fread(&dx10_header, 1, sizeof(DX10_HEADER), file) != sizeof(DX10_HEADER)) {
+            detexSetErrorMessage("detexFileProbeDDS: Error reading DX10 header %s", filename);
+            fclose(file);
+            return false;
+        }
+        offset += sizeof(DX10_HEADER);
+    }
+    fseek(file, 0, SEEK_END);
+    long file_size = ftell(file);
+    fclose(file);
+
+    const detexTextureFileInfo *info = LookupDDSHeaderFileInfo(&header, &dx10_header);
+    if (info == NULL) {
+        return false;
+    }
+    int nu_levels = (header.flags & DDS_HEADER_FLAGS_MIPMAP) ? (int)header.mipMapCount : 1;
+    if (header.width == 0 || header.height == 0 || nu_levels < 1 || nu_levels > DETEX_FILE_MAX_LEVELS) {
+        detexSetErrorMessage("detexFileProbeDDS: Invalid DDS header %s", filename);
+        return false;
+    }
+
+    layout->file_type = DETEX_FILE_TYPE_DDS;
+    layout->file_size = file_size < 0 ? 0 : (uint64_t)file_size;
+    layout->nu_levels = nu_levels;
+    uint32_t bytes_per_block = detextBytesPerBlock(info->texture_format);
+    uint32_t current_width = header.width;
+    uint32_t current_height = header.height;
+    for (int i = 0; i < nu_levels; i++) {
+        uint32_t width_in_blocks = max((current_width + info->block_width - 1) / info->block_width, 1);
+        uint32_t height_in_blocks = max((current_height + info->block_height - 1) / info->block_height, 1);
+        layout->levels[i] = (detexTexture){
+            .format = info->texture_format,
+            .width = current_width,
+            .height = current_height,
+            .width_in_blocks = width_in_blocks,
+            .height_in_blocks = height_in_blocks,
+        };
+        layout->offsets[i] = offset;
+        layout->sizes[i] = (size_t)width_in_blocks * height_in_blocks * bytes_per_block;
+        offset += layout->sizes[i];
+        current_width = max(current_width >> 1, 1);
+        current_height = max(current_height >> 1, 1);
+    }
+    if (offset > layout->file_size) {
+        detexSetErrorMessage("detexFileProbeDDS: File %s is truncated", filename);
+        return false;
+    }
+    return true;
+}
+
 // Load texture from DDS file with mip-maps. Returns true if successful.
 // nu_levels is a return parameter that returns the number of mipmap levels found.
 // textures_out is a return parameter for an array of detexTexture pointers that is allocated,
 // free with free(). textures_out[i] are allocated textures corresponding to each level, free
 // with free();
 bool detexFileLoadDDS(const char *filename, int max_mipmaps, detexTexture ***textures_out, int *nu_levels_out) {
+    if (max_mipmaps < 1) {
+        detexSetErrorMessage("detexFileLoadDDS: Invalid maximum number of mipmap levels %d", max_mipmaps);
+        return false;
+    }
     FILE *file = fopen(filename, "rb");
     if (file == NULL) {
         detexSetErrorMessage("detexFileLoadDDS: Could not open file %s", filename);
@@ -98,27 +192,14 @@ bool detexFileLoadDDS(const char *filename, int max_mipmaps, detexTexture ***tex
             detexSetErrorMessage("detexFileLoadDDS: Error reading DX10 header %s", filename);
             return false;
         }
-        if (dx10_header.resource_dimension != 3) {
-            detexSetErrorMessage("detexFileLoadDDS: Only 2D textures supported for .dds files");
-            return false;
-        }
     }
 
-    const detexTextureFileInfo *info = detexLookupDDSFileInfo(header.pixelFormat.fourCC,
-                                                              dx10_header.format,
-                                                              header.pixelFormat.flags,
-                                                              header.pixelFormat.bitCountRGB,
-                                                              header.pixelFormat.bitMaskR,
-                                                              header.pixelFormat.bitMaskG,
-                                                              header.pixelFormat.bitMaskB,
-                                                              header.pixelFormat.bitMaskA);
+    const detexTextureFileInfo *info = LookupDDSHeaderFileInfo(&header, &dx10_header);
     if (info == NULL) {
-        detexSetErrorMessage("detexFileLoadDDS: Unsupported format in .dds file (DX10 format = %d).",
-                             dx10_header.format);
         return false;
     }
 
-    int nu_file_mipmaps = (header.flags & DDS_HEADER_FLAGS_MIPMAP) ? header.mipMapCount : 1;
+    int nu_file_mipmaps = (header.flags & DDS_HEADER_FLAGS_MIPMAP) ? max((int)header.mipMapCount, 1) : 1;
     int nu_mipmaps = min(nu_file_mipmaps, max_mipmaps);
     *nu_levels_out = nu_mipmaps;
 
@@ -155,8 +236,96 @@ bool detexFileLoadDDS(const char *filename, int max_mipmaps, detexTexture ***tex
     return true;
 }
 
-// Save textures to DDS file (multiple mip-maps levels). Return true if succesful.
-bool detexFileSaveDDS(const char *filename, detexTexture **textures, int nu_levels) {
+// Map a DDS file into memory and return textures pointing into the mapping. Returns true if
+// successful. The textures must be freed with detexFreeTextures before the mapping is released
+// with detexFileUnmap.
+bool detexFileMapDDS(const char *filename,
+                     int max_mipmaps,
+                     detexTexture ***textures_out,
+                     int *nu_levels_out,
+                     detexFileMapping **mapping_out) {
+    if (max_mipmaps < 1) {
+        detexSetErrorMessage("detexFileMapDDS: Invalid maximum number of mipmap levels %d", max_mipmaps);
+        return false;
+    }
+    detexFileMapping *mapping = detexFileMap(filename);
+    if (mapping == NULL) {
+        return false;
+    }
+
+    DDS_HEADER header = {0};
+    DX10_HEADER dx10_header = {0};
+    size_t offset = 4 + sizeof(DDS_HEADER);
+    if (mapping->size < offset || memcmp(mapping->data, "DDS ", 4) != 0) {
+        detexSetErrorMessage("detexFileLoadDDS: Couldn't find DDS signature");
+        detexFileUnmap(mapping);
+        return false;
+    }
+    memcpy(&header, mapping->data + 4, sizeof(DDS_HEADER));
+
+    if (strncmp(header.pixelFormat.fourCC, "DX10", 4) == 0) {
+        if (mapping->size < offset + sizeof(DX10_HEADER)) {
+            detexSetErrorMessage("detexFileLoadDDS: Error reading DX10 header %s", filename);
+            detexFileUnmap(mapping);
+            return false;
+        }
+        memcpy(&dx10_header, mapping->data + offset, sizeof(DX10_HEADER));
+        offset += sizeof(DX10_HEADER);
+    }
+
+    const detexTextureFileInfo *info = LookupDDSHeaderFileInfo(&header, &dx10_header);
+    if (info == NULL) {
+        detexFileUnmap(mapping);
+        return false;
+    }
+
+    int nu_file_mipmaps = (header.flags & DDS_HEADER_FLAGS_MIPMAP) ? max((int)header.mipMapCount, 1) : 1;
+    int nu_mipmaps = min(nu_file_mipmaps, max_mipmaps);
+
+    detexTexture **textures = (detexTexture **)calloc(nu_mipmaps, sizeof(detexTexture *));
+
+    uint32_t bytes_per_block = detextBytesPerBlock(info->texture_format);
+    uint32_t block_width = info->block_width;
+    uint32_t block_height = info->block_height;
+    uint32_t current_width = header.width;
+    uint32_t current_height = header.height;
+    for (int i = 0; i < nu_mipmaps; i++) {
+        uint32_t width_in_blocks = max((current_width + block_width - 1) / block_width, 1);
+        uint32_t height_in_blocks = max((current_height + block_height - 1) / block_height, 1);
+        uint32_t size = width_in_blocks * height_in_blocks * bytes_per_block;
+        if (mapping->size - offset < size) {
+            detexSetErrorMessage("detexFileLoadDDS: Error reading file %s", filename);
+            detexFreeTextures(textures, nu_mipmaps);
+            detexFileUnmap(mapping);
+            return false;
+        }
+        textures[i] = (detexTexture *)malloc(sizeof(detexTexture));
+        *textures[i] = (detexTexture){
+            .format = info->texture_format,
+            .data = mapping->data + offset,
+            .width = current_width,
+            .height = current_height,
+            .width_in_blocks = width_in_blocks,
+            .height_in_blocks = height_in_blocks,
+            .flags = DETEX_TEXTURE_FLAG_BORROWED_DATA,
+        };
+        offset += size;
+        current_width = max(current_width >> 1, 1);
+        current_height = max(current_height >> 1, 1);
+    }
+    *textures_out = textures;
+    *nu_levels_out = nu_mipmaps;
+    *mapping_out = mapping;
+    return true;
+}
+
+// Write textures to DDS file (multiple mip-maps levels), writing the data of every level with write_level,
+// or fwrite when it is NULL. Return true if succesful.
+bool detexFileWriteDDS(const char *filename,
+                       detexTexture **textures,
+                       int nu_levels,
+                       detexFileWriteLevelFuncType write_level,
+                       void *context) {
     const detexTextureFileInfo *info = detexLookupTextureFormatFileInfo(textures[0]->format);
 
     if (info == NULL || !info->dds_support) {
@@ -236,10 +405,20 @@ bool detexFileSaveDDS(const char *filename, detexTexture **textures, int nu_leve
     uint32_t bytes_per_block = detextBytesPerBlock(info->texture_format);
     for (int i = 0; i < nu_levels; i++) {
         uint32_t size = textures[i]->width_in_blocks * textures[i]->height_in_blocks * bytes_per_block;
-        fwrite(textures[i]->data, 1, size, file);
+        if (write_level != NULL ? !write_level(context, file, textures[i], size)
+                                : fwrite(textures[i]->data, 1, size, file) != size) {
+            detexSetErrorMessage("detexFileSaveDDS: Can't write texture %d to %s", i, filename);
+            fclose(file);
+            return false;
+        }
     }
 
     fclose(file);
 
     return true;
 }
+
+// Save textures to DDS file (multiple mip-maps levels). Return true if succesful.
+bool detexFileSaveDDS(const char *filename, detexTexture **textures, int nu_levels) {
+    return detexFileWriteDDS(filename, textures, nu_levels, NULL, NULL);
+}
@@ -355,3 +355,81 @@ end:
     *alpha_mask_out = alpha_mask;
     return true;
 }
+
+// Probe a texture file of which the type is determined from its signature.
+bool detexFileProbe(const char *filename, detexFileLayout *layout) {
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL) {
+        detexSetErrorMessage("detexFileProbe: Could not open file %s", filename);
+        return false;
+    }
+    char magic[8] = {0};
+    size_t size = fread(magic, 1, 8, file);
+    fclose(file);
+    if (size >= 4 && memcmp(magic, "DDS ", 4) == 0) {
+        return detexFileProbeDDS(filename, layout);
+    }
+    if (size >= 4 && memcmp(magic, "TEX\0", 4) == 0) {
+        return detexFileProbeTEX(filename, layout);
+    }
+    if (size == 8 && memcmp(magic, "\xABKTX 11\xBB", 8) == 0) {
+        return detexFileProbeKTX(filename, layout);
+    }
+    detexSetErrorMessage("detexFileProbe: Unknown file type %s", filename);
+    return false;
+}
+
+// Load a range of levels of a texture file, using the layout calculated from its header to read
+// only their data.
+bool detexFileLoadLevels(const char *filename,
+                         int first_level,
+                         int nu_levels,
+                         detexTexture ***textures_out,
+                         int *nu_levels_out) {
+    detexFileLayout layout;
+    if (!detexFileProbe(filename, &layout)) {
+        return false;
+    }
+    if (first_level < 0) {
+        first_level += layout.nu_levels;
+    }
+    if (first_level < 0 || first_level >= layout.nu_levels || nu_levels < 1) {
+        detexSetErrorMessage("detexFileLoadLevels: File %s doesn't have level %d", filename, first_level);
+        return false;
+    }
+    nu_levels = min(nu_levels, layout.nu_levels - first_level);
+
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL) {
+        detexSetErrorMessage("detexFileLoadLevels: Could not open file %s", filename);
+        return false;
+    }
+    detexTexture **textures = (detexTexture **)calloc(nu_levels, sizeof(detexTexture *));
+    for (int i = 0; i < nu_levels; i++) {
+        int level = first_level + i;
+        size_t size = layout.sizes[level];
+        // KTX levels are preceded by their size, which is checked against the layout.
+        long offset = (long)layout.offsets[level];
+        uint32_t file_level_size = (uint32_t)size;
+        if (layout.file_type == DETEX_FILE_TYPE_KTX) {
+            offset -= 4;
+        }
+        if (fseek(file, offset, SEEK_SET) != 0 ||
+            (layout.file_type == DETEX_FILE_TYPE_KTX && fread(&file_level_size, 1, 4, file) != 4)) {
+            file_level_size = 0;
+        }
+        textures[i] = (detexTexture *)malloc(sizeof(detexTexture));
+        *textures[i] = layout.levels[level];
+        textures[i]->data = (uint8_t *)malloc(size);
+        if (file_level_size != size || fread(textures[i]->data, 1, size, file) != size) {
+            detexSetErrorMessage("detexFileLoadLevels: Can't read level %d of %s", level, filename);
+            detexFreeTextures(textures, nu_levels);
+            fclose(file);
+            return false;
+        }
+    }
+    fclose(file);
+    *textures_out = textures;
+    *nu_levels_out = nu_levels;
+    return true;
+}
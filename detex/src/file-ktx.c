@@ -40,12 +40,83 @@ typedef struct {
     uint32_t metada_size;           // 15
 } KTX_HEADER;
 
+// Read the header of a KTX file and calculate the layout of its levels. The image size fields in
+// front of the levels are not read. Returns true if successful.
+bool detexFileProbeKTX(const char *filename, detexFileLayout *layout) {
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL) {
+        detexSetErrorMessage("detexFileProbeKTX: Could not open KTX file %s", filename);
+        return false;
+    }
+
+    char magic[16];
+    KTX_HEADER header;
+    if (fread(magic, 1, 16, file) != 16 || memcmp(magic, KTX_MAGIC, 16) != 0 ||
+        fread(&header, 1, sizeof(KTX_HEADER), file) != sizeof(KTX_HEADER)) {
+        detexSetErrorMessage("detexFileProbeKTX: Couldn't find KTX signature %s", filename);
+        fclose(file);
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long file_size = ftell(file);
+    fclose(file);
+
+    const detexTextureFileInfo *info = detexLookupKTXFileInfo(header.glInternalFormat, header.glFormat, header.glType);
+    if (info == NULL) {
+        detexSetErrorMessage(
+            "detexFileProbeKTX: Unsupported format in .ktx file "
+            "(glInternalFormat = 0x%04X)",
+            header.glInternalFormat);
+        return false;
+    }
+    // A mip-map count of zero means the file only has the base level.
+    int nu_levels = max((int)header.nu_mipmaps, 1);
+    if (header.width == 0 || header.height == 0 || nu_levels > DETEX_FILE_MAX_LEVELS) {
+        detexSetErrorMessage("detexFileProbeKTX: Invalid KTX header %s", filename);
+        return false;
+    }
+
+    layout->file_type = DETEX_FILE_TYPE_KTX;
+    layout->file_size = file_size < 0 ? 0 : (uint64_t)file_size;
+    layout->nu_levels = nu_levels;
+    uint64_t offset = 16 + sizeof(KTX_HEADER) + (uint64_t)header.metada_size;
+    uint32_t bytes_per_block = detextBytesPerBlock(info->texture_format);
+    uint32_t current_width = header.width;
+    uint32_t current_height = header.height;
+    for (int i = 0; i < nu_levels; i++) {
+        uint32_t width_in_blocks = max((current_width + info->block_width - 1) / info->block_width, 1);
+        uint32_t height_in_blocks = max((current_height + info->block_height - 1) / info->block_height, 1);
+        layout->levels[i] = (detexTexture){
+            .format = info->texture_format,
+            .width = current_width,
+            .height = current_height,
+            .width_in_blocks = width_in_blocks,
+            .height_in_blocks = height_in_blocks,
+        };
+        layout->sizes[i] = (size_t)width_in_blocks * height_in_blocks * bytes_per_block;
+        // Every level is preceded by its size and padded to a multiple of four bytes.
+        layout->offsets[i] = (size_t)offset + 4;
+        offset += 4 + ((layout->sizes[i] + 3) & ~(size_t)3);
+        current_width = max(current_width >> 1, 1);
+        current_height = max(current_height >> 1, 1);
+    }
+    if (layout->offsets[nu_levels - 1] + layout->sizes[nu_levels - 1] > layout->file_size) {
+        detexSetErrorMessage("detexFileProbeKTX: File %s is truncated", filename);
+        return false;
+    }
+    return true;
+}
+
 // Load texture from KTX file with mip-maps. Returns true if successful.
 // nu_mipmaps is a return parameter that returns the number of mipmap levels found.
 // textures_out is a return parameter for an array of detexTexture pointers that is allocated,
 // free with free(). textures_out[i] are allocated textures corresponding to each level, free
 // with free();
 bool detexFileLoadKTX(const char *filename, int max_mipmaps, detexTexture ***textures_out, int *nu_levels_out) {
+    if (max_mipmaps < 1) {
+        detexSetErrorMessage("detexFileLoadKTX: Invalid maximum number of mipmap levels %d", max_mipmaps);
+        return false;
+    }
     FILE *file = fopen(filename, "rb");
     if (file == NULL) {
         detexSetErrorMessage("detexFileLoadKTX: Could not open KTX file %s", filename);
@@ -78,7 +149,8 @@ bool detexFileLoadKTX(const char *filename, int max_mipmaps, detexTexture ***tex
         return false;
     }
 
-    int nu_mipmaps = min(header.nu_mipmaps, max_mipmaps);
+    // A KTX file may store zero levels to request generated mipmaps; it still has the first level.
+    int nu_mipmaps = min(max((int)header.nu_mipmaps, 1), max_mipmaps);
     *nu_levels_out = nu_mipmaps;
 
     detexTexture **textures = (detexTexture **)calloc(nu_mipmaps, sizeof(detexTexture *));
@@ -134,8 +206,120 @@ bool detexFileLoadKTX(const char *filename, int max_mipmaps, detexTexture ***tex
     return true;
 }
 
-// Save textures to KTX file (multiple mip-maps levels). Return true if succesful.
-bool detexFileSaveKTX(const char *filename, detexTexture **textures, int nu_levels) {
+// Map a KTX file into memory and return textures pointing into the mapping. Returns true if
+// successful. The textures must be freed with detexFreeTextures before the mapping is released
+// with detexFileUnmap.
+bool detexFileMapKTX(const char *filename,
+                     int max_mipmaps,
+                     detexTexture ***textures_out,
+                     int *nu_levels_out,
+                     detexFileMapping **mapping_out) {
+    if (max_mipmaps < 1) {
+        detexSetErrorMessage("detexFileMapKTX: Invalid maximum number of mipmap levels %d", max_mipmaps);
+        return false;
+    }
+    detexFileMapping *mapping = detexFileMap(filename);
+    if (mapping == NULL) {
+        return false;
+    }
+
+    if (mapping->size < 16 + sizeof(KTX_HEADER) || memcmp(mapping->data, KTX_MAGIC, 16) != 0) {
+        detexSetErrorMessage("detexFileLoadKTX: Couldn't find KTX signature");
+        detexFileUnmap(mapping);
+        return false;
+    }
+
+    KTX_HEADER header;
+    memcpy(&header, mapping->data + 16, sizeof(KTX_HEADER));
+
+    const detexTextureFileInfo *info = detexLookupKTXFileInfo(header.glInternalFormat, header.glFormat, header.glType);
+    if (info == NULL) {
+        detexSetErrorMessage(
+            "detexFileLoadKTX: Unsupported format in .ktx file "
+            "(glInternalFormat = 0x%04X)",
+            header.glInternalFormat);
+        detexFileUnmap(mapping);
+        return false;
+    }
+
+    size_t offset = 16 + sizeof(KTX_HEADER);
+    if (mapping->size - offset < header.metada_size) {
+        detexSetErrorMessage("detexFileLoadKTX: Error reading KTX metadata %s", filename);
+        detexFileUnmap(mapping);
+        return false;
+    }
+    offset += header.metada_size;
+
+    // A KTX file may store zero levels to request generated mipmaps; it still has the first level.
+    int nu_mipmaps = min(max((int)header.nu_mipmaps, 1), max_mipmaps);
+
+    detexTexture **textures = (detexTexture **)calloc(nu_mipmaps, sizeof(detexTexture *));
+
+    uint32_t bytes_per_block = detextBytesPerBlock(info->texture_format);
+    uint32_t block_width = info->block_width;
+    uint32_t block_height = info->block_height;
+    uint32_t current_width = header.width;
+    uint32_t current_height = header.height;
+    for (int i = 0; i < nu_mipmaps; i++) {
+        uint32_t correct_size;
+        if (mapping->size - offset < 4) {
+            detexSetErrorMessage("detexFileLoadKTX: Error reading KTX mipmap size %s", filename);
+            detexFreeTextures(textures, nu_mipmaps);
+            detexFileUnmap(mapping);
+            return false;
+        }
+        memcpy(&correct_size, mapping->data + offset, 4);
+        offset += 4;
+        uint32_t width_in_blocks = max((current_width + block_width - 1) / block_width, 1);
+        uint32_t height_in_blocks = max((current_height + block_height - 1) / block_height, 1);
+        uint32_t size = width_in_blocks * height_in_blocks * bytes_per_block;
+        if (size != correct_size) {
+            detexSetErrorMessage(
+                "detexFileLoadKTX: Error loading file %s: "
+                "Image size field of mipmap level %d should be %u but is %u",
+                filename,
+                i,
+                correct_size,
+                size);
+            detexFreeTextures(textures, nu_mipmaps);
+            detexFileUnmap(mapping);
+            return false;
+        }
+        if (mapping->size - offset < size) {
+            detexSetErrorMessage("detexFileLoadKTX: Error reading file %s", filename);
+            detexFreeTextures(textures, nu_mipmaps);
+            detexFileUnmap(mapping);
+            return false;
+        }
+        textures[i] = (detexTexture *)malloc(sizeof(detexTexture));
+        *textures[i] = (detexTexture){
+            .format = info->texture_format,
+            .data = mapping->data + offset,
+            .width = current_width,
+            .height = current_height,
+            .width_in_blocks = width_in_blocks,
+            .height_in_blocks = height_in_blocks,
+            .flags = DETEX_TEXTURE_FLAG_BORROWED_DATA,
+        };
+        // Levels are padded to a multiple of four bytes.
+        offset += (size + 3) & ~3u;
+        offset = min(offset, mapping->size);
+        current_width = max(current_width >> 1, 1);
+        current_height = max(current_height >> 1, 1);
+    }
+    *textures_out = textures;
+    *nu_levels_out = nu_mipmaps;
+    *mapping_out = mapping;
+    return true;
+}
+
+// Write textures to KTX file (multiple mip-maps levels), writing the data of every level with write_level,
+// or fwrite when it is NULL. Return true if succesful.
+bool detexFileWriteKTX(const char *filename,
+                       detexTexture **textures,
+                       int nu_levels,
+                       detexFileWriteLevelFuncType write_level,
+                       void *context) {
     const detexTextureFileInfo *info = detexLookupTextureFormatFileInfo(textures[0]->format);
     if (info == NULL || !info->ktx_support) {
         detexSetErrorMessage("detexFileSaveKTX: Could not match texture format with KTX file format");
@@ -168,7 +352,12 @@ bool detexFileSaveKTX(const char *filename, detexTexture **textures, int nu_leve
     for (int i = 0; i < nu_levels; i++) {
         uint32_t size = textures[i]->width_in_blocks * textures[i]->height_in_blocks * bytes_per_block;
         fwrite(&size, 1, 4, file);
-        fwrite(textures[i]->data, 1, size, file);
+        if (write_level != NULL ? !write_level(context, file, textures[i], size)
+                                : fwrite(textures[i]->data, 1, size, file) != size) {
+            detexSetErrorMessage("detexFileSaveKTX: Can't write texture %d to %s", i, filename);
+            fclose(file);
+            return false;
+        }
         uint32_t unaligned = size % 4;
         if (unaligned > 0) {
             fwrite("\0\0\0", 1, 4 - unaligned, file);
@@ -178,3 +367,8 @@ bool detexFileSaveKTX(const char *filename, detexTexture **textures, int nu_leve
     fclose(file);
     return true;
 }
+
+// Save textures to KTX file (multiple mip-maps levels). Return true if succesful.
+bool detexFileSaveKTX(const char *filename, detexTexture **textures, int nu_levels) {
+    return detexFileWriteKTX(filename, textures, nu_levels, NULL, NULL);
+}
@@ -0,0 +1,175 @@
+/*
+
+Copyright (c) 2015 Harm Hanemaaijer <fgenfb@yahoo.com>
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+*/
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+// For copy_file_range.
+#    define _GNU_SOURCE
+#endif
+
+#ifdef _WIN32
+#    define WIN32_LEAN_AND_MEAN
+#    include <windows.h>
+#else
+#    include <fcntl.h>
+#    include <stdint.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+#ifdef __linux__
+#    include <sys/sendfile.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "detex.h"
+
+// Map a file into memory. Returns NULL if unsuccessful.
+detexFileMapping *detexFileMap(const char *filename) {
+    detexFileMapping *mapping = (detexFileMapping *)calloc(1, sizeof(detexFileMapping));
+#ifdef _WIN32
+    HANDLE file = CreateFileA(
+        filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        detexSetErrorMessage("detexFileMap: Could not open file %s", filename);
+        free(mapping);
+        return NULL;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        detexSetErrorMessage("detexFileMap: Empty file %s", filename);
+        CloseHandle(file);
+        free(mapping);
+        return NULL;
+    }
+    HANDLE file_mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+    void *data = file_mapping != NULL ? MapViewOfFile(file_mapping, FILE_MAP_COPY, 0, 0, 0) : NULL;
+    if (data == NULL) {
+        detexSetErrorMessage("detexFileMap: Could not map file %s", filename);
+        if (file_mapping != NULL) CloseHandle(file_mapping);
+        CloseHandle(file);
+        free(mapping);
+        return NULL;
+    }
+    mapping->data = (uint8_t *)data;
+    mapping->size = (size_t)size.QuadPart;
+    mapping->file_handle = file;
+    mapping->mapping_handle = file_mapping;
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        detexSetErrorMessage("detexFileMap: Could not open file %s", filename);
+        free(mapping);
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        detexSetErrorMessage("detexFileMap: Empty file %s", filename);
+        close(fd);
+        free(mapping);
+        return NULL;
+    }
+    void *data = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        detexSetErrorMessage("detexFileMap: Could not map file %s", filename);
+        close(fd);
+        free(mapping);
+        return NULL;
+    }
+    // Levels are usually read front to back, once.
+    madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+    mapping->data = (uint8_t *)data;
+    mapping->size = (size_t)st.st_size;
+    // The mapping stays valid without it, but detexFileRewrap copies from the file descriptor.
+    mapping->file_handle = (void *)(intptr_t)fd;
+#endif
+    return mapping;
+}
+
+// Unmap a file mapped with detexFileMap.
+void detexFileUnmap(detexFileMapping *mapping) {
+    if (mapping == NULL) return;
+#ifdef _WIN32
+    UnmapViewOfFile(mapping->data);
+    CloseHandle((HANDLE)mapping->mapping_handle);
+    CloseHandle((HANDLE)mapping->file_handle);
+#else
+    munmap(mapping->data, mapping->size);
+    close((int)(intptr_t)mapping->file_handle);
+#endif
+    free(mapping);
+}
+
+// Write the data of a level that points into the mapping passed as context. On Linux the kernel
+// copies it from the mapped file, so the pages of the mapping are never touched; elsewhere, or
+// when the file systems involved don't support it, it is written from the mapping.
+static bool WriteMappedLevel(void *context, FILE *file, const detexTexture *texture, size_t size) {
+    const detexFileMapping *mapping = (const detexFileMapping *)context;
+    size_t offset = (size_t)(texture->data - mapping->data);
+    if (offset > mapping->size || size > mapping->size - offset) {
+        return false;
+    }
+    size_t copied = 0;
+#ifdef __linux__
+    if (fflush(file) != 0) {
+        return false;
+    }
+    int in_fd = (int)(intptr_t)mapping->file_handle;
+    int out_fd = fileno(file);
+    while (copied < size) {
+        loff_t in_offset = (loff_t)(offset + copied);
+        ssize_t n = copy_file_range(in_fd, &in_offset, out_fd, NULL, size - copied, 0);
+        if (n <= 0) {
+            off_t sendfile_offset = (off_t)(offset + copied);
+            n = sendfile(out_fd, in_fd, &sendfile_offset, size - copied);
+        }
+        if (n <= 0) {
+            break;
+        }
+        copied += (size_t)n;
+    }
+    // The file descriptor was written behind the back of the stream, so move the stream to
+    // its end again.
+    if (fseek(file, 0, SEEK_END) != 0) {
+        return false;
+    }
+#endif
+    return fwrite(mapping->data + offset + copied, 1, size - copied, file) == size - copied;
+}
+
+// Save textures that point into a file mapping to a file of another container type, copying the
+// data of the levels from the mapped file. Returns true if successful.
+bool detexFileRewrap(const char *filename,
+                     uint32_t file_type,
+                     detexTexture **textures,
+                     int nu_levels,
+                     const detexFileMapping *mapping) {
+    void *context = (void *)mapping;
+    switch (file_type) {
+        case DETEX_FILE_TYPE_KTX:
+            return detexFileWriteKTX(filename, textures, nu_levels, WriteMappedLevel, context);
+        case DETEX_FILE_TYPE_DDS:
+            return detexFileWriteDDS(filename, textures, nu_levels, WriteMappedLevel, context);
+        case DETEX_FILE_TYPE_TEX:
+            return detexFileWriteTEX(filename, textures, nu_levels, WriteMappedLevel, context);
+        default:
+            detexSetErrorMessage("detexFileRewrap: Invalid file type %d", file_type);
+            return false;
+    }
+}
@@ -15,51 +15,41 @@ typedef struct {
     bool has_mipmaps;
 } TEX_HEADER;
 
-bool detexFileLoadTEX(const char *filename, int max_mipmaps, detexTexture ***textures_out, int *nu_levels_out) {
-    FILE *file = fopen(filename, "rb");
-    if (!file) {
-        detexSetErrorMessage("detexFileLoadTEX: Could not open file %s", filename);
-        return false;
-    }
-
-    TEX_HEADER header;
-    if (fread(&header, 1, sizeof(TEX_HEADER), file) != sizeof(TEX_HEADER)) {
-        fprintf(stderr, "detexFileLoadTEX: Couldn't read TEX header!\n");
-        fclose(file);
-        return false;
-    }
-
-    if (memcmp(header.magic, "TEX\0", 4) != 0) {
-        fprintf(stderr, "detexFileLoadTEX: Not a valid tex file!\n");
-        fclose(file);
-        return false;
-    }
-
-    uint32_t format = DETEX_TEXTURE_FORMAT_BC1;
-    switch (header.tex_format) {
+// Translate a TEX format code into a detex texture format. Returns false if it is not supported.
+static bool GetTEXTextureFormat(uint8_t tex_format, uint32_t *format_out) {
+    switch (tex_format) {
         case 1:
-            format = DETEX_TEXTURE_FORMAT_ETC1;
-            break;
+            *format_out = DETEX_TEXTURE_FORMAT_ETC1;
+            return true;
         case 2:
-            format = DETEX_TEXTURE_FORMAT_ETC2_EAC;
-            break;
+            *format_out = DETEX_TEXTURE_FORMAT_ETC2_EAC;
+            return true;
         // RGB_565 ?? case 3: break;
         case 10:
         case 11:
-            format = DETEX_TEXTURE_FORMAT_BC1;
-            break;
+            *format_out = DETEX_TEXTURE_FORMAT_BC1;
+            return true;
         case 12:
-            format = DETEX_TEXTURE_FORMAT_BC3;
-            break;
+            *format_out = DETEX_TEXTURE_FORMAT_BC3;
+            return true;
         case 20:
-            format = DETEX_PIXEL_FORMAT_RGBA8;
-            break;
+            *format_out = DETEX_PIXEL_FORMAT_RGBA8;
+            return true;
         default:
             // NOTE: technically riot handles all other formats as DXT1 ?????
-            detexSetErrorMessage("detexFileLoadTEX: Unhandled TEX format %d", header.tex_format);
+            detexSetErrorMessage("detexFileLoadTEX: Unhandled TEX format %d", tex_format);
             return false;
     }
+}
+
+// TEX image sizes are 16-bit, so there are at most 16 mip-map levels.
+#define TEX_MAX_LEVELS 16
 
+// Calculate the layout of all mip-map levels in a TEX file from its header. The levels are
+// stored smallest first after the header, so the offset of every level is known up front.
+// Fills in levels[] (without data) and the file offset of each level, returns the number of
+// levels in the file.
+static int GetTEXLayout(const TEX_HEADER *header, uint32_t format, detexTexture *levels, size_t *offsets) {
     detexTextureFileInfo const *info = detexLookupTextureFormatFileInfo(format);
     uint32_t bytes_per_block = detextBytesPerBlock(info->texture_format);
     uint32_t block_width = info->block_width;
@@ -67,43 +57,202 @@ bool detexFileLoadTEX(const char *filename, int max_mipmaps, detexTexture ***tex
 
     // TODO: log if clz method yields same result here
     // NOTE: this might actually be faster than clz
-    int count_mipmaps = header.has_mipmaps ? floor(log2(max(header.image_height, header.image_width))) + 1.0 : 1;
-    int nu_levels = min(max_mipmaps, count_mipmaps);
-    *nu_levels_out = nu_levels;
-    detexTexture **textures = malloc(nu_levels * sizeof(detexTexture *));
-    *textures_out = textures;
+    int count_mipmaps = header->has_mipmaps ? floor(log2(max(header->image_height, header->image_width))) + 1.0 : 1;
 
-    uint32_t current_width = header.image_width;
-    uint32_t current_height = header.image_height;
-    fseek(file, 0, SEEK_END);
-
-    for (int i = 0; i < nu_levels; ++i) {
-        // Calculate sizes
+    uint32_t current_width = header->image_width;
+    uint32_t current_height = header->image_height;
+    size_t sizes[TEX_MAX_LEVELS];
+    for (int i = 0; i < count_mipmaps; ++i) {
         uint32_t width_in_blocks = max((current_width + block_width - 1) / block_width, 1);
         uint32_t height_in_blocks = max((current_height + block_height - 1) / block_height, 1);
-        uint32_t size = width_in_blocks * height_in_blocks * bytes_per_block;
-        if (fseek(file, -size, SEEK_CUR) != 0 || ftell(file) < sizeof(TEX_HEADER)) {
-            detexSetErrorMessage("detexFileLoadTEX: Can't read texture %d", i);
-            return false;
-        }
-        textures[i] = (detexTexture *)malloc(sizeof(detexTexture));
-        *textures[i] = (detexTexture const){
+        sizes[i] = (size_t)width_in_blocks * height_in_blocks * bytes_per_block;
+        levels[i] = (detexTexture){
             .format = format,
             .width = current_width,
             .height = current_height,
             .width_in_blocks = width_in_blocks,
             .height_in_blocks = height_in_blocks,
-            .data = malloc(size),
         };
-        fread(textures[i]->data, 1, size, file);
-        fseek(file, -size, SEEK_CUR);
         current_width = max(current_width >> 1, 1);
         current_height = max(current_height >> 1, 1);
     }
+    size_t offset = sizeof(TEX_HEADER);
+    for (int i = count_mipmaps - 1; i >= 0; --i) {
+        offsets[i] = offset;
+        offset += sizes[i];
+    }
+    return count_mipmaps;
+}
+
+// Return the size in bytes of a level calculated by GetTEXLayout.
+static size_t GetTEXLevelSize(const detexTexture *level) {
+    return (size_t)level->width_in_blocks * level->height_in_blocks * detextBytesPerBlock(level->format);
+}
+
+// Read the header of a TEX file and calculate the layout of its levels. Returns true if successful.
+bool detexFileProbeTEX(const char *filename, detexFileLayout *layout) {
+    FILE *file = fopen(filename, "rb");
+    if (!file) {
+        detexSetErrorMessage("detexFileProbeTEX: Could not open file %s", filename);
+        return false;
+    }
+
+    TEX_HEADER header;
+    if (fread(&header, 1, sizeof(TEX_HEADER), file) != sizeof(TEX_HEADER) || memcmp(header.magic, "TEX\0", 4) != 0) {
+        detexSetErrorMessage("detexFileProbeTEX: Not a valid tex file %s", filename);
+        fclose(file);
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long file_size = ftell(file);
+    fclose(file);
+
+    uint32_t format;
+    if (!GetTEXTextureFormat(header.tex_format, &format)) {
+        return false;
+    }
+    if (header.image_width == 0 || header.image_height == 0) {
+        detexSetErrorMessage("detexFileProbeTEX: Invalid TEX header %s", filename);
+        return false;
+    }
+
+    layout->file_type = DETEX_FILE_TYPE_TEX;
+    layout->file_size = file_size < 0 ? 0 : (uint64_t)file_size;
+    layout->nu_levels = GetTEXLayout(&header, format, layout->levels, layout->offsets);
+    for (int i = 0; i < layout->nu_levels; ++i) {
+        layout->sizes[i] = GetTEXLevelSize(&layout->levels[i]);
+    }
+    // The largest level is stored last.
+    if (layout->offsets[0] + layout->sizes[0] > layout->file_size) {
+        detexSetErrorMessage("detexFileProbeTEX: File %s is truncated", filename);
+        return false;
+    }
     return true;
 }
 
-bool detexFileSaveTEX(const char *filename, detexTexture **textures, int nu_levels) {
+// Load TEX file. The layout is calculated from the header, after which the requested levels are
+// read in a single forward pass, smallest first.
+bool detexFileLoadTEX(const char *filename, int max_mipmaps, detexTexture ***textures_out, int *nu_levels_out) {
+    if (max_mipmaps < 1) {
+        detexSetErrorMessage("detexFileLoadTEX: Invalid maximum number of mipmap levels %d", max_mipmaps);
+        return false;
+    }
+    FILE *file = fopen(filename, "rb");
+    if (!file) {
+        detexSetErrorMessage("detexFileLoadTEX: Could not open file %s", filename);
+        return false;
+    }
+
+    TEX_HEADER header;
+    if (fread(&header, 1, sizeof(TEX_HEADER), file) != sizeof(TEX_HEADER)) {
+        detexSetErrorMessage("detexFileLoadTEX: Couldn't read TEX header %s", filename);
+        fclose(file);
+        return false;
+    }
+
+    if (memcmp(header.magic, "TEX\0", 4) != 0) {
+        detexSetErrorMessage("detexFileLoadTEX: Not a valid tex file %s", filename);
+        fclose(file);
+        return false;
+    }
+
+    uint32_t format;
+    if (!GetTEXTextureFormat(header.tex_format, &format)) {
+        fclose(file);
+        return false;
+    }
+
+    detexTexture levels[TEX_MAX_LEVELS];
+    size_t offsets[TEX_MAX_LEVELS];
+    int count_mipmaps = GetTEXLayout(&header, format, levels, offsets);
+    int nu_levels = min(max_mipmaps, count_mipmaps);
+    detexTexture **textures = (detexTexture **)calloc(nu_levels, sizeof(detexTexture *));
+
+    // Skip the levels smaller than the ones requested.
+    if (offsets[nu_levels - 1] != sizeof(TEX_HEADER) && fseek(file, (long)offsets[nu_levels - 1], SEEK_SET) != 0) {
+        detexSetErrorMessage("detexFileLoadTEX: Can't read texture %d", nu_levels - 1);
+        detexFreeTextures(textures, nu_levels);
+        fclose(file);
+        return false;
+    }
+    for (int i = nu_levels - 1; i >= 0; --i) {
+        size_t size = GetTEXLevelSize(&levels[i]);
+        textures[i] = (detexTexture *)malloc(sizeof(detexTexture));
+        *textures[i] = levels[i];
+        textures[i]->data = (uint8_t *)malloc(size);
+        if (fread(textures[i]->data, 1, size, file) != size) {
+            detexSetErrorMessage("detexFileLoadTEX: Can't read texture %d", i);
+            detexFreeTextures(textures, nu_levels);
+            fclose(file);
+            return false;
+        }
+    }
+    fclose(file);
+    *textures_out = textures;
+    *nu_levels_out = nu_levels;
+    return true;
+}
+
+// Map a TEX file into memory and return textures pointing into the mapping. Returns true if
+// successful. The textures must be freed with detexFreeTextures before the mapping is released
+// with detexFileUnmap.
+bool detexFileMapTEX(const char *filename,
+                     int max_mipmaps,
+                     detexTexture ***textures_out,
+                     int *nu_levels_out,
+                     detexFileMapping **mapping_out) {
+    if (max_mipmaps < 1) {
+        detexSetErrorMessage("detexFileMapTEX: Invalid maximum number of mipmap levels %d", max_mipmaps);
+        return false;
+    }
+    detexFileMapping *mapping = detexFileMap(filename);
+    if (mapping == NULL) {
+        return false;
+    }
+
+    TEX_HEADER header;
+    if (mapping->size < sizeof(TEX_HEADER) || memcmp(mapping->data, "TEX\0", 4) != 0) {
+        detexSetErrorMessage("detexFileLoadTEX: Not a valid tex file %s", filename);
+        detexFileUnmap(mapping);
+        return false;
+    }
+    memcpy(&header, mapping->data, sizeof(TEX_HEADER));
+
+    uint32_t format;
+    if (!GetTEXTextureFormat(header.tex_format, &format)) {
+        detexFileUnmap(mapping);
+        return false;
+    }
+
+    detexTexture levels[TEX_MAX_LEVELS];
+    size_t offsets[TEX_MAX_LEVELS];
+    int count_mipmaps = GetTEXLayout(&header, format, levels, offsets);
+    if (offsets[0] + GetTEXLevelSize(&levels[0]) > mapping->size) {
+        detexSetErrorMessage("detexFileLoadTEX: Can't read texture %d", 0);
+        detexFileUnmap(mapping);
+        return false;
+    }
+    int nu_levels = min(max_mipmaps, count_mipmaps);
+    detexTexture **textures = (detexTexture **)calloc(nu_levels, sizeof(detexTexture *));
+    for (int i = 0; i < nu_levels; ++i) {
+        textures[i] = (detexTexture *)malloc(sizeof(detexTexture));
+        *textures[i] = levels[i];
+        textures[i]->data = mapping->data + offsets[i];
+        textures[i]->flags = DETEX_TEXTURE_FLAG_BORROWED_DATA;
+    }
+    *textures_out = textures;
+    *nu_levels_out = nu_levels;
+    *mapping_out = mapping;
+    return true;
+}
+
+// Write textures to TEX file, writing the data of every level with write_level, or fwrite when it is NULL.
+// The levels are written smallest first.
+bool detexFileWriteTEX(const char *filename,
+                       detexTexture **textures,
+                       int nu_levels,
+                       detexFileWriteLevelFuncType write_level,
+                       void *context) {
     TEX_HEADER header = {
         .magic = "TEX\0",
         .image_width = textures[0]->width,
@@ -154,9 +303,18 @@ bool detexFileSaveTEX(const char *filename, detexTexture **textures, int nu_leve
     uint32_t bytes_per_block = detextBytesPerBlock(format);
     for (int i = nu_levels - 1; i >= 0; i--) {
         uint32_t size = textures[i]->width_in_blocks * textures[i]->height_in_blocks * bytes_per_block;
-        fwrite(textures[i]->data, 1, size, file);
+        if (write_level != NULL ? !write_level(context, file, textures[i], size)
+                                : fwrite(textures[i]->data, 1, size, file) != size) {
+            detexSetErrorMessage("detexFileSaveTEX: Can't write texture %d to %s", i, filename);
+            fclose(file);
+            return false;
+        }
     }
 
     fclose(file);
     return true;
 }
+
+bool detexFileSaveTEX(const char *filename, detexTexture **textures, int nu_levels) {
+    return detexFileWriteTEX(filename, textures, nu_levels, NULL, NULL);
+}
@@ -16,13 +16,19 @@ OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 
 */
 
-#include <fenv.h>
 #include <float.h>
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "detex.h"
 
+#if defined(DETEX_ARCH_X86)
+#    include <immintrin.h>
+#elif defined(DETEX_ARCH_ARM64)
+#    include <arm_neon.h>
+#endif
+
 /******************************************************************************
  *
  * Filename:    ieeehalfprecision.c
@@ -262,8 +268,12 @@ DETEX_INLINE_ONLY void halfp2singles(void *DETEX_RESTRICT target, void *DETEX_RE
 
 // Precalculated half-float table management.
 
+// The table is shared by all threads; it is calculated once, on first use.
+
 float *detex_half_float_table = NULL;
 
+static detexOnceFlag half_float_table_once = DETEX_ONCE_INIT;
+
 static void detexCalculateHalfFloatTable() {
     float *table = (float *)malloc(65536 * sizeof(float));
     uint16_t *hf_buffer = (uint16_t *)malloc(65536 * sizeof(uint16_t));
@@ -273,41 +283,288 @@ static void detexCalculateHalfFloatTable() {
     detex_half_float_table = table;
 }
 
-void detexValidateHalfFloatTable() {
-    if (detex_half_float_table == NULL) detexCalculateHalfFloatTable();
+void detexValidateHalfFloatTable() { detexCallOnce(&half_float_table_once, detexCalculateHalfFloatTable); }
+
+// Conversion functions. The scalar versions use the table and singles2halfp.
+
+static void ConvertHalfFloatToFloatScalar(const uint16_t *source_buffer, int n, float *target_buffer) {
+    detexValidateHalfFloatTable();
+    for (int i = 0; i < n; i++) target_buffer[i] = detex_half_float_table[source_buffer[i]];
 }
 
-// Conversion functions.
+static void ConvertFloatToHalfFloatScalar(const float *source_buffer, int n, uint16_t *target_buffer) {
+    singles2halfp(target_buffer, (void *)source_buffer, n);
+}
 
-void detexConvertHalfFloatToFloat(uint16_t *source_buffer, int n, float *target_buffer) {
+static void ConvertNormalizedHalfFloatToUInt16Scalar(uint16_t *buffer, int n) {
     detexValidateHalfFloatTable();
-    for (int i = 0; i < n; i++) target_buffer[i] = detexGetFloatFromHalfFloat(source_buffer[i]);
+    for (int i = 0; i < n; i++) buffer[i] = detexGetUInt16FromNormalizedFloat(detex_half_float_table[buffer[i]]);
+}
+
+static void ConvertNormalizedFloatToUInt16Scalar(const float *source_buffer, int n, uint16_t *target_buffer) {
+    for (int i = 0; i < n; i++) target_buffer[i] = detexGetUInt16FromNormalizedFloat(source_buffer[i]);
+}
+
+#ifdef DETEX_ARCH_X86
+
+// The AVX2 level includes F16C, which converts eight values at a time. The results
+// are made identical to the scalar versions: NaNs are replaced by the single NaN
+// value that halfp2singles and singles2halfp return, and halfway cases, which the
+// hardware rounds to even, are moved up by one unit in the last place first so
+// that they are rounded away from zero like singles2halfp does.
+
+DETEX_TARGET("avx2,f16c")
+static inline __m256 HalfFloatToFloatAVX2(__m128i h) {
+    __m256 f = _mm256_cvtph_ps(h);
+    __m256 nan = _mm256_castsi256_ps(_mm256_set1_epi32((int)0xFFC00000u));
+    return _mm256_blendv_ps(f, nan, _mm256_cmp_ps(f, f, _CMP_UNORD_Q));
+}
+
+DETEX_TARGET("avx2,f16c")
+static inline __m128i FloatToHalfFloatAVX2(__m256 f) {
+    __m256i x = _mm256_castps_si256(f);
+    __m256i a = _mm256_and_si256(x, _mm256_set1_epi32(0x7FFFFFFF));
+    // Halfway between two normal half floats the lower 13 mantissa bits are 0x1000.
+    __m256i normal = _mm256_cmpgt_epi32(a, _mm256_set1_epi32(0x387FFFFF));
+    __m256i halfway = _mm256_cmpeq_epi32(_mm256_and_si256(a, _mm256_set1_epi32(0x1FFF)), _mm256_set1_epi32(0x1000));
+    halfway = _mm256_and_si256(halfway, normal);
+    // Halfway between two denormal half floats |f| * 2^25 is an odd integer.
+    __m256 scaled = _mm256_mul_ps(_mm256_castsi256_ps(a), _mm256_set1_ps(33554432.0f));
+    __m256i i = _mm256_cvttps_epi32(scaled);
+    __m256i integer = _mm256_castps_si256(_mm256_cmp_ps(_mm256_cvtepi32_ps(i), scaled, _CMP_EQ_OQ));
+    __m256i odd = _mm256_srai_epi32(_mm256_slli_epi32(i, 31), 31);
+    halfway = _mm256_or_si256(halfway, _mm256_andnot_si256(normal, _mm256_and_si256(integer, odd)));
+    x = _mm256_sub_epi32(x, halfway);
+    __m128i h = _mm256_cvtps_ph(_mm256_castsi256_ps(x), _MM_FROUND_TO_NEAREST_INT);
+    __m256i nan = _mm256_cmpgt_epi32(a, _mm256_set1_epi32(0x7F800000));
+    __m128i nan16 = _mm_packs_epi32(_mm256_castsi256_si128(nan), _mm256_extracti128_si256(nan, 1));
+    return _mm_blendv_epi8(h, _mm_set1_epi16((short)0xFE00), nan16);
+}
+
+DETEX_TARGET("avx2,f16c")
+static inline __m128i NormalizedFloatToUInt16AVX2(__m256 f) {
+    // The maximum is zero for NaN.
+    f = _mm256_min_ps(_mm256_max_ps(f, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+    // Calculate in double precision like detexGetUInt16FromNormalizedFloat.
+    __m256d scale = _mm256_set1_pd(65535.0);
+    __m256d half = _mm256_set1_pd(0.5);
+    __m256d low = _mm256_add_pd(_mm256_mul_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(f)), scale), half);
+    __m256d high = _mm256_add_pd(_mm256_mul_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(f, 1)), scale), half);
+    return _mm_packus_epi32(_mm256_cvttpd_epi32(low), _mm256_cvttpd_epi32(high));
+}
+
+// The remaining values of each function are converted through a buffer of eight.
+
+DETEX_TARGET("avx2,f16c")
+static void ConvertHalfFloatToFloatAVX2(const uint16_t *source_buffer, int n, float *target_buffer) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i h = _mm_loadu_si128((const __m128i *)(source_buffer + i));
+        _mm256_storeu_ps(target_buffer + i, HalfFloatToFloatAVX2(h));
+    }
+    if (i < n) {
+        uint16_t h[8] = {0};
+        float f[8];
+        memcpy(h, source_buffer + i, (n - i) * sizeof(uint16_t));
+        _mm256_storeu_ps(f, HalfFloatToFloatAVX2(_mm_loadu_si128((const __m128i *)h)));
+        memcpy(target_buffer + i, f, (n - i) * sizeof(float));
+    }
+}
+
+DETEX_TARGET("avx2,f16c")
+static void ConvertFloatToHalfFloatAVX2(const float *source_buffer, int n, uint16_t *target_buffer) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+        _mm_storeu_si128((__m128i *)(target_buffer + i), FloatToHalfFloatAVX2(_mm256_loadu_ps(source_buffer + i)));
+    if (i < n) {
+        float f[8] = {0};
+        uint16_t h[8];
+        memcpy(f, source_buffer + i, (n - i) * sizeof(float));
+        _mm_storeu_si128((__m128i *)h, FloatToHalfFloatAVX2(_mm256_loadu_ps(f)));
+        memcpy(target_buffer + i, h, (n - i) * sizeof(uint16_t));
+    }
+}
+
+DETEX_TARGET("avx2,f16c")
+static void ConvertNormalizedHalfFloatToUInt16AVX2(uint16_t *buffer, int n) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 f = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(buffer + i)));
+        _mm_storeu_si128((__m128i *)(buffer + i), NormalizedFloatToUInt16AVX2(f));
+    }
+    if (i < n) {
+        uint16_t h[8] = {0};
+        memcpy(h, buffer + i, (n - i) * sizeof(uint16_t));
+        __m256 f = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)h));
+        _mm_storeu_si128((__m128i *)h, NormalizedFloatToUInt16AVX2(f));
+        memcpy(buffer + i, h, (n - i) * sizeof(uint16_t));
+    }
+}
+
+DETEX_TARGET("avx2,f16c")
+static void ConvertNormalizedFloatToUInt16AVX2(const float *source_buffer, int n, uint16_t *target_buffer) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i u = NormalizedFloatToUInt16AVX2(_mm256_loadu_ps(source_buffer + i));
+        _mm_storeu_si128((__m128i *)(target_buffer + i), u);
+    }
+    if (i < n) {
+        float f[8] = {0};
+        uint16_t u[8];
+        memcpy(f, source_buffer + i, (n - i) * sizeof(float));
+        _mm_storeu_si128((__m128i *)u, NormalizedFloatToUInt16AVX2(_mm256_loadu_ps(f)));
+        memcpy(target_buffer + i, u, (n - i) * sizeof(uint16_t));
+    }
+}
+
+#endif
+
+#ifdef DETEX_ARCH_ARM64
+
+// NEON converts four values at a time. As with F16C, NaNs and halfway cases are
+// adjusted to match the scalar versions.
+
+static inline float32x4_t HalfFloatToFloatNEON(uint16x4_t h) {
+    uint32x4_t x = vreinterpretq_u32_f32(vcvt_f32_f16(vreinterpret_f16_u16(h)));
+    uint32x4_t nan = vcgtq_u32(vandq_u32(x, vdupq_n_u32(0x7FFFFFFF)), vdupq_n_u32(0x7F800000));
+    return vreinterpretq_f32_u32(vbslq_u32(nan, vdupq_n_u32(0xFFC00000u), x));
+}
+
+static inline uint16x4_t FloatToHalfFloatNEON(float32x4_t f) {
+    uint32x4_t x = vreinterpretq_u32_f32(f);
+    uint32x4_t a = vandq_u32(x, vdupq_n_u32(0x7FFFFFFF));
+    // Halfway between two normal half floats the lower 13 mantissa bits are 0x1000.
+    uint32x4_t normal = vcgtq_u32(a, vdupq_n_u32(0x387FFFFF));
+    uint32x4_t halfway = vceqq_u32(vandq_u32(a, vdupq_n_u32(0x1FFF)), vdupq_n_u32(0x1000));
+    halfway = vandq_u32(halfway, normal);
+    // Halfway between two denormal half floats |f| * 2^25 is an odd integer.
+    float32x4_t scaled = vmulq_n_f32(vreinterpretq_f32_u32(a), 33554432.0f);
+    uint32x4_t i = vcvtq_u32_f32(scaled);
+    uint32x4_t integer = vceqq_f32(vcvtq_f32_u32(i), scaled);
+    uint32x4_t odd = vtstq_u32(i, vdupq_n_u32(1));
+    halfway = vorrq_u32(halfway, vbicq_u32(vandq_u32(integer, odd), normal));
+    x = vsubq_u32(x, halfway);
+    uint16x4_t h = vreinterpret_u16_f16(vcvt_f16_f32(vreinterpretq_f32_u32(x)));
+    uint16x4_t nan = vmovn_u32(vcgtq_u32(a, vdupq_n_u32(0x7F800000)));
+    return vbsl_u16(nan, vdup_n_u16(0xFE00), h);
+}
+
+static inline uint16x4_t NormalizedFloatToUInt16NEON(float32x4_t f) {
+    // The maximum number is zero for NaN.
+    f = vminq_f32(vmaxnmq_f32(f, vdupq_n_f32(0.0f)), vdupq_n_f32(1.0f));
+    // Calculate in double precision like detexGetUInt16FromNormalizedFloat.
+    float64x2_t scale = vdupq_n_f64(65535.0);
+    float64x2_t half = vdupq_n_f64(0.5);
+    float64x2_t low = vaddq_f64(vmulq_f64(vcvt_f64_f32(vget_low_f32(f)), scale), half);
+    float64x2_t high = vaddq_f64(vmulq_f64(vcvt_high_f64_f32(f), scale), half);
+    uint32x4_t u = vcombine_u32(vmovn_u64(vcvtq_u64_f64(low)), vmovn_u64(vcvtq_u64_f64(high)));
+    return vmovn_u32(u);
+}
+
+// The remaining values of each function are converted through a buffer of four.
+
+static void ConvertHalfFloatToFloatNEON(const uint16_t *source_buffer, int n, float *target_buffer) {
+    int i = 0;
+    for (; i + 4 <= n; i += 4) vst1q_f32(target_buffer + i, HalfFloatToFloatNEON(vld1_u16(source_buffer + i)));
+    if (i < n) {
+        uint16_t h[4] = {0};
+        float f[4];
+        memcpy(h, source_buffer + i, (n - i) * sizeof(uint16_t));
+        vst1q_f32(f, HalfFloatToFloatNEON(vld1_u16(h)));
+        memcpy(target_buffer + i, f, (n - i) * sizeof(float));
+    }
+}
+
+static void ConvertFloatToHalfFloatNEON(const float *source_buffer, int n, uint16_t *target_buffer) {
+    int i = 0;
+    for (; i + 4 <= n; i += 4) vst1_u16(target_buffer + i, FloatToHalfFloatNEON(vld1q_f32(source_buffer + i)));
+    if (i < n) {
+        float f[4] = {0};
+        uint16_t h[4];
+        memcpy(f, source_buffer + i, (n - i) * sizeof(float));
+        vst1_u16(h, FloatToHalfFloatNEON(vld1q_f32(f)));
+        memcpy(target_buffer + i, h, (n - i) * sizeof(uint16_t));
+    }
+}
+
+static void ConvertNormalizedHalfFloatToUInt16NEON(uint16_t *buffer, int n) {
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        float32x4_t f = vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(buffer + i)));
+        vst1_u16(buffer + i, NormalizedFloatToUInt16NEON(f));
+    }
+    if (i < n) {
+        uint16_t h[4] = {0};
+        memcpy(h, buffer + i, (n - i) * sizeof(uint16_t));
+        float32x4_t f = vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(h)));
+        vst1_u16(h, NormalizedFloatToUInt16NEON(f));
+        memcpy(buffer + i, h, (n - i) * sizeof(uint16_t));
+    }
+}
+
+static void ConvertNormalizedFloatToUInt16NEON(const float *source_buffer, int n, uint16_t *target_buffer) {
+    int i = 0;
+    for (; i + 4 <= n; i += 4) vst1_u16(target_buffer + i, NormalizedFloatToUInt16NEON(vld1q_f32(source_buffer + i)));
+    if (i < n) {
+        float f[4] = {0};
+        uint16_t u[4];
+        memcpy(f, source_buffer + i, (n - i) * sizeof(float));
+        vst1_u16(u, NormalizedFloatToUInt16NEON(vld1q_f32(f)));
+        memcpy(target_buffer + i, u, (n - i) * sizeof(uint16_t));
+    }
+}
+
+#endif
+
+typedef struct {
+    void (*half_float_to_float)(const uint16_t *source_buffer, int n, float *target_buffer);
+    void (*float_to_half_float)(const float *source_buffer, int n, uint16_t *target_buffer);
+    void (*normalized_half_float_to_uint16)(uint16_t *buffer, int n);
+    void (*normalized_float_to_uint16)(const float *source_buffer, int n, uint16_t *target_buffer);
+} ConversionFunctions;
+
+// Indexed by SIMD level.
+static const ConversionFunctions conversion_functions[] = {
+    [DETEX_SIMD_LEVEL_NONE] = {ConvertHalfFloatToFloatScalar,
+                               ConvertFloatToHalfFloatScalar,
+                               ConvertNormalizedHalfFloatToUInt16Scalar,
+                               ConvertNormalizedFloatToUInt16Scalar},
+#ifdef DETEX_ARCH_X86
+    [DETEX_SIMD_LEVEL_SSE2] = {ConvertHalfFloatToFloatScalar,
+                               ConvertFloatToHalfFloatScalar,
+                               ConvertNormalizedHalfFloatToUInt16Scalar,
+                               ConvertNormalizedFloatToUInt16Scalar},
+    [DETEX_SIMD_LEVEL_AVX2] = {ConvertHalfFloatToFloatAVX2,
+                               ConvertFloatToHalfFloatAVX2,
+                               ConvertNormalizedHalfFloatToUInt16AVX2,
+                               ConvertNormalizedFloatToUInt16AVX2},
+#endif
+#ifdef DETEX_ARCH_ARM64
+    [DETEX_SIMD_LEVEL_NEON] = {ConvertHalfFloatToFloatNEON,
+                               ConvertFloatToHalfFloatNEON,
+                               ConvertNormalizedHalfFloatToUInt16NEON,
+                               ConvertNormalizedFloatToUInt16NEON},
+#endif
+};
+
+void detexConvertHalfFloatToFloat(uint16_t *source_buffer, int n, float *target_buffer) {
+    conversion_functions[detexGetSIMDLevel()].half_float_to_float(source_buffer, n, target_buffer);
 }
 
 void detexConvertFloatToHalfFloat(float *source_buffer, int n, uint16_t *target_buffer) {
-    singles2halfp(target_buffer, source_buffer, n);
+    conversion_functions[detexGetSIMDLevel()].float_to_half_float(source_buffer, n, target_buffer);
 }
 
 // Convert normalized half floats to unsigned 16-bit integers in place.
 void detexConvertNormalizedHalfFloatToUInt16(uint16_t *buffer, int n) {
-    detexValidateHalfFloatTable();
-    fesetround(FE_DOWNWARD);
-    for (int i = 0; i < n; i++) {
-        float f = detexGetFloatFromHalfFloat(buffer[i]);
-        int u = lrintf(detexClamp0To1(f) * 65535.0f + 0.5f);
-        buffer[i] = (uint16_t)u;
-    }
+    conversion_functions[detexGetSIMDLevel()].normalized_half_float_to_uint16(buffer, n);
 }
 
 // Convert normalized floats to unsigned 16-bit integers.
 void detexConvertNormalizedFloatToUInt16(float *DETEX_RESTRICT source_buffer,
                                          int n,
                                          uint16_t *DETEX_RESTRICT target_buffer) {
-    fesetround(FE_DOWNWARD);
-    for (int i = 0; i < n; i++) {
-        int u = lrintf(detexClamp0To1(source_buffer[i]) * 65535.0f + 0.5f);
-        target_buffer[i] = (uint16_t)u;
-    }
+    conversion_functions[detexGetSIMDLevel()].normalized_float_to_uint16(source_buffer, n, target_buffer);
 }
 
 float detexGetFloatFromHalfFloat(uint16_t hf) {
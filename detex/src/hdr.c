@@ -16,42 +16,101 @@ OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 
 */
 
-#include <fenv.h>
 #include <float.h>
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef _WIN32
+#    define WIN32_LEAN_AND_MEAN
+#    include <windows.h>
+#else
+#    include <sched.h>
+#endif
+
 #include "detex.h"
 
-// Gamma/HDR parameters.
+// Gamma/HDR parameters. These are per-thread.
 
 DETEX_THREAD_LOCAL float detex_gamma = 1.0f;
 DETEX_THREAD_LOCAL float detex_gamma_range_min = 0.0f;
 DETEX_THREAD_LOCAL float detex_gamma_range_max = 1.0f;
-DETEX_THREAD_LOCAL float *detex_gamma_corrected_half_float_table = NULL;
-DETEX_THREAD_LOCAL float detex_corrected_half_float_table_gamma;
 
 void detexSetHDRParameters(float gamma, float range_min, float range_max) {
     detex_gamma = gamma;
     detex_gamma_range_min = range_min;
     detex_gamma_range_max = range_max;
-    detex_gamma_corrected_half_float_table = NULL;
 }
 
-// Update gamma-corrected half-float table when required.
-static void ValidateGammaCorrectedHalfFloatTable(float gamma) {
-    if (detex_gamma_corrected_half_float_table != NULL && detex_corrected_half_float_table_gamma == gamma) return;
-    if (detex_gamma_corrected_half_float_table == NULL)
-        detex_gamma_corrected_half_float_table = malloc(65536 * sizeof(float));
-    float *float_table = detex_gamma_corrected_half_float_table;
-    detexValidateHalfFloatTable();
-    memcpy(float_table, detex_half_float_table, 65536 * sizeof(float));
-    for (int i = 0; i <= 0xFFFF; i++)
-        if (float_table[i] >= 0.0f)
-            float_table[i] = powf(float_table[i], 1.0f / gamma);
-        else
-            float_table[i] = -powf(-float_table[i], 1.0f / gamma);
+void detexGetHDRParameters(float *gamma, float *range_min, float *range_max) {
+    *gamma = detex_gamma;
+    *range_min = detex_gamma_range_min;
+    *range_max = detex_gamma_range_max;
+}
+
+// Gamma-corrected half-float tables, one for every gamma value used, shared by
+// all threads. A table is never changed or freed once it is in the list, so it
+// can be read without locking; only the list itself is protected by a lock.
+typedef struct GammaTable {
+    struct GammaTable *next;
+    float gamma;
+    float table[65536];
+} GammaTable;
+
+static GammaTable *gamma_tables = NULL;
+static volatile long gamma_tables_lock = 0;
+// The table last used by this thread.
+DETEX_THREAD_LOCAL const GammaTable *detex_gamma_table = NULL;
+
+static void LockGammaTables() {
+#ifdef _WIN32
+    while (InterlockedCompareExchange(&gamma_tables_lock, 1, 0) != 0) Sleep(0);
+#else
+    long expected = 0;
+    while (!__atomic_compare_exchange_n(&gamma_tables_lock, &expected, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        expected = 0;
+        sched_yield();
+    }
+#endif
+}
+
+static void UnlockGammaTables() {
+#ifdef _WIN32
+    InterlockedExchange(&gamma_tables_lock, 0);
+#else
+    __atomic_store_n(&gamma_tables_lock, 0, __ATOMIC_RELEASE);
+#endif
+}
+
+// Return the gamma-corrected half-float table for gamma, creating it when
+// required. Returns NULL when out of memory.
+static const float *GetGammaCorrectedHalfFloatTable(float gamma) {
+    const GammaTable *gamma_table = detex_gamma_table;
+    if (gamma_table != NULL && gamma_table->gamma == gamma) return gamma_table->table;
+    LockGammaTables();
+    GammaTable *t = gamma_tables;
+    while (t != NULL && t->gamma != gamma) t = t->next;
+    if (t == NULL) {
+        t = (GammaTable *)malloc(sizeof(GammaTable));
+        if (t == NULL) {
+            UnlockGammaTables();
+            return NULL;
+        }
+        detexValidateHalfFloatTable();
+        t->gamma = gamma;
+        for (int i = 0; i <= 0xFFFF; i++) {
+            float f = detex_half_float_table[i];
+            if (f >= 0.0f)
+                t->table[i] = powf(f, 1.0f / gamma);
+            else
+                t->table[i] = -powf(-f, 1.0f / gamma);
+        }
+        t->next = gamma_tables;
+        gamma_tables = t;
+    }
+    UnlockGammaTables();
+    detex_gamma_table = t;
+    return t->table;
 }
 
 DETEX_INLINE_ONLY void CalculateRangeFloat(float *buffer, int n, float *range_min_out, float *range_max_out) {
@@ -67,13 +126,18 @@ DETEX_INLINE_ONLY void CalculateRangeFloat(float *buffer, int n, float *range_mi
 }
 
 DETEX_INLINE_ONLY void CalculateRangeHalfFloat(uint16_t *buffer, int n, float *range_min_out, float *range_max_out) {
-    detexValidateHalfFloatTable();
     float range_min = FLT_MAX;
     float range_max = -FLT_MAX;
-    for (int i = 0; i < n; i++) {
-        float f = detexGetFloatFromHalfFloat(buffer[i]);
-        if (f < range_min) range_min = f;
-        if (f > range_max) range_max = f;
+    // Convert in chunks so that the faster conversion functions can be used.
+    float float_buffer[256];
+    for (int i = 0; i < n; i += 256) {
+        int chunk = n - i < 256 ? n - i : 256;
+        detexConvertHalfFloatToFloat(buffer + i, chunk, float_buffer);
+        for (int j = 0; j < chunk; j++) {
+            float f = float_buffer[j];
+            if (f < range_min) range_min = f;
+            if (f > range_max) range_max = f;
+        }
     }
     *range_min_out = range_min;
     *range_max_out = range_max;
@@ -101,23 +165,17 @@ bool detexCalculateDynamicRange(
 
 // Convert half floats to unsigned 16-bit integers in place with gamma value of 1.
 DETEX_INLINE_ONLY void detexConvertHDRHalfFloatToUInt16Gamma1(uint16_t *buffer, int n) {
-    detexValidateHalfFloatTable();
     float range_min = detex_gamma_range_min;
     float range_max = detex_gamma_range_max;
-    fesetround(FE_DOWNWARD);
     if (range_min == 0.0f && range_max == 1.0f) {
-        for (int i = 0; i < n; i++) {
-            float f = detexGetFloatFromHalfFloat(buffer[i]);
-            int u = lrintf(detexClamp0To1(f) * 65535.0f + 0.5f);
-            buffer[i] = (uint16_t)u;
-        }
+        detexConvertNormalizedHalfFloatToUInt16(buffer, n);
         return;
     }
+    detexValidateHalfFloatTable();
     float factor = 1.0f / (range_max - range_min);
     for (int i = 0; i < n; i++) {
         float f = detexGetFloatFromHalfFloat(buffer[i]);
-        int u = lrintf(detexClamp0To1((f - range_min) * factor) * 65535.0f + 0.5f);
-        buffer[i] = (uint16_t)u;
+        buffer[i] = detexGetUInt16FromNormalizedFloat((f - range_min) * factor);
     }
 }
 
@@ -125,8 +183,7 @@ DETEX_INLINE_ONLY void detexConvertHDRHalfFloatToUInt16SpecialGamma(uint16_t *bu
     float gamma = detex_gamma;
     float range_min = detex_gamma_range_min;
     float range_max = detex_gamma_range_max;
-    ValidateGammaCorrectedHalfFloatTable(gamma);
-    float *corrected_half_float_table = detex_gamma_corrected_half_float_table;
+    const float *corrected_half_float_table = GetGammaCorrectedHalfFloatTable(gamma);
     float corrected_range_min, corrected_range_max;
     if (range_min >= 0.0f)
         corrected_range_min = powf(range_min, 1.0f / gamma);
@@ -138,9 +195,14 @@ DETEX_INLINE_ONLY void detexConvertHDRHalfFloatToUInt16SpecialGamma(uint16_t *bu
         corrected_range_max = -powf(-range_max, 1.0f / gamma);
     float factor = 1.0f / (corrected_range_max - corrected_range_min);
     for (int i = 0; i < n; i++) {
-        float f = corrected_half_float_table[buffer[i]];
-        int u = lrintf(detexClamp0To1((f - corrected_range_min) * factor) * 65535.0f + 0.5f);
-        buffer[i] = (uint16_t)u;
+        float f;
+        if (corrected_half_float_table != NULL)
+            f = corrected_half_float_table[buffer[i]];
+        else {
+            f = detexGetFloatFromHalfFloat(buffer[i]);
+            f = f >= 0.0f ? powf(f, 1.0f / gamma) : -powf(-f, 1.0f / gamma);
+        }
+        buffer[i] = detexGetUInt16FromNormalizedFloat((f - corrected_range_min) * factor);
     }
 }
 
@@ -154,7 +216,6 @@ void detexConvertHDRHalfFloatToUInt16(uint16_t *buffer, int n) {
 DETEX_INLINE_ONLY void detexConvertHDRFloatToFloatGamma1(float *buffer, int n) {
     float range_min = detex_gamma_range_min;
     float range_max = detex_gamma_range_max;
-    fesetround(FE_DOWNWARD);
     if (range_min == 0.0f && range_max == 1.0f) {
         for (int i = 0; i < n; i++) {
             float f = buffer[i];
@@ -0,0 +1,271 @@
+/*
+
+Copyright (c) 2015 Harm Hanemaaijer <fgenfb@yahoo.com>
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+*/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "detex.h"
+
+// Mip-map levels are generated one from the other, each level is resampled
+// with a separable filter. The output is divided into tiles that are processed
+// in parallel; a tile runs the horizontal pass over the source rows it needs,
+// then the vertical pass.
+
+// Size in pixels of the output tiles.
+#define TILE_SIZE 64
+
+// Radius of the Kaiser windowed sinc filter in output pixels, and the shape
+// parameter of the Kaiser window.
+#define KAISER_RADIUS 3.0f
+#define KAISER_ALPHA 4.0f
+
+#define PI 3.14159265358979f
+
+static detexOnceFlag srgb_table_once = DETEX_ONCE_INIT;
+static float srgb_to_linear_table[256];
+// Linear values quantized to 12 bits mapped to 8-bit sRGB.
+static uint8_t linear_to_srgb_table[4096];
+
+static void CalculateSRGBTables() {
+    for (int i = 0; i < 256; i++) {
+        float c = i / 255.0f;
+        srgb_to_linear_table[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+    }
+    for (int i = 0; i < 4096; i++) {
+        float c = i / 4095.0f;
+        float s = c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+        linear_to_srgb_table[i] = (uint8_t)(s * 255.0f + 0.5f);
+    }
+}
+
+static float BesselI0(float x) {
+    // Power series, converges quickly for the arguments used here.
+    float sum = 1.0f;
+    float term = 1.0f;
+    for (int k = 1; k < 32; k++) {
+        term *= (x * 0.5f / k) * (x * 0.5f / k);
+        sum += term;
+        if (term < sum * 1e-8f) break;
+    }
+    return sum;
+}
+
+static float Kaiser(float t) {
+    if (fabsf(t) >= KAISER_RADIUS) return 0.0f;
+    float sinc = t == 0.0f ? 1.0f : sinf(PI * t) / (PI * t);
+    float r = t / KAISER_RADIUS;
+    return sinc * BesselI0(KAISER_ALPHA * sqrtf(1.0f - r * r)) / BesselI0(KAISER_ALPHA);
+}
+
+// Filter weights for resampling src_size pixels to dst_size pixels along one
+// axis. Output pixel i is the sum of weights[i * nu_taps + k] times source pixel
+// first[i] + k (clamped to the edge).
+typedef struct {
+    int nu_taps;
+    int *first;
+    float *weights;
+} FilterWeights;
+
+// Returns false when out of memory.
+static bool CalculateFilterWeights(int src_size, int dst_size, uint32_t filter, FilterWeights *w) {
+    float scale = (float)src_size / dst_size;
+    // Support radius in source pixels.
+    float radius = filter == DETEX_MIPMAP_FILTER_KAISER ? KAISER_RADIUS * scale : scale * 0.5f;
+    w->nu_taps = (int)ceilf(radius * 2.0f) + 2;
+    w->first = (int *)malloc(dst_size * sizeof(int));
+    w->weights = (float *)calloc((size_t)dst_size * w->nu_taps, sizeof(float));
+    if (w->first == NULL || w->weights == NULL) return false;
+    for (int i = 0; i < dst_size; i++) {
+        float center = (i + 0.5f) * scale;
+        int first = (int)floorf(center - radius);
+        float *weights = &w->weights[i * w->nu_taps];
+        float sum = 0.0f;
+        for (int k = 0; k < w->nu_taps; k++) {
+            float s = (float)(first + k);
+            float weight;
+            if (filter == DETEX_MIPMAP_FILTER_KAISER) {
+                weight = Kaiser((s + 0.5f - center) / scale);
+            } else {
+                // Area of the source pixel covered by the output pixel.
+                float lo = fmaxf(s, center - radius);
+                float hi = fminf(s + 1.0f, center + radius);
+                weight = fmaxf(hi - lo, 0.0f);
+            }
+            weights[k] = weight;
+            sum += weight;
+        }
+        for (int k = 0; k < w->nu_taps; k++) weights[k] /= sum;
+        w->first[i] = first;
+    }
+    return true;
+}
+
+static void FreeFilterWeights(FilterWeights *w) {
+    free(w->first);
+    free(w->weights);
+}
+
+typedef struct {
+    const detexTexture *source;
+    detexTexture *target;
+    bool srgb;
+    FilterWeights horizontal;
+    FilterWeights vertical;
+    int nu_tiles_x;
+} MipmapJob;
+
+static inline int Clamp(int value, int max_value) { return value < 0 ? 0 : (value > max_value ? max_value : value); }
+
+static inline uint8_t LinearToPixel(float value, bool srgb) {
+    value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+    if (srgb) return linear_to_srgb_table[(int)(value * 4095.0f + 0.5f)];
+    return (uint8_t)(value * 255.0f + 0.5f);
+}
+
+static bool GenerateMipmapTile(void *context, int index) {
+    MipmapJob *job = (MipmapJob *)context;
+    const detexTexture *source = job->source;
+    detexTexture *target = job->target;
+    int x0 = (index % job->nu_tiles_x) * TILE_SIZE;
+    int y0 = (index / job->nu_tiles_x) * TILE_SIZE;
+    int x1 = min(x0 + TILE_SIZE, target->width);
+    int y1 = min(y0 + TILE_SIZE, target->height);
+    int tile_width = x1 - x0;
+    const FilterWeights *h = &job->horizontal;
+    const FilterWeights *v = &job->vertical;
+    // Source rows (unclamped) used by the vertical pass of this tile.
+    int row0 = v->first[y0];
+    int nu_rows = v->first[y1 - 1] + v->nu_taps - row0;
+    float *rows = (float *)malloc((size_t)nu_rows * tile_width * 4 * sizeof(float));
+    if (rows == NULL) return false;
+    const float *table = job->srgb ? srgb_to_linear_table : NULL;
+    // Horizontal pass.
+    for (int r = 0; r < nu_rows; r++) {
+        const uint8_t *src = source->data + (size_t)Clamp(row0 + r, source->height - 1) * source->width * 4;
+        float *out = rows + (size_t)r * tile_width * 4;
+        for (int x = x0; x < x1; x++) {
+            const float *weights = &h->weights[x * h->nu_taps];
+            float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+            for (int k = 0; k < h->nu_taps; k++) {
+                if (weights[k] == 0.0f) continue;
+                const uint8_t *pixel = src + Clamp(h->first[x] + k, source->width - 1) * 4;
+                for (int c = 0; c < 3; c++)
+                    sum[c] += weights[k] * (table != NULL ? table[pixel[c]] : pixel[c] * (1.0f / 255.0f));
+                sum[3] += weights[k] * (pixel[3] * (1.0f / 255.0f));
+            }
+            memcpy(out + (x - x0) * 4, sum, sizeof(sum));
+        }
+    }
+    // Vertical pass.
+    for (int y = y0; y < y1; y++) {
+        const float *weights = &v->weights[y * v->nu_taps];
+        uint8_t *dst = target->data + ((size_t)y * target->width + x0) * 4;
+        for (int x = 0; x < tile_width; x++) {
+            float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+            for (int k = 0; k < v->nu_taps; k++) {
+                const float *in = rows + ((size_t)(v->first[y] + k - row0) * tile_width + x) * 4;
+                for (int c = 0; c < 4; c++) sum[c] += weights[k] * in[c];
+            }
+            for (int c = 0; c < 3; c++) dst[x * 4 + c] = LinearToPixel(sum[c], job->srgb);
+            dst[x * 4 + 3] = LinearToPixel(sum[3], false);
+        }
+    }
+    free(rows);
+    return true;
+}
+
+// Returns NULL when out of memory.
+static detexTexture *AllocateRGBA8Texture(int width, int height) {
+    detexTexture *texture = (detexTexture *)malloc(sizeof(detexTexture));
+    if (texture == NULL) return NULL;
+    *texture = (detexTexture){
+        .format = DETEX_PIXEL_FORMAT_RGBA8,
+        .width = width,
+        .height = height,
+        .width_in_blocks = width,
+        .height_in_blocks = height,
+        .data = (uint8_t *)malloc((size_t)width * height * 4),
+    };
+    if (texture->data == NULL) {
+        free(texture);
+        return NULL;
+    }
+    return texture;
+}
+
+/*
+ * Generate a complete mip-map chain for a texture. Each level is resampled
+ * from the previous one, in parallel over tiles of the output.
+ */
+bool detexGenerateMipmaps(const detexTexture *texture,
+                          uint32_t filter,
+                          uint32_t flags,
+                          int nu_threads,
+                          detexTexture ***textures_out,
+                          int *nu_levels_out) {
+    int nu_levels = 1;
+    while ((max(texture->width, texture->height) >> nu_levels) > 0) nu_levels++;
+    detexTexture **textures = (detexTexture **)calloc(nu_levels, sizeof(detexTexture *));
+    if (textures == NULL) {
+        detexSetErrorMessage("detexGenerateMipmaps: Out of memory");
+        return false;
+    }
+    textures[0] = AllocateRGBA8Texture(texture->width, texture->height);
+    if (textures[0] == NULL) {
+        detexSetErrorMessage("detexGenerateMipmaps: Out of memory");
+        detexFreeTextures(textures, nu_levels);
+        return false;
+    }
+    if (!detexDecompressTextureLinearParallel(texture, textures[0]->data, DETEX_PIXEL_FORMAT_RGBA8, nu_threads)) {
+        detexFreeTextures(textures, nu_levels);
+        return false;
+    }
+    bool srgb = (flags & DETEX_MIPMAP_FLAG_SRGB) != 0;
+    detexCallOnce(&srgb_table_once, CalculateSRGBTables);
+    for (int i = 1; i < nu_levels; i++) {
+        const detexTexture *source = textures[i - 1];
+        textures[i] = AllocateRGBA8Texture(max(source->width >> 1, 1), max(source->height >> 1, 1));
+        if (textures[i] == NULL) {
+            detexSetErrorMessage("detexGenerateMipmaps: Out of memory");
+            detexFreeTextures(textures, nu_levels);
+            return false;
+        }
+        MipmapJob job = {
+            .source = source,
+            .target = textures[i],
+            .srgb = srgb,
+            .nu_tiles_x = (textures[i]->width + TILE_SIZE - 1) / TILE_SIZE,
+        };
+        int nu_tiles = job.nu_tiles_x * ((textures[i]->height + TILE_SIZE - 1) / TILE_SIZE);
+        // The weights of the job start out NULL, so they can be freed after a failure.
+        bool r = CalculateFilterWeights(source->width, textures[i]->width, filter, &job.horizontal) &&
+                 CalculateFilterWeights(source->height, textures[i]->height, filter, &job.vertical) &&
+                 detexParallelFor(nu_tiles, nu_threads, GenerateMipmapTile, &job);
+        FreeFilterWeights(&job.horizontal);
+        FreeFilterWeights(&job.vertical);
+        if (!r) {
+            detexSetErrorMessage("detexGenerateMipmaps: Out of memory");
+            detexFreeTextures(textures, nu_levels);
+            return false;
+        }
+    }
+    *textures_out = textures;
+    *nu_levels_out = nu_levels;
+    return true;
+}
@@ -0,0 +1,112 @@
+/*
+
+Copyright (c) 2015 Harm Hanemaaijer <fgenfb@yahoo.com>
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+*/
+
+#include "detex.h"
+
+#ifdef DETEX_ARCH_X86
+#    ifdef _MSC_VER
+#        include <intrin.h>
+#    else
+#        include <cpuid.h>
+#    endif
+#endif
+
+static detexOnceFlag simd_level_once = DETEX_ONCE_INIT;
+static uint32_t simd_level_supported;
+static volatile uint32_t simd_level;
+
+#ifdef DETEX_ARCH_X86
+
+static void GetCPUID(uint32_t leaf, uint32_t subleaf, uint32_t *regs) {
+#    ifdef _MSC_VER
+    int info[4];
+    __cpuidex(info, leaf, subleaf);
+    for (int i = 0; i < 4; i++) regs[i] = info[i];
+#    else
+    regs[0] = regs[1] = regs[2] = regs[3] = 0;
+    __get_cpuid_count(leaf, subleaf, &regs[0], &regs[1], &regs[2], &regs[3]);
+#    endif
+}
+
+// Return the state components enabled by the OS (XCR0).
+static uint64_t GetXCR0() {
+#    ifdef _MSC_VER
+    return _xgetbv(0);
+#    else
+    uint32_t eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((uint64_t)edx << 32) | eax;
+#    endif
+}
+
+static uint32_t DetectSIMDLevel() {
+    uint32_t regs[4];
+    GetCPUID(0, 0, regs);
+    uint32_t max_leaf = regs[0];
+    GetCPUID(1, 0, regs);
+    if (!(regs[3] & (1 << 26))) return DETEX_SIMD_LEVEL_NONE;
+    // AVX2 needs the OS to save the YMM registers (OSXSAVE, AVX and XCR0 bits 1 and 2).
+    bool avx = (regs[2] & (1 << 27)) && (regs[2] & (1 << 28)) && (GetXCR0() & 0x6) == 0x6;
+    // The AVX2 level includes F16C, which every AVX2 CPU supports.
+    bool f16c = regs[2] & (1 << 29);
+    if (avx && f16c && max_leaf >= 7) {
+        GetCPUID(7, 0, regs);
+        if (regs[1] & (1 << 5)) return DETEX_SIMD_LEVEL_AVX2;
+    }
+    return DETEX_SIMD_LEVEL_SSE2;
+}
+
+#elif defined(DETEX_ARCH_ARM64)
+
+// NEON is part of the base AArch64 instruction set.
+static uint32_t DetectSIMDLevel() { return DETEX_SIMD_LEVEL_NEON; }
+
+#else
+
+static uint32_t DetectSIMDLevel() { return DETEX_SIMD_LEVEL_NONE; }
+
+#endif
+
+static void InitializeSIMDLevel() {
+    simd_level_supported = DetectSIMDLevel();
+    simd_level = simd_level_supported;
+}
+
+/* Return the SIMD instruction set in use. */
+uint32_t detexGetSIMDLevel() {
+    detexCallOnce(&simd_level_once, InitializeSIMDLevel);
+    return simd_level;
+}
+
+/* Limit the SIMD instruction set used. */
+void detexSetSIMDLevel(uint32_t level) {
+    detexCallOnce(&simd_level_once, InitializeSIMDLevel);
+    bool supported;
+    switch (level) {
+        case DETEX_SIMD_LEVEL_NONE:
+            supported = true;
+            break;
+        case DETEX_SIMD_LEVEL_SSE2:
+            supported = simd_level_supported == DETEX_SIMD_LEVEL_SSE2 || simd_level_supported == DETEX_SIMD_LEVEL_AVX2;
+            break;
+        default:
+            supported = level == simd_level_supported;
+            break;
+    }
+    if (supported) simd_level = level;
+}
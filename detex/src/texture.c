@@ -59,6 +59,11 @@ bool detexDecompressBlock(const uint8_t *DETEX_RESTRICT bitstring,
                           uint32_t flags,
                           uint8_t *DETEX_RESTRICT pixel_buffer,
                           uint32_t pixel_format) {
+    if (flags == 0) {
+        detexDecompressBlocksFuncType func = detexGetDecompressBlocksFunction(texture_format, pixel_format);
+        // A rejected block is decompressed again below, which sets the error message.
+        if (func != NULL && func(bitstring, 1, pixel_buffer)) return true;
+    }
     uint8_t block_buffer[DETEX_MAX_BLOCK_SIZE];
     uint32_t compressed_format = detexGetCompressedFormat(texture_format);
     bool r = decompress_function[compressed_format](bitstring, mode_mask, flags, block_buffer);
@@ -73,6 +78,108 @@ bool detexDecompressBlock(const uint8_t *DETEX_RESTRICT bitstring,
     return detexConvertPixels(block_buffer, 16, detexGetPixelFormat(texture_format), pixel_buffer, pixel_format);
 }
 
+// Maximum number of blocks decompressed at a time by the texture decompression functions.
+#define DECOMPRESS_MAX_BLOCKS 16
+
+// Decompression of blocks of a texture format into a pixel format, looked up
+// once instead of for every block.
+typedef struct {
+    uint32_t texture_format;
+    uint32_t pixel_format;
+    uint32_t flags;
+    // Decompresses straight into the pixel format, NULL if there is no such function.
+    detexDecompressBlocksFuncType direct;
+    // Decompresses into the native pixel format of the texture format, NULL if there
+    // is no multi-block function.
+    detexDecompressBlocksFuncType native;
+} BlockDecompressor;
+
+static void InitBlockDecompressor(BlockDecompressor *decompressor,
+                                  uint32_t texture_format,
+                                  uint32_t flags,
+                                  uint32_t pixel_format) {
+    decompressor->texture_format = texture_format;
+    decompressor->pixel_format = pixel_format;
+    decompressor->flags = flags;
+    decompressor->direct = NULL;
+    decompressor->native = NULL;
+    // The multi-block functions decompress without flags.
+    if (flags == 0) {
+        decompressor->direct = detexGetDecompressBlocksFunction(texture_format, pixel_format);
+        decompressor->native = detexGetDecompressBlocksFunction(texture_format, detexGetPixelFormat(texture_format));
+    }
+}
+
+// Decompress up to DECOMPRESS_MAX_BLOCKS consecutive blocks into consecutive tiles in the given
+// pixel format. Blocks that fail are set to zero.
+static bool DecompressBlocks(const BlockDecompressor *decompressor,
+                             const uint8_t *data,
+                             int nu_blocks,
+                             uint8_t *DETEX_RESTRICT pixel_buffer) {
+    if (decompressor->direct != NULL && decompressor->direct(data, nu_blocks, pixel_buffer)) return true;
+    uint8_t block_buffer[DECOMPRESS_MAX_BLOCKS * DETEX_MAX_BLOCK_SIZE];
+    bool failed[DECOMPRESS_MAX_BLOCKS] = {false};
+    uint32_t texture_format = decompressor->texture_format;
+    uint32_t pixel_format = decompressor->pixel_format;
+    uint32_t compressed_format = detexGetCompressedFormat(texture_format);
+    uint32_t block_pixel_format = detexGetPixelFormat(texture_format);
+    // Decompress straight into the output when no conversion is needed.
+    uint8_t *tiles = block_pixel_format == pixel_format ? pixel_buffer : block_buffer;
+    bool result = true;
+    // When a multi-block function rejects a block, the blocks are decompressed again one by one
+    // to find the ones that failed.
+    if (decompressor->native == NULL || !decompressor->native(data, nu_blocks, tiles)) {
+        uint32_t block_size = detexGetCompressedBlockSize(texture_format);
+        uint32_t tile_size = detexGetPixelSize(block_pixel_format) * 16;
+        for (int i = 0; i < nu_blocks; i++)
+            if (!decompress_function[compressed_format](
+                    data + i * block_size, DETEX_MODE_MASK_ALL, decompressor->flags, tiles + i * tile_size)) {
+                failed[i] = true;
+                result = false;
+            }
+    }
+    uint32_t tile_size = detexGetPixelSize(pixel_format) * 16;
+    if (tiles != pixel_buffer &&
+        !detexConvertPixels(tiles, nu_blocks * 16, block_pixel_format, pixel_buffer, pixel_format)) {
+        memset(pixel_buffer, 0, nu_blocks * tile_size);
+        return false;
+    }
+    if (!result) {
+        for (int i = 0; i < nu_blocks; i++)
+            if (failed[i]) memset(pixel_buffer + i * tile_size, 0, tile_size);
+        detexSetErrorMessage(
+            "detexDecompressBlock: Decompress function for format "
+            "0x%08X returned error",
+            texture_format);
+    }
+    return result;
+}
+
+/*
+ * Decompress nu_blocks consecutive blocks into consecutive tiles in the given
+ * pixel format. Blocks that fail are set to zero; returns true if all blocks
+ * were decompressed succesfully.
+ */
+bool detexDecompressBlocks(const uint8_t *bitstring,
+                           uint32_t texture_format,
+                           int nu_blocks,
+                           uint32_t flags,
+                           uint8_t *DETEX_RESTRICT pixel_buffer,
+                           uint32_t pixel_format) {
+    BlockDecompressor decompressor;
+    InitBlockDecompressor(&decompressor, texture_format, flags, pixel_format);
+    if (decompressor.direct != NULL && decompressor.direct(bitstring, nu_blocks, pixel_buffer)) return true;
+    uint32_t block_size = detexGetCompressedBlockSize(texture_format);
+    uint32_t tile_size = detexGetPixelSize(pixel_format) * 16;
+    bool result = true;
+    for (int i = 0; i < nu_blocks; i += DECOMPRESS_MAX_BLOCKS) {
+        int n = min(nu_blocks - i, DECOMPRESS_MAX_BLOCKS);
+        if (!DecompressBlocks(&decompressor, bitstring + i * block_size, n, pixel_buffer + i * tile_size))
+            result = false;
+    }
+    return result;
+}
+
 /*
  * Decode texture function (tiled). Decode an entire compressed texture into an
  * array of image buffer tiles (corresponding to compressed blocks), converting
@@ -85,19 +192,47 @@ bool detexDecompressTextureTiled(const detexTexture *texture,
         detexSetErrorMessage("detexDecompressTextureTiled: Cannot handle uncompressed texture format");
         return false;
     }
-    const uint8_t *data = texture->data;
+    return detexDecompressBlocks(texture->data,
+                                 texture->format,
+                                 texture->width_in_blocks * texture->height_in_blocks,
+                                 0,
+                                 pixel_buffer,
+                                 pixel_format);
+}
+
+// Decode one row of blocks of a compressed texture into a linear image buffer.
+static bool DecompressBlockRowLinear(const detexTexture *texture,
+                                     const BlockDecompressor *decompressor,
+                                     int y,
+                                     uint8_t *DETEX_RESTRICT pixel_buffer) {
+    uint8_t tile_buffer[DECOMPRESS_MAX_BLOCKS * DETEX_MAX_BLOCK_SIZE];
+    uint32_t block_size = detexGetCompressedBlockSize(texture->format);
+    const uint8_t *data = texture->data + y * texture->width_in_blocks * block_size;
+    int pixel_size = detexGetPixelSize(decompressor->pixel_format);
     bool result = true;
-    for (int y = 0; y < texture->height_in_blocks; y++)
-        for (int x = 0; x < texture->width_in_blocks; x++) {
-            bool r = detexDecompressBlock(data, texture->format, DETEX_MODE_MASK_ALL, 0, pixel_buffer, pixel_format);
-            uint32_t block_size = detexGetPixelSize(pixel_format) * 16;
-            if (!r) {
-                result = false;
-                memset(pixel_buffer, 0, block_size);
-            }
-            data += detexGetCompressedBlockSize(texture->format);
-            pixel_buffer += block_size;
+    int nu_rows;
+    if (y * 4 + 3 >= texture->height)
+        nu_rows = texture->height - y * 4;
+    else
+        nu_rows = 4;
+    for (int x0 = 0; x0 < texture->width_in_blocks; x0 += DECOMPRESS_MAX_BLOCKS) {
+        int n = min(texture->width_in_blocks - x0, DECOMPRESS_MAX_BLOCKS);
+        if (!DecompressBlocks(decompressor, data + x0 * block_size, n, tile_buffer)) result = false;
+        for (int i = 0; i < n; i++) {
+            int x = x0 + i;
+            uint8_t *block_buffer = tile_buffer + i * 16 * pixel_size;
+            uint8_t *pixelp = pixel_buffer + y * 4 * texture->width * pixel_size + +x * 4 * pixel_size;
+            int nu_columns;
+            if (x * 4 + 3 >= texture->width)
+                nu_columns = texture->width - x * 4;
+            else
+                nu_columns = 4;
+            for (int row = 0; row < nu_rows; row++)
+                memcpy(pixelp + row * texture->width * pixel_size,
+                       block_buffer + row * 4 * pixel_size,
+                       nu_columns * pixel_size);
         }
+    }
     return result;
 }
 
@@ -109,7 +244,6 @@ bool detexDecompressTextureTiled(const detexTexture *texture,
 bool detexDecompressTextureLinear(const detexTexture *texture,
                                   uint8_t *DETEX_RESTRICT pixel_buffer,
                                   uint32_t pixel_format) {
-    uint8_t block_buffer[DETEX_MAX_BLOCK_SIZE];
     if (!detexFormatIsCompressed(texture->format)) {
         return detexConvertPixels(texture->data,
                                   texture->width * texture->height,
@@ -117,34 +251,322 @@ bool detexDecompressTextureLinear(const detexTexture *texture,
                                   pixel_buffer,
                                   pixel_format);
     }
-    const uint8_t *data = texture->data;
-    int pixel_size = detexGetPixelSize(pixel_format);
+    BlockDecompressor decompressor;
+    InitBlockDecompressor(&decompressor, texture->format, 0, pixel_format);
     bool result = true;
-    for (int y = 0; y < texture->height_in_blocks; y++) {
-        int nu_rows;
-        if (y * 4 + 3 >= texture->height)
-            nu_rows = texture->height - y * 4;
-        else
-            nu_rows = 4;
-        for (int x = 0; x < texture->width_in_blocks; x++) {
-            bool r = detexDecompressBlock(data, texture->format, DETEX_MODE_MASK_ALL, 0, block_buffer, pixel_format);
-            uint32_t block_size = detexGetPixelSize(pixel_format) * 16;
-            if (!r) {
-                result = false;
-                memset(block_buffer, 0, block_size);
-            }
-            uint8_t *pixelp = pixel_buffer + y * 4 * texture->width * pixel_size + +x * 4 * pixel_size;
-            int nu_columns;
-            if (x * 4 + 3 >= texture->width)
-                nu_columns = texture->width - x * 4;
-            else
-                nu_columns = 4;
-            for (int row = 0; row < nu_rows; row++)
-                memcpy(pixelp + row * texture->width * pixel_size,
-                       block_buffer + row * 4 * pixel_size,
-                       nu_columns * pixel_size);
-            data += detexGetCompressedBlockSize(texture->format);
+    for (int y = 0; y < texture->height_in_blocks; y++)
+        if (!DecompressBlockRowLinear(texture, &decompressor, y, pixel_buffer)) result = false;
+    return result;
+}
+
+typedef struct {
+    const detexTexture *texture;
+    BlockDecompressor decompressor;
+    uint8_t *pixel_buffer;
+    // HDR parameters of the calling thread.
+    float gamma;
+    float range_min;
+    float range_max;
+} DecompressLinearJob;
+
+static bool DecompressLinearJobRow(void *context, int index) {
+    DecompressLinearJob *job = (DecompressLinearJob *)context;
+    detexSetHDRParameters(job->gamma, job->range_min, job->range_max);
+    return DecompressBlockRowLinear(job->texture, &job->decompressor, index, job->pixel_buffer);
+}
+
+/*
+ * Decode texture function (linear, multi-threaded). The block rows of a
+ * compressed texture are distributed over nu_threads threads.
+ */
+bool detexDecompressTextureLinearParallel(const detexTexture *texture,
+                                          uint8_t *DETEX_RESTRICT pixel_buffer,
+                                          uint32_t pixel_format,
+                                          int nu_threads) {
+    if (!detexFormatIsCompressed(texture->format))
+        return detexDecompressTextureLinear(texture, pixel_buffer, pixel_format);
+    DecompressLinearJob job = {
+        .texture = texture,
+        .pixel_buffer = pixel_buffer,
+    };
+    InitBlockDecompressor(&job.decompressor, texture->format, 0, pixel_format);
+    detexGetHDRParameters(&job.gamma, &job.range_min, &job.range_max);
+    if (!detexParallelFor(texture->height_in_blocks, nu_threads, DecompressLinearJobRow, &job)) {
+        // Error messages are per-thread, so report the failure here.
+        detexSetErrorMessage(
+            "detexDecompressTextureLinearParallel: Decompress function for format "
+            "0x%08X returned error",
+            texture->format);
+        return false;
+    }
+    return true;
+}
+
+typedef bool (*detexCompressBlockFuncType)(const uint8_t *pixel_buffer, uint32_t flags, uint8_t *bitstring);
+
+static detexCompressBlockFuncType compress_function[] = {
+    [DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_BC1] = detexCompressBlockBC1,
+    [DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_BC3] = detexCompressBlockBC3,
+    [DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_RGTC1] = detexCompressBlockRGTC1,
+    [DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_SIGNED_RGTC1] = detexCompressBlockSIGNED_RGTC1,
+    [DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_RGTC2] = detexCompressBlockRGTC2,
+    [DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_SIGNED_RGTC2] = detexCompressBlockSIGNED_RGTC2,
+    [DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_ETC1] = detexCompressBlockETC1,
+    [DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_ETC2] = detexCompressBlockETC2,
+    [DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_ETC2_EAC] = detexCompressBlockETC2_EAC,
+    [DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_BPTC_FLOAT] = detexCompressBlockBPTC_FLOAT,
+    [DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_BPTC_SIGNED_FLOAT] = detexCompressBlockBPTC_SIGNED_FLOAT,
+    [DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_BPTC] = detexCompressBlockBPTC,
+    [DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_ASTC_4X4] = NULL,
+};
+
+typedef void (*detexOptimizeBlockFuncType)(const uint8_t *pixel_buffer,
+                                           uint32_t flags,
+                                           const uint8_t *const *references,
+                                           int nu_references,
+                                           uint8_t *bitstring);
+
+// Rate-distortion optimization of the blocks of the formats that support it.
+static detexOptimizeBlockFuncType optimize_function[] = {
+    [DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_BC1] = detexOptimizeBlockBC1,
+    [DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_BC3] = detexOptimizeBlockBC3,
+    [DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_ASTC_4X4] = NULL,
+};
+
+// Number of preceding blocks that a block is compared with by the
+// rate-distortion optimization, in addition to the three blocks above it.
+#define RDO_WINDOW 32
+
+// Pixel format of the input of the encoder of a compressed format.
+static uint32_t GetCompressPixelFormat(uint32_t compressed_format) {
+    if (compressed_format == DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_BPTC_FLOAT)
+        return DETEX_PIXEL_FORMAT_FLOAT_RGBX16;
+    if (compressed_format == DETEX_COMPRESSED_TEXTURE_FORMAT_INDEX_BPTC_SIGNED_FLOAT)
+        return DETEX_PIXEL_FORMAT_SIGNED_FLOAT_RGBX16;
+    return DETEX_PIXEL_FORMAT_RGBA8;
+}
+
+typedef struct {
+    detexCompressBlockFuncType func;
+    uint32_t flags;
+    uint32_t block_size;
+    // Source pixels in the input pixel format of the encoder, stored row-by-row.
+    const uint8_t *pixels;
+    uint32_t pixel_size;
+    int width;
+    int height;
+    int width_in_blocks;
+    uint8_t *bitstring;
+} CompressJob;
+
+// Gather the pixels of a block, repeating the last row/column at the edges.
+static void GetBlockPixels(const CompressJob *job, int x, int y, uint8_t *DETEX_RESTRICT block_pixels) {
+    for (int row = 0; row < 4; row++) {
+        int py = min(y * 4 + row, job->height - 1);
+        for (int column = 0; column < 4; column++) {
+            int px = min(x * 4 + column, job->width - 1);
+            memcpy(block_pixels + (row * 4 + column) * job->pixel_size,
+                   job->pixels + ((size_t)py * job->width + px) * job->pixel_size,
+                   job->pixel_size);
+        }
+    }
+}
+
+// Compress one row of blocks.
+static bool CompressBlockRow(void *context, int y) {
+    CompressJob *job = (CompressJob *)context;
+    uint8_t *bitstring = job->bitstring + (size_t)y * job->width_in_blocks * job->block_size;
+    bool result = true;
+    for (int x = 0; x < job->width_in_blocks; x++) {
+        // Large enough for 16 pixels of 64 bits.
+        uint64_t block_buffer[16];
+        GetBlockPixels(job, x, y, (uint8_t *)block_buffer);
+        if (!job->func((uint8_t *)block_buffer, job->flags, bitstring)) result = false;
+        bitstring += job->block_size;
+    }
+    return result;
+}
+
+// Rate-distortion optimize the compressed blocks in storage order. This pass
+// is sequential because every block is compared with the final version of the
+// blocks before it, which may be in previous rows.
+static void OptimizeBlocks(const CompressJob *job, detexOptimizeBlockFuncType optimize) {
+    int height_in_blocks = (job->height + 3) / 4;
+    for (int y = 0; y < height_in_blocks; y++)
+        for (int x = 0; x < job->width_in_blocks; x++) {
+            int index = y * job->width_in_blocks + x;
+            const uint8_t *references[RDO_WINDOW + 3];
+            int nu_references = 0;
+            for (int i = index - 1; i >= 0 && i >= index - RDO_WINDOW; i--)
+                references[nu_references++] = job->bitstring + (size_t)i * job->block_size;
+            // The blocks above, which are matched by compressors with a large
+            // enough window.
+            if (y > 0)
+                for (int i = max(x - 1, 0); i <= min(x + 1, job->width_in_blocks - 1); i++) {
+                    int above = index - job->width_in_blocks + i - x;
+                    if (above < index - RDO_WINDOW)
+                        references[nu_references++] = job->bitstring + (size_t)above * job->block_size;
+                }
+            uint64_t block_buffer[16];
+            GetBlockPixels(job, x, y, (uint8_t *)block_buffer);
+            optimize((uint8_t *)block_buffer,
+                     job->flags,
+                     references,
+                     nu_references,
+                     job->bitstring + (size_t)index * job->block_size);
         }
+}
+
+/*
+ * Encode texture function (multi-threaded). Compress an entire texture
+ * (compressed or uncompressed) into the given compressed texture format,
+ * distributing the block rows over nu_threads threads.
+ */
+bool detexCompressTextureParallel(const detexTexture *texture,
+                                  uint8_t *DETEX_RESTRICT bitstring,
+                                  uint32_t texture_format,
+                                  uint32_t flags,
+                                  int nu_threads) {
+    uint32_t compressed_format = detexGetCompressedFormat(texture_format);
+    if (!detexFormatIsCompressed(texture_format) || compress_function[compressed_format] == NULL) {
+        detexSetErrorMessage("detexCompressTexture: No encoder for texture format 0x%08X", texture_format);
+        return false;
+    }
+    uint32_t block_size = detexGetCompressedBlockSize(texture_format);
+    uint32_t lambda = (flags & DETEX_COMPRESS_RDO_MASK) >> DETEX_COMPRESS_RDO_SHIFT;
+    detexOptimizeBlockFuncType optimize = lambda > 0 ? optimize_function[compressed_format] : NULL;
+    // Blocks that are already in the format are kept as they are.
+    bool keep_blocks = texture->format == texture_format;
+    if (keep_blocks) {
+        memcpy(bitstring, texture->data, (size_t)texture->width_in_blocks * texture->height_in_blocks * block_size);
+        if (optimize == NULL) return true;
+    }
+    // Decode or convert the source texture into the input pixel format of the
+    // encoder first.
+    uint32_t pixel_format = GetCompressPixelFormat(compressed_format);
+    uint32_t pixel_size = detexGetPixelSize(pixel_format);
+    uint8_t *pixels = (uint8_t *)malloc((size_t)texture->width * texture->height * pixel_size);
+    if (pixels == NULL) {
+        detexSetErrorMessage("detexCompressTexture: Out of memory");
+        return false;
+    }
+    if (!detexDecompressTextureLinearParallel(texture, pixels, pixel_format, nu_threads)) {
+        free(pixels);
+        return false;
+    }
+    CompressJob job = {
+        .func = compress_function[compressed_format],
+        .flags = flags,
+        .block_size = block_size,
+        .pixels = pixels,
+        .pixel_size = pixel_size,
+        .width = texture->width,
+        .height = texture->height,
+        .width_in_blocks = (texture->width + 3) / 4,
+        .bitstring = bitstring,
+    };
+    bool result = true;
+    if (!keep_blocks) result = detexParallelFor((texture->height + 3) / 4, nu_threads, CompressBlockRow, &job);
+    if (result && optimize != NULL) OptimizeBlocks(&job, optimize);
+    free(pixels);
+    if (!result) {
+        // Error messages are per-thread, so report the failure here.
+        detexSetErrorMessage("detexCompressTexture: Compress function for format 0x%08X returned error",
+                             texture_format);
     }
     return result;
-}
\ No newline at end of file
+}
+
+/*
+ * Encode texture function. Compress an entire texture (compressed or
+ * uncompressed) into the given compressed texture format, storing the blocks
+ * row-by-row in bitstring.
+ */
+bool detexCompressTexture(const detexTexture *texture,
+                          uint8_t *DETEX_RESTRICT bitstring,
+                          uint32_t texture_format,
+                          uint32_t flags) {
+    return detexCompressTextureParallel(texture, bitstring, texture_format, flags, 1);
+}
+
+// Return whether a BC3 alpha block decodes to 255 for every pixel.
+static bool AlphaBlockIsOpaqueBC3(const uint8_t *bitstring) {
+    int alpha0 = bitstring[0];
+    int alpha1 = bitstring[1];
+    // Mask of the palette entries that are 255, following the BC3 decoder.
+    uint32_t opaque_mask;
+    if (alpha0 > alpha1) {
+        // Only alpha0 can be 255; the interpolated values are smaller.
+        opaque_mask = alpha0 == 0xFF ? 0x01 : 0x00;
+    } else {
+        // The interpolated values are 255 only when both endpoints are;
+        // entry 6 is always 0 and entry 7 always 255.
+        opaque_mask = 0x80;
+        if (alpha0 == 0xFF) opaque_mask |= 0x3F;
+        else if (alpha1 == 0xFF) opaque_mask |= 0x02;
+    }
+    if (opaque_mask == 0) return false;
+    uint64_t indices = 0;
+    for (int i = 0; i < 6; i++) indices |= (uint64_t)bitstring[2 + i] << (i * 8);
+    for (int i = 0; i < 16; i++)
+        if (!(opaque_mask & (1 << ((indices >> (i * 3)) & 7)))) return false;
+    return true;
+}
+
+/*
+ * Return whether every pixel of a BC3 texture has an alpha of 255, inspecting
+ * only the alpha blocks.
+ */
+bool detexTextureIsOpaqueBC3(const detexTexture *texture) {
+    if (texture->format != DETEX_TEXTURE_FORMAT_BC3) return false;
+    const uint8_t *data = texture->data;
+    size_t nu_blocks = (size_t)texture->width_in_blocks * texture->height_in_blocks;
+    for (size_t i = 0; i < nu_blocks; i++)
+        if (!AlphaBlockIsOpaqueBC3(data + i * 16)) return false;
+    return true;
+}
+
+/*
+ * Repack an opaque BC3 texture (see detexTextureIsOpaqueBC3) into BC1 by
+ * copying the color blocks, storing the blocks in bitstring.
+ */
+bool detexConvertOpaqueBC3ToBC1(const detexTexture *texture, uint8_t *DETEX_RESTRICT bitstring) {
+    if (texture->format != DETEX_TEXTURE_FORMAT_BC3) {
+        detexSetErrorMessage("detexConvertOpaqueBC3ToBC1: Texture format is not BC3");
+        return false;
+    }
+    const uint8_t *data = texture->data;
+    size_t nu_blocks = (size_t)texture->width_in_blocks * texture->height_in_blocks;
+    for (size_t i = 0; i < nu_blocks; i++) {
+        const uint8_t *color_block = data + i * 16 + 8;
+        uint8_t *out = bitstring + i * 8;
+        uint32_t color0 = color_block[0] | ((uint32_t)color_block[1] << 8);
+        uint32_t color1 = color_block[2] | ((uint32_t)color_block[3] << 8);
+        memcpy(out, color_block, 8);
+        // The color block of BC3 is always decoded in 4-color mode, while BC1
+        // uses the 3-color mode when color0 <= color1.
+        if (color0 < color1) {
+            // Swap the endpoints; the palette is reversed, which maps index i
+            // to i ^ 1.
+            memcpy(out, color_block + 2, 2);
+            memcpy(out + 2, color_block, 2);
+            for (int j = 4; j < 8; j++) out[j] ^= 0x55;
+        } else if (color0 == color1) {
+            // All four palette entries are the same color, which is palette
+            // entry 0 in the 3-color mode as well.
+            memset(out + 4, 0, 4);
+        }
+    }
+    return true;
+}
+
+// Free an array of textures returned by one of the file loaders.
+void detexFreeTextures(detexTexture **textures, int nu_levels) {
+    if (textures == NULL) return;
+    for (int i = 0; i < nu_levels; i++) {
+        if (textures[i] == NULL) continue;
+        if (!(textures[i]->flags & DETEX_TEXTURE_FLAG_BORROWED_DATA)) free(textures[i]->data);
+        free(textures[i]);
+    }
+    free(textures);
+}
@@ -0,0 +1,279 @@
+/*
+
+Copyright (c) 2015 Harm Hanemaaijer <fgenfb@yahoo.com>
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+*/
+
+#ifdef _WIN32
+#    define WIN32_LEAN_AND_MEAN
+#    include <windows.h>
+#else
+#    include <pthread.h>
+#    include <sched.h>
+#    include <unistd.h>
+#endif
+
+#include <stdlib.h>
+
+#include "detex.h"
+
+// Upper limit for the number of threads used by a single parallel loop.
+#define DETEX_MAX_THREADS 256
+
+// Every worker owns a range of indices [begin, end), packed into a single 64-bit
+// word (begin in the low half) so that it can be updated atomically. The owner
+// takes indices from the front; a worker that runs out steals the back half of
+// the range of another worker.
+typedef struct {
+    volatile int64_t range;
+    // Pad to a cache line, the ranges are updated constantly.
+    uint8_t padding[56];
+} ParallelWorkerRange;
+
+typedef struct {
+    detexParallelWorkerFuncType func;
+    void *context;
+    int nu_workers;
+    ParallelWorkerRange *ranges;
+#ifdef _WIN32
+    volatile LONG result;
+#else
+    int result;
+#endif
+} ParallelJob;
+
+typedef struct {
+    ParallelJob *job;
+    int worker;
+} ParallelThreadArgs;
+
+static int64_t PackRange(uint32_t begin, uint32_t end) {
+    return (int64_t)(((uint64_t)end << 32) | begin);
+}
+
+static bool CompareExchangeRange(volatile int64_t *range, int64_t expected, int64_t desired) {
+#ifdef _WIN32
+    return InterlockedCompareExchange64(range, desired, expected) == expected;
+#else
+    return __atomic_compare_exchange_n(range, &expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+#endif
+}
+
+static int64_t LoadRange(volatile int64_t *range) {
+#ifdef _WIN32
+    return InterlockedCompareExchange64(range, 0, 0);
+#else
+    return __atomic_load_n(range, __ATOMIC_ACQUIRE);
+#endif
+}
+
+// Take the first index of the worker's own range. Returns -1 when it is empty.
+static int PopIndex(ParallelWorkerRange *own) {
+    for (;;) {
+        int64_t range = LoadRange(&own->range);
+        uint32_t begin = (uint32_t)range;
+        uint32_t end = (uint32_t)((uint64_t)range >> 32);
+        if (begin >= end) return -1;
+        if (CompareExchangeRange(&own->range, range, PackRange(begin + 1, end))) return (int)begin;
+    }
+}
+
+// Steal the back half of the range of another worker, keeping one index to run
+// right away and storing the rest as the worker's own range. Returns -1 when
+// all other ranges are empty.
+static int StealIndex(ParallelJob *job, int worker) {
+    for (int i = 1; i < job->nu_workers; i++) {
+        ParallelWorkerRange *victim = &job->ranges[(worker + i) % job->nu_workers];
+        for (;;) {
+            int64_t range = LoadRange(&victim->range);
+            uint32_t begin = (uint32_t)range;
+            uint32_t end = (uint32_t)((uint64_t)range >> 32);
+            if (begin >= end) break;
+            uint32_t middle = end - (end - begin + 1) / 2;
+            if (CompareExchangeRange(&victim->range, range, PackRange(begin, middle))) {
+                // Only the owner grows its own range, and it is empty at this
+                // point, so there is nobody to race with.
+                int64_t own = PackRange(middle + 1, end);
+#ifdef _WIN32
+                InterlockedExchange64(&job->ranges[worker].range, own);
+#else
+                __atomic_store_n(&job->ranges[worker].range, own, __ATOMIC_RELEASE);
+#endif
+                return (int)middle;
+            }
+        }
+    }
+    return -1;
+}
+
+static void RunParallelJob(ParallelJob *job, int worker) {
+    for (;;) {
+        int index = PopIndex(&job->ranges[worker]);
+        if (index < 0) index = StealIndex(job, worker);
+        if (index < 0) break;
+        if (!job->func(job->context, worker, index)) {
+#ifdef _WIN32
+            InterlockedExchange(&job->result, 0);
+#else
+            __atomic_store_n(&job->result, 0, __ATOMIC_RELAXED);
+#endif
+        }
+    }
+}
+
+#ifdef _WIN32
+
+static DWORD WINAPI ParallelThreadMain(LPVOID arg) {
+    ParallelThreadArgs *args = (ParallelThreadArgs *)arg;
+    RunParallelJob(args->job, args->worker);
+    return 0;
+}
+
+/* Return the number of logical processors. */
+int detexGetNumberOfProcessors() {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+}
+
+#else
+
+static void *ParallelThreadMain(void *arg) {
+    ParallelThreadArgs *args = (ParallelThreadArgs *)arg;
+    RunParallelJob(args->job, args->worker);
+    return NULL;
+}
+
+/* Return the number of logical processors. */
+int detexGetNumberOfProcessors() {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+#endif
+
+/*
+ * Call func(context, worker, i) for every i from 0 to count - 1, distributed
+ * over nu_threads workers (the calling thread is worker 0). The indices are
+ * initially split into contiguous ranges, one per worker; workers that finish
+ * early steal work from the others. Returns false when any of the calls
+ * returned false.
+ */
+bool detexParallelForWorkers(int count, int nu_threads, detexParallelWorkerFuncType func, void *context) {
+    if (nu_threads > count) nu_threads = count;
+    if (nu_threads > DETEX_MAX_THREADS) nu_threads = DETEX_MAX_THREADS;
+    if (nu_threads <= 1) {
+        bool result = true;
+        for (int i = 0; i < count; i++)
+            if (!func(context, 0, i)) result = false;
+        return result;
+    }
+    ParallelWorkerRange *ranges = (ParallelWorkerRange *)malloc(nu_threads * sizeof(ParallelWorkerRange));
+    if (ranges == NULL) {
+        detexSetErrorMessage("detexParallelForWorkers: Out of memory");
+        return false;
+    }
+    for (int i = 0; i < nu_threads; i++)
+        ranges[i].range =
+            PackRange((uint32_t)((int64_t)count * i / nu_threads), (uint32_t)((int64_t)count * (i + 1) / nu_threads));
+    ParallelJob job = {
+        .func = func,
+        .context = context,
+        .nu_workers = nu_threads,
+        .ranges = ranges,
+        .result = 1,
+    };
+    ParallelThreadArgs args[DETEX_MAX_THREADS];
+    for (int i = 0; i < nu_threads; i++) {
+        args[i].job = &job;
+        args[i].worker = i;
+    }
+    // When a thread cannot be created, the other workers steal its range.
+#ifdef _WIN32
+    HANDLE threads[DETEX_MAX_THREADS];
+    int nu_started = 0;
+    for (int i = 1; i < nu_threads; i++) {
+        HANDLE thread = CreateThread(NULL, 0, ParallelThreadMain, &args[i], 0, NULL);
+        if (thread != NULL) threads[nu_started++] = thread;
+    }
+    RunParallelJob(&job, 0);
+    for (int i = 0; i < nu_started; i++) {
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+    }
+#else
+    pthread_t threads[DETEX_MAX_THREADS];
+    int nu_started = 0;
+    for (int i = 1; i < nu_threads; i++)
+        if (pthread_create(&threads[nu_started], NULL, ParallelThreadMain, &args[i]) == 0) nu_started++;
+    RunParallelJob(&job, 0);
+    for (int i = 0; i < nu_started; i++) pthread_join(threads[i], NULL);
+#endif
+    free(ranges);
+    return job.result != 0;
+}
+
+typedef struct {
+    detexParallelFuncType func;
+    void *context;
+} ParallelForContext;
+
+static bool ParallelForFunc(void *context, int worker, int index) {
+    ParallelForContext *c = (ParallelForContext *)context;
+    return c->func(c->context, index);
+}
+
+/*
+ * Call func(context, i) for every i from 0 to count - 1, distributed over
+ * nu_threads threads (the calling thread included). When nu_threads is zero
+ * or negative, the number of processors is used. Returns false when any of
+ * the calls returned false.
+ */
+bool detexParallelFor(int count, int nu_threads, detexParallelFuncType func, void *context) {
+    if (nu_threads <= 0) nu_threads = detexGetNumberOfProcessors();
+    ParallelForContext c = {func, context};
+    return detexParallelForWorkers(count, nu_threads, ParallelForFunc, &c);
+}
+
+// States of a detexOnceFlag.
+#define DETEX_ONCE_NOT_CALLED 0
+#define DETEX_ONCE_RUNNING 1
+#define DETEX_ONCE_DONE 2
+
+/*
+ * Call func exactly once for the given flag. Threads that arrive while another
+ * thread is running func wait until it has finished.
+ */
+void detexCallOnce(detexOnceFlag *flag, void (*func)(void)) {
+#ifdef _WIN32
+    if (InterlockedCompareExchange(flag, DETEX_ONCE_DONE, DETEX_ONCE_DONE) == DETEX_ONCE_DONE) return;
+    if (InterlockedCompareExchange(flag, DETEX_ONCE_RUNNING, DETEX_ONCE_NOT_CALLED) == DETEX_ONCE_NOT_CALLED) {
+        func();
+        InterlockedExchange(flag, DETEX_ONCE_DONE);
+        return;
+    }
+    while (InterlockedCompareExchange(flag, DETEX_ONCE_DONE, DETEX_ONCE_DONE) != DETEX_ONCE_DONE) Sleep(0);
+#else
+    if (__atomic_load_n(flag, __ATOMIC_ACQUIRE) == DETEX_ONCE_DONE) return;
+    long expected = DETEX_ONCE_NOT_CALLED;
+    if (__atomic_compare_exchange_n(
+            flag, &expected, DETEX_ONCE_RUNNING, false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+        func();
+        __atomic_store_n(flag, DETEX_ONCE_DONE, __ATOMIC_RELEASE);
+        return;
+    }
+    while (__atomic_load_n(flag, __ATOMIC_ACQUIRE) != DETEX_ONCE_DONE) sched_yield();
+#endif
+}
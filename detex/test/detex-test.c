@@ -0,0 +1,589 @@
+/*
+
+Copyright (c) 2015 Harm Hanemaaijer <fgenfb@yahoo.com>
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+*/
+
+/*
+ * Regression tests for the encoders, decoders and file loaders. Every test
+ * prints the checks that failed; the program exits with a non-zero status
+ * when any test failed.
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "detex.h"
+
+static int nu_failures = 0;
+
+#define CHECK(condition)                                                                          \
+    do {                                                                                          \
+        if (!(condition)) {                                                                       \
+            fprintf(stderr, "%s:%d: %s: check failed: %s\n", __FILE__, __LINE__, __func__, #condition); \
+            nu_failures++;                                                                        \
+        }                                                                                         \
+    } while (0)
+
+// Deterministic pseudo-random numbers, so that failures are reproducible.
+static uint32_t random_state = 0x12345678;
+
+static uint32_t Random(void) {
+    random_state = random_state * 1103515245 + 12345;
+    return random_state >> 8;
+}
+
+// Opaque gray block of which some pixels are (nearly) black, which makes the
+// 3-color mode of BC1 with its black palette entry attractive to an encoder.
+static void GenerateDarkGrayBlock(uint8_t *pixel_buffer) {
+    int level = 64 + Random() % 160;
+    for (int i = 0; i < 16; i++) {
+        int value = Random() % 4 == 0 ? Random() % 8 : level + Random() % 16;
+        pixel_buffer[i * 4] = pixel_buffer[i * 4 + 1] = pixel_buffer[i * 4 + 2] = value;
+        pixel_buffer[i * 4 + 3] = 0xFF;
+    }
+}
+
+// Decode a BC1 block the way D3D and GPUs do, with punchthrough alpha, and
+// check that it is opaque.
+static bool IsOpaqueBC1A(const uint8_t *bitstring) {
+    uint8_t pixel_buffer[64];
+    if (!detexDecompressBlockBC1A(bitstring, DETEX_MODE_MASK_ALL, 0, pixel_buffer)) return false;
+    for (int i = 0; i < 16; i++)
+        if (pixel_buffer[i * 4 + 3] != 0xFF) return false;
+    return true;
+}
+
+// Opaque sources must not be encoded with the transparent black entry of the
+// BC1 3-color mode, unless DETEX_COMPRESS_FLAG_BC1_BLACK is given.
+static void TestCompressBC1Opaque(void) {
+    static const uint32_t flags[] = {0, DETEX_COMPRESS_FLAG_QUALITY};
+    for (int f = 0; f < 2; f++) {
+        int nu_transparent = 0;
+        uint8_t blocks[8][8];
+        for (int i = 0; i < 1000; i++) {
+            uint8_t pixel_buffer[64];
+            GenerateDarkGrayBlock(pixel_buffer);
+            uint8_t *bitstring = blocks[i % 8];
+            detexCompressBlockBC1(pixel_buffer, flags[f], bitstring);
+            if (!IsOpaqueBC1A(bitstring)) nu_transparent++;
+            // The rate-distortion optimization, against the previous blocks.
+            const uint8_t *references[7];
+            int nu_references = 0;
+            for (int j = 1; j < 8 && j <= i; j++) references[nu_references++] = blocks[(i - j) % 8];
+            detexOptimizeBlockBC1(
+                pixel_buffer, flags[f] | DETEX_COMPRESS_FLAG_RDO(255), references, nu_references, bitstring);
+            if (!IsOpaqueBC1A(bitstring)) nu_transparent++;
+        }
+        CHECK(nu_transparent == 0);
+    }
+    // The black entry is still used on request.
+    int nu_transparent = 0;
+    for (int i = 0; i < 1000; i++) {
+        uint8_t pixel_buffer[64];
+        uint8_t bitstring[8];
+        GenerateDarkGrayBlock(pixel_buffer);
+        detexCompressBlockBC1(pixel_buffer, DETEX_COMPRESS_FLAG_QUALITY | DETEX_COMPRESS_FLAG_BC1_BLACK, bitstring);
+        if (!IsOpaqueBC1A(bitstring)) nu_transparent++;
+    }
+    CHECK(nu_transparent > 0);
+}
+
+// Block with a random gradient and some noise in every component. Alpha is
+// 0xFF when has_alpha is false.
+static void GenerateSmoothBlock(uint8_t *pixel_buffer, bool has_alpha) {
+    int base[4], dx[4], dy[4];
+    for (int c = 0; c < 4; c++) {
+        base[c] = Random() % 256;
+        dx[c] = (int)(Random() % 17) - 8;
+        dy[c] = (int)(Random() % 17) - 8;
+    }
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 4; c++) {
+            int value = base[c] + dx[c] * (i % 4) + dy[c] * (i / 4) + (int)(Random() % 5) - 2;
+            if (value < 0) value = 0;
+            if (value > 255) value = 255;
+            pixel_buffer[i * 4 + c] = (c == 3 && !has_alpha) ? 0xFF : value;
+        }
+}
+
+// Mean squared error of the first nu_components components of two RGBA8 blocks.
+static double BlockError(const uint8_t *pixel_buffer1, const uint8_t *pixel_buffer2, int nu_components) {
+    int error = 0;
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < nu_components; c++) {
+            int d = pixel_buffer1[i * 4 + c] - pixel_buffer2[i * 4 + c];
+            error += d * d;
+        }
+    return (double)error / (16 * nu_components);
+}
+
+typedef bool (*CompressFuncType)(const uint8_t *pixel_buffer, uint32_t flags, uint8_t *bitstring);
+
+// An encoder and the error bounds of its round trip on smooth blocks: the mean
+// squared error of every block and the mean over all blocks.
+typedef struct {
+    CompressFuncType func;
+    uint32_t texture_format;
+    int nu_components;
+    double max_error;
+    double max_mean_error;
+} RoundTripTest;
+
+// Encode smooth blocks, decode them and check the error against the bounds.
+static void CheckRoundTrip(const RoundTripTest *test, uint32_t flags) {
+    enum { NU_BLOCKS = 1000 };
+    double total_error = 0;
+    for (int i = 0; i < NU_BLOCKS; i++) {
+        uint8_t pixel_buffer[64];
+        GenerateSmoothBlock(pixel_buffer, test->nu_components == 4);
+        uint8_t bitstring[16];
+        CHECK(test->func(pixel_buffer, flags, bitstring));
+        uint8_t decoded[64];
+        CHECK(detexDecompressBlock(
+            bitstring, test->texture_format, DETEX_MODE_MASK_ALL, 0, decoded, DETEX_PIXEL_FORMAT_RGBA8));
+        double error = BlockError(pixel_buffer, decoded, test->nu_components);
+        CHECK(error <= test->max_error);
+        total_error += error;
+    }
+    CHECK(total_error / NU_BLOCKS <= test->max_mean_error);
+}
+
+// ETC1, ETC2 and ETC2_EAC round trips, with the fast and the quality search.
+static void TestCompressETC(void) {
+    static const RoundTripTest tests[] = {
+        {detexCompressBlockETC1, DETEX_TEXTURE_FORMAT_ETC1, 3, 128.0, 32.0},
+        {detexCompressBlockETC2, DETEX_TEXTURE_FORMAT_ETC2, 3, 128.0, 32.0},
+        {detexCompressBlockETC2_EAC, DETEX_TEXTURE_FORMAT_ETC2_EAC, 4, 96.0, 24.0},
+    };
+    for (int i = 0; i < 3; i++) {
+        CheckRoundTrip(&tests[i], 0);
+        CheckRoundTrip(&tests[i], DETEX_COMPRESS_FLAG_QUALITY);
+    }
+}
+
+// Block of which the pixels of every subset of a partition (16 subset numbers,
+// or NULL for a single subset) lie on a line of their own, with a few levels
+// along it. Alpha is 0xFF when has_alpha is false. Without a partition, alpha
+// has eight levels of its own, which suits the modes with separate alpha
+// indices.
+static void GeneratePartitionedBlock(uint8_t *pixel_buffer, const uint8_t *subsets, bool has_alpha) {
+    int base[3][4], direction[3][4];
+    for (int s = 0; s < 3; s++)
+        for (int c = 0; c < 4; c++) {
+            base[s][c] = 32 + Random() % 192;
+            direction[s][c] = (int)(Random() % 21) - 10;
+        }
+    for (int i = 0; i < 16; i++) {
+        int s = subsets == NULL ? 0 : subsets[i];
+        int level = Random() % 4;
+        int alpha_level = subsets == NULL ? Random() % 8 : level;
+        for (int c = 0; c < 4; c++) {
+            int value = base[s][c] + direction[s][c] * (c == 3 ? alpha_level : level);
+            if (value < 0) value = 0;
+            if (value > 255) value = 255;
+            pixel_buffer[i * 4 + c] = (c == 3 && !has_alpha) ? 0xFF : value;
+        }
+    }
+}
+
+// BPTC round trips, and the quality search with the largest budget selects
+// every mode for a mix of smooth and partitioned blocks.
+static void TestCompressBPTC(void) {
+    static const RoundTripTest test = {detexCompressBlockBPTC, DETEX_TEXTURE_FORMAT_BPTC, 4, 32.0, 12.0};
+    CheckRoundTrip(&test, 0);
+    CheckRoundTrip(&test, DETEX_COMPRESS_FLAG_QUALITY);
+    int nu_blocks_per_mode[8] = {0};
+    for (int i = 0; i < 3000; i++) {
+        uint8_t pixel_buffer[64];
+        // The three subset modes have no alpha.
+        bool has_alpha = (i / 3) % 2 == 1 && i % 3 != 2;
+        if (i % 3 == 0)
+            GeneratePartitionedBlock(pixel_buffer, NULL, has_alpha);
+        else if (i % 3 == 1)
+            GeneratePartitionedBlock(pixel_buffer, &detex_bptc_table_P2[(Random() % 64) * 16], has_alpha);
+        else
+            GeneratePartitionedBlock(pixel_buffer, &detex_bptc_table_P3[(Random() % 64) * 16], has_alpha);
+        uint8_t bitstring[16];
+        CHECK(detexCompressBlockBPTC(
+            pixel_buffer, DETEX_COMPRESS_FLAG_QUALITY | DETEX_COMPRESS_FLAG_BUDGET(64), bitstring));
+        uint32_t mode = detexGetModeBPTC(bitstring);
+        CHECK(mode < 8);
+        if (mode < 8) nu_blocks_per_mode[mode]++;
+        uint8_t decoded[64];
+        CHECK(detexDecompressBlockBPTC(bitstring, DETEX_MODE_MASK_ALL, 0, decoded));
+        CHECK(BlockError(pixel_buffer, decoded, 4) <= 32.0);
+    }
+    for (int mode = 0; mode < 8; mode++) CHECK(nu_blocks_per_mode[mode] > 0);
+}
+
+// RGTC1 and RGTC2 round trips. The signed variants encode the components minus
+// 128 and decode to 16-bit values, which are mapped back to [-127, 127].
+static void TestCompressRGTC(void) {
+    static const RoundTripTest tests[] = {
+        {detexCompressBlockRGTC1, DETEX_TEXTURE_FORMAT_RGTC1, 1, 8.0, 2.0},
+        {detexCompressBlockRGTC2, DETEX_TEXTURE_FORMAT_RGTC2, 2, 8.0, 2.0},
+    };
+    for (int i = 0; i < 2; i++) {
+        CheckRoundTrip(&tests[i], 0);
+        CheckRoundTrip(&tests[i], DETEX_COMPRESS_FLAG_QUALITY);
+    }
+    for (int nu_components = 1; nu_components <= 2; nu_components++) {
+        double total_error = 0;
+        for (int i = 0; i < 1000; i++) {
+            uint8_t pixel_buffer[64];
+            GenerateSmoothBlock(pixel_buffer, false);
+            uint8_t bitstring[16];
+            int16_t decoded[32];
+            if (nu_components == 1) {
+                CHECK(detexCompressBlockSIGNED_RGTC1(pixel_buffer, 0, bitstring));
+                CHECK(detexDecompressBlockSIGNED_RGTC1(bitstring, DETEX_MODE_MASK_ALL, 0, (uint8_t *)decoded));
+            } else {
+                CHECK(detexCompressBlockSIGNED_RGTC2(pixel_buffer, 0, bitstring));
+                CHECK(detexDecompressBlockSIGNED_RGTC2(bitstring, DETEX_MODE_MASK_ALL, 0, (uint8_t *)decoded));
+            }
+            double error = 0;
+            for (int j = 0; j < 16; j++)
+                for (int c = 0; c < nu_components; c++) {
+                    int value = pixel_buffer[j * 4 + c] - 128;
+                    if (value < -127) value = -127;
+                    double d = value - ((decoded[j * nu_components + c] + 32768) * 254.0 / 65535.0 - 127.0);
+                    error += d * d;
+                }
+            error /= 16 * nu_components;
+            CHECK(error <= 8.0);
+            total_error += error;
+        }
+        CHECK(total_error / 1000 <= 2.0);
+    }
+}
+
+// BPTC_FLOAT and BPTC_SIGNED_FLOAT round trips of blocks that follow each of
+// the 32 partitions of the two subset modes: the subsets have different colors
+// with a gradient in a different component, so that the encoder selects that
+// partition when its budget covers every partition. The error is relative to
+// the magnitude of the value, or absolute below one.
+static void TestCompressBPTCFloat(void) {
+    uint32_t flags = DETEX_COMPRESS_FLAG_BUDGET(32);
+    for (int is_signed = 0; is_signed < 2; is_signed++)
+        for (int partition = 0; partition < 32; partition++) {
+            float values[64];
+            float base[2][3];
+            float gradient[2];
+            for (int s = 0; s < 2; s++) {
+                for (int c = 0; c < 3; c++) base[s][c] = 1.0f + (c == 2 ? 1.5f * s : 0) + (Random() % 100) / 100.0f;
+                gradient[s] = 2.0f + (Random() % 100) / 100.0f;
+            }
+            // Signed blocks are negative for every other partition.
+            float sign = is_signed && partition % 2 == 1 ? -1.0f : 1.0f;
+            // The levels cycle through the pixels of a subset, so that no pixel
+            // of the other subset lies on its line.
+            int nu_members[2] = {0, 0};
+            for (int i = 0; i < 16; i++) {
+                int s = detex_bptc_table_P2[partition * 16 + i];
+                float level = (nu_members[s]++ % 4) / 3.0f;
+                for (int c = 0; c < 3; c++) values[i * 4 + c] = sign * (base[s][c] + (c == s ? gradient[s] * level : 0));
+                values[i * 4 + 3] = 1.0f;
+            }
+            uint16_t pixel_buffer[64];
+            detexConvertFloatToHalfFloat(values, 64, pixel_buffer);
+            uint8_t bitstring[16];
+            uint16_t decoded[64];
+            if (is_signed) {
+                CHECK(detexCompressBlockBPTC_SIGNED_FLOAT((uint8_t *)pixel_buffer, flags, bitstring));
+                CHECK(detexDecompressBlockBPTC_SIGNED_FLOAT(bitstring, DETEX_MODE_MASK_ALL, 0, (uint8_t *)decoded));
+            } else {
+                CHECK(detexCompressBlockBPTC_FLOAT((uint8_t *)pixel_buffer, flags, bitstring));
+                CHECK(detexDecompressBlockBPTC_FLOAT(bitstring, DETEX_MODE_MASK_ALL, 0, (uint8_t *)decoded));
+            }
+            // Modes 0 to 9 have two subsets, with the partition in bits 77 to 81.
+            CHECK(detexGetModeBPTC_FLOAT(bitstring) < 10);
+            uint64_t data1;
+            memcpy(&data1, &bitstring[8], 8);
+            CHECK(detexGetBits64(data1, 13, 17) == (uint32_t)partition);
+            float decoded_values[64];
+            detexConvertHalfFloatToFloat(decoded, 64, decoded_values);
+            for (int i = 0; i < 16; i++)
+                for (int c = 0; c < 3; c++) {
+                    float value = values[i * 4 + c];
+                    float scale = fabsf(value) > 1.0f ? fabsf(value) : 1.0f;
+                    CHECK(fabsf(decoded_values[i * 4 + c] - value) <= 0.25f * scale);
+                }
+        }
+}
+
+// Signed half-floats converted to unsigned half-floats have their negative
+// values clamped to zero; the other direction keeps the values.
+static void TestConvertSignedHalfFloat(void) {
+    float values[8] = {-1.5f, -0.0f, 0.0f, 2.0f, -65504.0f, 0.25f, -0.001f, 1.0f};
+    uint16_t source[8];
+    detexConvertFloatToHalfFloat(values, 8, source);
+    uint16_t target[8];
+    CHECK(detexConvertPixels((uint8_t *)source,
+                             2,
+                             DETEX_PIXEL_FORMAT_SIGNED_FLOAT_RGBX16,
+                             (uint8_t *)target,
+                             DETEX_PIXEL_FORMAT_FLOAT_RGBX16));
+    for (int i = 0; i < 8; i++) CHECK(target[i] == ((source[i] & 0x8000) ? 0 : source[i]));
+    // The source is not modified.
+    CHECK(source[0] == 0xBE00);
+    CHECK(detexConvertPixelsInPlace(
+        (uint8_t *)source, 2, DETEX_PIXEL_FORMAT_SIGNED_FLOAT_RGBX16, DETEX_PIXEL_FORMAT_FLOAT_RGBX16));
+    CHECK(memcmp(source, target, sizeof(target)) == 0);
+    CHECK(detexConvertPixels((uint8_t *)target,
+                             2,
+                             DETEX_PIXEL_FORMAT_FLOAT_RGBX16,
+                             (uint8_t *)source,
+                             DETEX_PIXEL_FORMAT_SIGNED_FLOAT_RGBX16));
+    CHECK(memcmp(source, target, sizeof(target)) == 0);
+}
+
+// Squared error of the first nu_components components of a 4x4 tile of an
+// RGBA8 image and a decoded block.
+static int TileError(const uint8_t *image, int width, int x, int y, const uint8_t *pixel_buffer, int nu_components) {
+    int error = 0;
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < nu_components; c++) {
+            int d = image[((y * 4 + i / 4) * width + x * 4 + i % 4) * 4 + c] - pixel_buffer[i * 4 + c];
+            error += d * d;
+        }
+    return error;
+}
+
+// Rate-distortion optimized BC1 and BC3 textures stay within the distortion
+// budget: every 64-bit half block that is replaced costs at least 16 bits
+// instead of at most 64, so its squared error grows by at most lambda * 48.
+// The multi-block decoders give the same result at every SIMD level.
+static void TestCompressRDO(void) {
+    enum { WIDTH = 64, HEIGHT = 64, NU_BLOCKS = (WIDTH / 4) * (HEIGHT / 4), LAMBDA = 32 };
+    // Smooth blocks, of which about half repeat the block before them with
+    // some noise, so that there are blocks worth reusing.
+    uint8_t *image = (uint8_t *)malloc(WIDTH * HEIGHT * 4);
+    uint8_t pixel_buffer[64];
+    for (int y = 0; y < HEIGHT / 4; y++)
+        for (int x = 0; x < WIDTH / 4; x++) {
+            if (Random() % 2 == 0)
+                GenerateSmoothBlock(pixel_buffer, true);
+            else
+                for (int i = 0; i < 64; i++) {
+                    int value = pixel_buffer[i] + (int)(Random() % 5) - 2;
+                    pixel_buffer[i] = value < 0 ? 0 : value > 255 ? 255 : value;
+                }
+            for (int i = 0; i < 16; i++)
+                memcpy(&image[((y * 4 + i / 4) * WIDTH + x * 4 + i % 4) * 4], &pixel_buffer[i * 4], 4);
+        }
+    detexTexture texture = {DETEX_PIXEL_FORMAT_RGBA8, WIDTH, HEIGHT, WIDTH, HEIGHT, image, 0};
+    static const uint32_t texture_formats[] = {DETEX_TEXTURE_FORMAT_BC1, DETEX_TEXTURE_FORMAT_BC3};
+    uint32_t default_level = detexGetSIMDLevel();
+    for (int f = 0; f < 2; f++) {
+        uint32_t texture_format = texture_formats[f];
+        int block_size = texture_format == DETEX_TEXTURE_FORMAT_BC1 ? 8 : 16;
+        int nu_components = texture_format == DETEX_TEXTURE_FORMAT_BC1 ? 3 : 4;
+        uint8_t *bitstring = (uint8_t *)malloc(NU_BLOCKS * block_size);
+        uint8_t *optimized = (uint8_t *)malloc(NU_BLOCKS * block_size);
+        CHECK(detexCompressTexture(&texture, bitstring, texture_format, 0));
+        CHECK(detexCompressTexture(&texture, optimized, texture_format, DETEX_COMPRESS_FLAG_RDO(LAMBDA)));
+        int nu_changed = 0;
+        for (int i = 0; i < NU_BLOCKS; i++) {
+            uint8_t decoded[64];
+            uint8_t optimized_decoded[64];
+            CHECK(detexDecompressBlock(&bitstring[i * block_size],
+                                       texture_format,
+                                       DETEX_MODE_MASK_ALL,
+                                       0,
+                                       decoded,
+                                       DETEX_PIXEL_FORMAT_RGBA8));
+            CHECK(detexDecompressBlock(&optimized[i * block_size],
+                                       texture_format,
+                                       DETEX_MODE_MASK_ALL,
+                                       0,
+                                       optimized_decoded,
+                                       DETEX_PIXEL_FORMAT_RGBA8));
+            int x = i % (WIDTH / 4);
+            int y = i / (WIDTH / 4);
+            int error = TileError(image, WIDTH, x, y, decoded, nu_components);
+            int optimized_error = TileError(image, WIDTH, x, y, optimized_decoded, nu_components);
+            CHECK(optimized_error <= error + LAMBDA * 48 * (block_size / 8));
+            if (memcmp(&bitstring[i * block_size], &optimized[i * block_size], block_size) != 0) nu_changed++;
+        }
+        CHECK(nu_changed > 0);
+        // Decode the optimized texture with scalar code, then with every
+        // supported SIMD level.
+        uint8_t *expected = (uint8_t *)malloc(NU_BLOCKS * 64);
+        uint8_t *result = (uint8_t *)malloc(NU_BLOCKS * 64);
+        detexSetSIMDLevel(DETEX_SIMD_LEVEL_NONE);
+        if (f == 0)
+            CHECK(detexDecompressBlocksBC1(optimized, NU_BLOCKS, 0, expected));
+        else
+            CHECK(detexDecompressBlocksBC3(optimized, NU_BLOCKS, 0, expected));
+        for (uint32_t level = DETEX_SIMD_LEVEL_SSE2; level <= DETEX_SIMD_LEVEL_NEON; level++) {
+            detexSetSIMDLevel(level);
+            if (detexGetSIMDLevel() != level) continue;
+            memset(result, 0, NU_BLOCKS * 64);
+            if (f == 0)
+                CHECK(detexDecompressBlocksBC1(optimized, NU_BLOCKS, 0, result));
+            else
+                CHECK(detexDecompressBlocksBC3(optimized, NU_BLOCKS, 0, result));
+            CHECK(memcmp(result, expected, NU_BLOCKS * 64) == 0);
+        }
+        detexSetSIMDLevel(default_level);
+        free(result);
+        free(expected);
+        free(optimized);
+        free(bitstring);
+    }
+    free(image);
+}
+
+// Set bits bit0 to bit1 (inclusive) of a 128-bit block to ones.
+static void SetBlockBits(uint8_t *block, int bit0, int bit1) {
+    for (int i = bit0; i <= bit1; i++) block[i / 8] |= 1 << (i % 8);
+}
+
+// Fields that end at bit 63 of a 64-bit word, or straddle the two words of a
+// 128-bit block.
+static void TestGetBits64(void) {
+    uint64_t data = 0xF00000000000000FULL;
+    CHECK(detexGetBits64(data, 60, 63) == 0xF);
+    CHECK(detexGetBits64(data, 0, 3) == 0xF);
+    CHECK(detexGetBits64(data, 59, 63) == 0x1E);
+    CHECK(detexClearBits64(data, 60, 63) == 0xF);
+    CHECK(detexSetBits64(0, 61, 63, 5) == 0xA000000000000000ULL);
+    CHECK(detexSetBits64(UINT64_MAX, 59, 63, 0) == 0x07FFFFFFFFFFFFFFULL);
+    // BPTC mode 1, of which the second blue endpoint (bits 62-67) straddles
+    // the two words. All blue endpoint bits, p-bits and indices are set, so
+    // that every pixel decodes to blue 255.
+    uint8_t block[16] = {0};
+    SetBlockBits(block, 1, 1);
+    SetBlockBits(block, 56, 127);
+    uint8_t pixel_buffer[64];
+    CHECK(detexDecompressBlockBPTC(block, DETEX_MODE_MASK_ALL, 0, pixel_buffer));
+    for (int i = 0; i < 16; i++) CHECK(pixel_buffer[i * 4 + 2] == 0xFF);
+    // BPTC mode 6, of which the second p-bit is bit 64. Only that p-bit is
+    // set, so that the second endpoint is 255 and the first 254.
+    memset(block, 0, sizeof(block));
+    SetBlockBits(block, 6, 62);
+    SetBlockBits(block, 64, 127);
+    CHECK(detexDecompressBlockBPTC(block, DETEX_MODE_MASK_ALL, 0, pixel_buffer));
+    for (int i = 1; i < 16; i++) CHECK(memcmp(&pixel_buffer[i * 4], "\xFF\xFF\xFF\xFF", 4) == 0);
+}
+
+typedef bool (*SaveFuncType)(const char *filename, detexTexture **textures, int nu_levels);
+typedef bool (*LoadFuncType)(const char *filename, int max_mipmaps, detexTexture ***textures_out, int *nu_levels_out);
+typedef bool (*MapFuncType)(const char *filename,
+                            int max_mipmaps,
+                            detexTexture ***textures_out,
+                            int *nu_levels_out,
+                            detexFileMapping **mapping_out);
+
+// The file loaders reject a maximum number of levels below one, and load a
+// single level when it is one.
+static void TestFileMaxMipmaps(void) {
+    static const char *filenames[] = {"detex-test.tex", "detex-test.ktx", "detex-test.dds"};
+    static const SaveFuncType save_functions[] = {detexFileSaveTEX, detexFileSaveKTX, detexFileSaveDDS};
+    static const LoadFuncType load_functions[] = {detexFileLoadTEX, detexFileLoadKTX, detexFileLoadDDS};
+    static const MapFuncType map_functions[] = {detexFileMapTEX, detexFileMapKTX, detexFileMapDDS};
+    uint8_t data[8] = {0};
+    detexTexture texture = {DETEX_TEXTURE_FORMAT_BC1, 4, 4, 1, 1, data, 0};
+    detexTexture *levels[1] = {&texture};
+    for (int i = 0; i < 3; i++) {
+        CHECK(save_functions[i](filenames[i], levels, 1));
+        for (int max_mipmaps = -1; max_mipmaps <= 1; max_mipmaps++) {
+            detexTexture **textures = NULL;
+            int nu_levels = 0;
+            bool r = load_functions[i](filenames[i], max_mipmaps, &textures, &nu_levels);
+            CHECK(r == (max_mipmaps == 1));
+            if (r) {
+                CHECK(nu_levels == 1);
+                detexFreeTextures(textures, nu_levels);
+            }
+            detexFileMapping *mapping = NULL;
+            r = map_functions[i](filenames[i], max_mipmaps, &textures, &nu_levels, &mapping);
+            CHECK(r == (max_mipmaps == 1));
+            if (r) {
+                CHECK(nu_levels == 1);
+                detexFreeTextures(textures, nu_levels);
+                detexFileUnmap(mapping);
+            }
+        }
+        remove(filenames[i]);
+    }
+}
+
+// Every worker converts a row of half floats with its own HDR parameters, as
+// the parallel decoders do.
+#define HDR_ROW_SIZE 4096
+
+typedef struct {
+    const uint16_t *source;
+    uint16_t *target;
+} HDRGammaJob;
+
+static bool ConvertHDRGammaRow(void *context, int index) {
+    HDRGammaJob *job = (HDRGammaJob *)context;
+    detexSetHDRParameters(2.2f, 0.0f, 1.0f);
+    uint16_t *row = job->target + (size_t)index * HDR_ROW_SIZE;
+    memcpy(row, job->source, HDR_ROW_SIZE * sizeof(uint16_t));
+    detexConvertHDRHalfFloatToUInt16(row, HDR_ROW_SIZE);
+    return true;
+}
+
+// Gamma-corrected HDR conversion gives the same result on every thread, in
+// repeated parallel loops (which start new threads) that share the table.
+static void TestHDRGammaParallel(void) {
+    enum { NU_ROWS = 16 };
+    float values[HDR_ROW_SIZE];
+    for (int i = 0; i < HDR_ROW_SIZE; i++) values[i] = (float)i / (HDR_ROW_SIZE - 1);
+    uint16_t source[HDR_ROW_SIZE];
+    detexConvertFloatToHalfFloat(values, HDR_ROW_SIZE, source);
+    uint16_t expected[HDR_ROW_SIZE];
+    memcpy(expected, source, sizeof(expected));
+    detexSetHDRParameters(2.2f, 0.0f, 1.0f);
+    detexConvertHDRHalfFloatToUInt16(expected, HDR_ROW_SIZE);
+    detexSetHDRParameters(1.0f, 0.0f, 1.0f);
+    // Gamma 2.2 brightens the middle of the range.
+    CHECK(expected[HDR_ROW_SIZE / 2] > 0x8000 + 0x1000);
+    uint16_t *target = (uint16_t *)malloc(NU_ROWS * HDR_ROW_SIZE * sizeof(uint16_t));
+    HDRGammaJob job = {source, target};
+    for (int i = 0; i < 8; i++) {
+        memset(target, 0, NU_ROWS * HDR_ROW_SIZE * sizeof(uint16_t));
+        CHECK(detexParallelFor(NU_ROWS, 4, ConvertHDRGammaRow, &job));
+        for (int row = 0; row < NU_ROWS; row++)
+            CHECK(memcmp(target + row * HDR_ROW_SIZE, expected, sizeof(expected)) == 0);
+    }
+    free(target);
+}
+
+int main(void) {
+    TestCompressBC1Opaque();
+    TestCompressETC();
+    TestCompressBPTC();
+    TestCompressRGTC();
+    TestCompressBPTCFloat();
+    TestConvertSignedHalfFloat();
+    TestCompressRDO();
+    TestGetBits64();
+    TestFileMaxMipmaps();
+    TestHDRGammaParallel();
+    if (nu_failures > 0) {
+        fprintf(stderr, "%d checks failed\n", nu_failures);
+        return EXIT_FAILURE;
+    }
+    printf("All tests passed\n");
+    return EXIT_SUCCESS;
+}
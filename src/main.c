@@ -18,19 +18,30 @@ OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 
 /* Texture file converter. */
 
+#include <errno.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#    define WIN32_LEAN_AND_MEAN
+#    include <windows.h>
+#else
+#    include <dirent.h>
+#    include <glob.h>
+#    include <sys/stat.h>
+#endif
 
 #include "detex.h"
 
 typedef enum FILE_TYPE {
     FILE_TYPE_NONE = 0,
-    FILE_TYPE_KTX = 1,
-    FILE_TYPE_DDS = 2,
-    FILE_TYPE_TEX = 3,
+    FILE_TYPE_KTX = DETEX_FILE_TYPE_KTX,
+    FILE_TYPE_DDS = DETEX_FILE_TYPE_DDS,
+    FILE_TYPE_TEX = DETEX_FILE_TYPE_TEX,
 } FILE_TYPE;
 
 static FILE_TYPE get_extension(char* filename) {
@@ -71,7 +82,31 @@ static FILE_TYPE get_magic(char* filename) {
     return FILE_TYPE_NONE;
 }
 
+// Compressed formats that DDS and KTX files can be written in, selected with --format.
+typedef struct OutputFormat {
+    const char* name;
+    uint32_t format;
+} OutputFormat;
+
+static OutputFormat const output_formats[] = {
+    {"bc1", DETEX_TEXTURE_FORMAT_BC1},
+    {"bc3", DETEX_TEXTURE_FORMAT_BC3},
+    {"bc4", DETEX_TEXTURE_FORMAT_RGTC1},
+    {"bc4s", DETEX_TEXTURE_FORMAT_SIGNED_RGTC1},
+    {"bc5", DETEX_TEXTURE_FORMAT_RGTC2},
+    {"bc5s", DETEX_TEXTURE_FORMAT_SIGNED_RGTC2},
+    {"bc6h", DETEX_TEXTURE_FORMAT_BPTC_FLOAT},
+    {"bc6hs", DETEX_TEXTURE_FORMAT_BPTC_SIGNED_FLOAT},
+    {"bc7", DETEX_TEXTURE_FORMAT_BPTC},
+};
+
+// Zero keeps the format of the input texture.
+static uint32_t output_format = 0;
+
 static uint32_t format_for_dds(uint32_t format) {
+    if (output_format != 0) {
+        return output_format;
+    }
     detexTextureFileInfo const* info = detexLookupTextureFormatFileInfo(format);
     if (info == NULL || !info->dds_support) {
         format = detexGetPixelFormat(format);
@@ -92,6 +127,9 @@ static uint32_t format_for_dds(uint32_t format) {
 }
 
 static uint32_t format_for_ktx(uint32_t format) {
+    if (output_format != 0) {
+        return output_format;
+    }
     detexTextureFileInfo const* info = detexLookupTextureFormatFileInfo(format);
     if (info == NULL || !info->ktx_support) {
         format = detexGetPixelFormat(format);
@@ -109,61 +147,177 @@ static uint32_t format_for_ktx(uint32_t format) {
     return format;
 }
 
+// Compressed formats written to TEX files, selected with --tex-format.
+typedef enum TEX_FORMAT {
+    TEX_FORMAT_BC = 0,
+    TEX_FORMAT_ETC1 = 1,
+    TEX_FORMAT_ETC2 = 2,
+} TEX_FORMAT;
+
+static TEX_FORMAT tex_format = TEX_FORMAT_BC;
+
 static uint32_t format_for_tex(uint32_t format) {
+    switch (tex_format) {
+        case TEX_FORMAT_ETC1:
+            // ETC1 has no alpha channel.
+            return DETEX_TEXTURE_FORMAT_ETC1;
+        case TEX_FORMAT_ETC2:
+            // Opaque textures are stored as ETC1, which is a subset of ETC2.
+            if (format == DETEX_TEXTURE_FORMAT_ETC1 || format == DETEX_TEXTURE_FORMAT_ETC2_EAC) {
+                return format;
+            }
+            return detexFormatHasAlpha(format) ? DETEX_TEXTURE_FORMAT_ETC2_EAC : DETEX_TEXTURE_FORMAT_ETC1;
+        default:
+            break;
+    }
     switch (format) {
         case DETEX_TEXTURE_FORMAT_BC1:
         // case DETEX_TEXTURE_FORMAT_BC2:
         case DETEX_TEXTURE_FORMAT_BC3:
             return format;
         default:
-            return DETEX_PIXEL_FORMAT_RGBA8;
+            // Encode everything else, keeping the alpha channel when there is one.
+            return detexFormatHasAlpha(format) ? DETEX_TEXTURE_FORMAT_BC3 : DETEX_TEXTURE_FORMAT_BC1;
     }
 }
 
-static bool convert_textures(detexTexture** textures, int nu_levels, uint32_t (*selectFormat)(uint32_t in_format)) {
+// Texture files are loaded with at most this many mipmap levels.
+#define MAX_LEVELS 32
+
+// Reusable buffers for the converted levels of a texture. Every batch worker
+// has its own, so converting a file does not allocate once the buffer has
+// grown to fit the largest texture.
+typedef struct Scratch {
+    detexTexture levels[MAX_LEVELS];
+    uint8_t* data;
+    size_t capacity;
+} Scratch;
+
+static uint32_t compress_flags = DETEX_COMPRESS_FLAG_QUALITY;
+static int nu_threads = 0;
+// Regenerate the mip-map chain from the first level with this filter, unless negative.
+static int mipmap_filter = -1;
+static uint32_t mipmap_flags = 0;
+// Store BC3 textures of which the alpha channel is fully opaque as BC1.
+static bool opaque_bc1 = false;
+// Drop this many of the largest mip-map levels, keeping at least the smallest one.
+static int drop_mips = 0;
+
+// Return whether the levels are BC3 with an opaque alpha channel and would be
+// stored as BC3, so that they can be repacked into BC1 instead.
+static bool can_repack_as_bc1(detexTexture** in_textures,
+                              int nu_levels,
+                              uint32_t (*selectFormat)(uint32_t in_format)) {
+    if (!opaque_bc1 || nu_levels == 0 || selectFormat(DETEX_TEXTURE_FORMAT_BC3) != DETEX_TEXTURE_FORMAT_BC3) {
+        return false;
+    }
     for (int i = 0; i < nu_levels; ++i) {
-        detexTexture* in_texture = textures[i];
-        uint32_t out_format = selectFormat(in_texture->format);
-        if (in_texture->format == out_format) {
-            continue;
-        }
-        detexTexture* out_texture = (detexTexture*)malloc(sizeof(detexTexture));
-        uint32_t size = detexGetPixelSize(out_format) * in_texture->width * in_texture->height;
-        out_texture->data = (uint8_t*)malloc(size);
-        if (!detexDecompressTextureLinear(in_texture, out_texture->data, out_format)) {
-            free(out_texture->data);
-            free(out_texture);
+        if (!detexTextureIsOpaqueBC3(in_textures[i])) {
             return false;
         }
-        out_texture->format = out_format;
+    }
+    return true;
+}
+
+// Convert the levels in in_textures that selectFormat maps to another format,
+// storing the results in scratch. out_textures receives either the original or
+// the converted level.
+static bool convert_textures(detexTexture** in_textures,
+                             detexTexture** out_textures,
+                             int nu_levels,
+                             uint32_t (*selectFormat)(uint32_t in_format),
+                             Scratch* scratch,
+                             int nu_decode_threads) {
+    size_t offsets[MAX_LEVELS];
+    size_t total_size = 0;
+    bool repack_as_bc1 = can_repack_as_bc1(in_textures, nu_levels, selectFormat);
+    for (int i = 0; i < nu_levels; ++i) {
+        detexTexture* in_texture = in_textures[i];
+        detexTexture* out_texture = &scratch->levels[i];
+        out_texture->format = repack_as_bc1 ? DETEX_TEXTURE_FORMAT_BC1 : selectFormat(in_texture->format);
         out_texture->width = in_texture->width;
         out_texture->height = in_texture->height;
-        out_texture->width_in_blocks = in_texture->width;
-        out_texture->height_in_blocks = in_texture->height;
-        textures[i] = out_texture;
+        if (detexFormatIsCompressed(out_texture->format)) {
+            out_texture->width_in_blocks = (in_texture->width + 3) / 4;
+            out_texture->height_in_blocks = (in_texture->height + 3) / 4;
+        } else {
+            out_texture->width_in_blocks = in_texture->width;
+            out_texture->height_in_blocks = in_texture->height;
+        }
+        offsets[i] = total_size;
+        if (in_texture->format != out_texture->format ||
+            (detexFormatIsCompressed(in_texture->format) && (compress_flags & DETEX_COMPRESS_RDO_MASK))) {
+            total_size += (size_t)detextBytesPerBlock(out_texture->format) * out_texture->width_in_blocks *
+                          out_texture->height_in_blocks;
+        }
+    }
+    if (total_size > scratch->capacity) {
+        uint8_t* data = (uint8_t*)realloc(scratch->data, total_size);
+        if (data == NULL) {
+            detexSetErrorMessage("Out of memory");
+            return false;
+        }
+        scratch->data = data;
+        scratch->capacity = total_size;
+    }
+    for (int i = 0; i < nu_levels; ++i) {
+        detexTexture* in_texture = in_textures[i];
+        detexTexture* out_texture = &scratch->levels[i];
+        // Compressed levels are passed through the encoder for rate-distortion optimization.
+        if (in_texture->format == out_texture->format &&
+            !(detexFormatIsCompressed(in_texture->format) && (compress_flags & DETEX_COMPRESS_RDO_MASK))) {
+            out_textures[i] = in_texture;
+            continue;
+        }
+        out_texture->data = scratch->data + offsets[i];
+        bool r;
+        if (repack_as_bc1) {
+            r = detexConvertOpaqueBC3ToBC1(in_texture, out_texture->data);
+        } else if (detexFormatIsCompressed(out_texture->format)) {
+            r = detexCompressTextureParallel(
+                in_texture, out_texture->data, out_texture->format, compress_flags, nu_decode_threads);
+        } else {
+            r = detexDecompressTextureLinearParallel(
+                in_texture, out_texture->data, out_texture->format, nu_decode_threads);
+        }
+        if (!r) {
+            return false;
+        }
+        out_textures[i] = out_texture;
     }
     return true;
 }
 
-static bool read_textures(char* in_filename, detexTexture*** textures, int* nu_levels, FILE_TYPE in_file_type) {
+// Load the textures of a file. Unless copy is set, the file is mapped into memory and the textures
+// point into *mapping, which must be released with detexFileUnmap once they are no longer needed.
+static bool read_textures(char* in_filename,
+                          detexTexture*** textures,
+                          int* nu_levels,
+                          FILE_TYPE in_file_type,
+                          bool copy,
+                          detexFileMapping** mapping) {
     *textures = NULL;
     *nu_levels = 0;
+    *mapping = NULL;
     if (in_file_type == FILE_TYPE_NONE) {
         in_file_type = get_magic(in_filename);
     }
     switch (in_file_type) {
         case FILE_TYPE_KTX:
-            if (!detexFileLoadKTX(in_filename, 32, textures, nu_levels)) {
+            if (copy ? !detexFileLoadKTX(in_filename, MAX_LEVELS, textures, nu_levels)
+                     : !detexFileMapKTX(in_filename, MAX_LEVELS, textures, nu_levels, mapping)) {
                 return false;
             }
             break;
         case FILE_TYPE_DDS:
-            if (!detexFileLoadDDS(in_filename, 32, textures, nu_levels)) {
+            if (copy ? !detexFileLoadDDS(in_filename, MAX_LEVELS, textures, nu_levels)
+                     : !detexFileMapDDS(in_filename, MAX_LEVELS, textures, nu_levels, mapping)) {
                 return false;
             }
             break;
         case FILE_TYPE_TEX:
-            if (!detexFileLoadTEX(in_filename, 32, textures, nu_levels)) {
+            if (copy ? !detexFileLoadTEX(in_filename, MAX_LEVELS, textures, nu_levels)
+                     : !detexFileMapTEX(in_filename, MAX_LEVELS, textures, nu_levels, mapping)) {
                 return false;
             }
             break;
@@ -174,56 +328,717 @@ static bool read_textures(char* in_filename, detexTexture*** textures, int* nu_l
     return true;
 }
 
-static bool write_textures(char* out_filename, detexTexture** textures, int nu_levels, FILE_TYPE out_file_type) {
+// Write the textures to a file. When the textures point into mapping and none of the levels has to be
+// converted, the data is copied straight from the mapped file without reading it.
+static bool write_textures(char* out_filename,
+                           detexTexture** in_textures,
+                           int nu_levels,
+                           FILE_TYPE out_file_type,
+                           const detexFileMapping* mapping,
+                           Scratch* scratch,
+                           int nu_decode_threads) {
+    detexTexture* textures[MAX_LEVELS];
+    uint32_t (*selectFormat)(uint32_t in_format);
     if (out_file_type == FILE_TYPE_NONE) {
         out_file_type = get_extension(out_filename);
     }
     switch (out_file_type) {
         case FILE_TYPE_KTX:
-            if (!convert_textures(textures, nu_levels, &format_for_ktx)) {
-                return false;
-            }
-            if (!detexFileSaveKTX(out_filename, textures, nu_levels)) {
-                return false;
-            }
+            selectFormat = &format_for_ktx;
             break;
         case FILE_TYPE_DDS:
-            if (!convert_textures(textures, nu_levels, &format_for_dds)) {
-                return false;
-            }
-            if (!detexFileSaveDDS(out_filename, textures, nu_levels)) {
-                return false;
-            }
+            selectFormat = &format_for_dds;
             break;
         case FILE_TYPE_TEX:
-            if (!convert_textures(textures, nu_levels, &format_for_tex)) {
-                return false;
-            }
-            if (!detexFileSaveTEX(out_filename, textures, nu_levels)) {
-                return false;
-            }
+            selectFormat = &format_for_tex;
             break;
         default:
             detexSetErrorMessage("Invalid output file type %d", out_file_type);
             return false;
     }
+    if (!convert_textures(in_textures, textures, nu_levels, selectFormat, scratch, nu_decode_threads)) {
+        return false;
+    }
+    bool rewrap = mapping != NULL;
+    for (int i = 0; i < nu_levels && rewrap; ++i) {
+        rewrap = textures[i] == in_textures[i];
+    }
+    if (rewrap) {
+        return detexFileRewrap(out_filename, out_file_type, textures, nu_levels, mapping);
+    }
+    switch (out_file_type) {
+        case FILE_TYPE_KTX:
+            return detexFileSaveKTX(out_filename, textures, nu_levels);
+        case FILE_TYPE_DDS:
+            return detexFileSaveDDS(out_filename, textures, nu_levels);
+        default:
+            return detexFileSaveTEX(out_filename, textures, nu_levels);
+    }
+}
+
+// Free the first nu_dropped levels and move the remaining ones to the front.
+static void drop_levels(detexTexture** textures, int* nu_levels, int nu_dropped) {
+    for (int i = 0; i < nu_dropped; ++i) {
+        if (!(textures[i]->flags & DETEX_TEXTURE_FLAG_BORROWED_DATA)) {
+            free(textures[i]->data);
+        }
+        free(textures[i]);
+    }
+    memmove(textures, textures + nu_dropped, (*nu_levels - nu_dropped) * sizeof(detexTexture*));
+    *nu_levels -= nu_dropped;
+}
+
+// Whether both names refer to the same existing file, however they are spelled.
+static bool is_same_file(char* filename1, char* filename2) {
+#ifdef _WIN32
+    BY_HANDLE_FILE_INFORMATION info[2];
+    char* filenames[2] = {filename1, filename2};
+    for (int i = 0; i < 2; ++i) {
+        HANDLE file = CreateFileA(filenames[i],
+                                  0,
+                                  FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                  NULL,
+                                  OPEN_EXISTING,
+                                  FILE_FLAG_BACKUP_SEMANTICS,
+                                  NULL);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        BOOL r = GetFileInformationByHandle(file, &info[i]);
+        CloseHandle(file);
+        if (!r) {
+            return false;
+        }
+    }
+    return info[0].dwVolumeSerialNumber == info[1].dwVolumeSerialNumber &&
+           info[0].nFileIndexHigh == info[1].nFileIndexHigh && info[0].nFileIndexLow == info[1].nFileIndexLow;
+#else
+    struct stat st1, st2;
+    return stat(filename1, &st1) == 0 && stat(filename2, &st2) == 0 && st1.st_dev == st2.st_dev &&
+           st1.st_ino == st2.st_ino;
+#endif
+}
+
+// Replace filename by temp_filename.
+static bool replace_file(char* temp_filename, char* filename) {
+#ifdef _WIN32
+    if (!MoveFileExA(temp_filename, filename, MOVEFILE_REPLACE_EXISTING)) {
+#else
+    if (rename(temp_filename, filename) != 0) {
+#endif
+        detexSetErrorMessage("Can't rename %s to %s", temp_filename, filename);
+        remove(temp_filename);
+        return false;
+    }
     return true;
 }
 
-int main(int argc, char** argv) {
-    int nu_levels = 0;
+static bool convert_file(char* in_filename, char* out_filename, Scratch* scratch, int nu_decode_threads) {
     detexTexture** textures = NULL;
-    // Check arguments
-    if (argc < 3) {
-        fprintf(stderr, "Bad arguments: ritotex <INPUT_FILE> <OUTPUT_FILE>");
+    int nu_levels = 0;
+    detexFileMapping* mapping = NULL;
+    // A file that is mapped can't be overwritten while its textures are in use.
+    bool copy = is_same_file(in_filename, out_filename);
+    if (!read_textures(in_filename, &textures, &nu_levels, FILE_TYPE_NONE, copy, &mapping)) {
+        fprintf(stderr, "Failed to read_textures %s: %s\n", in_filename, detexGetErrorMessage());
+        return false;
+    }
+    // The remaining levels are written as they are, with the header of the new first level.
+    drop_levels(textures, &nu_levels, min(drop_mips, nu_levels - 1));
+    if (mipmap_filter >= 0) {
+        detexTexture** mipmaps = NULL;
+        int nu_mipmaps = 0;
+        bool r = detexGenerateMipmaps(
+            textures[0], mipmap_filter, mipmap_flags, nu_decode_threads, &mipmaps, &nu_mipmaps);
+        detexFreeTextures(textures, nu_levels);
+        detexFileUnmap(mapping);
+        mapping = NULL;
+        if (!r) {
+            fprintf(stderr, "Failed to generate mipmaps %s: %s\n", in_filename, detexGetErrorMessage());
+            return false;
+        }
+        textures = mipmaps;
+        nu_levels = nu_mipmaps;
+    }
+    // The output is written next to the target and renamed over it once complete, so that a failed
+    // conversion never leaves a truncated file behind, nor destroys the input.
+    size_t length = strlen(out_filename);
+    char* temp_filename = (char*)malloc(length + 5);
+    memcpy(temp_filename, out_filename, length);
+    memcpy(temp_filename + length, ".tmp", 5);
+    bool r = write_textures(temp_filename,
+                            textures,
+                            nu_levels,
+                            get_extension(out_filename),
+                            mapping,
+                            scratch,
+                            nu_decode_threads);
+    if (r) {
+        r = replace_file(temp_filename, out_filename);
+    } else {
+        remove(temp_filename);
+    }
+    if (!r) {
+        fprintf(stderr, "Failed to write_textures %s: %s\n", out_filename, detexGetErrorMessage());
+    }
+    free(temp_filename);
+    detexFreeTextures(textures, nu_levels);
+    detexFileUnmap(mapping);
+    return r;
+}
+
+static long long get_file_size(char* filename) {
+    FILE* file = fopen(filename, "rb");
+    if (!file) {
+        return 0;
+    }
+    fseek(file, 0, SEEK_END);
+    long long size = ftell(file);
+    fclose(file);
+    return size;
+}
+
+static bool is_directory(char* path) {
+#ifdef _WIN32
+    DWORD attributes = GetFileAttributesA(path);
+    return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+#endif
+}
+
+static bool create_directory(char* path) {
+#ifdef _WIN32
+    bool r = CreateDirectoryA(path, NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+#else
+    bool r = mkdir(path, 0777) == 0 || errno == EEXIST;
+#endif
+    if (!r || !is_directory(path)) {
+        detexSetErrorMessage("Can't create directory");
+        return false;
+    }
+    return true;
+}
+
+static double get_time() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+typedef struct BatchFile {
+    char* in_filename;
+    char* out_filename;
+} BatchFile;
+
+typedef struct BatchStats {
+    int nu_converted;
+    int nu_failed;
+    long long in_bytes;
+    long long out_bytes;
+} BatchStats;
+
+typedef struct Batch {
+    BatchFile* files;
+    int nu_files;
+    int capacity;
+    char* out_directory;
+    char* out_extension;
+    Scratch* scratch;    // One per worker.
+    BatchStats* stats;   // One per worker.
+} Batch;
+
+static char* copy_string(const char* s, size_t length) {
+    char* copy = (char*)malloc(length + 1);
+    memcpy(copy, s, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+// Output files of directories, globs and manifest lines without an explicit
+// output go to out_directory, with the input extension replaced.
+static char* make_out_filename(Batch* batch, const char* in_filename) {
+    const char* name = in_filename;
+    for (const char* c = in_filename; *c; ++c) {
+        if (*c == '/' || *c == '\\') {
+            name = c + 1;
+        }
+    }
+    size_t name_length = strlen(name);
+    const char* dot = strrchr(name, '.');
+    if (dot != NULL && dot != name) {
+        name_length = dot - name;
+    }
+    size_t directory_length = strlen(batch->out_directory);
+    size_t extension_length = strlen(batch->out_extension);
+    char* out_filename = (char*)malloc(directory_length + 1 + name_length + 1 + extension_length + 1);
+    sprintf(out_filename, "%s/%.*s.%s", batch->out_directory, (int)name_length, name, batch->out_extension);
+    return out_filename;
+}
+
+static void add_batch_file(Batch* batch, const char* in_filename, size_t in_length, char* out_filename) {
+    if (batch->nu_files == batch->capacity) {
+        batch->capacity = batch->capacity == 0 ? 256 : batch->capacity * 2;
+        batch->files = (BatchFile*)realloc(batch->files, batch->capacity * sizeof(BatchFile));
+    }
+    BatchFile* file = &batch->files[batch->nu_files++];
+    file->in_filename = copy_string(in_filename, in_length);
+    // Without an output directory (--info), files have no output.
+    file->out_filename =
+        out_filename != NULL || batch->out_directory == NULL ? out_filename : make_out_filename(batch, file->in_filename);
+}
+
+// Add the texture files in a directory (not recursive).
+static bool add_batch_directory(Batch* batch, char* directory) {
+    char path[4096];
+#ifdef _WIN32
+    snprintf(path, sizeof(path), "%s\\*", directory);
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA(path, &data);
+    if (find == INVALID_HANDLE_VALUE) {
+        detexSetErrorMessage("Can't open directory");
+        return false;
+    }
+    do {
+        if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            continue;
+        }
+        int length = snprintf(path, sizeof(path), "%s\\%s", directory, data.cFileName);
+        if (get_extension(path) != FILE_TYPE_NONE) {
+            add_batch_file(batch, path, length, NULL);
+        }
+    } while (FindNextFileA(find, &data));
+    FindClose(find);
+#else
+    DIR* dir = opendir(directory);
+    if (dir == NULL) {
+        detexSetErrorMessage("Can't open directory");
+        return false;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        int length = snprintf(path, sizeof(path), "%s/%s", directory, entry->d_name);
+        if (get_extension(path) != FILE_TYPE_NONE && !is_directory(path)) {
+            add_batch_file(batch, path, length, NULL);
+        }
+    }
+    closedir(dir);
+#endif
+    return true;
+}
+
+// Add the files matching a wildcard pattern. On Windows, only the last path
+// component may contain wildcards.
+static bool add_batch_glob(Batch* batch, char* pattern) {
+#ifdef _WIN32
+    char path[4096];
+    size_t directory_length = 0;
+    for (size_t i = 0; pattern[i]; ++i) {
+        if (pattern[i] == '/' || pattern[i] == '\\') {
+            directory_length = i + 1;
+        }
+    }
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA(pattern, &data);
+    if (find == INVALID_HANDLE_VALUE) {
+        return true;
+    }
+    do {
+        if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            continue;
+        }
+        int length = snprintf(path, sizeof(path), "%.*s%s", (int)directory_length, pattern, data.cFileName);
+        add_batch_file(batch, path, length, NULL);
+    } while (FindNextFileA(find, &data));
+    FindClose(find);
+#else
+    glob_t g;
+    int r = glob(pattern, 0, NULL, &g);
+    if (r == GLOB_NOMATCH) {
+        return true;
+    }
+    if (r != 0) {
+        detexSetErrorMessage("Invalid glob pattern");
+        return false;
+    }
+    for (size_t i = 0; i < g.gl_pathc; ++i) {
+        if (!is_directory(g.gl_pathv[i])) {
+            add_batch_file(batch, g.gl_pathv[i], strlen(g.gl_pathv[i]), NULL);
+        }
+    }
+    globfree(&g);
+#endif
+    return true;
+}
+
+// A manifest has one input file per line, optionally followed by a tab and the
+// output file. Empty lines and lines starting with '#' are skipped.
+static bool add_batch_manifest(Batch* batch, char* manifest) {
+    FILE* file = fopen(manifest, "rt");
+    if (!file) {
+        detexSetErrorMessage("Can't open manifest file");
+        return false;
+    }
+    char line[8192];
+    while (fgets(line, sizeof(line), file)) {
+        size_t length = strcspn(line, "\r\n");
+        line[length] = '\0';
+        if (length == 0 || line[0] == '#') {
+            continue;
+        }
+        char* tab = strchr(line, '\t');
+        if (tab != NULL) {
+            add_batch_file(batch, line, tab - line, copy_string(tab + 1, strlen(tab + 1)));
+        } else {
+            add_batch_file(batch, line, length, NULL);
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+static bool convert_batch_file(void* context, int worker, int index) {
+    Batch* batch = (Batch*)context;
+    BatchFile* file = &batch->files[index];
+    BatchStats* stats = &batch->stats[worker];
+    // Files are already spread over the workers, so every file is decoded on a
+    // single thread.
+    if (!convert_file(file->in_filename, file->out_filename, &batch->scratch[worker], 1)) {
+        stats->nu_failed++;
+        return false;
+    }
+    stats->nu_converted++;
+    stats->in_bytes += get_file_size(file->in_filename);
+    stats->out_bytes += get_file_size(file->out_filename);
+    return true;
+}
+
+static int run_batch(char* out_type, char* source, char* out_directory) {
+    Batch batch = {0};
+    batch.out_directory = out_directory;
+    batch.out_extension = out_type;
+    if (!create_directory(out_directory)) {
+        fprintf(stderr, "Failed to create output directory %s: %s\n", out_directory, detexGetErrorMessage());
+        return EXIT_FAILURE;
+    }
+    bool r;
+    if (is_directory(source)) {
+        r = add_batch_directory(&batch, source);
+    } else if (strpbrk(source, "*?[") != NULL) {
+        r = add_batch_glob(&batch, source);
+    } else {
+        r = add_batch_manifest(&batch, source);
+    }
+    if (!r) {
+        fprintf(stderr, "Failed to list batch files %s: %s\n", source, detexGetErrorMessage());
         return EXIT_FAILURE;
     }
-    if (!read_textures(argv[1], &textures, &nu_levels, FILE_TYPE_NONE)) {
-        fprintf(stderr, "Failed to read_textures: %s\n", detexGetErrorMessage());
+    int nu_workers = nu_threads > 0 ? nu_threads : detexGetNumberOfProcessors();
+    batch.scratch = (Scratch*)calloc(nu_workers, sizeof(Scratch));
+    batch.stats = (BatchStats*)calloc(nu_workers, sizeof(BatchStats));
+    double start_time = get_time();
+    detexParallelForWorkers(batch.nu_files, nu_workers, convert_batch_file, &batch);
+    double elapsed_time = get_time() - start_time;
+    BatchStats total = {0};
+    for (int i = 0; i < nu_workers; ++i) {
+        total.nu_converted += batch.stats[i].nu_converted;
+        total.nu_failed += batch.stats[i].nu_failed;
+        total.in_bytes += batch.stats[i].in_bytes;
+        total.out_bytes += batch.stats[i].out_bytes;
+        free(batch.scratch[i].data);
+    }
+    if (elapsed_time <= 0) {
+        elapsed_time = 1e-9;
+    }
+    printf("Converted %d files (%d failed) in %.3f s using %d threads: %.1f files/s, %.1f MB/s in, %.1f MB/s out\n",
+           total.nu_converted,
+           total.nu_failed,
+           elapsed_time,
+           nu_workers,
+           total.nu_converted / elapsed_time,
+           total.in_bytes / elapsed_time / (1024.0 * 1024.0),
+           total.out_bytes / elapsed_time / (1024.0 * 1024.0));
+    for (int i = 0; i < batch.nu_files; ++i) {
+        free(batch.files[i].in_filename);
+        free(batch.files[i].out_filename);
+    }
+    free(batch.files);
+    free(batch.scratch);
+    free(batch.stats);
+    return total.nu_failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Output formats of --info.
+typedef enum INFO_FORMAT {
+    INFO_FORMAT_NONE = 0,
+    INFO_FORMAT_JSON = 1,
+    INFO_FORMAT_CSV = 2,
+} INFO_FORMAT;
+
+static INFO_FORMAT info_format = INFO_FORMAT_NONE;
+
+typedef struct InfoScan {
+    Batch* batch;
+    char** lines;  // One per file, NULL if probing it failed.
+} InfoScan;
+
+// Write s as a JSON string or a CSV field to buffer, which must have room for
+// 6 * strlen(s) + 3 characters. Returns the number of characters written.
+static int quote_string(char* buffer, const char* s) {
+    char* p = buffer;
+    *p++ = '"';
+    for (; *s; ++s) {
+        unsigned char c = (unsigned char)*s;
+        if (info_format == INFO_FORMAT_CSV) {
+            if (c == '"') {
+                *p++ = '"';
+            }
+            *p++ = c;
+        } else if (c == '"' || c == '\\') {
+            *p++ = '\\';
+            *p++ = c;
+        } else if (c < 0x20) {
+            p += sprintf(p, "\\u%04x", c);
+        } else {
+            *p++ = c;
+        }
+    }
+    *p++ = '"';
+    *p = '\0';
+    return (int)(p - buffer);
+}
+
+static const char* get_file_type_name(uint32_t file_type) {
+    switch (file_type) {
+        case FILE_TYPE_KTX:
+            return "ktx";
+        case FILE_TYPE_DDS:
+            return "dds";
+        default:
+            return "tex";
+    }
+}
+
+// Probe a file of an --info scan, formatting its line of output.
+static bool probe_info_file(void* context, int worker, int index) {
+    InfoScan* scan = (InfoScan*)context;
+    char* filename = scan->batch->files[index].in_filename;
+    detexFileLayout layout;
+    if (!detexFileProbe(filename, &layout)) {
+        fprintf(stderr, "Failed to probe %s: %s\n", filename, detexGetErrorMessage());
+        return false;
+    }
+    const detexTexture* level = &layout.levels[0];
+    char* line = (char*)malloc(strlen(filename) * 6 + 256 + layout.nu_levels * 96);
+    int length = info_format == INFO_FORMAT_JSON ? sprintf(line, "  {\"file\": ") : 0;
+    length += quote_string(line + length, filename);
+    size_t data_size = 0;
+    for (int i = 0; i < layout.nu_levels; ++i) {
+        data_size += layout.sizes[i];
+    }
+    if (info_format == INFO_FORMAT_CSV) {
+        sprintf(line + length,
+                ",%s,%s,%u,%u,%d,%llu,%llu\n",
+                get_file_type_name(layout.file_type),
+                detexGetTextureFormatText(level->format),
+                level->width,
+                level->height,
+                layout.nu_levels,
+                (unsigned long long)layout.file_size,
+                (unsigned long long)data_size);
+    } else {
+        length += sprintf(line + length,
+                          ", \"container\": \"%s\", \"format\": \"%s\", \"width\": %u, \"height\": %u, "
+                          "\"file_size\": %llu, \"data_size\": %llu, \"levels\": [",
+                          get_file_type_name(layout.file_type),
+                          detexGetTextureFormatText(level->format),
+                          level->width,
+                          level->height,
+                          (unsigned long long)layout.file_size,
+                          (unsigned long long)data_size);
+        for (int i = 0; i < layout.nu_levels; ++i) {
+            length += sprintf(line + length,
+                              "%s{\"width\": %u, \"height\": %u, \"offset\": %llu, \"size\": %llu}",
+                              i > 0 ? ", " : "",
+                              layout.levels[i].width,
+                              layout.levels[i].height,
+                              (unsigned long long)layout.offsets[i],
+                              (unsigned long long)layout.sizes[i]);
+        }
+        sprintf(line + length, "]}");
+    }
+    scan->lines[index] = line;
+    return true;
+}
+
+// Print the header information of a texture file, or of the texture files in a
+// directory, glob or manifest, probing them in parallel.
+static int run_info(char* source) {
+    Batch batch = {0};
+    bool r = true;
+    if (is_directory(source)) {
+        r = add_batch_directory(&batch, source);
+    } else if (strpbrk(source, "*?[") != NULL) {
+        r = add_batch_glob(&batch, source);
+    } else if (get_extension(source) != FILE_TYPE_NONE) {
+        add_batch_file(&batch, source, strlen(source), NULL);
+    } else {
+        r = add_batch_manifest(&batch, source);
+    }
+    if (!r) {
+        fprintf(stderr, "Failed to list files %s: %s\n", source, detexGetErrorMessage());
+        return EXIT_FAILURE;
+    }
+    InfoScan scan = {&batch, (char**)calloc(batch.nu_files + 1, sizeof(char*))};
+    int nu_workers = nu_threads > 0 ? nu_threads : detexGetNumberOfProcessors();
+    double start_time = get_time();
+    detexParallelForWorkers(batch.nu_files, nu_workers, probe_info_file, &scan);
+    double elapsed_time = get_time() - start_time;
+    printf(info_format == INFO_FORMAT_JSON ? "[\n" : "file,container,format,width,height,levels,file_size,data_size\n");
+    int nu_failed = 0;
+    const char* separator = "";
+    for (int i = 0; i < batch.nu_files; ++i) {
+        if (scan.lines[i] == NULL) {
+            nu_failed++;
+        } else {
+            printf("%s%s", separator, scan.lines[i]);
+            // CSV lines end with a newline, JSON objects are separated by commas.
+            separator = info_format == INFO_FORMAT_JSON ? ",\n" : "";
+        }
+        free(scan.lines[i]);
+        free(batch.files[i].in_filename);
+        free(batch.files[i].out_filename);
+    }
+    if (info_format == INFO_FORMAT_JSON) {
+        printf("\n]\n");
+    }
+    fprintf(stderr,
+            "Probed %d files (%d failed) in %.3f s using %d threads\n",
+            batch.nu_files - nu_failed,
+            nu_failed,
+            elapsed_time,
+            nu_workers);
+    free(scan.lines);
+    free(batch.files);
+    return nu_failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static bool is_batch_type(char* type) {
+    return strcmp(type, "dds") == 0 || strcmp(type, "ktx") == 0 || strcmp(type, "tex") == 0;
+}
+
+#define OPTIONS_USAGE                                                                                 \
+    "[--fast] [--budget N] [--rdo LAMBDA] [--opaque-bc1] [--drop-mips N] [--threads N] "              \
+    "[--mips box|kaiser] [--srgb] [--tex-format bc|etc1|etc2] [--format bc1|bc3|bc4|bc4s|bc5|bc5s|bc6h|bc6hs|bc7]"
+
+int main(int argc, char** argv) {
+    char* filenames[3] = {NULL, NULL, NULL};
+    int nu_filenames = 0;
+    bool batch = false;
+    bool bad_arguments = false;
+    // Check arguments
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--fast") == 0) {
+            compress_flags &= ~DETEX_COMPRESS_FLAG_QUALITY;
+        } else if (strcmp(argv[i], "--budget") == 0 && i + 1 < argc) {
+            int budget = atoi(argv[++i]);
+            if (budget < 1 || budget > 255) {
+                bad_arguments = true;
+            }
+            compress_flags = (compress_flags & ~DETEX_COMPRESS_BUDGET_MASK) | DETEX_COMPRESS_FLAG_BUDGET(budget);
+        } else if (strcmp(argv[i], "--rdo") == 0 && i + 1 < argc) {
+            int lambda = atoi(argv[++i]);
+            if (lambda < 1 || lambda > 255) {
+                bad_arguments = true;
+            }
+            compress_flags = (compress_flags & ~DETEX_COMPRESS_RDO_MASK) | DETEX_COMPRESS_FLAG_RDO(lambda);
+        } else if (strcmp(argv[i], "--opaque-bc1") == 0) {
+            opaque_bc1 = true;
+        } else if (strcmp(argv[i], "--drop-mips") == 0 && i + 1 < argc) {
+            drop_mips = atoi(argv[++i]);
+            if (drop_mips < 1 || drop_mips >= MAX_LEVELS) {
+                bad_arguments = true;
+            }
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            char* end;
+            long threads = strtol(argv[++i], &end, 10);
+            if (end == argv[i] || *end != '\0' || threads < 0 || threads > 1024) {
+                bad_arguments = true;
+            }
+            nu_threads = (int)threads;
+        } else if (strcmp(argv[i], "--info") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "json") == 0) {
+                info_format = INFO_FORMAT_JSON;
+            } else if (strcmp(argv[i], "csv") == 0) {
+                info_format = INFO_FORMAT_CSV;
+            } else {
+                bad_arguments = true;
+            }
+        } else if (strcmp(argv[i], "--batch") == 0) {
+            batch = true;
+        } else if (strcmp(argv[i], "--mips") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "box") == 0) {
+                mipmap_filter = DETEX_MIPMAP_FILTER_BOX;
+            } else if (strcmp(argv[i], "kaiser") == 0) {
+                mipmap_filter = DETEX_MIPMAP_FILTER_KAISER;
+            } else {
+                bad_arguments = true;
+            }
+        } else if (strcmp(argv[i], "--srgb") == 0) {
+            mipmap_flags |= DETEX_MIPMAP_FLAG_SRGB;
+        } else if (strcmp(argv[i], "--tex-format") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "bc") == 0) {
+                tex_format = TEX_FORMAT_BC;
+            } else if (strcmp(argv[i], "etc1") == 0) {
+                tex_format = TEX_FORMAT_ETC1;
+            } else if (strcmp(argv[i], "etc2") == 0) {
+                tex_format = TEX_FORMAT_ETC2;
+            } else {
+                bad_arguments = true;
+            }
+        } else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            i++;
+            output_format = 0;
+            for (size_t f = 0; f < sizeof(output_formats) / sizeof(output_formats[0]); f++) {
+                if (strcmp(argv[i], output_formats[f].name) == 0) {
+                    output_format = output_formats[f].format;
+                }
+            }
+            if (output_format == 0) {
+                bad_arguments = true;
+            }
+        } else if (nu_filenames < 3) {
+            filenames[nu_filenames++] = argv[i];
+        } else {
+            bad_arguments = true;
+        }
+    }
+    if (info_format != INFO_FORMAT_NONE) {
+        if (bad_arguments || batch || nu_filenames != 1) {
+            fprintf(stderr, "Bad arguments: ritotex [--threads N] --info <json|csv> <FILE|DIRECTORY|GLOB|MANIFEST>");
+            return EXIT_FAILURE;
+        }
+        return run_info(filenames[0]);
+    }
+    if (batch) {
+        if (bad_arguments || nu_filenames != 3 || !is_batch_type(filenames[0])) {
+            fprintf(stderr,
+                    "Bad arguments: ritotex " OPTIONS_USAGE
+                    " --batch <dds|ktx|tex> <DIRECTORY|GLOB|MANIFEST> <OUTPUT_DIRECTORY>");
+            return EXIT_FAILURE;
+        }
+        return run_batch(filenames[0], filenames[1], filenames[2]);
+    }
+    if (bad_arguments || nu_filenames != 2) {
+        fprintf(stderr, "Bad arguments: ritotex " OPTIONS_USAGE " <INPUT_FILE> <OUTPUT_FILE>");
         return EXIT_FAILURE;
     }
-    if (!write_textures(argv[2], textures, nu_levels, FILE_TYPE_NONE)) {
-        fprintf(stderr, "Failed to write_textures: %s\n", detexGetErrorMessage());
+    Scratch scratch = {0};
+    if (!convert_file(filenames[0], filenames[1], &scratch, nu_threads)) {
         return EXIT_FAILURE;
     }
     return EXIT_SUCCESS;